@@ -15,12 +15,16 @@
  */
 
 #include <iostream>
+#include <memory>
 #include <random>
 #include <qcoreapplication.h>
 #include <QStringList>
 #include <QUrl>
+#include <QVector>
+#include <QPair>
 #include <QFile>
 #include <QFileInfo>
+#include <QDir>
 #include <QJsonDocument>
 #include <QJsonObject>
 #include <QNetworkProxy>
@@ -35,7 +39,11 @@
 #endif
 #include "simplesslerrorhandler.h"
 #include "syncengine.h"
+#include "syncscheduler.h"
+#include "syncstatistics.h"
+#include "vfsoptions.h"
 #include "common/syncjournaldb.h"
+#include "common/vfs.h"
 #include "config.h"
 #include "csync_exclude.h"
 
@@ -81,6 +89,11 @@ struct CmdOptions
     int restartTimes;
     int downlimit;
     int uplimit;
+    bool watch;
+    int pollInterval;
+    QVector<QPair<QString, QString>> extraFolders; /// local dir and remote path
+    QString statsJson; /// file the statistics of each run are appended to, "-" for stdout
+    VfsOptions vfs;
 };
 
 // we can't use csync_set_userdata because the SyncEngine sets it already.
@@ -183,6 +196,7 @@ void help()
     std::cout << "  --trust                Trust the SSL certification." << std::endl;
     std::cout << "  --exclude [file]       Exclude list file" << std::endl;
     std::cout << "  --unsyncedfolders [file]    File containing the list of unsynced remote folders (selective sync)" << std::endl;
+    std::cout << "                         of the main folder, not of those given with --folder" << std::endl;
     std::cout << "  --user, -u [name]      Use [name] as the login name" << std::endl;
     std::cout << "  --password, -p [pass]  Use [pass] as password" << std::endl;
     std::cout << "  -n                     Use netrc (5) for login" << std::endl;
@@ -194,6 +208,21 @@ void help()
     std::cout << "  --version, -v          Display version and exit" << std::endl;
     std::cout << "  --logdebug             More verbose logging" << std::endl;
     std::cout << "  --path                 Path to a folder on a remote server" << std::endl;
+    std::cout << "  --folder [dir] [path]  Also sync the local [dir] with the remote [path]," << std::endl;
+    std::cout << "                         may be given several times" << std::endl;
+    std::cout << "  --watch                Keep running and sync local and remote changes" << std::endl;
+    std::cout << "                         as they happen" << std::endl;
+    std::cout << "  --poll-interval [s]    With --watch, check for remote changes every s" << std::endl;
+    std::cout << "                         seconds when push notifications are not available" << std::endl;
+    std::cout << "                         (default 30)" << std::endl;
+    std::cout << "  --vfs [mode]           Create virtual files instead of downloading the" << std::endl;
+    std::cout << "                         content, mode is suffix or xattr" << std::endl;
+    std::cout << "  --hydrate [path]       With --vfs, always keep the content of the local" << std::endl;
+    std::cout << "                         path, may be given several times" << std::endl;
+    std::cout << "  --dehydrate [path]     With --vfs, replace the local path by virtual" << std::endl;
+    std::cout << "                         files, may be given several times" << std::endl;
+    std::cout << "  --stats-json [file]    Append the statistics of each sync run as one" << std::endl;
+    std::cout << "                         JSON line to file, - for stdout" << std::endl;
     std::cout << "" << std::endl;
     exit(0);
 }
@@ -204,6 +233,61 @@ void showVersion()
     exit(0);
 }
 
+QString localDirectoryArgument(QString dir)
+{
+    if (!dir.endsWith('/')) {
+        dir.append('/');
+    }
+    QFileInfo fi(dir);
+    if (!fi.exists()) {
+        std::cerr << "Source dir '" << qPrintable(dir) << "' does not exist." << std::endl;
+        exit(1);
+    }
+    return fi.absoluteFilePath();
+}
+
+static void writeStatistics(const QString &target, const QJsonObject &statistics)
+{
+    const QByteArray line = QJsonDocument(statistics).toJson(QJsonDocument::Compact);
+    if (target == "-") {
+        std::cout << line.constData() << std::endl;
+        return;
+    }
+    QFile file(target);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Append)) {
+        qWarning() << "Could not write the sync statistics to" << target << file.errorString();
+        return;
+    }
+    file.write(line + '\n');
+}
+
+/**
+ * Starts the virtual files plugin of the folder, see VfsOptions::setupFolder().
+ */
+static QSharedPointer<Vfs> setupVirtualFiles(const CmdOptions &options, const AccountPtr &account,
+    const QString &localDir, const QString &remotePath, SyncJournalDb *db, bool isMainFolder)
+{
+    QSharedPointer<Vfs> vfs(createVfsFromPlugin(options.vfs.mode).release());
+    if (!vfs) {
+        std::cerr << "Could not load the virtual files plugin" << std::endl;
+        return {};
+    }
+
+    VfsSetupParams params;
+    params.filesystemPath = localDir.endsWith('/') ? localDir : localDir + '/';
+    params.displayName = QDir(localDir).dirName();
+    params.alias = params.displayName;
+    params.remotePath = remotePath.endsWith('/') ? remotePath : remotePath + '/';
+    params.account = account;
+    params.journal = db;
+    params.providerName = Theme::instance()->appNameGUI();
+    params.providerVersion = Theme::instance()->version();
+    vfs->start(params);
+
+    options.vfs.setupFolder(*vfs, params.filesystemPath, *db, isMainFolder);
+    return vfs;
+}
+
 void parseOptions(const QStringList &app_args, CmdOptions *options)
 {
     QStringList args(app_args);
@@ -222,16 +306,7 @@ void parseOptions(const QStringList &app_args, CmdOptions *options)
 
     options->target_url = args.takeLast();
 
-    options->source_dir = args.takeLast();
-    if (!options->source_dir.endsWith('/')) {
-        options->source_dir.append('/');
-    }
-    QFileInfo fi(options->source_dir);
-    if (!fi.exists()) {
-        std::cerr << "Source dir '" << qPrintable(options->source_dir) << "' does not exist." << std::endl;
-        exit(1);
-    }
-    options->source_dir = fi.absoluteFilePath();
+    options->source_dir = localDirectoryArgument(args.takeLast());
 
     QStringListIterator it(args);
     // skip file name;
@@ -272,6 +347,22 @@ void parseOptions(const QStringList &app_args, CmdOptions *options)
             Logger::instance()->setLogDebug(true);
         } else if (option == "--path" && !it.peekNext().startsWith("-")) {
             options->remotePath = it.next();
+        } else if (option == "--folder" && !it.peekNext().startsWith("-")) {
+            const auto localDir = localDirectoryArgument(it.next());
+            if (!it.hasNext() || it.peekNext().startsWith("-")) {
+                help();
+            }
+            options->extraFolders.append(qMakePair(localDir, it.next()));
+        } else if (option == "--watch") {
+            options->watch = true;
+        } else if (option == "--poll-interval" && !it.peekNext().startsWith("-")) {
+            options->pollInterval = qMax(1, it.next().toInt());
+        } else if (option == "--stats-json" && it.hasNext() && (it.peekNext() == "-" || !it.peekNext().startsWith("-"))) {
+            options->statsJson = it.next();
+        } else if ((option == "--vfs" || option == "--hydrate" || option == "--dehydrate") && !it.peekNext().startsWith("-")) {
+            if (!options->vfs.parseOption(option, it.next())) {
+                help();
+            }
         }
         else {
             help();
@@ -330,9 +421,20 @@ int main(int argc, char **argv)
     options.restartTimes = 3;
     options.uplimit = 0;
     options.downlimit = 0;
+    options.watch = false;
+    options.pollInterval = 30;
 
     parseOptions(app.arguments(), &options);
 
+    if (!options.vfs.pinStates.isEmpty() && options.vfs.mode == Vfs::Off) {
+        std::cerr << "--hydrate and --dehydrate need --vfs" << std::endl;
+        return EXIT_FAILURE;
+    }
+    if (options.vfs.mode != Vfs::Off && !isVfsPluginAvailable(options.vfs.mode)) {
+        std::cerr << "Virtual files mode '" << qPrintable(Vfs::modeToString(options.vfs.mode)) << "' is not available" << std::endl;
+        return EXIT_FAILURE;
+    }
+
     if (options.silent) {
         qInstallMessageHandler(nullMessageHandler);
     } else {
@@ -468,11 +570,10 @@ int main(int argc, char **argv)
     job->start();
     loop.exec();
 
-    // much lower age than the default since this utility is usually made to be run right after a change in the tests
-    SyncEngine::minimumFileAgeForUpload = std::chrono::milliseconds(0);
-
-    int restartCount = 0;
-restart_sync:
+    if (!options.watch) {
+        // much lower age than the default since this utility is usually made to be run right after a change in the tests
+        SyncEngine::minimumFileAgeForUpload = std::chrono::milliseconds(0);
+    }
 
     opts = &options;
 
@@ -494,59 +595,83 @@ restart_sync:
     }
 
     Cmd cmd;
-    QString dbPath = options.source_dir + SyncJournalDb::makeDbName(options.source_dir, credentialFreeUrl, folder, user);
-    SyncJournalDb db(dbPath);
-
-    if (!selectiveSyncList.empty()) {
-        selectiveSyncFixup(&db, selectiveSyncList);
-    }
-
-    SyncOptions opt;
-    opt.fillFromEnvironmentVariables();
-    opt.verifyChunkSizes();
-    SyncEngine engine(account, options.source_dir, folder, &db);
-    engine.setIgnoreHiddenFiles(options.ignoreHiddenFiles);
-    engine.setNetworkLimits(options.uplimit, options.downlimit);
-    QObject::connect(&engine, &SyncEngine::finished,
-        [&app](bool result) { app.exit(result ? EXIT_SUCCESS : EXIT_FAILURE); });
-    QObject::connect(&engine, &SyncEngine::transmissionProgress, &cmd, &Cmd::transmissionProgressSlot);
-    QObject::connect(&engine, &SyncEngine::syncError,
-        [](const QString &error) { qWarning() << "Sync error:" << error; });
+    SyncScheduler scheduler(account);
+    scheduler.setWatchChanges(options.watch);
+    scheduler.setPollInterval(std::chrono::seconds(options.pollInterval));
+    scheduler.setRestartTimes(options.restartTimes);
+
+    QVector<QSharedPointer<Vfs>> vfsInstances;
+
+    // The account, its connection and the capabilities are shared by all folders
+    auto folders = options.extraFolders;
+    folders.prepend(qMakePair(options.source_dir, folder));
+    for (const auto &syncFolder : qAsConst(folders)) {
+        const QString &localDir = syncFolder.first;
+        const QString &remotePath = syncFolder.second;
+
+        QString dbPath = localDir + SyncJournalDb::makeDbName(localDir, credentialFreeUrl, remotePath, user);
+        auto db = std::make_unique<SyncJournalDb>(dbPath);
+
+        // The list names folders below the main remote path, the other folders keep the list of their journal
+        if (!selectiveSyncList.empty() && syncFolder == folders.first()) {
+            selectiveSyncFixup(db.get(), selectiveSyncList);
+        }
 
+        SyncOptions opt;
+        opt.fillFromEnvironmentVariables();
+        opt.verifyChunkSizes();
+        if (options.vfs.mode != Vfs::Off) {
+            auto vfs = setupVirtualFiles(options, account, localDir, remotePath, db.get(), syncFolder == folders.first());
+            if (!vfs) {
+                return EXIT_FAILURE;
+            }
+            opt._vfs = vfs;
+            vfsInstances.append(vfs);
+        }
 
-    // Exclude lists
+        auto engine = std::make_unique<SyncEngine>(account, localDir, remotePath, db.get());
+        engine->setSyncOptions(opt);
+        engine->setIgnoreHiddenFiles(options.ignoreHiddenFiles);
+        engine->setNetworkLimits(options.uplimit, options.downlimit);
+        QObject::connect(engine.get(), &SyncEngine::transmissionProgress, &cmd, &Cmd::transmissionProgressSlot);
+        QObject::connect(engine.get(), &SyncEngine::syncError,
+            [](const QString &error) { qWarning() << "Sync error:" << error; });
+        if (!options.statsJson.isEmpty()) {
+            auto statistics = new SyncStatistics(engine.get(), db.get(), engine.get());
+            QObject::connect(statistics, &SyncStatistics::runFinished,
+                [target = options.statsJson](const QJsonObject &stats) { writeStatistics(target, stats); });
+        }
 
-    bool hasUserExcludeFile = !options.exclude.isEmpty();
-    QString systemExcludeFile = ConfigFile::excludeFileFromSystem();
 
-    // Always try to load the user-provided exclude list if one is specified
-    if (hasUserExcludeFile) {
-        engine.excludedFiles().addExcludeFilePath(options.exclude);
-    }
-    // Load the system list if available, or if there's no user-provided list
-    if (!hasUserExcludeFile || QFile::exists(systemExcludeFile)) {
-        engine.excludedFiles().addExcludeFilePath(systemExcludeFile);
-    }
+        // Exclude lists
 
-    if (!engine.excludedFiles().reloadExcludeFiles()) {
-        qFatal("Cannot load system exclude list or list supplied via --exclude");
-        return EXIT_FAILURE;
-    }
+        bool hasUserExcludeFile = !options.exclude.isEmpty();
+        QString systemExcludeFile = ConfigFile::excludeFileFromSystem();
 
+        // Always try to load the user-provided exclude list if one is specified
+        if (hasUserExcludeFile) {
+            engine->excludedFiles().addExcludeFilePath(options.exclude);
+        }
+        // Load the system list if available, or if there's no user-provided list
+        if (!hasUserExcludeFile || QFile::exists(systemExcludeFile)) {
+            engine->excludedFiles().addExcludeFilePath(systemExcludeFile);
+        }
 
-    // Have to be done async, else, an error before exec() does not terminate the event loop.
-    QMetaObject::invokeMethod(&engine, "startSync", Qt::QueuedConnection);
+        if (!engine->excludedFiles().reloadExcludeFiles()) {
+            qFatal("Cannot load system exclude list or list supplied via --exclude");
+            return EXIT_FAILURE;
+        }
 
-    int resultCode = app.exec();
+        scheduler.addFolder(localDir, std::move(db), std::move(engine));
+    }
 
-    if (engine.isAnotherSyncNeeded() != NoFollowUpSync) {
-        if (restartCount < options.restartTimes) {
-            restartCount++;
-            qDebug() << "Restarting Sync, because another sync is needed" << restartCount;
-            goto restart_sync;
+    QObject::connect(&scheduler, &SyncScheduler::finished, [&app, &vfsInstances](bool result) {
+        for (const auto &vfs : qAsConst(vfsInstances)) {
+            vfs->stop();
         }
-        qWarning() << "Another sync is needed, but not done because restart count is exceeded" << restartCount;
-    }
+        app.exit(result ? EXIT_SUCCESS : EXIT_FAILURE);
+    });
+    scheduler.start();
 
-    return resultCode;
+    return app.exec();
 }
@@ -0,0 +1,217 @@
+/*
+ * Copyright (C) by Nextcloud GmbH
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ */
+
+#include "syncscheduler.h"
+
+#include "account.h"
+#include "csync_exclude.h"
+#include "folderwatcher.h"
+#include "pushnotifications.h"
+#include "syncengine.h"
+#include "common/syncjournaldb.h"
+
+#include <QLoggingCategory>
+
+#include <algorithm>
+
+namespace OCC {
+
+Q_LOGGING_CATEGORY(lcSyncScheduler, "nextcloud.cmd.syncscheduler", QtInfoMsg)
+
+SyncScheduler::SyncScheduler(const AccountPtr &account, QObject *parent)
+    : QObject(parent)
+    , _account(account)
+{
+    // Gives the watcher and the push notifications a moment to settle
+    _scheduleTimer.setSingleShot(true);
+    _scheduleTimer.setInterval(1000);
+    connect(&_scheduleTimer, &QTimer::timeout, this, &SyncScheduler::scheduleNextSync);
+
+    connect(&_pollTimer, &QTimer::timeout, this, &SyncScheduler::slotRemoteChanged);
+}
+
+SyncScheduler::~SyncScheduler() = default;
+
+void SyncScheduler::addFolder(const QString &localPath, std::unique_ptr<SyncJournalDb> journal, std::unique_ptr<SyncEngine> engine)
+{
+    connect(engine.get(), &SyncEngine::finished, this, &SyncScheduler::slotSyncFinished);
+
+    auto folder = std::make_unique<Folder>();
+    folder->localPath = localPath.endsWith('/') ? localPath : localPath + '/';
+    folder->journal = std::move(journal);
+    folder->engine = std::move(engine);
+    _folders.push_back(std::move(folder));
+}
+
+void SyncScheduler::start()
+{
+    if (_watch) {
+        for (auto &folder : _folders) {
+            watchFolder(*folder);
+        }
+
+        const auto pushNotificationsReady = [this] {
+            qCInfo(lcSyncScheduler) << "Using push notifications for remote changes";
+            _pollTimer.stop();
+            auto pushNotifications = _account->pushNotifications();
+            connect(pushNotifications, &PushNotifications::filesChanged, this, &SyncScheduler::slotRemoteChanged, Qt::UniqueConnection);
+            connect(pushNotifications, &PushNotifications::fileIdsChanged, this, &SyncScheduler::slotRemoteChanged, Qt::UniqueConnection);
+        };
+        connect(_account.data(), &Account::pushNotificationsReady, this, pushNotificationsReady);
+        connect(_account.data(), &Account::pushNotificationsDisabled, this, [this] {
+            qCInfo(lcSyncScheduler) << "Push notifications unavailable, polling for remote changes";
+            _pollTimer.start(_pollInterval);
+        });
+        if (_account->pushNotifications() && _account->pushNotifications()->isReady()) {
+            pushNotificationsReady();
+        } else {
+            _pollTimer.start(_pollInterval);
+        }
+    }
+
+    // Have to be done async, else, an error before exec() does not terminate the event loop.
+    QMetaObject::invokeMethod(this, "scheduleNextSync", Qt::QueuedConnection);
+}
+
+void SyncScheduler::watchFolder(Folder &folder)
+{
+    folder.watcher = std::make_unique<FolderWatcher>();
+    auto folderPtr = &folder;
+    folder.watcher->setIgnoreCheck([folderPtr](const QString &path) {
+        auto &engine = *folderPtr->engine;
+        return engine.excludedFiles().isExcluded(path, folderPtr->localPath, engine.ignoreHiddenFiles());
+    });
+    connect(folder.watcher.get(), &FolderWatcher::pathsChanged, this, [this, folderPtr](const QSet<QString> &paths) {
+        auto &engine = *folderPtr->engine;
+        bool changed = false;
+        for (const auto &path : paths) {
+            // Our own changes
+            if (engine.wasFileTouched(path))
+                continue;
+            folderPtr->touchedPaths.insert(path.mid(folderPtr->localPath.size()));
+            changed = true;
+        }
+        if (changed) {
+            folderPtr->syncNeeded = true;
+            _scheduleTimer.start();
+        }
+    });
+    const auto lookAtEverything = [this, folderPtr] {
+        folderPtr->fullLocalDiscovery = true;
+        folderPtr->syncNeeded = true;
+        _scheduleTimer.start();
+    };
+    connect(folder.watcher.get(), &FolderWatcher::lostChanges, this, lookAtEverything);
+    connect(folder.watcher.get(), &FolderWatcher::becameUnreliable, this, [folderPtr, lookAtEverything](const QString &message) {
+        qCWarning(lcSyncScheduler) << "Local changes of" << folderPtr->localPath << "are not watched reliably:" << message;
+        lookAtEverything();
+    });
+    folder.watcher->init(folder.localPath);
+}
+
+void SyncScheduler::slotRemoteChanged()
+{
+    // Remote discovery only descends into folders whose etag changed
+    for (auto &folder : _folders) {
+        folder->syncNeeded = true;
+    }
+    _scheduleTimer.start();
+}
+
+void SyncScheduler::scheduleNextSync()
+{
+    if (_runningFolder) {
+        // picked up when it is done
+        return;
+    }
+
+    for (auto &folder : _folders) {
+        if (folder->syncNeeded) {
+            startSync(*folder);
+            return;
+        }
+    }
+
+    if (!_watch) {
+        const bool success = std::all_of(_folders.cbegin(), _folders.cend(), [](const auto &folder) { return folder->succeeded; });
+        emit finished(success);
+    }
+}
+
+void SyncScheduler::startSync(Folder &folder)
+{
+    _runningFolder = &folder;
+    folder.syncNeeded = false;
+
+    // Without a working watcher every sync has to look at the whole tree
+    if (folder.fullLocalDiscovery || !folder.watcher || !folder.watcher->isReliable()) {
+        folder.fullLocalDiscovery = false;
+        folder.touchedPaths.clear();
+        folder.runningPaths.clear();
+        folder.engine->setLocalDiscoveryOptions(LocalDiscoveryStyle::FilesystemOnly);
+    } else {
+        folder.runningPaths = std::move(folder.touchedPaths);
+        folder.touchedPaths.clear();
+        folder.engine->setLocalDiscoveryOptions(LocalDiscoveryStyle::DatabaseAndFilesystem, folder.runningPaths);
+    }
+
+    qCInfo(lcSyncScheduler) << "Starting sync of" << folder.localPath;
+    folder.engine->startSync();
+}
+
+void SyncScheduler::slotSyncFinished(bool success)
+{
+    auto folder = _runningFolder;
+    _runningFolder = nullptr;
+    if (!folder) {
+        return;
+    }
+    qCInfo(lcSyncScheduler) << "Sync of" << folder->localPath << (success ? "succeeded" : "failed");
+    folder->succeeded = success;
+
+    const auto anotherSyncNeeded = folder->engine->isAnotherSyncNeeded();
+    if (!success || anotherSyncNeeded != NoFollowUpSync) {
+        // Look at the same local paths again
+        folder->touchedPaths.insert(folder->runningPaths.begin(), folder->runningPaths.end());
+    }
+    folder->runningPaths.clear();
+
+    bool restart = false;
+    if (anotherSyncNeeded == NoFollowUpSync) {
+        folder->restartCount = 0;
+    } else if (folder->restartCount < _restartTimes) {
+        folder->restartCount++;
+        qCInfo(lcSyncScheduler) << "Restarting Sync, because another sync is needed" << folder->restartCount;
+        restart = true;
+    } else {
+        qCWarning(lcSyncScheduler) << "Another sync is needed, but not done because restart count is exceeded" << folder->restartCount;
+    }
+
+    if (!_watch) {
+        folder->syncNeeded = restart;
+    } else if (restart && anotherSyncNeeded == ImmediateFollowUp) {
+        folder->syncNeeded = true;
+    } else if (!success || anotherSyncNeeded != NoFollowUpSync) {
+        // Don't retry in a tight loop
+        QTimer::singleShot(_pollInterval, this, [this, folder] {
+            folder->syncNeeded = true;
+            _scheduleTimer.start();
+        });
+    }
+
+    // Not from within the engine's signal
+    QMetaObject::invokeMethod(this, "scheduleNextSync", Qt::QueuedConnection);
+}
+
+} // namespace OCC
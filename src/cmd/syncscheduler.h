@@ -0,0 +1,106 @@
+/*
+ * Copyright (C) by Nextcloud GmbH
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ */
+
+#ifndef SYNCSCHEDULER_H
+#define SYNCSCHEDULER_H
+
+#include "accountfwd.h"
+
+#include <QObject>
+#include <QSet>
+#include <QString>
+#include <QTimer>
+
+#include <chrono>
+#include <memory>
+#include <set>
+#include <vector>
+
+namespace OCC {
+
+class FolderWatcher;
+class SyncEngine;
+class SyncJournalDb;
+
+/**
+ * @brief Runs the syncs of the command line client
+ * @ingroup cmd
+ *
+ * Syncs the folders one after the other. Without watching, each folder is
+ * synced once, repeated while another sync is needed, and finished() is
+ * emitted.
+ *
+ * When watching, the scheduler keeps the engines and journals and keeps
+ * running: local changes reported by the watcher are synced with a local
+ * discovery limited to the changed paths, and remote changes are picked up
+ * through push notifications or, without them, by polling.
+ */
+class SyncScheduler : public QObject
+{
+    Q_OBJECT
+public:
+    explicit SyncScheduler(const AccountPtr &account, QObject *parent = nullptr);
+    ~SyncScheduler() override;
+
+    /// The engine must work on the journal, both are owned by the scheduler from now on
+    void addFolder(const QString &localPath, std::unique_ptr<SyncJournalDb> journal, std::unique_ptr<SyncEngine> engine);
+
+    void setWatchChanges(bool watch) { _watch = watch; }
+    void setPollInterval(std::chrono::seconds interval) { _pollInterval = interval; }
+    void setRestartTimes(int restartTimes) { _restartTimes = restartTimes; }
+
+    void start();
+
+signals:
+    /// Without watching, when all folders were synced
+    void finished(bool success);
+
+private slots:
+    void scheduleNextSync();
+    void slotSyncFinished(bool success);
+    void slotRemoteChanged();
+
+private:
+    struct Folder
+    {
+        QString localPath;
+        std::unique_ptr<SyncJournalDb> journal;
+        std::unique_ptr<SyncEngine> engine;
+        std::unique_ptr<FolderWatcher> watcher;
+
+        bool syncNeeded = true;
+        bool fullLocalDiscovery = true;
+        std::set<QString> touchedPaths; /// relative to localPath
+        std::set<QString> runningPaths; /// what the running sync looks at
+        int restartCount = 0;
+        bool succeeded = true; /// result of the last sync
+    };
+
+    void watchFolder(Folder &folder);
+    void startSync(Folder &folder);
+
+    AccountPtr _account;
+    std::vector<std::unique_ptr<Folder>> _folders;
+    Folder *_runningFolder = nullptr;
+
+    bool _watch = false;
+    std::chrono::seconds _pollInterval = std::chrono::seconds(30);
+    int _restartTimes = 3;
+
+    QTimer _scheduleTimer;
+    QTimer _pollTimer;
+};
+}
+
+#endif // SYNCSCHEDULER_H
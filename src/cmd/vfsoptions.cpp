@@ -0,0 +1,90 @@
+/*
+ * Copyright (C) by Nextcloud GmbH
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ */
+
+#include "vfsoptions.h"
+
+#include "syncengine.h"
+#include "common/syncjournaldb.h"
+
+#include <QFileInfo>
+#include <QLoggingCategory>
+
+namespace OCC {
+
+Q_LOGGING_CATEGORY(lcVfsOptions, "nextcloud.cmd.vfsoptions", QtInfoMsg)
+
+Optional<Vfs::Mode> VfsOptions::modeFromString(const QString &str)
+{
+    if (str == QLatin1String("xattr")) {
+        return Vfs::XAttr;
+    }
+    return Vfs::modeFromString(str);
+}
+
+bool VfsOptions::parseOption(const QString &option, const QString &value)
+{
+    if (option == QLatin1String("--vfs")) {
+        const auto newMode = modeFromString(value);
+        if (!newMode) {
+            return false;
+        }
+        mode = *newMode;
+        return true;
+    }
+    if (option == QLatin1String("--hydrate")) {
+        pinStates.append(qMakePair(value, PinState::AlwaysLocal));
+        return true;
+    }
+    if (option == QLatin1String("--dehydrate")) {
+        pinStates.append(qMakePair(value, PinState::OnlineOnly));
+        return true;
+    }
+    return false;
+}
+
+void VfsOptions::setupFolder(Vfs &vfs, const QString &filesystemPath, SyncJournalDb &journal, bool applyPinStates) const
+{
+    const auto rootPinState = journal.internalPinStates().rawForPath(QByteArray());
+    if (rootPinState && *rootPinState == PinState::Inherited) {
+        qCInfo(lcVfsOptions) << "Switching" << filesystemPath << "to virtual files";
+        const bool newFolder = journal.getFileRecordCount() <= 0;
+        if (!vfs.setPinState(QString(), newFolder ? PinState::OnlineOnly : PinState::Unspecified)) {
+            qCWarning(lcVfsOptions) << "Could not set the root pin state of" << filesystemPath;
+        }
+        if (!newFolder) {
+            SyncEngine::switchToVirtualFiles(filesystemPath, journal, vfs);
+        }
+    }
+
+    if (!applyPinStates) {
+        return;
+    }
+    for (const auto &pin : pinStates) {
+        QString path = pin.first;
+        while (path.endsWith('/')) {
+            path.chop(1);
+        }
+        // The pin state of a dehydrated file belongs to its placeholder, which may be given without the suffix
+        const auto suffix = vfs.fileSuffix();
+        if (!suffix.isEmpty() && !path.endsWith(suffix)
+            && !QFileInfo::exists(filesystemPath + path) && QFileInfo::exists(filesystemPath + path + suffix)) {
+            path += suffix;
+        }
+        if (!vfs.setPinState(path, pin.second)) {
+            qCWarning(lcVfsOptions) << "Could not set the pin state of" << path;
+        }
+    }
+}
+
+}
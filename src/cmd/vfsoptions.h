@@ -0,0 +1,67 @@
+/*
+ * Copyright (C) by Nextcloud GmbH
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ */
+
+#ifndef VFSOPTIONS_H
+#define VFSOPTIONS_H
+
+#include "common/pinstate.h"
+#include "common/vfs.h"
+
+#include <QPair>
+#include <QString>
+#include <QVector>
+
+namespace OCC {
+
+class SyncJournalDb;
+
+/**
+ * @brief The virtual files options of the command line client
+ * @ingroup cmd
+ *
+ * Holds what was given with --vfs, --hydrate and --dehydrate and applies it
+ * to the folders once their virtual files plugin is started.
+ */
+class VfsOptions
+{
+public:
+    /** The mode given with --vfs.
+     *
+     * Unlike Vfs::modeFromString(), which reads the client's config, this
+     * also takes "xattr".
+     */
+    static Optional<Vfs::Mode> modeFromString(const QString &str);
+
+    /** Handles --vfs, --hydrate and --dehydrate with their argument
+     *
+     * Returns false if the option is none of them or its argument is invalid.
+     */
+    bool parseOption(const QString &option, const QString &value);
+
+    /** Prepares the folder of the started \a vfs for a sync
+     *
+     * Like in the client, a new folder gets virtual files by default while
+     * the files of a folder that was synced before are kept. The pin states
+     * of --hydrate and --dehydrate are set if \a applyPinStates, they are
+     * relative to the main folder. \a filesystemPath ends with a slash.
+     */
+    void setupFolder(Vfs &vfs, const QString &filesystemPath, SyncJournalDb &journal, bool applyPinStates) const;
+
+    Vfs::Mode mode = Vfs::Off;
+    QVector<QPair<QString, PinState>> pinStates;
+};
+
+}
+
+#endif
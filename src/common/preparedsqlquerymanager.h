@@ -63,6 +63,11 @@ public:
         GetFileRecordQueryByMangledName,
         GetFileRecordQueryByInode,
         GetFileRecordQueryByFileId,
+        GetFileRecordQueryByNumericFileId,
+        SearchFileNamesQuery,
+        SetFileNameIndexQuery,
+        DeleteFileNameIndexPhash,
+        DeleteFileNameIndexRecursively,
         GetFilesBelowPathQuery,
         GetAllFilesQuery,
         ListFilesInPathQuery,
@@ -93,7 +98,6 @@ public:
         SetConflictRecordQuery,
         DeleteConflictRecordQuery,
         GetRawPinStateQuery,
-        GetEffectivePinStateQuery,
         GetSubPinsQuery,
         CountDehydratedFilesQuery,
         SetPinStateQuery,
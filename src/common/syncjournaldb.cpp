@@ -24,6 +24,7 @@
 #include <QUrl>
 #include <QDir>
 #include <sqlite3.h>
+#include <atomic>
 #include <cstring>
 
 #include "common/syncjournaldb.h"
@@ -68,6 +69,8 @@ static void fillFileRecordFromGetQuery(SyncJournalFileRecord &rec, SqlQuery &que
     rec._isE2eEncrypted = query.intValue(11) > 0;
 }
 
+static std::atomic<bool> fileNameIndexEnabled{true};
+
 static QByteArray defaultJournalMode(const QString &dbPath)
 {
 #if defined(Q_OS_WIN)
@@ -242,6 +245,7 @@ void SyncJournalDb::commitTransaction()
             return;
         }
         _transaction = 0;
+        ++_commitCount;
     } else {
         qCDebug(lcDb) << "No database Transaction to commit";
     }
@@ -358,6 +362,13 @@ bool SyncJournalDb::checkConnect()
                                                                         end - text, 0));
                                 }, nullptr, nullptr);
 
+    // Same as getPHash(), for computing the key of a rewritten path in SQL
+    sqlite3_create_function(_db.sqliteDb(), "path_hash", 1, SQLITE_UTF8 | SQLITE_DETERMINISTIC, nullptr,
+                                [] (sqlite3_context *ctx,int, sqlite3_value **argv) {
+                                    auto text = reinterpret_cast<const uint8_t*>(sqlite3_value_text(argv[0]));
+                                    sqlite3_result_int64(ctx, c_jhash64(text, sqlite3_value_bytes(argv[0]), 0));
+                                }, nullptr, nullptr);
+
     /* Because insert is so slow, we do everything in a transaction, and only need one call to commit */
     startTransaction();
 
@@ -523,6 +534,7 @@ bool SyncJournalDb::checkConnect()
     SqlQuery versionQuery("SELECT major, minor, patch FROM version;", _db);
     if (!versionQuery.next().hasData) {
         forceRemoteDiscovery = true;
+        _fileNameIndexNeedsRebuild = true;
 
         createQuery.prepare("INSERT INTO version VALUES (?1, ?2, ?3, ?4);");
         createQuery.bindValue(1, MIRALL_VERSION_MAJOR);
@@ -553,6 +565,9 @@ bool SyncJournalDb::checkConnect()
 
         // Not comparing the BUILD id here, correct?
         if (!(major == MIRALL_VERSION_MAJOR && minor == MIRALL_VERSION_MINOR && patch == MIRALL_VERSION_PATCH)) {
+            // Another version wrote to the journal, it may not have maintained the file name index
+            _fileNameIndexNeedsRebuild = true;
+
             createQuery.prepare("UPDATE version SET major=?1, minor=?2, patch =?3, custom=?4 "
                                 "WHERE major=?5 AND minor=?6 AND patch=?7;");
             createQuery.bindValue(1, MIRALL_VERSION_MAJOR);
@@ -634,6 +649,7 @@ void SyncJournalDb::close()
 
     _db.close();
     clearEtagStorageFilter();
+    invalidatePinStateCache();
     _metadataTableIsEmpty = false;
 }
 
@@ -644,6 +660,7 @@ bool SyncJournalDb::updateDatabaseStructure()
         return false;
     if (!updateErrorBlacklistTableStructure())
         return false;
+    updateFileNameIndexStructure();
     return true;
 }
 
@@ -809,6 +826,82 @@ bool SyncJournalDb::updateMetadataTableStructure()
     return re;
 }
 
+void SyncJournalDb::setFileNameIndexEnabled(bool enabled)
+{
+    fileNameIndexEnabled = enabled;
+}
+
+void SyncJournalDb::updateFileNameIndexStructure()
+{
+    _hasFileNameIndex = false;
+
+    SqlQuery query(_db);
+    if (!fileNameIndexEnabled) {
+        // An index left behind would miss every change from now on
+        if (query.prepare("DROP TABLE IF EXISTS filenames;", true) != SQLITE_OK || !query.exec()) {
+            qCInfo(lcDb) << "Could not drop the file name index:" << query.error();
+        }
+        return;
+    }
+
+    query.prepare("SELECT 1 FROM sqlite_master WHERE type='table' AND name='filenames';");
+    if (!query.exec()) {
+        qCWarning(lcDb) << "Could not look up the file name index:" << query.error();
+        return;
+    }
+    const bool indexExisted = query.next().hasData;
+
+    // The index is optional: the trigram tokenizer needs SQLite 3.34 with FTS5.
+    // The rowid of an entry is the phash of the metadata row.
+    if (query.prepare("CREATE VIRTUAL TABLE IF NOT EXISTS filenames USING fts5(name, tokenize='trigram');", true) != SQLITE_OK
+        || !query.exec()) {
+        qCInfo(lcDb) << "No file name index, SQLite lacks FTS5 trigram support:" << query.error();
+        return;
+    }
+
+    // Clients without the index write their own version to the journal, see checkConnect()
+    if (!indexExisted || _fileNameIndexNeedsRebuild) {
+        qCInfo(lcDb) << "Rebuilding the file name index";
+        query.prepare("DELETE FROM filenames;");
+        if (!query.exec()) {
+            dropFileNameIndex();
+            return;
+        }
+        SqlQuery select("SELECT phash, path FROM metadata;", _db);
+        SqlQuery insert("INSERT INTO filenames (rowid, name) VALUES (?1, ?2);", _db);
+        if (!select.exec()) {
+            dropFileNameIndex();
+            return;
+        }
+        while (select.next().hasData) {
+            const auto path = select.baValue(1);
+            insert.reset_and_clear_bindings();
+            insert.bindValue(1, static_cast<qint64>(select.int64Value(0)));
+            insert.bindValue(2, path.mid(path.lastIndexOf('/') + 1));
+            if (!insert.exec()) {
+                dropFileNameIndex();
+                return;
+            }
+        }
+        commitInternal(QStringLiteral("rebuild file name index"));
+    }
+    _fileNameIndexNeedsRebuild = false;
+
+    _hasFileNameIndex = true;
+}
+
+void SyncJournalDb::dropFileNameIndex()
+{
+    qCWarning(lcDb) << "Dropping the file name index after an error";
+    _hasFileNameIndex = false;
+
+    // Without the table the next open rebuilds the index from scratch
+    SqlQuery query(_db);
+    if (query.prepare("DROP TABLE IF EXISTS filenames;", true) != SQLITE_OK || !query.exec()) {
+        qCWarning(lcDb) << "Could not drop the file name index:" << query.error();
+    }
+}
+
 bool SyncJournalDb::updateErrorBlacklistTableStructure()
 {
     auto columns = tableColumns("blacklist");
@@ -967,6 +1060,21 @@ Result<void, QString> SyncJournalDb::setFileRecord(const SyncJournalFileRecord &
             return query->error();
         }
 
+        if (_hasFileNameIndex) {
+            // Same phash means same path, so an existing entry is still correct
+            const auto indexQuery = _queryManager.get(PreparedSqlQueryManager::SetFileNameIndexQuery, QByteArrayLiteral("INSERT INTO filenames (rowid, name) "
+                                                                                                                      "SELECT ?1, ?2 WHERE NOT EXISTS (SELECT 1 FROM filenames WHERE rowid=?1);"),
+                _db);
+            if (indexQuery) {
+                indexQuery->bindValue(1, phash);
+                indexQuery->bindValue(2, record._path.mid(record._path.lastIndexOf('/') + 1));
+            }
+            if (!indexQuery || !indexQuery->exec()) {
+                // The record itself is stored, only the search is affected
+                dropFileNameIndex();
+            }
+        }
+
         // Can't be true anymore.
         _metadataTableIsEmpty = false;
 
@@ -977,6 +1085,77 @@ Result<void, QString> SyncJournalDb::setFileRecord(const SyncJournalFileRecord &
     }
 }
 
+bool SyncJournalDb::hasFileNameIndex()
+{
+    QMutexLocker locker(&_mutex);
+    return checkConnect() && _hasFileNameIndex;
+}
+
+bool SyncJournalDb::searchFileNames(const QString &term, int limit, const std::function<void(const SyncJournalFileRecord &)> &rowCallback)
+{
+    QMutexLocker locker(&_mutex);
+
+    if (term.isEmpty() || limit <= 0 || _metadataTableIsEmpty)
+        return true; // no error, yet nothing found
+
+    if (!checkConnect())
+        return false;
+
+    // Match the term literally
+    auto pattern = term.toUtf8();
+    pattern.replace('\\', "\\\\").replace('%', "\\%").replace('_', "\\_");
+    pattern = '%' + pattern + '%';
+
+    if (_hasFileNameIndex) {
+        // LIKE on the trigram index is case insensitive and uses the index for terms of three or more characters
+        const auto query = _queryManager.get(PreparedSqlQueryManager::SearchFileNamesQuery, QByteArrayLiteral(GET_FILE_RECORD_QUERY " WHERE phash IN (SELECT rowid FROM filenames WHERE name LIKE ?1 ESCAPE '\\' LIMIT ?2) ORDER BY path"), _db);
+        if (!query) {
+            return false;
+        }
+        query->bindValue(1, pattern);
+        query->bindValue(2, limit);
+        if (!query->exec())
+            return false;
+
+        forever {
+            auto next = query->next();
+            if (!next.ok)
+                return false;
+            if (!next.hasData)
+                break;
+
+            SyncJournalFileRecord rec;
+            fillFileRecordFromGetQuery(rec, *query);
+            rowCallback(rec);
+        }
+        return true;
+    }
+
+    // Without the index the path has to be matched, only its last segment counts
+    SqlQuery query(GET_FILE_RECORD_QUERY " WHERE path LIKE ?1 ESCAPE '\\' ORDER BY path", _db);
+    query.bindValue(1, pattern);
+    if (!query.exec())
+        return false;
+
+    int found = 0;
+    while (found < limit) {
+        auto next = query.next();
+        if (!next.ok)
+            return false;
+        if (!next.hasData)
+            break;
+
+        SyncJournalFileRecord rec;
+        fillFileRecordFromGetQuery(rec, query);
+        const auto fileName = QString::fromUtf8(rec._path.mid(rec._path.lastIndexOf('/') + 1));
+        if (fileName.contains(term, Qt::CaseInsensitive)) {
+            rowCallback(rec);
+            ++found;
+        }
+    }
+    return true;
+}
+
 void SyncJournalDb::keyValueStoreSet(const QString &key, QVariant value)
 {
     QMutexLocker locker(&_mutex);
@@ -1040,13 +1219,13 @@ bool SyncJournalDb::deleteFileRecord(const QString &filename, bool recursively)
         // if (!recursively) {
         // always delete the actual file.
 
+        const qint64 phash = getPHash(filename.toUtf8());
         {
             const auto query = _queryManager.get(PreparedSqlQueryManager::DeleteFileRecordPhash, QByteArrayLiteral("DELETE FROM metadata WHERE phash=?1"), _db);
             if (!query) {
                 return false;
             }
 
-            const qint64 phash = getPHash(filename.toUtf8());
             query->bindValue(1, phash);
 
             if (!query->exec()) {
@@ -1054,6 +1233,27 @@ bool SyncJournalDb::deleteFileRecord(const QString &filename, bool recursively)
             }
         }
 
+        if (_hasFileNameIndex) {
+            const auto query = _queryManager.get(PreparedSqlQueryManager::DeleteFileNameIndexPhash, QByteArrayLiteral("DELETE FROM filenames WHERE rowid=?1"), _db);
+            if (query) {
+                query->bindValue(1, phash);
+            }
+            if (!query || !query->exec()) {
+                dropFileNameIndex();
+            }
+        }
+
+        if (recursively && _hasFileNameIndex) {
+            // Must happen before the metadata rows are gone
+            const auto query = _queryManager.get(PreparedSqlQueryManager::DeleteFileNameIndexRecursively, QByteArrayLiteral("DELETE FROM filenames WHERE rowid IN (SELECT phash FROM metadata WHERE " IS_PREFIX_PATH_OF("?1", "path") ")"), _db);
+            if (query) {
+                query->bindValue(1, filename);
+            }
+            if (!query || !query->exec()) {
+                dropFileNameIndex();
+            }
+        }
+
         if (recursively) {
             const auto query = _queryManager.get(PreparedSqlQueryManager::DeleteFileRecordRecursively, QByteArrayLiteral("DELETE FROM metadata WHERE " IS_PREFIX_PATH_OF("?1", "path")), _db);
             if (!query)
@@ -1224,6 +1424,43 @@ bool SyncJournalDb::getFileRecordsByFileId(const QByteArray &fileId, const std::
     return true;
 }
 
+bool SyncJournalDb::getFileRecordsByNumericFileId(qint64 numericFileId, const std::function<void(const SyncJournalFileRecord &)> &rowCallback)
+{
+    QMutexLocker locker(&_mutex);
+
+    if (numericFileId <= 0 || _metadataTableIsEmpty)
+        return true; // no error, yet nothing found
+
+    if (!checkConnect())
+        return false;
+
+    // The file id is the zero padded numeric id followed by the instance id. GLOB
+    // with a literal prefix still uses the index on fileid.
+    const auto query = _queryManager.get(PreparedSqlQueryManager::GetFileRecordQueryByNumericFileId, QByteArrayLiteral(GET_FILE_RECORD_QUERY " WHERE fileid GLOB ?1"), _db);
+    if (!query) {
+        return false;
+    }
+
+    query->bindValue(1, QByteArray(QByteArray::number(numericFileId).rightJustified(8, '0') + "[^0-9]*"));
+
+    if (!query->exec())
+        return false;
+
+    forever {
+        auto next = query->next();
+        if (!next.ok)
+            return false;
+        if (!next.hasData)
+            break;
+
+        SyncJournalFileRecord rec;
+        fillFileRecordFromGetQuery(rec, *query);
+        rowCallback(rec);
+    }
+
+    return true;
+}
+
 bool SyncJournalDb::getFilesBelowPath(const QByteArray &path, const std::function<void(const SyncJournalFileRecord&)> &rowCallback)
 {
     QMutexLocker locker(&_mutex);
@@ -1743,6 +1980,7 @@ void SyncJournalDb::deleteStaleFlagsEntries()
 
     SqlQuery delQuery("DELETE FROM flags WHERE path != '' AND path NOT IN (SELECT path from metadata);", _db);
     delQuery.exec();
+    invalidatePinStateCache();
 }
 
 int SyncJournalDb::errorBlackListEntryCount()
@@ -2230,12 +2468,70 @@ QByteArray SyncJournalDb::conflictFileBaseName(const QByteArray &conflictName)
     return result;
 }
 
+bool SyncJournalDb::moveFileRecordsBelow(const QString &from, const QString &to)
+{
+    QMutexLocker locker(&_mutex);
+
+    if (from.isEmpty() || to.isEmpty())
+        return false;
+    if (from == to)
+        return true;
+
+    if (!checkConnect())
+        return false;
+
+    // The new path is built on bytes, substr() on text would count characters
+#define MOVED_PATH "(?2 || substr(CAST(path AS BLOB), ?3))"
+    const auto bindPaths = [&](SqlQuery &query) {
+        const auto fromUtf8 = from.toUtf8();
+        query.bindValue(1, fromUtf8);
+        query.bindValue(2, to.toUtf8());
+        query.bindValue(3, fromUtf8.size() + 1);
+    };
+
+    SqlQuery query(_db);
+    if (_hasFileNameIndex) {
+        // The names don't change, only the rowids that mirror the phash
+        query.prepare("DELETE FROM filenames WHERE rowid IN (SELECT phash FROM metadata WHERE " IS_PREFIX_PATH_OF("?2", "path") ");");
+        bindPaths(query);
+        bool ok = query.exec();
+        if (ok) {
+            query.prepare("UPDATE filenames SET rowid = (SELECT path_hash(" MOVED_PATH ") FROM metadata WHERE phash = filenames.rowid) "
+                          "WHERE rowid IN (SELECT phash FROM metadata WHERE " IS_PREFIX_PATH_OF("?1", "path") ");");
+            bindPaths(query);
+            ok = query.exec();
+        }
+        if (!ok)
+            dropFileNameIndex();
+    }
+
+    query.prepare("UPDATE OR REPLACE metadata SET path = " MOVED_PATH ", phash = path_hash(" MOVED_PATH "), "
+                  "pathlen = length(CAST(" MOVED_PATH " AS BLOB)) WHERE " IS_PREFIX_PATH_OF("?1", "path") ";");
+    bindPaths(query);
+    if (!query.exec())
+        return false;
+    qCInfo(lcDb) << "Moved" << query.numRowsAffected() << "records from below" << from << "to below" << to;
+
+    query.prepare("UPDATE OR REPLACE flags SET path = " MOVED_PATH " WHERE " IS_PREFIX_PATH_OF("?1", "path") ";");
+    bindPaths(query);
+    if (!query.exec())
+        return false;
+    invalidatePinStateCache();
+#undef MOVED_PATH
+
+    return true;
+}
+
 void SyncJournalDb::clearFileTable()
 {
     QMutexLocker lock(&_mutex);
     SqlQuery query(_db);
     query.prepare("DELETE FROM metadata;");
     query.exec();
+    if (_hasFileNameIndex) {
+        query.prepare("DELETE FROM filenames;");
+        query.exec();
+    }
 }
 
 void SyncJournalDb::markVirtualFileForDownloadRecursively(const QByteArray &path)
@@ -2281,31 +2577,70 @@ Optional<PinState> SyncJournalDb::PinStateInterface::rawForPath(const QByteArray
     return static_cast<PinState>(query->intValue(0));
 }
 
+bool SyncJournalDb::loadPinStateCache()
+{
+    QWriteLocker cacheLock(&_pinStateCacheLock);
+    if (_pinStateCacheValid)
+        return true;
+
+    SqlQuery query("SELECT path, pinState FROM flags WHERE pinState is not null AND pinState != 0;", _db);
+    if (!query.exec())
+        return false;
+
+    _pinStateCache.clear();
+    forever {
+        auto next = query.next();
+        if (!next.ok) {
+            _pinStateCache.clear();
+            return false;
+        }
+        if (!next.hasData)
+            break;
+        _pinStateCache.insert(query.baValue(0), static_cast<PinState>(query.intValue(1)));
+    }
+    _pinStateCacheValid = true;
+    return true;
+}
+
+void SyncJournalDb::invalidatePinStateCache()
+{
+    QWriteLocker cacheLock(&_pinStateCacheLock);
+    _pinStateCacheValid = false;
+    _pinStateCache.clear();
+}
+
+static PinState effectivePinStateFromCache(const QHash<QByteArray, PinState> &pinStates, const QByteArray &path)
+{
+    // Walk from the path itself up to the root "", without copying the prefixes
+    int length = path.size();
+    forever {
+        const auto it = pinStates.constFind(QByteArray::fromRawData(path.constData(), length));
+        if (it != pinStates.constEnd())
+            return *it;
+        if (length == 0)
+            break;
+        length = qMax(0, path.lastIndexOf('/', length - 1));
+    }
+    // If the root path has no setting, assume AlwaysLocal
+    return PinState::AlwaysLocal;
+}
+
 Optional<PinState> SyncJournalDb::PinStateInterface::effectiveForPath(const QByteArray &path)
 {
+    {
+        QReadLocker cacheLock(&_db->_pinStateCacheLock);
+        if (_db->_pinStateCacheValid)
+            return effectivePinStateFromCache(_db->_pinStateCache, path);
+    }
+
     QMutexLocker lock(&_db->_mutex);
     if (!_db->checkConnect())
         return {};
-
-    const auto query = _db->_queryManager.get(PreparedSqlQueryManager::GetEffectivePinStateQuery, QByteArrayLiteral("SELECT pinState FROM flags WHERE"
-                                                                                                                    // explicitly allow "" to represent the root path
-                                                                                                                    // (it'd be great if paths started with a / and "/" could be the root)
-                                                                                                                    " (" IS_PREFIX_PATH_OR_EQUAL("path", "?1") " OR path == '')"
-                                                                                                                                                               " AND pinState is not null AND pinState != 0"
-                                                                                                                                                               " ORDER BY length(path) DESC LIMIT 1;"),
-        _db->_db);
-    ASSERT(query)
-    query->bindValue(1, path);
-    query->exec();
-
-    auto next = query->next();
-    if (!next.ok)
+    if (!_db->loadPinStateCache())
         return {};
-    // If the root path has no setting, assume AlwaysLocal
-    if (!next.hasData)
-        return PinState::AlwaysLocal;
 
-    return static_cast<PinState>(query->intValue(0));
+    QReadLocker cacheLock(&_db->_pinStateCacheLock);
+    return effectivePinStateFromCache(_db->_pinStateCache, path);
 }
 
 Optional<PinState> SyncJournalDb::PinStateInterface::effectiveForPathRecursive(const QByteArray &path)
@@ -2362,6 +2697,7 @@ void SyncJournalDb::PinStateInterface::setForPath(const QByteArray &path, PinSta
     query->bindValue(1, path);
     query->bindValue(2, state);
     query->exec();
+    _db->invalidatePinStateCache();
 }
 
 void SyncJournalDb::PinStateInterface::wipeForPathAndBelow(const QByteArray &path)
@@ -2377,6 +2713,7 @@ void SyncJournalDb::PinStateInterface::wipeForPathAndBelow(const QByteArray &pat
     ASSERT(query)
     query->bindValue(1, path);
     query->exec();
+    _db->invalidatePinStateCache();
 }
 
 Optional<QVector<QPair<QByteArray, PinState>>>
@@ -2412,6 +2749,12 @@ void SyncJournalDb::commit(const QString &context, bool startTrans)
     commitInternal(context, startTrans);
 }
 
+int SyncJournalDb::commitCount()
+{
+    QMutexLocker lock(&_mutex);
+    return _commitCount;
+}
+
 void SyncJournalDb::commitIfNeededAndStartNewTransaction(const QString &context)
 {
     QMutexLocker lock(&_mutex);
@@ -23,6 +23,7 @@
 #include <QDateTime>
 #include <QHash>
 #include <QMutex>
+#include <QReadWriteLock>
 #include <QVariant>
 #include <functional>
 
@@ -64,15 +65,44 @@ public:
     bool getFileRecordByE2eMangledName(const QString &mangledName, SyncJournalFileRecord *rec);
     bool getFileRecordByInode(quint64 inode, SyncJournalFileRecord *rec);
     bool getFileRecordsByFileId(const QByteArray &fileId, const std::function<void(const SyncJournalFileRecord &)> &rowCallback);
+    /// Like getFileRecordsByFileId() for the server's numeric id, see SyncJournalFileRecord::numericFileId()
+    bool getFileRecordsByNumericFileId(qint64 numericFileId, const std::function<void(const SyncJournalFileRecord &)> &rowCallback);
     bool getFilesBelowPath(const QByteArray &path, const std::function<void(const SyncJournalFileRecord&)> &rowCallback);
     bool listFilesInPath(const QByteArray &path, const std::function<void(const SyncJournalFileRecord&)> &rowCallback);
     Result<void, QString> setFileRecord(const SyncJournalFileRecord &record);
 
+    /**
+     * Calls @a rowCallback for up to @a limit records whose file name contains
+     * @a term, ignoring case.
+     *
+     * Uses a trigram index over the file names when it is enabled and SQLite
+     * supports it, see hasFileNameIndex(), and otherwise scans all paths.
+     */
+    bool searchFileNames(const QString &term, int limit, const std::function<void(const SyncJournalFileRecord &)> &rowCallback);
+    bool hasFileNameIndex();
+
+    /**
+     * Whether journals keep the file name index, on by default.
+     *
+     * Takes effect when a journal is opened. Disabling it drops the index.
+     */
+    static void setFileNameIndexEnabled(bool enabled);
+
     void keyValueStoreSet(const QString &key, QVariant value);
     qint64 keyValueStoreGetInt(const QString &key, qint64 defaultValue);
     void keyValueStoreDelete(const QString &key);
 
     bool deleteFileRecord(const QString &filename, bool recursively = false);
+
+    /**
+     * Moves the records of everything below @a from to the same relative path below @a to.
+     *
+     * The record of @a from itself is not touched. This runs as a few statements
+     * regardless of the number of descendants, so after a directory rename its
+     * unchanged content doesn't need to be renamed record by record. Pin states
+     * stored in the journal move along.
+     */
+    bool moveFileRecordsBelow(const QString &from, const QString &to);
     bool updateFileRecordChecksum(const QString &filename,
         const QByteArray &contentChecksum,
         const QByteArray &contentChecksumType);
@@ -211,6 +241,9 @@ public:
     void commit(const QString &context, bool startTrans = true);
     void commitIfNeededAndStartNewTransaction(const QString &context);
 
+    /// Number of transactions committed since the journal was opened, for statistics
+    int commitCount();
+
     /** Open the db if it isn't already.
      *
      * This usually creates some temporary files next to the db file, like
@@ -375,6 +408,9 @@ private:
     bool updateDatabaseStructure();
     bool updateMetadataTableStructure();
     bool updateErrorBlacklistTableStructure();
+    void updateFileNameIndexStructure();
+    // Used when maintaining the index fails, so the next open rebuilds it
+    void dropFileNameIndex();
     bool sqlFail(const QString &log, const SqlQuery &query);
     void commitInternal(const QString &context, bool startTrans = true);
     void startTransaction();
@@ -385,6 +421,11 @@ private:
     // Same as forceRemoteDiscoveryNextSync but without acquiring the lock
     void forceRemoteDiscoveryNextSyncLocked();
 
+    // Fills _pinStateCache from the flags table, must be called with _mutex held
+    bool loadPinStateCache();
+    // Drops _pinStateCache, must be called with _mutex held after changing the flags table
+    void invalidatePinStateCache();
+
     // Returns the integer id of the checksum type
     //
     // Returns 0 on failure and for empty checksum types.
@@ -393,9 +434,12 @@ private:
     SqlDatabase _db;
     QString _dbFile;
     QRecursiveMutex _mutex; // Public functions are protected with the mutex.
+    int _commitCount = 0;
     QMap<QByteArray, int> _checksymTypeCache;
     int _transaction;
     bool _metadataTableIsEmpty;
+    bool _hasFileNameIndex = false;
+    bool _fileNameIndexNeedsRebuild = false;
 
     /* Storing etags to these folders, or their parent folders, is filtered out.
      *
@@ -419,6 +463,19 @@ private:
      */
     QByteArray _journalMode;
 
+    /** The explicit (not Inherited) pin states of the flags table, by path.
+     *
+     * PinStateInterface::effectiveForPath() is called for every local entry
+     * during discovery, from several threads. Walking up the parents of a path
+     * in this hash avoids a query and the contention on _mutex for each of them.
+     *
+     * Loaded on demand and dropped whenever the flags table is modified.
+     * Guarded by _pinStateCacheLock; only changed while _mutex is held too.
+     */
+    QHash<QByteArray, PinState> _pinStateCache;
+    bool _pinStateCacheValid = false;
+    QReadWriteLock _pinStateCacheLock;
+
     PreparedSqlQueryManager _queryManager;
 };
 
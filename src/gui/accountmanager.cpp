@@ -23,6 +23,8 @@
 #include <cookiejar.h>
 #include <QSettings>
 #include <QDir>
+#include <QJsonDocument>
+#include <QJsonObject>
 #include <QNetworkAccessManager>
 #include <QMessageBox>
 #include "clientsideencryption.h"
@@ -38,6 +40,7 @@ static const char caCertsKeyC[] = "CaCertificates";
 static const char accountsC[] = "Accounts";
 static const char versionC[] = "version";
 static const char serverVersionC[] = "serverVersion";
+static const char capabilitiesC[] = "capabilities";
 
 // The maximum versions that this client can read
 static const int maxAccountsVersion = 2;
@@ -223,6 +226,11 @@ void AccountManager::saveAccountHelper(Account *acc, QSettings &settings, bool s
     settings.setValue(QLatin1String(urlC), acc->_url.toString());
     settings.setValue(QLatin1String(davUserC), acc->_davUser);
     settings.setValue(QLatin1String(serverVersionC), acc->_serverVersion);
+    if (acc->_capabilities.isValid()) {
+        // Loaded on the next start, so the client doesn't have to wait for the server
+        const auto capabilities = QJsonDocument::fromVariant(acc->_capabilities.toVariantMap());
+        settings.setValue(QLatin1String(capabilitiesC), capabilities.toJson(QJsonDocument::Compact));
+    }
     if (acc->_credentials) {
         if (saveCredentials) {
             // Only persist the credentials if the parameter is set, on migration from 1.8.x
@@ -317,6 +325,11 @@ AccountPtr AccountManager::loadAccountHelper(QSettings &settings)
     qCInfo(lcAccountManager) << "Account for" << acc->url() << "using auth type" << authType;
 
     acc->_serverVersion = settings.value(QLatin1String(serverVersionC)).toString();
+    // The capabilities of the last connection, until the server sent the current ones
+    const auto capabilities = QJsonDocument::fromJson(settings.value(QLatin1String(capabilitiesC)).toByteArray());
+    if (capabilities.isObject()) {
+        acc->_capabilities = Capabilities(capabilities.object().toVariantMap());
+    }
     acc->_davUser = settings.value(QLatin1String(davUserC), "").toString();
 
     // We want to only restore settings for that auth type and the user value
@@ -44,6 +44,7 @@
 #include "version.h"
 #include "csync_exclude.h"
 #include "common/vfs.h"
+#include "common/syncjournaldb.h"
 
 #include "config.h"
 
@@ -82,6 +83,7 @@ namespace {
         "                         (to be used with --logdir)\n"
         "  --logflush           : flush the log file after every write.\n"
         "  --logdebug           : also output debug-level messages in the log.\n"
+        "  --logasync           : write the log file from a background thread.\n"
         "  --confdir <dirname>  : Use the given configuration folder.\n"
         "  --background         : launch the application in the background.\n";
 
@@ -195,6 +197,7 @@ Application::Application(int &argc, char **argv)
     , _logExpire(0)
     , _logFlush(false)
     , _logDebug(true)
+    , _logAsync(false)
     , _userTriggeredConnect(false)
     , _debugMode(false)
     , _backgroundMode(false)
@@ -309,6 +312,9 @@ Application::Application(int &argc, char **argv)
     if (!AbstractNetworkJob::httpTimeout)
         AbstractNetworkJob::httpTimeout = cfg.timeout();
 
+    // Before FolderMan opens the journals
+    SyncJournalDb::setFileNameIndexEnabled(cfg.localFileSearchIndex());
+
     // Check vfs plugins
     if (Theme::instance()->showVirtualFilesOption() && bestAvailableVfsMode() == Vfs::Off) {
         qCWarning(lcApplication) << "Theme wants to show vfs mode, but no vfs plugins are available";
@@ -534,6 +540,7 @@ void Application::setupLogging()
     logger->setLogExpire(_logExpire > 0 ? _logExpire : ConfigFile().logExpire());
     logger->setLogFlush(_logFlush || ConfigFile().logFlush());
     logger->setLogDebug(_logDebug || ConfigFile().logDebug());
+    logger->setLogAsync(_logAsync || ConfigFile().logAsync());
     if (!logger->isLoggingToFile() && ConfigFile().automaticLogDir()) {
         logger->setupTemporaryFolderLogDir();
     }
@@ -624,6 +631,8 @@ void Application::parseOptions(const QStringList &options)
             _logFlush = true;
         } else if (option == QLatin1String("--logdebug")) {
             _logDebug = true;
+        } else if (option == QLatin1String("--logasync")) {
+            _logAsync = true;
         } else if (option == QLatin1String("--confdir")) {
             if (it.hasNext() && !it.peekNext().startsWith(QLatin1String("--"))) {
                 QString confDir = it.next();
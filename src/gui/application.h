@@ -131,6 +131,7 @@ private:
     int _logExpire;
     bool _logFlush;
     bool _logDebug;
+    bool _logAsync;
     bool _userTriggeredConnect;
     bool _debugMode;
     bool _backgroundMode;
@@ -179,6 +179,11 @@ void ConnectionValidator::checkAuthentication()
     connect(job, &PropfindJob::result, this, &ConnectionValidator::slotAuthSuccess);
     connect(job, &PropfindJob::finishedWithError, this, &ConnectionValidator::slotAuthFailed);
     job->start();
+
+    if (_isCheckingServerAndAuth) {
+        // Doesn't depend on the result of the authentication check
+        checkServerCapabilities();
+    }
 }
 
 void ConnectionValidator::slotAuthFailed(QNetworkReply *reply)
@@ -217,14 +222,17 @@ void ConnectionValidator::slotAuthSuccess()
         reportResult(Connected);
         return;
     }
-    checkServerCapabilities();
+    _authChecked = true;
+    continueWhenReady();
 }
 
 void ConnectionValidator::checkServerCapabilities()
 {
-    // The main flow now needs the capabilities
+    // The main flow now needs the capabilities. Credential failures are
+    // handled by the authentication check running at the same time.
     auto *job = new JsonApiJob(_account, QLatin1String("ocs/v1.php/cloud/capabilities"), this);
     job->setTimeout(timeoutToUseMsec);
+    job->setIgnoreCredentialFailure(true);
     QObject::connect(job, &JsonApiJob::jsonReceived, this, &ConnectionValidator::slotCapabilitiesRecieved);
     job->start();
 }
@@ -232,8 +240,21 @@ void ConnectionValidator::checkServerCapabilities()
 void ConnectionValidator::slotCapabilitiesRecieved(const QJsonDocument &json)
 {
     auto caps = json.object().value("ocs").toObject().value("data").toObject().value("capabilities").toObject();
+    if (caps.isEmpty() && _account->capabilities().isValid()) {
+        qCWarning(lcConnectionValidator) << "Could not fetch the server capabilities, using the stored ones";
+        _capabilitiesChecked = true;
+        continueWhenReady();
+        return;
+    }
     qCInfo(lcConnectionValidator) << "Server capabilities" << caps;
-    _account->setCapabilities(caps.toVariantMap());
+    const auto capabilities = caps.toVariantMap();
+    const auto changed = capabilities != _account->capabilities().toVariantMap();
+    // Also when unchanged: the stored capabilities were loaded without emitting
+    // capabilitiesChanged() or setting up push notifications and the user status
+    _account->setCapabilities(capabilities);
+    if (changed) {
+        _account->wantsAccountSaved(_account.data());
+    }
 
     // New servers also report the version in the capabilities
     QString serverVersion = caps["core"].toObject()["status"].toObject()["version"].toString();
@@ -246,7 +267,38 @@ void ConnectionValidator::slotCapabilitiesRecieved(const QJsonDocument &json)
     QString directEditingETag = caps["files"].toObject()["directEditing"].toObject()["etag"].toString();
     _account->fetchDirectEditors(directEditingURL, directEditingETag);
 
-    fetchUser();
+    _capabilitiesChecked = true;
+    continueWhenReady();
+}
+
+void ConnectionValidator::continueWhenReady()
+{
+    if (!_authChecked) {
+        return;
+    }
+
+    // The user info only needs capabilities, the ones stored from the
+    // last connection will do until the server sent the current ones
+    if (!_userFetchStarted) {
+        if (!_capabilitiesChecked && !_account->capabilities().isValid()) {
+            return;
+        }
+        _userFetchStarted = true;
+        fetchUser();
+        return;
+    }
+
+    // The encryption setup depends on the current capabilities
+    if (!_userFetched || !_capabilitiesChecked) {
+        return;
+    }
+
+#ifndef TOKEN_AUTH_ONLY
+    connect(_account->e2e(), &ClientSideEncryption::initializationFinished, this, &ConnectionValidator::reportConnected);
+    _account->e2e()->initialize(_account);
+#else
+    reportResult(Connected);
+#endif
 }
 
 void ConnectionValidator::fetchUser()
@@ -292,12 +344,8 @@ void ConnectionValidator::slotUserFetched(UserInfo *userInfo)
         userInfo->deleteLater();
     }
 
-#ifndef TOKEN_AUTH_ONLY
-    connect(_account->e2e(), &ClientSideEncryption::initializationFinished, this, &ConnectionValidator::reportConnected);
-    _account->e2e()->initialize(_account);
-#else
-    reportResult(Connected);
-#endif
+    _userFetched = true;
+    continueWhenReady();
 }
 
 #ifndef TOKEN_AUTH_ONLY
@@ -308,6 +356,11 @@ void ConnectionValidator::reportConnected() {
 
 void ConnectionValidator::reportResult(Status status)
 {
+    // The checks run in parallel, only the first result counts
+    if (_resultReported) {
+        return;
+    }
+    _resultReported = true;
     emit connectionResult(status, _errors);
     deleteLater();
 }
@@ -51,25 +51,27 @@ namespace OCC {
   +---------------------------+
   |
 *-+-> checkAuthentication (PROPFIND on root)
-        PropfindJob
-        |
-        +-> slotAuthFailed --> X
-        |
-        +-> slotAuthSuccess --+--> X (depending if coming from checkServerAndAuth or not)
-                              |
-  +---------------------------+
+  |     PropfindJob
+  |     |
+  |     +-> slotAuthFailed --> X
+  |     |
+  |     +-> slotAuthSuccess --+--> X (depending if coming from checkServerAndAuth or not)
+  |                           |
+  |                           +--> continueWhenReady
   |
-  +-> checkServerCapabilities --------------v (in parallel)
+  +-> checkServerCapabilities (at the same time, only when coming from checkServerAndAuth)
         JsonApiJob (cloud/capabilities)
-        +-> slotCapabilitiesRecieved -+
-                                      |
-    +---------------------------------+
+        +-> slotCapabilitiesRecieved --> continueWhenReady
+                                           |
+    +--------------------------------------+
     |
-  fetchUser
+  fetchUser (once authenticated, the stored capabilities are used until the current ones arrived)
         Utilizes the UserInfo class to fetch the user and avatar image
-  +-----------------------------------+
+        +-> slotUserFetched --> continueWhenReady
+                                  |
+  +-------------------------------+
   |
-  +-> Client Side Encryption Checks --+ --reportResult()
+  +-> Client Side Encryption Checks (once the current capabilities arrived) --+ --reportResult()
     \endcode
  */
 
@@ -131,6 +133,9 @@ private:
     void checkServerCapabilities();
     void fetchUser();
 
+    /// Goes on with the user info and the encryption setup once their requirements are met
+    void continueWhenReady();
+
     /** Sets the account's server version
      *
      * Returns false and reports ServerVersionMismatch for very old servers.
@@ -141,6 +146,12 @@ private:
     AccountStatePtr _accountState;
     AccountPtr _account;
     bool _isCheckingServerAndAuth;
+
+    bool _authChecked = false;
+    bool _capabilitiesChecked = false;
+    bool _userFetchStarted = false;
+    bool _userFetched = false;
+    bool _resultReported = false;
 };
 }
 
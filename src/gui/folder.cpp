@@ -28,6 +28,7 @@
 #include "clientproxy.h"
 #include "syncengine.h"
 #include "syncrunfilelog.h"
+#include "syncstatistics.h"
 #include "socketapi/socketapi.h"
 #include "theme.h"
 #include "filesystem.h"
@@ -38,6 +39,7 @@
 #include "settingsdialog.h"
 
 #include <QTimer>
+#include <QtConcurrent>
 #include <QUrl>
 #include <QDir>
 #include <QSettings>
@@ -107,11 +109,19 @@ Folder::Folder(const FolderDefinition &definition,
 
     connect(_engine.data(), &SyncEngine::addErrorToGui, this, &Folder::slotAddErrorToGui);
 
+    _statistics.reset(new SyncStatistics(_engine.data(), &_journal));
+    connect(_statistics.data(), &SyncStatistics::runFinished, this, [this](const QJsonObject &statistics) {
+        _fileLog->logStatistics(statistics);
+    });
+
     _scheduleSelfTimer.setSingleShot(true);
     _scheduleSelfTimer.setInterval(SyncEngine::minimumFileAgeForUpload);
     connect(&_scheduleSelfTimer, &QTimer::timeout,
         this, &Folder::slotScheduleThisFolder);
 
+    connect(&_watchedChangesWatcher, &QFutureWatcher<QVector<WatchedPathChange>>::finished,
+        this, &Folder::slotWatchedPathChangesChecked);
+
     connect(ProgressDispatcher::instance(), &ProgressDispatcher::folderConflicts,
         this, &Folder::slotFolderConflicts);
 
@@ -148,6 +158,9 @@ Folder::~Folder()
     if (_vfs)
         _vfs->stop();
 
+    // The watched path check uses the journal
+    _watchedChangesWatcher.waitForFinished();
+
     // Reset then engine first as it will abort and try to access members of the Folder
     _engine.reset();
 }
@@ -552,20 +565,56 @@ int Folder::slotWipeErrorBlacklist()
 }
 
 void Folder::slotWatchedPathChanged(const QString &path, ChangeReason reason)
+{
+    WatchedPathChange change;
+    if (!registerWatchedPathChange(path, &change)) {
+        return;
+    }
+
+    _journal.getFileRecord(change.relativePath.toUtf8(), &change.record);
+    if (reason != ChangeReason::UnLock) {
+        change.changed = !change.record.isValid()
+            || FileSystem::fileChanged(path, change.record._fileSize, change.record._modtime);
+        if (isSpuriousChange(change)) {
+            qCInfo(lcFolder) << "Ignoring spurious notification for file" << change.relativePath;
+            return; // probably a spurious notification
+        }
+    }
+    applyWatchedPathChange(change);
+}
+
+void Folder::slotWatchedPathsChanged(const QSet<QString> &paths)
+{
+    for (const auto &path : paths) {
+        WatchedPathChange change;
+        if (registerWatchedPathChange(path, &change)) {
+            _pendingWatchedChanges.append(change);
+        }
+    }
+    checkWatchedPathChanges();
+}
+
+bool Folder::registerWatchedPathChange(const QString &path, WatchedPathChange *change)
 {
     if (!path.startsWith(this->path())) {
         qCDebug(lcFolder) << "Changed path is not contained in folder, ignoring:" << path;
-        return;
+        return false;
     }
 
-    auto relativePath = path.midRef(this->path().size());
+    change->path = path;
+    change->relativePath = path.mid(this->path().size());
 
     // Add to list of locally modified paths
     //
     // We do this before checking for our own sync-related changes to make
     // extra sure to not miss relevant changes.
-    auto relativePathBytes = relativePath.toUtf8();
-    _localDiscoveryTracker->addTouchedPath(relativePathBytes);
+    auto relativePathBytes = change->relativePath.toUtf8();
+    change->pickedUpByRunningSync = _engine->addLocalDiscoveryPath(relativePathBytes);
+    if (change->pickedUpByRunningSync) {
+        _localDiscoveryTracker->addTouchedPathForRunningSync(relativePathBytes);
+    } else {
+        _localDiscoveryTracker->addTouchedPath(relativePathBytes);
+    }
 
 // The folder watcher fires a lot of bogus notifications during
 // a sync operation, both for actual user files and the database
@@ -578,36 +627,84 @@ void Folder::slotWatchedPathChanged(const QString &path, ChangeReason reason)
     // Use the path to figure out whether it was our own change
     if (_engine->wasFileTouched(path)) {
         qCDebug(lcFolder) << "Changed path was touched by SyncEngine, ignoring:" << path;
-        return;
+        return false;
     }
 #endif
+    return true;
+}
 
+void Folder::checkWatchedPathChanges()
+{
+    if (_pendingWatchedChanges.isEmpty() || _watchedChangesWatcher.isRunning()) {
+        // the running check picks up the pending ones when it is done
+        return;
+    }
 
-    SyncJournalFileRecord record;
-    _journal.getFileRecord(relativePathBytes, &record);
-    if (reason != ChangeReason::UnLock) {
-        // Check that the mtime/size actually changed or there was
-        // an attribute change (pin state) that caused the notification
-        bool spurious = false;
-        if (record.isValid()
-            && !FileSystem::fileChanged(path, record._fileSize, record._modtime)) {
-            spurious = true;
-
-            if (auto pinState = _vfs->pinState(relativePath.toString())) {
-                if (*pinState == PinState::AlwaysLocal && record.isVirtualFile())
-                    spurious = false;
-                if (*pinState == PinState::OnlineOnly && record.isFile())
-                    spurious = false;
-            }
+    // The journal lookups and the stat calls add up for bursts of
+    // notifications, do them in a thread.
+    auto changes = std::move(_pendingWatchedChanges);
+    _pendingWatchedChanges.clear();
+    auto journal = &_journal;
+    _watchedChangesWatcher.setFuture(QtConcurrent::run([journal, changes]() mutable {
+        for (auto &change : changes) {
+            journal->getFileRecord(change.relativePath.toUtf8(), &change.record);
+            change.changed = !change.record.isValid()
+                || FileSystem::fileChanged(change.path, change.record._fileSize, change.record._modtime);
         }
-        if (spurious) {
-            qCInfo(lcFolder) << "Ignoring spurious notification for file" << relativePath;
-            return; // probably a spurious notification
+        return changes;
+    }));
+}
+
+void Folder::slotWatchedPathChangesChecked()
+{
+    const auto changes = _watchedChangesWatcher.result();
+    int spuriousCount = 0;
+    for (const auto &change : changes) {
+        if (isSpuriousChange(change)) {
+            qCDebug(lcFolder) << "Ignoring spurious notification for file" << change.relativePath;
+            ++spuriousCount;
+            continue;
         }
+        applyWatchedPathChange(change);
     }
-    warnOnNewExcludedItem(record, relativePath);
+    if (spuriousCount > 0) {
+        qCInfo(lcFolder) << "Ignored" << spuriousCount << "spurious notifications";
+    }
+
+    checkWatchedPathChanges();
+}
+
+bool Folder::isSpuriousChange(const WatchedPathChange &change) const
+{
+    // Check that the mtime/size actually changed or there was
+    // an attribute change (pin state) that caused the notification
+    if (change.changed) {
+        return false;
+    }
+    if (auto pinState = _vfs->pinState(change.relativePath)) {
+        if (*pinState == PinState::AlwaysLocal && change.record.isVirtualFile())
+            return false;
+        if (*pinState == PinState::OnlineOnly && change.record.isFile())
+            return false;
+    }
+    return true;
+}
+
+void Folder::applyWatchedPathChange(const WatchedPathChange &change)
+{
+    warnOnNewExcludedItem(change.record, QStringRef(&change.relativePath));
 
-    emit watchedFileChangedExternally(path);
+    emit watchedFileChangedExternally(change.path);
+
+    if (change.pickedUpByRunningSync) {
+        return;
+    }
+    _userTouched = true;
+    if (isSyncRunning()) {
+        // Don't queue a full follow-up in the middle of the run, see slotSyncFinished()
+        _localChangesDuringSync = true;
+        return;
+    }
 
     // Also schedule this folder for a sync, but only after some delay:
     // The sync will not upload files that were changed too recently.
@@ -788,6 +885,7 @@ void Folder::wipeForRemoval()
 
     // Unregister the socket API so it does not keep the .sync_journal file open
     FolderMan::instance()->socketApi()->slotUnregisterPath(alias());
+    _watchedChangesWatcher.waitForFinished();
     _journal.close(); // close the sync journal
 
     // Remove db and temporaries
@@ -830,6 +928,7 @@ void Folder::startSync(const QStringList &pathList)
     }
 
     _timeSinceLastSyncStart.start();
+    _userTouched = false;
     _syncResult.setStatus(SyncResult::SyncPrepare);
     emit syncStateChange();
 
@@ -906,7 +1005,7 @@ void Folder::setSyncOptions()
     opt._confirmExternalStorage = cfgFile.confirmExternalStorage();
     opt._moveFilesToTrash = cfgFile.moveToTrash();
     opt._vfs = _vfs;
-    opt._parallelNetworkJobs = _accountState->account()->isHttp2Supported() ? 20 : 6;
+    opt._parallelNetworkJobs = cfgFile.maxConcurrentRequests(_accountState->account()->isHttp2Supported());
 
     opt._initialChunkSize = cfgFile.chunkSize();
     opt._minChunkSize = cfgFile.minChunkSize();
@@ -916,9 +1015,24 @@ void Folder::setSyncOptions()
     opt.fillFromEnvironmentVariables();
     opt.verifyChunkSizes();
 
+    _networkBudget = opt._parallelNetworkJobs;
+    opt._parallelNetworkJobs = qMax(1, _networkBudget / _networkBudgetShare);
+
     _engine->setSyncOptions(opt);
 }
 
+void Folder::setNetworkBudgetShare(int share)
+{
+    share = qMax(1, share);
+    if (share == _networkBudgetShare) {
+        return;
+    }
+    _networkBudgetShare = share;
+    if (_networkBudget > 0) {
+        _engine->setParallelNetworkJobs(qMax(1, _networkBudget / _networkBudgetShare));
+    }
+}
+
 void Folder::setDirtyNetworkLimits()
 {
     ConfigFile cfg;
@@ -1040,6 +1154,13 @@ void Folder::slotSyncFinished(bool success)
         // the folder again.
         scheduleThisFolderSoon();
     }
+
+    // Local changes that arrived too late for this run are in the local discovery
+    // tracker, so the next run only needs to rediscover those paths locally.
+    if (_localChangesDuringSync) {
+        _localChangesDuringSync = false;
+        scheduleThisFolderSoon();
+    }
 }
 
 void Folder::slotEmitFinishedDelayed()
@@ -1238,8 +1359,9 @@ void Folder::registerFolderWatcher()
         return;
 
     _folderWatcher.reset(new FolderWatcher(this));
-    connect(_folderWatcher.data(), &FolderWatcher::pathChanged,
-        this, [this](const QString &path) { slotWatchedPathChanged(path, Folder::ChangeReason::Other); });
+    _folderWatcher->setIgnoreCheck([this](const QString &path) { return isFileExcludedAbsolute(path); });
+    connect(_folderWatcher.data(), &FolderWatcher::pathsChanged,
+        this, &Folder::slotWatchedPathsChanged);
     connect(_folderWatcher.data(), &FolderWatcher::lostChanges,
         this, &Folder::slotNextSyncFullLocalDiscovery);
     connect(_folderWatcher.data(), &FolderWatcher::becameUnreliable,
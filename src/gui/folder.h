@@ -25,6 +25,7 @@
 
 #include <QObject>
 #include <QStringList>
+#include <QFutureWatcher>
 #include <QUuid>
 #include <set>
 #include <chrono>
@@ -32,6 +33,7 @@
 
 class QThread;
 class QSettings;
+class TestFolderMan;
 
 namespace OCC {
 
@@ -39,6 +41,7 @@ class Vfs;
 class SyncEngine;
 class AccountState;
 class SyncRunFileLog;
+class SyncStatistics;
 class FolderWatcher;
 class LocalDiscoveryTracker;
 
@@ -227,6 +230,22 @@ public:
     RequestEtagJob *etagJob() { return _requestEtagJob; }
     std::chrono::milliseconds msecSinceLastSync() const { return std::chrono::milliseconds(_timeSinceLastSyncDone.elapsed()); }
     std::chrono::milliseconds msecLastSyncDuration() const { return _lastSyncDuration; }
+
+    /**
+     * Whether the pending sync was asked for by the user, through a local
+     * edit or an explicit "sync now". FolderMan starts such folders first.
+     * Reset when the sync starts.
+     */
+    bool isUserTouched() const { return _userTouched; }
+    void setUserTouched() { _userTouched = true; }
+
+    /**
+     * Number of syncs of the same account that run at the same time as this
+     * one, including itself. The parallel network jobs of the account are
+     * split between them, a running sync adapts right away.
+     */
+    void setNetworkBudgetShare(int share);
+    int networkBudgetShare() const { return _networkBudgetShare; }
     int consecutiveFollowUpSyncs() const { return _consecutiveFollowUpSyncs; }
     int consecutiveFailingSyncs() const { return _consecutiveFailingSyncs; }
 
@@ -340,6 +359,13 @@ public slots:
        */
     void slotWatchedPathChanged(const QString &path, ChangeReason reason);
 
+    /**
+     * Same as slotWatchedPathChanged() for a batch of changes reported by
+     * the folder watcher. The journal lookups and the checks for spurious
+     * notifications run in a thread.
+     */
+    void slotWatchedPathsChanged(const QSet<QString> &paths);
+
     /**
      * Mark a virtual file as being requested for download, and start a sync.
      *
@@ -403,6 +429,8 @@ private slots:
      */
     void slotFolderConflicts(const QString &folder, const QStringList &conflictPaths);
 
+    void slotWatchedPathChangesChecked();
+
     /** Warn users if they create a file or folder that is selective-sync excluded */
     void warnOnNewExcludedItem(const SyncJournalFileRecord &record, const QStringRef &path);
 
@@ -448,6 +476,22 @@ private:
 
     void correctPlaceholderFiles();
 
+    /// A change notification that passed the checks done on the GUI thread
+    struct WatchedPathChange
+    {
+        QString path;
+        QString relativePath;
+        SyncJournalFileRecord record;
+        bool pickedUpByRunningSync = false;
+        bool changed = true; /// whether the size or mtime differ from the record
+    };
+
+    /// Registers the change for local discovery, false if it is not relevant
+    bool registerWatchedPathChange(const QString &path, WatchedPathChange *change);
+    void checkWatchedPathChanges();
+    bool isSpuriousChange(const WatchedPathChange &change) const;
+    void applyWatchedPathChange(const WatchedPathChange &change);
+
     AccountStatePtr _accountState;
     FolderDefinition _definition;
     QString _canonicalLocalPath; // As returned with QFileInfo:canonicalFilePath.  Always ends with "/"
@@ -469,9 +513,22 @@ private:
     /// Reset when no follow-up is requested.
     int _consecutiveFollowUpSyncs;
 
+    /// Local changes were reported during a sync run that it could not pick up anymore.
+    /// A sync limited to those paths is scheduled once the run is done.
+    bool _localChangesDuringSync = false;
+
+    /// See isUserTouched()
+    bool _userTouched = false;
+
+    /// See setNetworkBudgetShare()
+    int _networkBudgetShare = 1;
+    /// Parallel network jobs of the account, 0 until the sync options are set
+    int _networkBudget = 0;
+
     mutable SyncJournalDb _journal;
 
     QScopedPointer<SyncRunFileLog> _fileLog;
+    QScopedPointer<SyncStatistics> _statistics;
 
     QTimer _scheduleSelfTimer;
 
@@ -513,6 +570,10 @@ private:
      */
     QScopedPointer<FolderWatcher> _folderWatcher;
 
+    /// Watcher changes waiting for the journal and stat checks
+    QVector<WatchedPathChange> _pendingWatchedChanges;
+    QFutureWatcher<QVector<WatchedPathChange>> _watchedChangesWatcher;
+
     /**
      * Keeps track of locally dirty files so we can skip local discovery sometimes.
      */
@@ -522,6 +583,8 @@ private:
      * The vfs mode instance (created by plugin) to use. Never null.
      */
     QSharedPointer<Vfs> _vfs;
+
+    friend class ::TestFolderMan;
 };
 }
 
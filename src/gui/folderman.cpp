@@ -36,6 +36,10 @@
 #include <QMutableSetIterator>
 #include <QSet>
 #include <QNetworkProxy>
+#include <QtConcurrent>
+
+#include <algorithm>
+#include <tuple>
 
 static const char versionC[] = "version";
 static const int maxFoldersVersion = 1;
@@ -92,6 +96,7 @@ FolderMan *FolderMan::instance()
 
 FolderMan::~FolderMan()
 {
+    waitForFileNameSearches();
     qDeleteAll(_folderMap);
     _instance = nullptr;
 }
@@ -107,9 +112,12 @@ void FolderMan::unloadFolder(Folder *f)
         return;
     }
 
+    waitForFileNameSearches();
+
     _socketApi->slotUnregisterPath(f->alias());
 
     _folderMap.remove(f->alias());
+    _currentSyncFolders.removeAll(f);
 
     disconnect(f, &Folder::syncStarted,
         this, &FolderMan::slotFolderSyncStarted);
@@ -141,7 +149,7 @@ int FolderMan::unloadAndDeleteAllFolders()
     ASSERT(_folderMap.isEmpty());
 
     _lastSyncFolder = nullptr;
-    _currentSyncFolder = nullptr;
+    _currentSyncFolders.clear();
     _scheduledFolders.clear();
     emit folderListChanged(_folderMap);
     emit scheduleQueueChanged();
@@ -651,6 +659,7 @@ void FolderMan::scheduleFolderNext(Folder *f)
 
     _scheduledFolders.removeAll(f);
 
+    f->setUserTouched();
     f->prepareToSync();
     emit folderSyncStateChange(f);
     _scheduledFolders.prepend(f);
@@ -761,7 +770,7 @@ void FolderMan::startScheduledSyncSoon()
     if (_scheduledFolders.empty()) {
         return;
     }
-    if (isAnySyncRunning()) {
+    if (runningSyncFolders().size() >= ConfigFile().maxConcurrentSyncs()) {
         return;
     }
 
@@ -796,17 +805,13 @@ void FolderMan::startScheduledSyncSoon()
   * slot to start folder syncs.
   * It is either called from the slot where folders enqueue themselves for
   * syncing or after a folder sync was finished.
+  *
+  * Several folders may sync at once, up to ConfigFile::maxConcurrentSyncs().
+  * That way a huge folder doing its initial sync doesn't keep edits in all
+  * the other folders waiting.
   */
 void FolderMan::slotStartScheduledFolderSync()
 {
-    if (isAnySyncRunning()) {
-        for (auto f : _folderMap) {
-            if (f->isSyncRunning())
-                qCInfo(lcFolderMan) << "Currently folder " << f->remoteUrl().toString() << " is running, wait for finish!";
-        }
-        return;
-    }
-
     if (!_syncEnabled) {
         qCInfo(lcFolderMan) << "FolderMan: Syncing is disabled, no scheduling.";
         return;
@@ -817,28 +822,88 @@ void FolderMan::slotStartScheduledFolderSync()
         return;
     }
 
-    // Find the first folder in the queue that can be synced.
-    Folder *folder = nullptr;
-    while (!_scheduledFolders.isEmpty()) {
-        Folder *g = _scheduledFolders.dequeue();
-        if (g->canSync()) {
-            folder = g;
-            break;
-        }
-    }
+    // Drop the folders in the queue that can't be synced.
+    _scheduledFolders.erase(std::remove_if(_scheduledFolders.begin(), _scheduledFolders.end(),
+                                [](Folder *f) { return !f->canSync(); }),
+        _scheduledFolders.end());
 
-    emit scheduleQueueChanged();
+    const int maxConcurrentSyncs = ConfigFile().maxConcurrentSyncs();
+    auto running = runningSyncFolders();
+    while (running.size() < maxConcurrentSyncs) {
+        Folder *folder = nextScheduledFolder(running);
+        if (!folder)
+            break;
+        _scheduledFolders.removeAll(folder);
 
-    // Start syncing this folder!
-    if (folder) {
         // Safe to call several times, and necessary to try again if
         // the folder path didn't exist previously.
         folder->registerFolderWatcher();
         registerFolderWithSocketApi(folder);
 
-        _currentSyncFolder = folder;
+        // Start syncing this folder!
+        _currentSyncFolders.append(folder);
+        running.append(folder);
+        shareNetworkBudget(running);
         folder->startSync(QStringList());
     }
+
+    if (!_scheduledFolders.isEmpty()) {
+        for (auto f : qAsConst(running)) {
+            qCInfo(lcFolderMan) << "Currently folder " << f->remoteUrl().toString() << " is running, wait for finish!";
+        }
+    }
+
+    emit scheduleQueueChanged();
+}
+
+QList<Folder *> FolderMan::runningSyncFolders() const
+{
+    // A folder counts from the moment it was started, even though its engine
+    // only starts in the next event loop iteration.
+    auto running = _currentSyncFolders;
+    for (auto f : _folderMap) {
+        if (f->isSyncRunning() && !running.contains(f))
+            running.append(f);
+    }
+    return running;
+}
+
+Folder *FolderMan::nextScheduledFolder(const QList<Folder *> &runningFolders) const
+{
+    QSet<AccountState *> busyAccounts;
+    QSet<QString> busyDisks;
+    for (auto f : runningFolders) {
+        busyAccounts.insert(f->accountState());
+        busyDisks.insert(QStorageInfo(f->path()).rootPath());
+    }
+
+    using Priority = std::tuple<bool, bool, std::chrono::milliseconds>;
+    Folder *next = nullptr;
+    Priority nextPriority;
+    for (auto f : _scheduledFolders) {
+        if (f->isBusy()) // e.g. hydrating a virtual file, stays in the queue
+            continue;
+        const bool competes = busyAccounts.contains(f->accountState())
+            || busyDisks.contains(QStorageInfo(f->path()).rootPath());
+        // A folder that never synced may take long, the quick ones go first
+        const auto duration = f->msecLastSyncDuration() > std::chrono::milliseconds(0)
+            ? f->msecLastSyncDuration() : std::chrono::milliseconds::max();
+        const auto priority = std::make_tuple(!f->isUserTouched(), competes, duration);
+        if (!next || priority < nextPriority) {
+            next = f;
+            nextPriority = priority;
+        }
+    }
+    return next;
+}
+
+void FolderMan::shareNetworkBudget(const QList<Folder *> &runningFolders)
+{
+    for (auto folder : runningFolders) {
+        const auto sameAccount = std::count_if(runningFolders.cbegin(), runningFolders.cend(),
+            [folder](Folder *f) { return f->accountState() == folder->accountState(); });
+        folder->setNetworkBudgetShare(static_cast<int>(sameAccount));
+    }
 }
 
 bool FolderMan::pushNotificationsFilesReady(Account *account)
@@ -1030,7 +1095,7 @@ void FolderMan::slotScheduleFolderByTime()
 
 bool FolderMan::isAnySyncRunning() const
 {
-    if (_currentSyncFolder)
+    if (!_currentSyncFolders.isEmpty())
         return true;
 
     for (auto f : _folderMap) {
@@ -1071,12 +1136,16 @@ void FolderMan::slotFolderSyncFinished(const SyncResult &)
         qPrintable(f->accountState()->account()->displayName()),
         qPrintable(f->remoteUrl().toString()));
 
-    if (f == _currentSyncFolder) {
-        _lastSyncFolder = _currentSyncFolder;
-        _currentSyncFolder = nullptr;
+    if (_currentSyncFolders.removeAll(f) > 0) {
+        _lastSyncFolder = f;
     }
-    if (!isAnySyncRunning())
-        startScheduledSyncSoon();
+
+    // The syncs that keep running get the share of this one
+    auto running = runningSyncFolders();
+    running.removeAll(f);
+    shareNetworkBudget(running);
+
+    startScheduledSyncSoon();
 }
 
 Folder *FolderMan::addFolder(AccountState *accountState, const FolderDefinition &folderDefinition)
@@ -1198,6 +1267,46 @@ QStringList FolderMan::findFileInLocalFolders(const QString &relPath, const Acco
     return re;
 }
 
+QFuture<QStringList> FolderMan::findSyncedFilesByNameAsync(const QString &term, int limit, const AccountPtr acc)
+{
+    QVector<QPair<QString, SyncJournalDb *>> journals;
+    if (!term.isEmpty()) {
+        for (Folder *folder : this->map().values()) {
+            if (!acc || folder->accountState()->account() == acc) {
+                journals.append({ folder->path(), folder->journalDb() });
+            }
+        }
+    }
+
+    // The journals are mutex protected, waitForFileNameSearches() keeps the folders alive
+    auto search = QtConcurrent::run([term, limit, journals]() {
+        QStringList re;
+        for (const auto &journal : journals) {
+            const auto remaining = limit - re.size();
+            if (remaining <= 0)
+                break;
+            journal.second->searchFileNames(term, remaining, [&](const SyncJournalFileRecord &record) {
+                re.append(journal.first + QString::fromUtf8(record._path));
+            });
+        }
+        return re;
+    });
+
+    _fileNameSearches.erase(std::remove_if(_fileNameSearches.begin(), _fileNameSearches.end(), [](const QFuture<QStringList> &f) {
+        return f.isFinished();
+    }), _fileNameSearches.end());
+    _fileNameSearches.append(search);
+    return search;
+}
+
+void FolderMan::waitForFileNameSearches()
+{
+    for (auto &search : _fileNameSearches) {
+        search.waitForFinished();
+    }
+    _fileNameSearches.clear();
+}
+
 void FolderMan::removeFolder(Folder *f)
 {
     if (!f) {
@@ -1207,6 +1316,9 @@ void FolderMan::removeFolder(Folder *f)
 
     qCInfo(lcFolderMan) << "Removing " << f->alias();
 
+    // Wiping deletes the journal
+    waitForFileNameSearches();
+
     const bool currentlyRunning = f->isSyncRunning();
     if (currentlyRunning) {
         // abort the sync now
@@ -1332,10 +1444,10 @@ void FolderMan::slotWipeFolderForAccount(AccountState *accountState)
 
         qCInfo(lcFolderMan) << "Removing " << f->alias();
 
-        const bool currentlyRunning = (_currentSyncFolder == f);
+        const bool currentlyRunning = _currentSyncFolders.contains(f);
         if (currentlyRunning) {
             // abort the sync now
-            _currentSyncFolder->slotTerminateSync();
+            f->slotTerminateSync();
         }
 
         if (_scheduledFolders.removeAll(f) > 0) {
@@ -1696,9 +1808,14 @@ QQueue<Folder *> FolderMan::scheduleQueue() const
     return _scheduledFolders;
 }
 
+QList<Folder *> FolderMan::currentSyncFolders() const
+{
+    return _currentSyncFolders;
+}
+
 Folder *FolderMan::currentSyncFolder() const
 {
-    return _currentSyncFolder;
+    return _currentSyncFolders.value(0, nullptr);
 }
 
 void FolderMan::restartApplication()
@@ -1744,6 +1861,55 @@ void FolderMan::slotProcessFilesPushNotification(Account *account)
     }
 }
 
+QList<Folder *> FolderMan::foldersForFileIdsPushNotification(Account *account, const QVector<qint64> &fileIds)
+{
+    QList<Folder *> accountFolders;
+    QList<Folder *> affectedFolders;
+    QSet<qint64> knownFileIds;
+    for (auto folder : qAsConst(_folderMap)) {
+        // Just run on the folders that belong to this account
+        if (folder->accountState()->account() != account) {
+            continue;
+        }
+        accountFolders.append(folder);
+
+        // Only the parents of the changed files need to be discovered again,
+        // every other directory keeps its etag from the database
+        bool folderAffected = false;
+        for (const auto fileId : fileIds) {
+            folder->journalDb()->getFileRecordsByNumericFileId(fileId, [&](const SyncJournalFileRecord &record) {
+                folder->journalDb()->schedulePathForRemoteDiscovery(record._path);
+                knownFileIds.insert(fileId);
+                folderAffected = true;
+            });
+        }
+        if (folderAffected) {
+            affectedFolders.append(folder);
+        }
+    }
+
+    // The ids of new files can't be known yet: any of the folders may contain them
+    const auto allFileIdsKnown = !fileIds.isEmpty() && std::all_of(fileIds.cbegin(), fileIds.cend(), [&knownFileIds](qint64 fileId) {
+        return knownFileIds.contains(fileId);
+    });
+    if (!allFileIdsKnown) {
+        qCInfo(lcFolderMan) << "Not every file id is known, all folders of the account are affected";
+        return accountFolders;
+    }
+    return affectedFolders;
+}
+
+void FolderMan::slotProcessFileIdsPushNotification(Account *account, const QVector<qint64> &fileIds)
+{
+    qCInfo(lcFolderMan) << "Got files push notification for account" << account << "with" << fileIds.size() << "file ids";
+
+    const auto folders = foldersForFileIdsPushNotification(account, fileIds);
+    for (auto folder : folders) {
+        qCInfo(lcFolderMan) << "Schedule folder" << folder << "for sync";
+        scheduleFolder(folder);
+    }
+}
+
 void FolderMan::slotConnectToPushNotifications(Account *account)
 {
     const auto pushNotifications = account->pushNotifications();
@@ -1751,6 +1917,7 @@ void FolderMan::slotConnectToPushNotifications(Account *account)
     if (pushNotificationsFilesReady(account)) {
         qCInfo(lcFolderMan) << "Push notifications ready";
         connect(pushNotifications, &PushNotifications::filesChanged, this, &FolderMan::slotProcessFilesPushNotification, Qt::UniqueConnection);
+        connect(pushNotifications, &PushNotifications::fileIdsChanged, this, &FolderMan::slotProcessFileIdsPushNotification, Qt::UniqueConnection);
     }
 }
 
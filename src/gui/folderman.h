@@ -19,6 +19,7 @@
 #include <QObject>
 #include <QQueue>
 #include <QList>
+#include <QFuture>
 
 #include "folder.h"
 #include "folderwatcher.h"
@@ -93,6 +94,13 @@ public:
       */
     QStringList findFileInLocalFolders(const QString &relPath, const AccountPtr acc);
 
+    /**
+      * returns up to \a limit local paths of synced files whose name contains
+      * \a term. Only the sync journals are consulted, not the server or the disk.
+      * The journals are read on a worker thread.
+      */
+    QFuture<QStringList> findSyncedFilesByNameAsync(const QString &term, int limit, const AccountPtr acc = AccountPtr());
+
     /** Returns the folder by alias or \c nullptr if no folder with the alias exists. */
     Folder *folder(const QString &);
 
@@ -163,13 +171,25 @@ public:
     QQueue<Folder *> scheduleQueue() const;
 
     /**
-     * Access to the currently syncing folder.
+     * The folders of @a account to sync for a push notification about @a fileIds.
+     *
+     * Marks the paths of the known files for remote discovery. As soon as one
+     * of the ids is unknown to every folder, which is the case for new files,
+     * all folders of the account are returned.
+     */
+    QList<Folder *> foldersForFileIdsPushNotification(Account *account, const QVector<qint64> &fileIds);
+
+    /**
+     * Access to the currently syncing folders.
      *
-     * Note: This is only the folder that's currently syncing *as-scheduled*. There
-     * may be externally-managed syncs such as from placeholder hydrations.
+     * Note: These are only the folders that are currently syncing *as-scheduled*.
+     * There may be externally-managed syncs such as from placeholder hydrations.
      *
      * See also isAnySyncRunning()
      */
+    QList<Folder *> currentSyncFolders() const;
+
+    /** The first of currentSyncFolders(), or nullptr */
     Folder *currentSyncFolder() const;
 
     /**
@@ -292,6 +312,7 @@ private slots:
 
     void slotSetupPushNotifications(const Folder::Map &);
     void slotProcessFilesPushNotification(Account *account);
+    void slotProcessFileIdsPushNotification(Account *account, const QVector<qint64> &fileIds);
     void slotConnectToPushNotifications(Account *account);
 
 private:
@@ -319,6 +340,21 @@ private:
 
     void setupFoldersHelper(QSettings &settings, AccountStatePtr account, const QStringList &ignoreKeys, bool backwardsCompatible, bool foldersWithPlaceholders);
 
+    /** Folders syncing right now, scheduled or externally-managed */
+    QList<Folder *> runningSyncFolders() const;
+
+    /**
+     * Picks the scheduled folder to start next, or nullptr if none can start.
+     *
+     * Folders the user is waiting for come first, then folders that don't compete
+     * with a running sync for the same account or disk, then the ones whose last
+     * sync was quickest, folders that never synced last. Ties keep the queue order.
+     */
+    Folder *nextScheduledFolder(const QList<Folder *> &runningFolders) const;
+
+    /** Splits the network budget of each account between its running syncs */
+    static void shareNetworkBudget(const QList<Folder *> &runningFolders);
+
     void runEtagJobsIfPossible(const QList<Folder *> &folderMap);
     void runEtagJobIfPossible(Folder *folder);
 
@@ -326,11 +362,15 @@ private:
 
     bool isSwitchToVfsNeeded(const FolderDefinition &folderDefinition) const;
 
+    /** Blocks until no search reads the journals anymore, before folders go away */
+    void waitForFileNameSearches();
+
     QSet<Folder *> _disabledFolders;
     Folder::Map _folderMap;
     QString _folderConfigPath;
-    Folder *_currentSyncFolder = nullptr;
+    QList<Folder *> _currentSyncFolders;
     QPointer<Folder> _lastSyncFolder;
+    QList<QFuture<QStringList>> _fileNameSearches;
     bool _syncEnabled = true;
 
     /// Folder aliases from the settings that weren't read
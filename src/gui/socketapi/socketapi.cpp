@@ -57,6 +57,7 @@
 #include <QMessageBox>
 #include <QInputDialog>
 #include <QFileDialog>
+#include <QFutureWatcher>
 
 
 #include <QAction>
@@ -974,6 +975,28 @@ void SocketApi::command_V2_UPLOAD_FILES_FROM(const QSharedPointer<SocketApiJobV2
     uploadJob->start();
 }
 
+void SocketApi::command_V2_SEARCH_FILES(const QSharedPointer<SocketApiJobV2> &job) const
+{
+    const auto term = job->arguments().value(QStringLiteral("term")).toString();
+    if (term.isEmpty()) {
+        job->failure(QStringLiteral("Missing search term"));
+        return;
+    }
+    const auto limit = job->arguments().value(QStringLiteral("limit")).toInt(50);
+
+    // The journals are read on a worker thread, answer once they are done
+    auto watcher = new QFutureWatcher<QStringList>;
+    connect(watcher, &QFutureWatcher<QStringList>::finished, watcher, [job, watcher] {
+        QJsonArray out;
+        for (const auto &localFile : watcher->result()) {
+            out << QDir::toNativeSeparators(localFile);
+        }
+        job->success({ { "files", out } });
+        watcher->deleteLater();
+    });
+    watcher->setFuture(FolderMan::instance()->findSyncedFilesByNameAsync(term, limit));
+}
+
 void SocketApi::emailPrivateLink(const QString &link)
 {
     Utility::openEmailComposer(
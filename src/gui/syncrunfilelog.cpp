@@ -12,6 +12,7 @@
  * for more details.
  */
 
+#include <QJsonDocument>
 #include <QRegularExpression>
 
 #include "syncrunfilelog.h"
@@ -28,10 +29,25 @@ QString SyncRunFileLog::dateTimeStr(const QDateTime &dt)
     return dt.toString(Qt::ISODate);
 }
 
-void SyncRunFileLog::start(const QString &folderPath)
-{
+namespace {
     const qint64 logfileMaxSize = 10 * 1024 * 1024; // 10MiB
 
+    // When the file is too big, just rename it to an old name.
+    bool rotateIfTooBig(const QString &filename)
+    {
+        QFileInfo info(filename);
+        if (info.exists() && info.size() > logfileMaxSize) {
+            QString newFilename = filename + QLatin1String(".1");
+            QFile::remove(newFilename);
+            QFile::rename(filename, newFilename);
+            return true;
+        }
+        return false;
+    }
+}
+
+void SyncRunFileLog::start(const QString &folderPath)
+{
     const QString logpath = QStandardPaths::writableLocation(QStandardPaths::AppDataLocation);
     if(!QDir(logpath).exists()) {
         QDir().mkdir(logpath);
@@ -64,15 +80,8 @@ void SyncRunFileLog::start(const QString &folderPath)
         else break;
     }
 
-    // When the file is too big, just rename it to an old name.
-    QFileInfo info(filename);
-    bool exists = info.exists();
-    if (exists && info.size() > logfileMaxSize) {
-        exists = false;
-        QString newFilename = filename + QLatin1String(".1");
-        QFile::remove(newFilename);
-        QFile::rename(filename, newFilename);
-    }
+    bool exists = !rotateIfTooBig(filename) && QFile::exists(filename);
+    _statisticsFileName = filename.left(filename.size() - int(qstrlen("_sync.log"))) + QLatin1String("_sync_stats.json");
     _file.reset(new QFile(filename));
 
     _file->open(QIODevice::WriteOnly | QIODevice::Append | QIODevice::Text);
@@ -149,4 +158,23 @@ void SyncRunFileLog::finish()
          << ", total: " << _totalDuration.elapsed() << " msec)" << endl;
     _file->close();
 }
+
+void SyncRunFileLog::logStatistics(const QJsonObject &statistics)
+{
+    if (_statisticsFileName.isEmpty()) {
+        return;
+    }
+    rotateIfTooBig(_statisticsFileName);
+
+    QFile file(_statisticsFileName);
+    const bool exists = file.exists();
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Append)) {
+        return;
+    }
+    file.write(QJsonDocument(statistics).toJson(QJsonDocument::Compact) + '\n');
+    file.close();
+    if (!exists) {
+        FileSystem::setFileHidden(_statisticsFileName, true);
+    }
+}
 }
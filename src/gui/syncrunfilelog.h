@@ -21,6 +21,7 @@
 #include <QElapsedTimer>
 #include <QStandardPaths>
 #include <QDir>
+#include <QJsonObject>
 
 #include "syncfileitem.h"
 
@@ -40,11 +41,18 @@ public:
     void logLap(const QString &name);
     void finish();
 
+    /**
+     * Appends the SyncStatistics record of a run as one JSON line to the
+     * "_sync_stats.json" file next to the log file of start().
+     */
+    void logStatistics(const QJsonObject &statistics);
+
 protected:
 private:
     QString dateTimeStr(const QDateTime &dt);
 
     QScopedPointer<QFile> _file;
+    QString _statisticsFileName;
     QTextStream _out;
     QElapsedTimer _totalDuration;
     QElapsedTimer _lapDuration;
@@ -187,6 +187,13 @@ constexpr int searchTermEditingFinishedSearchStartDelay = 800;
 
 // server-side bug of returning the cursor > 0 and isPaginated == 'true', using '5' as it is done on Android client's end now
 constexpr int minimumEntresNumberToShowLoadMore = 5;
+
+// results from the sync journals, listed before everything the server returns
+const QString localFilesProviderId = QStringLiteral("local-files");
+constexpr int localFilesProviderOrder = std::numeric_limits<qint32>::min();
+constexpr int localSearchResultsLimit = 10;
+// The journals answer quickly, but not every keystroke needs a query
+constexpr int localSearchStartDelay = 150;
 }
 namespace OCC {
 Q_LOGGING_CATEGORY(lcUnifiedSearch, "nextcloud.gui.unifiedsearch", QtInfoMsg)
@@ -195,6 +202,10 @@ UnifiedSearchResultsListModel::UnifiedSearchResultsListModel(AccountState *accou
     : QAbstractListModel(parent)
     , _accountState(accountState)
 {
+    _localSearchTimer.setSingleShot(true);
+    _localSearchTimer.setInterval(localSearchStartDelay);
+    connect(&_localSearchTimer, &QTimer::timeout, this, &UnifiedSearchResultsListModel::startLocalSearch);
+    connect(&_localSearchWatcher, &QFutureWatcher<QStringList>::finished, this, &UnifiedSearchResultsListModel::slotLocalSearchFinished);
 }
 
 QVariant UnifiedSearchResultsListModel::data(const QModelIndex &index, int role) const
@@ -310,6 +321,13 @@ void UnifiedSearchResultsListModel::setSearchTerm(const QString &term)
         _results.clear();
         endResetModel();
     }
+
+    // The journals answer quickly, no need to wait for typing to finish
+    if (_searchTerm.isEmpty()) {
+        _localSearchTimer.stop();
+    } else {
+        _localSearchTimer.start();
+    }
 }
 
 bool UnifiedSearchResultsListModel::isSearchInProgress() const
@@ -319,6 +337,12 @@ bool UnifiedSearchResultsListModel::isSearchInProgress() const
 
 void UnifiedSearchResultsListModel::resultClicked(const QString &providerId, const QUrl &resourceUrl) const
 {
+    if (providerId == localFilesProviderId && resourceUrl.isLocalFile()) {
+        qCInfo(lcUnifiedSearch) << "Opening file:" << resourceUrl.toLocalFile();
+        QDesktopServices::openUrl(resourceUrl);
+        return;
+    }
+
     const QUrlQuery urlQuery{resourceUrl};
     const auto dir = urlQuery.queryItemValue(QStringLiteral("dir"), QUrl::ComponentFormattingOption::FullyDecoded);
     const auto fileName =
@@ -484,11 +508,57 @@ void UnifiedSearchResultsListModel::startSearch()
         endResetModel();
     }
 
+    startLocalSearch();
+
     for (const auto &provider : _providers) {
         startSearchForProvider(provider._id);
     }
 }
 
+void UnifiedSearchResultsListModel::startLocalSearch()
+{
+    if (_searchTerm.isEmpty() || !_accountState || !_accountState->account()) {
+        return;
+    }
+
+    _localSearchTimer.stop();
+    _localSearchTerm = _searchTerm;
+    _localSearchWatcher.setFuture(FolderMan::instance()->findSyncedFilesByNameAsync(_searchTerm, localSearchResultsLimit, _accountState->account()));
+}
+
+void UnifiedSearchResultsListModel::slotLocalSearchFinished()
+{
+    // The user kept typing meanwhile
+    if (_localSearchTerm != _searchTerm) {
+        return;
+    }
+
+    const auto localFiles = _localSearchWatcher.result();
+    if (localFiles.isEmpty()) {
+        return;
+    }
+
+    UnifiedSearchProvider provider;
+    provider._id = localFilesProviderId;
+    provider._name = tr("Synced files");
+    provider._order = localFilesProviderOrder;
+
+    QVector<UnifiedSearchResult> results;
+    for (const auto &localFile : localFiles) {
+        const QFileInfo fileInfo(localFile);
+        UnifiedSearchResult result;
+        result._providerId = provider._id;
+        result._order = provider._order;
+        result._providerName = provider._name;
+        result._title = fileInfo.fileName();
+        result._subline = QDir::toNativeSeparators(fileInfo.path());
+        result._resourceUrl = QUrl::fromLocalFile(localFile);
+        results.push_back(result);
+    }
+
+    appendResults(results, provider);
+}
+
 void UnifiedSearchResultsListModel::startSearchForProvider(const QString &providerId, qint32 cursor)
 {
     Q_ASSERT(_accountState && _accountState->account());
@@ -83,6 +83,7 @@ public:
 
 private:
     void startSearch();
+    void startLocalSearch();
     void startSearchForProvider(const QString &providerId, qint32 cursor = -1);
 
     void parseResultsForProvider(const QJsonObject &data, const QString &providerId, bool fetchedMore = false);
@@ -112,6 +113,7 @@ private slots:
     void slotSearchTermEditingFinished();
     void slotFetchProvidersFinished(const QJsonDocument &json, int statusCode);
     void slotSearchForProviderFinished(const QJsonDocument &json, int statusCode);
+    void slotLocalSearchFinished();
 
 private:
     QMap<QString, UnifiedSearchProvider> _providers;
@@ -126,6 +128,10 @@ private:
 
     QTimer _unifiedSearchTextEditingFinishedTimer;
 
+    QTimer _localSearchTimer;
+    QFutureWatcher<QStringList> _localSearchWatcher;
+    QString _localSearchTerm;
+
     AccountState *_accountState = nullptr;
 };
 }
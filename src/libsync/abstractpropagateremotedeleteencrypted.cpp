@@ -144,7 +144,7 @@ void AbstractPropagateRemoteDeleteEncrypted::slotDeleteRemoteItemFinished()
         return;
     }
 
-    _propagator->_journal->deleteFileRecord(_item->_originalFile, _item->isDirectory());
+    _propagator->_journal->deleteFileRecord(_propagator->adjustRenamedPath(_item->_originalFile), _item->isDirectory());
     _propagator->_journal->commit("Remote Remove");
 
     unlockFolder();
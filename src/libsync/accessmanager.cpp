@@ -22,9 +22,13 @@
 #include <QNetworkCookieJar>
 #include <QNetworkConfiguration>
 #include <QUuid>
+#if QT_VERSION >= QT_VERSION_CHECK(5, 14, 0)
+#include <QHttp2Configuration>
+#endif
 
 #include "cookiejar.h"
 #include "accessmanager.h"
+#include "configfile.h"
 #include "common/utility.h"
 #include "httplogger.h"
 
@@ -32,6 +36,12 @@ namespace OCC {
 
 Q_LOGGING_CATEGORY(lcAccessManager, "nextcloud.sync.accessmanager", QtInfoMsg)
 
+namespace {
+
+    // Same as the size below which uploads are small enough to be bundled
+    const qint64 http2MaximumUploadSize = 1000 * 1000;
+}
+
 AccessManager::AccessManager(QObject *parent)
     : QNetworkAccessManager(parent)
 {
@@ -47,6 +57,24 @@ AccessManager::AccessManager(QObject *parent)
     setConfiguration(QNetworkConfiguration());
 #endif
     setCookieJar(new CookieJar);
+
+    connect(this, &QNetworkAccessManager::encrypted, this, [this] {
+        _requestStatistics.tlsHandshakes++;
+    });
+}
+
+bool AccessManager::http2Enabled()
+{
+    const auto env = qgetenv("OWNCLOUD_HTTP2_ENABLED");
+    if (!env.isEmpty()) {
+        return env == "1";
+    }
+    return ConfigFile().http2Enabled();
+}
+
+bool AccessManager::isHttp2Candidate(QIODevice *outgoingData)
+{
+    return !outgoingData || (!outgoingData->isSequential() && outgoingData->size() <= http2MaximumUploadSize);
 }
 
 QByteArray AccessManager::generateRequestId()
@@ -82,14 +110,31 @@ QNetworkReply *AccessManager::createRequest(QNetworkAccessManager::Operation op,
     // only enable HTTP2 with Qt 5.9.4 because old Qt have too many bugs (e.g. QTBUG-64359 is fixed in >= Qt 5.9.4)
     if (newRequest.url().scheme() == "https") { // Not for "http": QTBUG-61397
         // http2 seems to cause issues, as with our recommended server setup we don't support http2, disable it by default for now
-        static const bool http2EnabledEnv = qEnvironmentVariableIntValue("OWNCLOUD_HTTP2_ENABLED") == 1;
-
-        newRequest.setAttribute(QNetworkRequest::HTTP2AllowedAttribute, http2EnabledEnv);
+        static const bool http2EnabledSetting = http2Enabled();
+
+        newRequest.setAttribute(QNetworkRequest::HTTP2AllowedAttribute, http2EnabledSetting && isHttp2Candidate(outgoingData));
+#if QT_VERSION >= QT_VERSION_CHECK(5, 14, 0)
+        if (http2EnabledSetting) {
+            // Qt's small default receive windows stall downloads from a far-away
+            // server after every few kilobytes until the window update arrives
+            QHttp2Configuration http2Configuration;
+            http2Configuration.setSessionReceiveWindowSize(64 * 1024 * 1024);
+            http2Configuration.setStreamReceiveWindowSize(16 * 1024 * 1024);
+            newRequest.setHttp2Configuration(http2Configuration);
+        }
+#endif
     }
 #endif
 
     const auto reply = QNetworkAccessManager::createRequest(op, newRequest, outgoingData);
     HttpLogger::logRequest(reply, op, outgoingData);
+    connect(reply, &QNetworkReply::finished, this, [this, reply] {
+        if (reply->attribute(QNetworkRequest::HTTP2WasUsedAttribute).toBool()) {
+            _requestStatistics.http2Requests++;
+        } else {
+            _requestStatistics.http1Requests++;
+        }
+    });
     return reply;
 }
 
@@ -20,6 +20,7 @@
 
 class QByteArray;
 class QUrl;
+class TestAccessManager;
 
 namespace OCC {
 
@@ -32,12 +33,42 @@ class OWNCLOUDSYNC_EXPORT AccessManager : public QNetworkAccessManager
     Q_OBJECT
 
 public:
+    /** Counts since the access manager was created
+     *
+     * Every new TLS connection takes a handshake, so the requests per
+     * handshake show how well requests share connections.
+     */
+    struct RequestStatistics
+    {
+        qint64 http1Requests = 0;
+        qint64 http2Requests = 0;
+        qint64 tlsHandshakes = 0;
+    };
+
     static QByteArray generateRequestId();
 
     AccessManager(QObject *parent = nullptr);
 
+    RequestStatistics requestStatistics() const { return _requestStatistics; }
+
 protected:
     QNetworkReply *createRequest(QNetworkAccessManager::Operation op, const QNetworkRequest &request, QIODevice *outgoingData = nullptr) override;
+
+private:
+    /** Whether HTTP/2 is turned on, OWNCLOUD_HTTP2_ENABLED overrides the setting in both directions */
+    static bool http2Enabled();
+
+    /** Whether a request may be multiplexed over HTTP/2
+     *
+     * Only requests without a body or with a small body that can be rewound:
+     * Qt has to resend a request when the server resets its stream, and a
+     * large upload gains nothing from sharing the connection.
+     */
+    static bool isHttp2Candidate(QIODevice *outgoingData);
+
+    RequestStatistics _requestStatistics;
+
+    friend class ::TestAccessManager;
 };
 
 } // namespace OCC
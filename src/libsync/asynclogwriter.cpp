@@ -0,0 +1,165 @@
+/*
+ * Copyright (C) by Nextcloud GmbH
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ */
+
+#include "asynclogwriter.h"
+
+namespace {
+// How long the idle writer sleeps before looking at the queue again in case
+// a wake-up was missed. Producers never wait for this.
+constexpr unsigned long IdleWaitMs = 100;
+
+// Upper bound of records handed to the sink at once so a flood of messages
+// does not hold the logger mutex for too long.
+constexpr int MaxBatchSize = 4096;
+}
+
+namespace OCC {
+
+LogRecordQueue::LogRecordQueue()
+    : _head(&_stub)
+    , _tail(&_stub)
+{
+}
+
+LogRecordQueue::~LogRecordQueue()
+{
+    QString discard;
+    while (pop(discard)) {
+    }
+}
+
+void LogRecordQueue::push(QString record)
+{
+    auto node = new Node;
+    node->record = std::move(record);
+    pushNode(node);
+}
+
+void LogRecordQueue::pushNode(Node *node)
+{
+    node->next.store(nullptr, std::memory_order_relaxed);
+    Node *previous = _head.exchange(node, std::memory_order_acq_rel);
+    previous->next.store(node, std::memory_order_release);
+}
+
+bool LogRecordQueue::pop(QString &record)
+{
+    Node *tail = _tail;
+    Node *next = tail->next.load(std::memory_order_acquire);
+    if (tail == &_stub) {
+        if (!next) {
+            return false;
+        }
+        _tail = next;
+        tail = next;
+        next = next->next.load(std::memory_order_acquire);
+    }
+    if (next) {
+        _tail = next;
+        record = std::move(tail->record);
+        delete tail;
+        return true;
+    }
+    // A producer is between exchanging the head and linking its node;
+    // the record will be picked up on the next round.
+    if (tail != _head.load(std::memory_order_acquire)) {
+        return false;
+    }
+    pushNode(&_stub);
+    next = tail->next.load(std::memory_order_acquire);
+    if (next) {
+        _tail = next;
+        record = std::move(tail->record);
+        delete tail;
+        return true;
+    }
+    return false;
+}
+
+AsyncLogWriter::AsyncLogWriter(Sink sink, QObject *parent)
+    : QThread(parent)
+    , _sink(std::move(sink))
+{
+    setObjectName(QStringLiteral("AsyncLogWriter"));
+}
+
+AsyncLogWriter::~AsyncLogWriter()
+{
+    stop();
+}
+
+void AsyncLogWriter::enqueue(QString record)
+{
+    _queue.push(std::move(record));
+    _pending.fetch_add(1);
+    if (_idle.load()) {
+        QMutexLocker lock(&_wakeMutex);
+        _wakeCondition.wakeOne();
+    }
+}
+
+void AsyncLogWriter::drain()
+{
+    while (drainBatch()) {
+    }
+}
+
+bool AsyncLogWriter::drainBatch()
+{
+    QMutexLocker lock(&_consumerMutex);
+    QVector<QString> batch;
+    QString record;
+    while (batch.size() < MaxBatchSize && _queue.pop(record)) {
+        batch.append(std::move(record));
+    }
+    if (batch.isEmpty()) {
+        return false;
+    }
+    _pending.fetch_sub(batch.size());
+    _sink(batch);
+    return true;
+}
+
+void AsyncLogWriter::stop()
+{
+    if (isRunning()) {
+        _stopRequested.store(true, std::memory_order_release);
+        {
+            QMutexLocker lock(&_wakeMutex);
+            _wakeCondition.wakeOne();
+        }
+        wait();
+        _stopRequested.store(false, std::memory_order_release);
+    }
+    drain();
+}
+
+void AsyncLogWriter::run()
+{
+    while (!_stopRequested.load(std::memory_order_acquire)) {
+        if (drainBatch()) {
+            continue;
+        }
+        QMutexLocker lock(&_wakeMutex);
+        _idle.store(true);
+        // re-check after announcing we are idle so a concurrent enqueue is not missed
+        if (_pending.load() == 0 && !_stopRequested.load(std::memory_order_acquire)) {
+            _wakeCondition.wait(&_wakeMutex, IdleWaitMs);
+        }
+        _idle.store(false);
+    }
+    drain();
+}
+
+} // namespace OCC
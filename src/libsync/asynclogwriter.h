@@ -0,0 +1,110 @@
+/*
+ * Copyright (C) by Nextcloud GmbH
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ */
+
+#pragma once
+
+#include <QThread>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QVector>
+#include <QString>
+
+#include <atomic>
+#include <functional>
+
+#include "owncloudlib.h"
+
+namespace OCC {
+
+/**
+ * @brief Lock-free multi-producer single-consumer queue of log records
+ *
+ * Intrusive node based queue (Vyukov style). push() never blocks and may be
+ * called from any thread; pop() must only be called by one consumer at a time.
+ *
+ * @ingroup libsync
+ */
+class OWNCLOUDSYNC_EXPORT LogRecordQueue
+{
+public:
+    LogRecordQueue();
+    ~LogRecordQueue();
+
+    void push(QString record);
+
+    /** Moves the oldest record into @a record, returns false if the queue looked empty */
+    bool pop(QString &record);
+
+private:
+    struct Node
+    {
+        std::atomic<Node *> next{ nullptr };
+        QString record;
+    };
+
+    void pushNode(Node *node);
+
+    std::atomic<Node *> _head;
+    Node *_tail;
+    Node _stub;
+
+    Q_DISABLE_COPY(LogRecordQueue)
+};
+
+/**
+ * @brief Background thread that drains preformatted log records in batches
+ *
+ * Producers only pay for a lock-free push; the writer thread collects
+ * everything that accumulated and hands it to the sink in one call, so the
+ * sink (file write, optional flush) runs once per batch instead of once per
+ * message.
+ *
+ * @ingroup libsync
+ */
+class OWNCLOUDSYNC_EXPORT AsyncLogWriter : public QThread
+{
+    Q_OBJECT
+public:
+    using Sink = std::function<void(const QVector<QString> &)>;
+
+    explicit AsyncLogWriter(Sink sink, QObject *parent = nullptr);
+    ~AsyncLogWriter() override;
+
+    /** Thread-safe and lock-free unless the writer is idle and needs waking up */
+    void enqueue(QString record);
+
+    /** Synchronously writes everything that was queued so far, from the calling thread */
+    void drain();
+
+    /** Drains the remaining records and joins the writer thread */
+    void stop();
+
+protected:
+    void run() override;
+
+private:
+    bool drainBatch();
+
+    Sink _sink;
+    LogRecordQueue _queue;
+    QMutex _consumerMutex;
+
+    QMutex _wakeMutex;
+    QWaitCondition _wakeCondition;
+    std::atomic<int> _pending{ 0 };
+    std::atomic<bool> _idle{ false };
+    std::atomic<bool> _stopRequested{ false };
+};
+
+} // namespace OCC
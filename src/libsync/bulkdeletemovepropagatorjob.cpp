@@ -0,0 +1,182 @@
+/*
+ * Copyright (C) by Nextcloud GmbH
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ */
+
+#include "bulkdeletemovepropagatorjob.h"
+
+#include "account.h"
+#include "propagateremotedelete.h"
+#include "propagateremotemove.h"
+#include "common/asserts.h"
+
+#include <algorithm>
+
+namespace OCC {
+
+Q_LOGGING_CATEGORY(lcBulkDeleteMovePropagatorJob, "nextcloud.sync.propagator.bulkdeletemove", QtInfoMsg)
+
+namespace {
+
+    // Servers usually allow 100 concurrent streams per HTTP/2 connection,
+    // leave room for the other requests of the client
+    constexpr int http2MaximumRunningJobs = 50;
+}
+
+BulkDeleteMovePropagatorJob::BulkDeleteMovePropagatorJob(OwncloudPropagator *propagator,
+                                                         const std::deque<SyncFileItemPtr> &items)
+    : PropagatorJob(propagator)
+{
+    for (const auto &item : items) {
+        if (item->_instruction == CSYNC_INSTRUCTION_REMOVE) {
+            _deletes.push_back(item);
+        } else {
+            _moves.push_back(item);
+        }
+    }
+    qCInfo(lcBulkDeleteMovePropagatorJob) << "Batching" << _deletes.size() << "deletes and" << _moves.size() << "moves";
+}
+
+bool BulkDeleteMovePropagatorJob::scheduleSelfOrChild()
+{
+    if (_state == Finished) {
+        return false;
+    }
+    _state = Running;
+
+    if (startJobs()) {
+        return true;
+    }
+    if (_runningJobs.isEmpty() && _deletes.empty() && _moves.empty()) {
+        // Our parent is iterating over its running jobs, don't finish from within
+        QMetaObject::invokeMethod(this, "finalize", Qt::QueuedConnection);
+    }
+    return false;
+}
+
+PropagatorJob::JobParallelism BulkDeleteMovePropagatorJob::parallelism()
+{
+    // The bulk upload may recreate files at the names that are freed here
+    return WaitForFinished;
+}
+
+void BulkDeleteMovePropagatorJob::abort(PropagatorJob::AbortType abortType)
+{
+    _deletes.clear();
+    _moves.clear();
+
+    // Aborting a DELETE or MOVE only aborts its reply
+    for (auto job : qAsConst(_runningJobs)) {
+        job->abort(AbortType::Synchronous);
+    }
+    if (abortType == AbortType::Asynchronous) {
+        emit abortFinished();
+    }
+}
+
+int BulkDeleteMovePropagatorJob::maximumRunningJobs() const
+{
+    const auto limit = propagator()->hardMaximumActiveJob();
+    if (limit <= 1) {
+        return 1;
+    }
+    // Over HTTP/1 the access manager opens a handful of connections per host
+    // and queues the other requests, where they might time out
+    return propagator()->account()->isHttp2Supported() ? std::max(limit, http2MaximumRunningJobs) : limit;
+}
+
+bool BulkDeleteMovePropagatorJob::startJobs()
+{
+    if (propagator()->_abortRequested) {
+        return false;
+    }
+
+    bool started = false;
+    while (_runningJobs.size() < maximumRunningJobs()) {
+        // Jobs in encrypted folders must not overlap with any other
+        const auto exclusiveJobRunning = std::any_of(_runningJobs.cbegin(), _runningJobs.cend(), [](PropagateItemJob *job) {
+            return job->parallelism() == WaitForFinished;
+        });
+        if (exclusiveJobRunning) {
+            break;
+        }
+
+        PropagateItemJob *job = nullptr;
+        if (!_deletes.empty()) {
+            job = new PropagateRemoteDelete(propagator(), _deletes.front());
+            _deletes.pop_front();
+            ++_runningDeletes;
+        } else if (!_moves.empty() && _runningDeletes == 0) {
+            job = new PropagateRemoteMove(propagator(), _moves.front());
+            _moves.pop_front();
+        } else {
+            break;
+        }
+
+        if (job->parallelism() == WaitForFinished && !_runningJobs.isEmpty()) {
+            // Put it back and wait for the others
+            if (qobject_cast<PropagateRemoteDelete *>(job)) {
+                _deletes.push_front(job->_item);
+                --_runningDeletes;
+            } else {
+                _moves.push_front(job->_item);
+            }
+            delete job;
+            break;
+        }
+
+        connect(job, &PropagatorJob::finished, this, &BulkDeleteMovePropagatorJob::slotItemJobFinished);
+        _runningJobs.append(job);
+        job->scheduleSelfOrChild();
+        started = true;
+    }
+    return started;
+}
+
+void BulkDeleteMovePropagatorJob::slotItemJobFinished(SyncFileItem::Status status)
+{
+    auto job = qobject_cast<PropagateItemJob *>(sender());
+    ASSERT(job);
+
+    job->deleteLater();
+    _runningJobs.removeOne(job);
+    if (qobject_cast<PropagateRemoteDelete *>(job)) {
+        --_runningDeletes;
+    }
+
+    if (status == SyncFileItem::FatalError
+        || status == SyncFileItem::NormalError
+        || status == SyncFileItem::SoftError
+        || status == SyncFileItem::DetailError
+        || status == SyncFileItem::BlacklistedError) {
+        _hasError = status;
+    }
+
+    // The propagator doesn't schedule while the window keeps the active job list full
+    startJobs();
+
+    if (_runningJobs.isEmpty() && ((_deletes.empty() && _moves.empty()) || propagator()->_abortRequested)) {
+        finalize();
+    }
+}
+
+void BulkDeleteMovePropagatorJob::finalize()
+{
+    if (_state == Finished) {
+        return;
+    }
+
+    _state = Finished;
+    emit finished(_hasError == SyncFileItem::NoStatus ? SyncFileItem::Success : _hasError);
+}
+
+}
@@ -0,0 +1,78 @@
+/*
+ * Copyright (C) by Nextcloud GmbH
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ */
+
+#pragma once
+
+#include "owncloudpropagator.h"
+
+#include <QLoggingCategory>
+#include <QVector>
+
+#include <deque>
+
+namespace OCC {
+
+Q_DECLARE_LOGGING_CATEGORY(lcBulkDeleteMovePropagatorJob)
+
+/**
+ * @brief Propagates the remote deletes and moves of files of the whole sync at once
+ * @ingroup libsync
+ *
+ * Within the job tree these items wait for the directory job of their
+ * folder and then count against the limit of active jobs like transfers do.
+ * When many files in many folders are deleted or moved, that makes them
+ * trickle out one directory at a time.
+ *
+ * This job runs after all the other jobs of the tree, before the bulk upload
+ * and the directory deletions. It keeps a window of DELETE and MOVE requests
+ * in flight, which share one connection when the server speaks HTTP/2. Each
+ * request is a regular PropagateRemoteDelete or PropagateRemoteMove, so every
+ * item is checked and recorded on its own. All deletes finish before the first
+ * move starts, since a moved file may take the name of a deleted one.
+ */
+class BulkDeleteMovePropagatorJob : public PropagatorJob
+{
+    Q_OBJECT
+
+public:
+    explicit BulkDeleteMovePropagatorJob(OwncloudPropagator *propagator,
+                                         const std::deque<SyncFileItemPtr> &items);
+
+    bool scheduleSelfOrChild() override;
+
+    JobParallelism parallelism() override;
+
+    void abort(PropagatorJob::AbortType abortType) override;
+
+private slots:
+    void slotItemJobFinished(SyncFileItem::Status status);
+
+    void finalize();
+
+private:
+    /** Starts jobs until the window is full, returns whether one was started */
+    bool startJobs();
+
+    int maximumRunningJobs() const;
+
+    std::deque<SyncFileItemPtr> _deletes;
+    std::deque<SyncFileItemPtr> _moves;
+
+    QVector<PropagateItemJob *> _runningJobs;
+    int _runningDeletes = 0;
+
+    SyncFileItem::Status _hasError = SyncFileItem::NoStatus;
+};
+
+}
@@ -0,0 +1,476 @@
+/*
+ * Copyright (C) by Nextcloud GmbH
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ */
+
+#include "bulkdownloadpropagatorjob.h"
+
+#include "networkjobs.h"
+#include "filesystem.h"
+#include "account.h"
+#include "common/utility.h"
+#include "common/checksums.h"
+#include "common/syncjournaldb.h"
+
+#include <QBuffer>
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QNetworkReply>
+#include <QUrlQuery>
+
+#include <algorithm>
+
+namespace OCC {
+
+Q_LOGGING_CATEGORY(lcBulkDownloadPropagatorJob, "nextcloud.sync.propagator.bulkdownload", QtInfoMsg)
+
+QString createDownloadTmpFileName(const QString &previous);
+
+}
+
+namespace {
+
+constexpr auto tarBlockSize = 512;
+
+// The file names end up in the query string, keep the url reasonably short.
+constexpr auto requestMaximumFiles = 100;
+constexpr auto requestMaximumNamesLength = 4000;
+
+// Long names and pax headers larger than that are not file names we asked for.
+constexpr qint64 metadataEntryMaximumSize = 64 * 1024;
+
+QString fileNameOf(const QString &path)
+{
+    return path.mid(path.lastIndexOf(QLatin1Char('/')) + 1);
+}
+
+QByteArray tarString(const char *field, int length)
+{
+    return QByteArray(field, static_cast<int>(qstrnlen(field, static_cast<uint>(length))));
+}
+
+qint64 tarNumber(const char *field, int length)
+{
+    if (static_cast<unsigned char>(field[0]) & 0x80) {
+        // base-256, used by GNU tar for values that do not fit in octal
+        quint64 value = static_cast<unsigned char>(field[0]) & 0x7f;
+        for (int i = 1; i < length; ++i) {
+            value = (value << 8) | static_cast<unsigned char>(field[i]);
+        }
+        return static_cast<qint64>(value);
+    }
+
+    qint64 value = 0;
+    for (int i = 0; i < length; ++i) {
+        const auto c = field[i];
+        if (c == ' ' && value == 0) {
+            continue;
+        }
+        if (c < '0' || c > '7') {
+            break;
+        }
+        value = value * 8 + (c - '0');
+    }
+    return value;
+}
+
+bool tarHeaderChecksumMatches(const char *header)
+{
+    // the checksum is computed with its own field filled with spaces
+    qint64 sum = 0;
+    for (int i = 0; i < tarBlockSize; ++i) {
+        sum += (i >= 148 && i < 156) ? ' ' : static_cast<unsigned char>(header[i]);
+    }
+    return sum == tarNumber(header + 148, 8);
+}
+
+}
+
+namespace OCC {
+
+BulkDownloadPropagatorJob::BulkDownloadPropagatorJob(OwncloudPropagator *propagator,
+                                                     const QString &directory,
+                                                     const SyncFileItemVector &items)
+    : PropagatorJob(propagator)
+    , _directory(directory)
+    , _items(items)
+    , _downloads(propagator)
+{
+    _downloads._tasksToDo = items;
+    connect(&_downloads, &PropagatorJob::finished, this, &BulkDownloadPropagatorJob::slotDownloadsFinished);
+}
+
+bool BulkDownloadPropagatorJob::scheduleSelfOrChild()
+{
+    if (_state == Finished) {
+        return false;
+    }
+
+    if (_state == NotYetStarted) {
+        _state = Running;
+        QMetaObject::invokeMethod(this, &BulkDownloadPropagatorJob::startNextRequest, Qt::QueuedConnection);
+        return true;
+    }
+
+    // the download jobs must find the extracted files
+    if (!_archiveFinished) {
+        return false;
+    }
+    return _downloads.scheduleSelfOrChild();
+}
+
+PropagatorJob::JobParallelism BulkDownloadPropagatorJob::parallelism()
+{
+    // only the downloads of this directory wait for the archive, they are held back in here
+    return _archiveFinished ? _downloads.parallelism() : FullParallelism;
+}
+
+void BulkDownloadPropagatorJob::abort(PropagatorJob::AbortType abortType)
+{
+    if (_job && _job->reply()) {
+        _job->reply()->abort();
+    }
+    if (abortType == AbortType::Asynchronous) {
+        connect(&_downloads, &PropagatorCompositeJob::abortFinished, this, &BulkDownloadPropagatorJob::abortFinished);
+    }
+    _downloads.abort(abortType);
+}
+
+void BulkDownloadPropagatorJob::startNextRequest()
+{
+    if (_nextItem >= _items.size()
+        || propagator()->_abortRequested
+        || !propagator()->bulkDownloadAvailable()
+        || propagator()->diskSpaceCheck() != OwncloudPropagator::DiskSpaceOk) {
+        finalizeArchive();
+        return;
+    }
+
+    QJsonArray fileNames;
+    int namesLength = 0;
+    while (_nextItem < _items.size()
+           && fileNames.size() < requestMaximumFiles
+           && namesLength < requestMaximumNamesLength) {
+        const auto &item = _items.at(_nextItem++);
+        const auto fileName = fileNameOf(item->_file);
+        fileNames.append(fileName);
+        namesLength += fileName.size();
+        _requestedItems.insert(fileName, item);
+    }
+
+    // The names are percent encoded here: QUrlQuery would leave '+' alone
+    QUrlQuery query;
+    query.addQueryItem(QStringLiteral("files"),
+        QString::fromLatin1(QUrl::toPercentEncoding(QString::fromUtf8(QJsonDocument(fileNames).toJson(QJsonDocument::Compact)))));
+    const auto url = Utility::concatUrlPath(propagator()->account()->davUrl(), propagator()->fullRemotePath(_directory), query);
+
+    QNetworkRequest request;
+    request.setRawHeader("Accept", "application/x-tar");
+    request.setPriority(QNetworkRequest::LowPriority);
+
+    qCInfo(lcBulkDownloadPropagatorJob) << "Requesting" << fileNames.size() << "files of" << _directory << "as an archive";
+
+    _job = new SimpleNetworkJob(propagator()->account(), this);
+    connect(_job.data(), &SimpleNetworkJob::finishedSignal, this, &BulkDownloadPropagatorJob::slotRequestFinished);
+    const auto reply = _job->startRequest("GET", url, request);
+    connect(reply, &QNetworkReply::readyRead, this, &BulkDownloadPropagatorJob::slotReadyRead);
+}
+
+bool BulkDownloadPropagatorJob::checkArchiveReply()
+{
+    _archiveChecked = true;
+
+    const auto reply = _job->reply();
+    const auto httpStatus = reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+    const auto contentType = reply->header(QNetworkRequest::ContentTypeHeader).toByteArray();
+    _archiveValid = httpStatus == 200 && contentType.startsWith("application/x-tar");
+
+    if (!_archiveValid && httpStatus != 0) {
+        // The server answered, but not with an archive: don't ask again during this sync
+        qCInfo(lcBulkDownloadPropagatorJob) << "Server does not support archive downloads" << httpStatus << contentType;
+        propagator()->_bulkDownloadUnsupported = true;
+    }
+    return _archiveValid;
+}
+
+void BulkDownloadPropagatorJob::slotReadyRead()
+{
+    if (!_job || !_job->reply()) {
+        return;
+    }
+    if (!_archiveChecked) {
+        checkArchiveReply();
+    }
+    if (!_archiveValid || _archiveEnded) {
+        _job->reply()->readAll();
+        return;
+    }
+
+    _buffer.append(_job->reply()->readAll());
+    readArchive();
+}
+
+void BulkDownloadPropagatorJob::slotRequestFinished()
+{
+    const auto reply = _job->reply();
+    if (!_archiveChecked) {
+        checkArchiveReply();
+    }
+    if (_archiveValid && !_archiveEnded) {
+        _buffer.append(reply->readAll());
+        readArchive();
+    }
+    if (reply->error() != QNetworkReply::NoError) {
+        qCWarning(lcBulkDownloadPropagatorJob) << "Archive download of" << _directory << "failed" << reply->errorString();
+    }
+    qCInfo(lcBulkDownloadPropagatorJob) << _requestedItems.size() << "requested files were not extracted from the archive of" << _directory;
+
+    // One commit for all the download infos of this archive
+    propagator()->_journal->commit("bulk download");
+
+    _job.clear();
+    _requestedItems.clear();
+    _buffer.clear();
+    _bufferPosition = 0;
+    _archiveChecked = false;
+    _archiveValid = false;
+    _archiveEnded = false;
+    _entryKind = EntryKind::None;
+    _entryItem.reset();
+    _entryContent.clear();
+    _entryRemaining = 0;
+    _skipRemaining = 0;
+    _nextEntryName.clear();
+
+    startNextRequest();
+}
+
+void BulkDownloadPropagatorJob::readArchive()
+{
+    while (!_archiveEnded) {
+        const auto available = _buffer.size() - _bufferPosition;
+
+        if (_entryRemaining > 0) {
+            if (available == 0) {
+                break;
+            }
+            const auto length = static_cast<int>(qMin<qint64>(available, _entryRemaining));
+            if (_entryKind != EntryKind::None) {
+                _entryContent.append(_buffer.constData() + _bufferPosition, length);
+            }
+            _bufferPosition += length;
+            _entryRemaining -= length;
+            if (_entryRemaining == 0) {
+                entryFinished();
+            }
+            continue;
+        }
+
+        if (_skipRemaining > 0) {
+            if (available == 0) {
+                break;
+            }
+            const auto length = static_cast<int>(qMin<qint64>(available, _skipRemaining));
+            _bufferPosition += length;
+            _skipRemaining -= length;
+            continue;
+        }
+
+        if (available < tarBlockSize) {
+            break;
+        }
+        const auto header = _buffer.constData() + _bufferPosition;
+        _bufferPosition += tarBlockSize;
+        if (!parseHeader(header)) {
+            _archiveEnded = true;
+        } else if (_entryRemaining == 0) {
+            entryFinished();
+        }
+    }
+
+    _buffer.remove(0, _bufferPosition);
+    _bufferPosition = 0;
+}
+
+bool BulkDownloadPropagatorJob::parseHeader(const char *header)
+{
+    if (std::all_of(header, header + tarBlockSize, [](char c) { return c == 0; })) {
+        // end of archive marker
+        return false;
+    }
+    if (!tarHeaderChecksumMatches(header)) {
+        qCWarning(lcBulkDownloadPropagatorJob) << "Invalid tar header in the archive of" << _directory;
+        return false;
+    }
+
+    const auto size = tarNumber(header + 124, 12);
+    if (size < 0) {
+        return false;
+    }
+    _entryKind = EntryKind::None;
+    _entryItem.reset();
+    _entryContent.clear();
+    _entryRemaining = size;
+    _skipRemaining = (tarBlockSize - size % tarBlockSize) % tarBlockSize;
+
+    const auto typeFlag = header[156];
+    switch (typeFlag) {
+    case 'L': // GNU long name of the next entry
+        if (size <= metadataEntryMaximumSize) {
+            _entryKind = EntryKind::LongName;
+        }
+        break;
+    case 'x': // pax extended header of the next entry
+        if (size <= metadataEntryMaximumSize) {
+            _entryKind = EntryKind::PaxHeader;
+        }
+        break;
+    case '0':
+    case '\0':
+    case '7': {
+        auto name = _nextEntryName;
+        _nextEntryName.clear();
+        if (name.isEmpty()) {
+            name = tarString(header, 100);
+            if (qstrncmp(header + 257, "ustar", 5) == 0) {
+                const auto prefix = tarString(header + 345, 155);
+                if (!prefix.isEmpty()) {
+                    name = prefix + '/' + name;
+                }
+            }
+        }
+
+        // The archive may put the files below a folder named like the directory
+        const auto item = _requestedItems.value(fileNameOf(QString::fromUtf8(name)));
+        if (item && item->_size == size) {
+            _entryKind = EntryKind::File;
+            _entryItem = item;
+            _entryMtime = tarNumber(header + 136, 12);
+            _entryContent.reserve(static_cast<int>(size));
+        } else {
+            qCDebug(lcBulkDownloadPropagatorJob) << "Skipping archive entry" << name << size;
+        }
+        break;
+    }
+    default:
+        _nextEntryName.clear();
+        break;
+    }
+    return true;
+}
+
+void BulkDownloadPropagatorJob::entryFinished()
+{
+    switch (_entryKind) {
+    case EntryKind::LongName:
+        _nextEntryName = _entryContent.left(_entryContent.indexOf('\0'));
+        break;
+    case EntryKind::PaxHeader: {
+        // records look like "<length> <key>=<value>\n"
+        int position = 0;
+        while (position < _entryContent.size()) {
+            const auto space = _entryContent.indexOf(' ', position);
+            if (space < 0) {
+                break;
+            }
+            const auto length = _entryContent.mid(position, space - position).toInt();
+            if (length <= space - position + 1 || position + length > _entryContent.size()) {
+                break;
+            }
+            const auto record = _entryContent.mid(space + 1, position + length - space - 2);
+            if (record.startsWith("path=")) {
+                _nextEntryName = record.mid(5);
+            }
+            position += length;
+        }
+        break;
+    }
+    case EntryKind::File:
+        _requestedItems.remove(fileNameOf(_entryItem->_file));
+        extractFile(_entryItem, _entryContent, _entryMtime);
+        break;
+    case EntryKind::None:
+        break;
+    }
+
+    _entryKind = EntryKind::None;
+    _entryItem.reset();
+    _entryContent.clear();
+}
+
+void BulkDownloadPropagatorJob::extractFile(const SyncFileItemPtr &item, const QByteArray &content, qint64 mtime)
+{
+    if (mtime != item->_modtime) {
+        qCInfo(lcBulkDownloadPropagatorJob) << item->_file << "changed on the server since discovery" << mtime << item->_modtime;
+        return;
+    }
+
+    if (!item->_checksumHeader.isEmpty()) {
+        QByteArray checksumType;
+        QByteArray checksum;
+        if (parseChecksumHeader(item->_checksumHeader, &checksumType, &checksum)) {
+            QBuffer buffer;
+            buffer.setData(content);
+            buffer.open(QIODevice::ReadOnly);
+            const auto computedChecksum = ComputeChecksum::computeNow(&buffer, checksumType);
+            if (!computedChecksum.isEmpty() && computedChecksum.toLower() != checksum.toLower()) {
+                qCWarning(lcBulkDownloadPropagatorJob) << "Checksum mismatch for" << item->_file << "in the archive";
+                return;
+            }
+        }
+    }
+
+    auto downloadInfo = propagator()->_journal->getDownloadInfo(item->_file);
+    if (downloadInfo._valid && downloadInfo._etag != item->_etag) {
+        FileSystem::remove(propagator()->fullLocalPath(downloadInfo._tmpfile));
+        downloadInfo._valid = false;
+    }
+    const auto tmpFileName = downloadInfo._valid ? downloadInfo._tmpfile : createDownloadTmpFileName(item->_file);
+
+    QFile tmpFile(propagator()->fullLocalPath(tmpFileName));
+    if (tmpFile.exists()) {
+        FileSystem::setFileReadOnly(tmpFile.fileName(), false);
+    }
+    if (!tmpFile.open(QIODevice::WriteOnly | QIODevice::Truncate) || tmpFile.write(content) != content.size()) {
+        qCWarning(lcBulkDownloadPropagatorJob) << "Could not write" << tmpFile.fileName() << tmpFile.errorString();
+        tmpFile.close();
+        tmpFile.remove();
+        propagator()->_journal->setDownloadInfo(item->_file, SyncJournalDb::DownloadInfo());
+        return;
+    }
+    tmpFile.close();
+    FileSystem::setFileHidden(tmpFile.fileName(), true);
+
+    SyncJournalDb::DownloadInfo pi;
+    pi._etag = item->_etag;
+    pi._tmpfile = tmpFileName;
+    pi._valid = true;
+    propagator()->_journal->setDownloadInfo(item->_file, pi);
+
+    ++_extractedCount;
+}
+
+void BulkDownloadPropagatorJob::finalizeArchive()
+{
+    qCInfo(lcBulkDownloadPropagatorJob) << "Extracted" << _extractedCount << "of" << _items.size() << "files of" << _directory;
+    _archiveFinished = true;
+    propagator()->scheduleNextJob();
+}
+
+void BulkDownloadPropagatorJob::slotDownloadsFinished(SyncFileItem::Status status)
+{
+    _state = Finished;
+    emit finished(status);
+}
+
+}
@@ -0,0 +1,126 @@
+/*
+ * Copyright (C) by Nextcloud GmbH
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ */
+
+#pragma once
+
+#include "owncloudpropagator.h"
+
+#include <QLoggingCategory>
+#include <QHash>
+#include <QPointer>
+#include <QByteArray>
+
+namespace OCC {
+
+Q_DECLARE_LOGGING_CATEGORY(lcBulkDownloadPropagatorJob)
+
+class SimpleNetworkJob;
+
+/**
+ * @brief Fetches many small files of one directory as a single tar archive
+ * @ingroup libsync
+ *
+ * The server streams the requested files of a folder as a tar archive when
+ * asked with "Accept: application/x-tar". Each entry is checked against the
+ * size, modification time and checksum found during discovery and written
+ * to the temporary file a PropagateDownloadFile would download into, with
+ * the matching download info in the journal.
+ *
+ * The regular download jobs for these items are held back in this job until
+ * the archive is done, other jobs of the sync keep running meanwhile. They
+ * find the complete temporary file and only do the rename and the journal
+ * update. Files that are missing from the archive or that do not match are
+ * simply downloaded by these jobs as usual, so the archive never fails an
+ * item.
+ */
+class BulkDownloadPropagatorJob : public PropagatorJob
+{
+    Q_OBJECT
+
+public:
+    explicit BulkDownloadPropagatorJob(OwncloudPropagator *propagator,
+                                       const QString &directory,
+                                       const SyncFileItemVector &items);
+
+    bool scheduleSelfOrChild() override;
+
+    JobParallelism parallelism() override;
+
+    void abort(PropagatorJob::AbortType abortType) override;
+
+    qint64 committedDiskSpace() const override
+    {
+        return _downloads.committedDiskSpace();
+    }
+
+private slots:
+    void startNextRequest();
+
+    void slotReadyRead();
+
+    void slotRequestFinished();
+
+    void slotDownloadsFinished(SyncFileItem::Status status);
+
+private:
+    enum class EntryKind {
+        None,
+        File,
+        LongName,
+        PaxHeader,
+    };
+
+    bool checkArchiveReply();
+
+    void readArchive();
+
+    bool parseHeader(const char *header);
+
+    void entryFinished();
+
+    void extractFile(const SyncFileItemPtr &item, const QByteArray &content, qint64 mtime);
+
+    void finalizeArchive();
+
+    QString _directory;
+
+    SyncFileItemVector _items;
+    int _nextItem = 0; /// index of the first item that was not requested yet
+
+    bool _archiveFinished = false;
+    PropagatorCompositeJob _downloads; /// the download jobs of the items, started once the archive is done
+
+    QHash<QString, SyncFileItemPtr> _requestedItems; /// by file name, for the running request
+
+    QPointer<SimpleNetworkJob> _job;
+
+    bool _archiveChecked = false;
+    bool _archiveValid = false;
+    bool _archiveEnded = false;
+
+    QByteArray _buffer;
+    int _bufferPosition = 0;
+
+    EntryKind _entryKind = EntryKind::None;
+    SyncFileItemPtr _entryItem;
+    QByteArray _entryContent;
+    qint64 _entryMtime = 0;
+    qint64 _entryRemaining = 0;
+    qint64 _skipRemaining = 0;
+    QByteArray _nextEntryName; /// from a preceding GNU long name or pax header
+
+    int _extractedCount = 0;
+};
+
+}
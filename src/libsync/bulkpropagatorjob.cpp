@@ -28,6 +28,10 @@
 
 #include <QFileInfo>
 #include <QDir>
+#include <QBuffer>
+#include <QFile>
+#include <QFutureWatcher>
+#include <QtConcurrent>
 #include <QJsonDocument>
 #include <QJsonArray>
 #include <QJsonObject>
@@ -66,7 +70,54 @@ QByteArray getHeaderFromJsonReply(const QJsonObject &reply, const QByteArray &he
 
 constexpr auto batchSize = 100;
 
-constexpr auto parallelJobsMaximumCount = 1;
+// A batch is also closed once it holds this many bytes, so that a single
+// request of a hundred medium sized files does not hold up the others.
+constexpr qint64 batchMaximumBytes = 20 * 1000 * 1000;
+
+// Files up to this size are read into memory while their checksum is computed.
+constexpr qint64 readAheadMaximumSize = 1024 * 1024;
+
+struct ReadAheadResult
+{
+    QByteArray _content;
+    QByteArray _checksum;
+};
+
+/**
+ * Reads a small file and computes its transmission checksum from the
+ * same bytes. Runs on a worker thread.
+ *
+ * Returns a null _content if the file could not be read, the checksum
+ * and the upload then fall back to opening the file again.
+ */
+ReadAheadResult readAheadFile(const QString &filePath, const QByteArray &checksumType)
+{
+    ReadAheadResult result;
+
+    QFile file(filePath);
+    QString openError;
+    if (!OCC::FileSystem::openAndSeekFileSharedRead(&file, &openError, 0)) {
+        qCWarning(OCC::lcBulkPropagatorJob) << "Could not read ahead" << filePath << openError;
+        return result;
+    }
+    result._content = file.read(readAheadMaximumSize + 1);
+    if (file.error() != QFileDevice::NoError) {
+        qCWarning(OCC::lcBulkPropagatorJob) << "Could not read ahead" << filePath << file.errorString();
+        result._content = QByteArray();
+        return result;
+    }
+    if (result._content.isNull()) {
+        // an empty file, but the content must still count as read
+        result._content = QByteArray("");
+    }
+
+    if (!checksumType.isEmpty()) {
+        QBuffer buffer(&result._content);
+        buffer.open(QIODevice::ReadOnly);
+        result._checksum = OCC::ComputeChecksum::computeNow(&buffer, checksumType);
+    }
+    return result;
+}
 }
 
 namespace OCC {
@@ -88,11 +139,19 @@ bool BulkPropagatorJob::scheduleSelfOrChild()
     if (!_pendingChecksumFiles.empty()) {
         return false;
     }
+    if (_jobs.size() >= propagator()->maximumActiveTransferJob()) {
+        return false;
+    }
 
     _state = Running;
+    qint64 batchBytes = 0;
     for(int i = 0; i < batchSize && !_items.empty(); ++i) {
+        if (i > 0 && batchBytes + _items.front()->_size > batchMaximumBytes) {
+            break;
+        }
         auto currentItem = _items.front();
         _items.pop_front();
+        batchBytes += currentItem->_size;
         _pendingChecksumFiles.insert(currentItem->_file);
         QMetaObject::invokeMethod(this, [this, currentItem] () {
             UploadFileInfo fileToUpload;
@@ -146,7 +205,6 @@ void BulkPropagatorJob::doStartUpload(SyncFileItemPtr item,
     pi._contentChecksum = item->_checksumHeader;
     pi._size = item->_size;
     propagator()->_journal->setUploadInfo(item->_file, pi);
-    propagator()->_journal->commit("Upload info");
 
     auto currentHeaders = headers(item);
     currentHeaders[QByteArrayLiteral("Content-Length")] = QByteArray::number(fileToUpload._size);
@@ -157,7 +215,9 @@ void BulkPropagatorJob::doStartUpload(SyncFileItemPtr item,
         const auto newFilePathAbsolute = propagator()->fullLocalPath(item->_renameTarget);
         const auto renameSuccess = QFile::rename(originalFilePathAbsolute, newFilePathAbsolute);
         if (!renameSuccess) {
+            _pendingChecksumFiles.remove(item->_file);
             done(item, SyncFileItem::NormalError, "File contains trailing spaces and couldn't be renamed");
+            checkPropagationIsDone();
             return;
         }
         qCWarning(lcBulkPropagatorJob()) << item->_file << item->_renameTarget;
@@ -195,10 +255,19 @@ void BulkPropagatorJob::triggerUpload()
     uploadParametersData.reserve(_filesToUpload.size());
 
     int timeout = 0;
-    for(auto &singleFile : _filesToUpload) {
+    for (auto it = _filesToUpload.begin(); it != _filesToUpload.end();) {
+        auto &singleFile = *it;
         // job takes ownership of device via a QScopedPointer. Job deletes itself when finishing
-        auto device = std::make_unique<UploadDevice>(
-                singleFile._localPath, 0, singleFile._fileSize, &propagator()->_bandwidthManager);
+        std::unique_ptr<UploadDevice> device;
+        if (singleFile._fileToUpload._content.isNull()) {
+            device = std::make_unique<UploadDevice>(
+                    singleFile._localPath, 0, singleFile._fileSize, &propagator()->_bandwidthManager);
+        } else {
+            auto buffer = std::make_unique<QBuffer>();
+            buffer->setData(singleFile._fileToUpload._content);
+            device = std::make_unique<UploadDevice>(
+                    std::move(buffer), 0, singleFile._fileSize, &propagator()->_bandwidthManager);
+        }
         if (!device->open(QIODevice::ReadOnly)) {
             qCWarning(lcBulkPropagatorJob) << "Could not prepare upload device: " << device->errorString();
 
@@ -208,14 +277,20 @@ void BulkPropagatorJob::triggerUpload()
                 emit propagator()->seenLockedFile(singleFile._localPath);
             }
 
-            abortWithError(singleFile._item, SyncFileItem::NormalError, device->errorString());
-            emit finished(SyncFileItem::NormalError);
-
-            return;
+            // Other requests may still be in flight: only leave this file out
+            done(singleFile._item, SyncFileItem::NormalError, device->errorString());
+            it = _filesToUpload.erase(it);
+            continue;
         }
         singleFile._headers["X-File-Path"] = singleFile._remotePath.toUtf8();
         uploadParametersData.push_back({std::move(device), singleFile._headers});
         timeout += singleFile._fileSize;
+        ++it;
+    }
+
+    if (_filesToUpload.empty()) {
+        checkPropagationIsDone();
+        return;
     }
 
     const auto bulkUploadUrl = Utility::concatUrlPath(propagator()->account()->url(), QStringLiteral("/remote.php/dav/bulk"));
@@ -229,16 +304,31 @@ void BulkPropagatorJob::triggerUpload()
         });
     }
 
+    // one commit for the upload info of the whole batch
+    propagator()->_journal->commit("Upload info");
+
     adjustLastJobTimeout(job.get(), timeout);
     _jobs.append(job.get());
+    _filesInTransit.emplace(job.get(), std::move(_filesToUpload));
+    _filesToUpload = {};
+    _filesToUpload.reserve(batchSize);
     job.release()->start();
-    if (parallelism() == PropagatorJob::JobParallelism::FullParallelism && _jobs.size() < parallelJobsMaximumCount) {
+    if (parallelism() == PropagatorJob::JobParallelism::FullParallelism) {
         scheduleSelfOrChild();
     }
 }
 
 void BulkPropagatorJob::checkPropagationIsDone()
 {
+    if (_state == Finished) {
+        return;
+    }
+
+    if (_pendingChecksumFiles.empty() && !_filesToUpload.empty()) {
+        // the last file of the batch being prepared failed, send the others
+        triggerUpload();
+    }
+
     if (_items.empty()) {
         if (!_jobs.empty() || !_pendingChecksumFiles.empty()) {
             // just wait for the other job to finish.
@@ -246,6 +336,7 @@ void BulkPropagatorJob::checkPropagationIsDone()
         }
 
         qCInfo(lcBulkPropagatorJob) << "final status" << _finalStatus;
+        _state = Finished;
         emit finished(_finalStatus);
         propagator()->scheduleNextJob();
     } else {
@@ -260,13 +351,38 @@ void BulkPropagatorJob::slotComputeTransmissionChecksum(SyncFileItemPtr item,
     const auto supportedTransmissionChecksums =
         propagator()->account()->capabilities().supportedChecksumTypes();
 
+    const auto checksumType = uploadChecksumEnabled() ? QByteArray("MD5" /*propagator()->account()->capabilities().uploadChecksumType()*/)
+                                                      : QByteArray();
+
+    if (fileToUpload._size <= readAheadMaximumSize) {
+        // Small files are read once: the bytes that are hashed are the ones sent.
+        auto watcher = new QFutureWatcher<ReadAheadResult>(this);
+        connect(watcher, &QFutureWatcherBase::finished,
+                this, [this, watcher, item, fileToUpload, checksumType] () mutable {
+            const auto result = watcher->result();
+            watcher->deleteLater();
+            if (result._content.isNull()) {
+                // Without the content there is no checksum either
+                computeChecksumOfFile(item, fileToUpload, checksumType);
+                return;
+            }
+            fileToUpload._content = result._content;
+            slotStartUpload(item, fileToUpload, checksumType, result._checksum);
+        });
+        watcher->setFuture(QtConcurrent::run(readAheadFile, fileToUpload._path, checksumType));
+        return;
+    }
+
+    computeChecksumOfFile(item, fileToUpload, checksumType);
+}
+
+void BulkPropagatorJob::computeChecksumOfFile(SyncFileItemPtr item,
+                                              UploadFileInfo fileToUpload,
+                                              const QByteArray &checksumType)
+{
     // Compute the transmission checksum.
     auto computeChecksum = std::make_unique<ComputeChecksum>(this);
-    if (uploadChecksumEnabled()) {
-        computeChecksum->setChecksumType("MD5" /*propagator()->account()->capabilities().uploadChecksumType()*/);
-    } else {
-        computeChecksum->setChecksumType(QByteArray());
-    }
+    computeChecksum->setChecksumType(checksumType);
 
     connect(computeChecksum.get(), &ComputeChecksum::done,
             this, [this, item, fileToUpload] (const QByteArray &contentChecksumType, const QByteArray &contentChecksum) {
@@ -318,6 +434,14 @@ void BulkPropagatorJob::slotStartUpload(SyncFileItemPtr item,
     fileToUpload._size = FileSystem::getSize(fullFilePath);
     item->_size = FileSystem::getSize(originalFilePath);
 
+    if (!fileToUpload._content.isNull() && fileToUpload._content.size() != fileToUpload._size) {
+        propagator()->_anotherSyncNeeded = true;
+        _pendingChecksumFiles.remove(item->_file);
+        slotOnErrorStartFolderUnlock(item, SyncFileItem::SoftError, tr("Local file changed during sync."));
+        checkPropagationIsDone();
+        return;
+    }
+
     // But skip the file if the mtime is too close to 'now'!
     // That usually indicates a file that is still being changed
     // or not yet fully copied to the destination.
@@ -407,13 +531,18 @@ void BulkPropagatorJob::slotPutFinished()
 
     slotJobDestroyed(job); // remove it from the _jobs list
 
+    const auto filesIt = _filesInTransit.find(job);
+    Q_ASSERT(filesIt != _filesInTransit.end());
+    const auto files = std::move(filesIt->second);
+    _filesInTransit.erase(filesIt);
+
     const auto jobError = job->reply()->error();
 
     const auto replyData = job->reply()->readAll();
     const auto replyJson = QJsonDocument::fromJson(replyData);
     const auto fullReplyObject = replyJson.object();
 
-    for (const auto &singleFile : _filesToUpload) {
+    for (const auto &singleFile : files) {
         if (!fullReplyObject.contains(singleFile._remotePath)) {
             if (jobError != QNetworkReply::NoError) {
                 singleFile._item->_status = SyncFileItem::NormalError;
@@ -425,7 +554,7 @@ void BulkPropagatorJob::slotPutFinished()
         slotPutFinishedOneFile(singleFile, job, singleReplyObject);
     }
 
-    finalize(fullReplyObject);
+    finalize(files, fullReplyObject);
 }
 
 void BulkPropagatorJob::slotUploadProgress(SyncFileItemPtr item, qint64 sent, qint64 total)
@@ -482,16 +611,16 @@ void BulkPropagatorJob::finalizeOneFile(const BulkUploadItem &oneFile)
 
     // Remove from the progress database:
     propagator()->_journal->setUploadInfo(oneFile._item->_file, SyncJournalDb::UploadInfo());
-    propagator()->_journal->commit("upload file start");
 }
 
-void BulkPropagatorJob::finalize(const QJsonObject &fullReply)
+void BulkPropagatorJob::finalize(const std::vector<BulkUploadItem> &files, const QJsonObject &fullReply)
 {
-    for(auto singleFileIt = std::begin(_filesToUpload); singleFileIt != std::end(_filesToUpload); ) {
-        const auto &singleFile = *singleFileIt;
-
+    for (const auto &singleFile : files) {
         if (!fullReply.contains(singleFile._remotePath)) {
-            ++singleFileIt;
+            if (!singleFile._item->hasErrorStatus()) {
+                propagator()->_anotherSyncNeeded = true;
+                done(singleFile._item, SyncFileItem::SoftError, tr("The server did not report the result of the upload."));
+            }
             continue;
         }
         if (!singleFile._item->hasErrorStatus()) {
@@ -499,9 +628,8 @@ void BulkPropagatorJob::finalize(const QJsonObject &fullReply)
         }
 
         done(singleFile._item, singleFile._item->_status, {});
-
-        singleFileIt = _filesToUpload.erase(singleFileIt);
     }
+    propagator()->_journal->commit("bulk upload finished");
 
     checkPropagationIsDone();
 }
@@ -22,6 +22,7 @@
 #include <QMap>
 #include <QByteArray>
 #include <deque>
+#include <unordered_map>
 
 namespace OCC {
 
@@ -45,6 +46,7 @@ class BulkPropagatorJob : public PropagatorJob
       QString _file; /// I'm still unsure if I should use a SyncFilePtr here.
       QString _path; /// the full path on disk.
       qint64 _size;
+      QByteArray _content; /// the file content if it was read ahead, null otherwise.
     };
 
     struct BulkUploadItem
@@ -91,6 +93,11 @@ private slots:
     void slotJobDestroyed(QObject *job);
 
 private:
+    /// Hashes the file on disk, the upload reads it again
+    void computeChecksumOfFile(SyncFileItemPtr item,
+                               UploadFileInfo fileToUpload,
+                               const QByteArray &checksumType);
+
     void doStartUpload(SyncFileItemPtr item,
                        UploadFileInfo fileToUpload,
                        QByteArray transmissionChecksumHeader);
@@ -98,7 +105,7 @@ private:
     void adjustLastJobTimeout(AbstractNetworkJob *job,
                               qint64 fileSize) const;
 
-    void finalize(const QJsonObject &fullReply);
+    void finalize(const std::vector<BulkUploadItem> &files, const QJsonObject &fullReply);
 
     void finalizeOneFile(const BulkUploadItem &oneFile);
 
@@ -159,7 +166,9 @@ private:
 
     QSet<QString> _pendingChecksumFiles;
 
-    std::vector<BulkUploadItem> _filesToUpload;
+    std::vector<BulkUploadItem> _filesToUpload; /// the batch that is being prepared
+
+    std::unordered_map<PutMultiFileJob *, std::vector<BulkUploadItem>> _filesInTransit;
 
     SyncFileItem::Status _finalStatus = SyncFileItem::Status::NoStatus;
 };
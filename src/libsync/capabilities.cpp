@@ -28,6 +28,28 @@ Q_LOGGING_CATEGORY(lcServerCapabilities, "nextcloud.sync.server.capabilities", Q
 Capabilities::Capabilities(const QVariantMap &capabilities)
     : _capabilities(capabilities)
 {
+    // The sync asks for these per item, so parse them once
+    const auto dav = _capabilities.value(QStringLiteral("dav")).toMap();
+    _chunkingNg = dav.value(QStringLiteral("chunking")).toByteArray() >= "1.0";
+    _bulkUpload = dav.value(QStringLiteral("bulkupload")).toByteArray() >= "1.0";
+    _chunkingParallelUploadDisabled = dav.value(QStringLiteral("chunkingParallelUploadDisabled")).toBool();
+    for (const auto &code : dav.value(QStringLiteral("httpErrorCodesThatResetFailingChunkedUploads")).toList()) {
+        _httpErrorCodesThatResetFailingChunkedUploads.push_back(code.toInt());
+    }
+    _invalidFilenameRegex = dav.value(QStringLiteral("invalidFilenameRegex")).toString();
+
+    const auto checksums = _capabilities.value(QStringLiteral("checksums")).toMap();
+    for (const auto &type : checksums.value(QStringLiteral("supportedTypes")).toList()) {
+        _supportedChecksumTypes.push_back(type.toByteArray());
+    }
+    _preferredUploadChecksumType = checksums.value(QStringLiteral("preferredUploadType"), QStringLiteral("SHA1")).toString();
+
+    _uploadConflictFiles = _capabilities.value(QStringLiteral("uploadConflictFiles")).toBool();
+}
+
+QVariantMap Capabilities::toVariantMap() const
+{
+    return _capabilities;
 }
 
 bool Capabilities::shareAPI() const
@@ -181,18 +203,12 @@ bool Capabilities::hasActivities() const
 
 QList<QByteArray> Capabilities::supportedChecksumTypes() const
 {
-    QList<QByteArray> list;
-    foreach (const auto &t, _capabilities["checksums"].toMap()["supportedTypes"].toList()) {
-        list.push_back(t.toByteArray());
-    }
-    return list;
+    return _supportedChecksumTypes;
 }
 
 QByteArray Capabilities::preferredUploadChecksumType() const
 {
-    return qEnvironmentVariable("OWNCLOUD_CONTENT_CHECKSUM_TYPE",
-                                _capabilities.value(QStringLiteral("checksums")).toMap()
-                                .value(QStringLiteral("preferredUploadType"), QStringLiteral("SHA1")).toString()).toUtf8();
+    return qEnvironmentVariable("OWNCLOUD_CONTENT_CHECKSUM_TYPE", _preferredUploadChecksumType).toUtf8();
 }
 
 QByteArray Capabilities::uploadChecksumType() const
@@ -213,12 +229,12 @@ bool Capabilities::chunkingNg() const
         return false;
     if (chunkng == "1")
         return true;
-    return _capabilities["dav"].toMap()["chunking"].toByteArray() >= "1.0";
+    return _chunkingNg;
 }
 
 bool Capabilities::bulkUpload() const
 {
-    return _capabilities["dav"].toMap()["bulkupload"].toByteArray() >= "1.0";
+    return _bulkUpload;
 }
 
 bool Capabilities::userStatus() const
@@ -294,7 +310,7 @@ QUrl Capabilities::pushNotificationsWebSocketUrl() const
 
 bool Capabilities::chunkingParallelUploadDisabled() const
 {
-    return _capabilities["dav"].toMap()["chunkingParallelUploadDisabled"].toBool();
+    return _chunkingParallelUploadDisabled;
 }
 
 bool Capabilities::privateLinkPropertyAvailable() const
@@ -304,16 +320,12 @@ bool Capabilities::privateLinkPropertyAvailable() const
 
 QList<int> Capabilities::httpErrorCodesThatResetFailingChunkedUploads() const
 {
-    QList<int> list;
-    foreach (const auto &t, _capabilities["dav"].toMap()["httpErrorCodesThatResetFailingChunkedUploads"].toList()) {
-        list.push_back(t.toInt());
-    }
-    return list;
+    return _httpErrorCodesThatResetFailingChunkedUploads;
 }
 
 QString Capabilities::invalidFilenameRegex() const
 {
-    return _capabilities[QStringLiteral("dav")].toMap()[QStringLiteral("invalidFilenameRegex")].toString();
+    return _invalidFilenameRegex;
 }
 
 bool Capabilities::uploadConflictFiles() const
@@ -323,7 +335,7 @@ bool Capabilities::uploadConflictFiles() const
     if (envIsSet)
         return envValue != 0;
 
-    return _capabilities[QStringLiteral("uploadConflictFiles")].toBool();
+    return _uploadConflictFiles;
 }
 
 QStringList Capabilities::blacklistedFiles() const
@@ -46,6 +46,9 @@ class OWNCLOUDSYNC_EXPORT Capabilities
 public:
     Capabilities(const QVariantMap &capabilities);
 
+    /// The raw capabilities as received from the server, for persisting them
+    QVariantMap toVariantMap() const;
+
     bool shareAPI() const;
     bool shareEmailPasswordEnabled() const;
     bool shareEmailPasswordEnforced() const;
@@ -174,6 +177,16 @@ private:
 
     QVariantMap _capabilities;
 
+    // Parsed in the constructor, see there
+    bool _chunkingNg = false;
+    bool _bulkUpload = false;
+    bool _chunkingParallelUploadDisabled = false;
+    bool _uploadConflictFiles = false;
+    QList<QByteArray> _supportedChecksumTypes;
+    QString _preferredUploadChecksumType;
+    QList<int> _httpErrorCodesThatResetFailingChunkedUploads;
+    QString _invalidFilenameRegex;
+
     QList<DirectEditor*> _directEditors;
 };
 
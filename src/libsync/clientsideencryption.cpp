@@ -12,6 +12,7 @@
 #include "networkjobs.h"
 #include "clientsideencryptionjobs.h"
 #include "theme.h"
+#include "filesystem.h"
 #include "creds/abstractcredentials.h"
 
 #include <map>
@@ -34,6 +35,7 @@
 #include <QUuid>
 #include <QScopeGuard>
 #include <QRandomGenerator>
+#include <QtEndian>
 
 #include <qt5keychain/keychain.h>
 #include <common/utility.h>
@@ -1957,4 +1959,218 @@ bool EncryptionHelper::StreamingDecryptor::isFinished() const
 {
     return _isFinished;
 }
+
+namespace {
+    constexpr int aesBlockSize = 16;
+    // Plain data encrypted per round in EncryptedFileDevice
+    constexpr qint64 streamingBlockSize = 1024 * 1024;
+}
+
+EncryptionHelper::EncryptedFileDevice::EncryptedFileDevice(const QString &fileName, const QByteArray &key, const QByteArray &iv, const QByteArray &tag)
+    : _file(fileName)
+    , _key(key)
+    , _iv(iv)
+    , _tag(tag)
+{
+}
+
+QByteArray EncryptionHelper::EncryptedFileDevice::computeTag(const QString &fileName, const QByteArray &key, const QByteArray &iv)
+{
+    QFile input(fileName);
+    QString openError;
+    if (!FileSystem::openAndSeekFileSharedRead(&input, &openError, 0)) {
+        qCWarning(lcCse) << "Could not open input file for reading" << fileName << openError;
+        return QByteArray();
+    }
+
+    CipherCtx ctx;
+    if (!ctx
+        || !EVP_EncryptInit_ex(ctx, EVP_aes_128_gcm(), nullptr, nullptr, nullptr)
+        || !EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_GCM_SET_IVLEN, iv.size(), nullptr)
+        || !EVP_EncryptInit_ex(ctx, nullptr, nullptr, reinterpret_cast<const unsigned char *>(key.constData()), reinterpret_cast<const unsigned char *>(iv.constData()))) {
+        qCInfo(lcCse()) << "Could not init cipher";
+        return QByteArray();
+    }
+
+    QByteArray in(int(streamingBlockSize), Qt::Uninitialized);
+    QByteArray out(int(streamingBlockSize) + OCC::Constants::e2EeTagSize, Qt::Uninitialized);
+    int len = 0;
+    forever {
+        const auto bytesRead = input.read(in.data(), in.size());
+        if (bytesRead < 0) {
+            qCInfo(lcCse()) << "Could not read data from file" << input.errorString();
+            return QByteArray();
+        }
+        if (bytesRead == 0) {
+            break;
+        }
+        if (!EVP_EncryptUpdate(ctx, unsignedData(out), &len, reinterpret_cast<const unsigned char *>(in.constData()), int(bytesRead))) {
+            qCInfo(lcCse()) << "Could not encrypt";
+            return QByteArray();
+        }
+    }
+
+    if (1 != EVP_EncryptFinal_ex(ctx, unsignedData(out), &len)) {
+        qCInfo(lcCse()) << "Could finalize encryption";
+        return QByteArray();
+    }
+
+    QByteArray e2EeTag(OCC::Constants::e2EeTagSize, '\0');
+    if (1 != EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_GCM_GET_TAG, OCC::Constants::e2EeTagSize, unsignedData(e2EeTag))) {
+        qCInfo(lcCse()) << "Could not get e2EeTag";
+        return QByteArray();
+    }
+    return e2EeTag;
+}
+
+bool EncryptionHelper::EncryptedFileDevice::initKeystream()
+{
+    if (_key.size() != aesBlockSize || _iv.isEmpty()) {
+        return false;
+    }
+    const auto key = reinterpret_cast<const unsigned char *>(_key.constData());
+
+    // Block i of the ciphertext is the plain block XOR E(K, counter + i), where
+    // only the low 32 bits of the counter are incremented. For IVs that aren't
+    // 96 bits long the first counter is derived with GHASH. Rather than doing that
+    // here, let OpenSSL encrypt one zero block and run the resulting keystream
+    // block back through the block cipher.
+    CipherCtx gcm;
+    const unsigned char zeros[aesBlockSize] = {};
+    unsigned char keystream[aesBlockSize];
+    int len = 0;
+    if (!gcm
+        || !EVP_EncryptInit_ex(gcm, EVP_aes_128_gcm(), nullptr, nullptr, nullptr)
+        || !EVP_CIPHER_CTX_ctrl(gcm, EVP_CTRL_GCM_SET_IVLEN, _iv.size(), nullptr)
+        || !EVP_EncryptInit_ex(gcm, nullptr, nullptr, key, reinterpret_cast<const unsigned char *>(_iv.constData()))
+        || !EVP_EncryptUpdate(gcm, keystream, &len, zeros, aesBlockSize)
+        || len != aesBlockSize) {
+        return false;
+    }
+
+    CipherCtx ecbDecrypt;
+    if (!ecbDecrypt || !EVP_DecryptInit_ex(ecbDecrypt, EVP_aes_128_ecb(), nullptr, key, nullptr)) {
+        return false;
+    }
+    EVP_CIPHER_CTX_set_padding(ecbDecrypt, 0);
+    if (!EVP_DecryptUpdate(ecbDecrypt, _firstCounter, &len, keystream, aesBlockSize) || len != aesBlockSize) {
+        return false;
+    }
+
+    if (!_blockCipher || !EVP_EncryptInit_ex(_blockCipher, EVP_aes_128_ecb(), nullptr, key, nullptr)) {
+        return false;
+    }
+    EVP_CIPHER_CTX_set_padding(_blockCipher, 0);
+    return true;
+}
+
+bool EncryptionHelper::EncryptedFileDevice::open(OpenMode mode)
+{
+    if (mode & QIODevice::WriteOnly) {
+        setErrorString(tr("Encrypted files can only be read"));
+        return false;
+    }
+
+    QString openError;
+    if (!FileSystem::openAndSeekFileSharedRead(&_file, &openError, 0)) {
+        setErrorString(openError);
+        return false;
+    }
+    if (!initKeystream()) {
+        _file.close();
+        setErrorString(tr("Could not initialize the encryption of %1").arg(_file.fileName()));
+        return false;
+    }
+
+    _plainSize = _file.size();
+    _pos = 0;
+    return QIODevice::open(mode | QIODevice::Unbuffered);
+}
+
+void EncryptionHelper::EncryptedFileDevice::close()
+{
+    _file.close();
+    QIODevice::close();
+}
+
+qint64 EncryptionHelper::EncryptedFileDevice::size() const
+{
+    return _plainSize + OCC::Constants::e2EeTagSize;
+}
+
+bool EncryptionHelper::EncryptedFileDevice::seek(qint64 pos)
+{
+    if (pos < 0 || pos > size() || !QIODevice::seek(pos)) {
+        return false;
+    }
+    _pos = pos;
+    return true;
+}
+
+qint64 EncryptionHelper::EncryptedFileDevice::writeData(const char *, qint64)
+{
+    Q_ASSERT_X(false, "EncryptedFileDevice", "write to read only device");
+    return -1;
+}
+
+qint64 EncryptionHelper::EncryptedFileDevice::readData(char *data, qint64 maxlen)
+{
+    maxlen = qMin(maxlen, size() - _pos);
+    if (maxlen <= 0) {
+        return 0;
+    }
+
+    qint64 done = 0;
+    while (done < maxlen && _pos < _plainSize) {
+        const auto firstBlock = _pos / aesBlockSize;
+        const auto offsetInBlock = _pos % aesBlockSize;
+        const auto length = qMin(qMin(maxlen - done, _plainSize - _pos), streamingBlockSize - offsetInBlock);
+        const int blockCount = int((offsetInBlock + length + aesBlockSize - 1) / aesBlockSize);
+
+        if (_file.pos() != _pos && !_file.seek(_pos)) {
+            setErrorString(_file.errorString());
+            return done > 0 ? done : -1;
+        }
+        if (_file.read(data + done, length) != length) {
+            setErrorString(tr("Could not read %1").arg(_file.fileName()));
+            return done > 0 ? done : -1;
+        }
+
+        // Counter blocks for the covered range; GCM increments the low 32 bits only
+        _counters.resize(blockCount * aesBlockSize);
+        _keystream.resize(blockCount * aesBlockSize);
+        const auto counterBase = qFromBigEndian<quint32>(_firstCounter + 12);
+        for (int i = 0; i < blockCount; ++i) {
+            const auto counter = reinterpret_cast<unsigned char *>(_counters.data()) + i * aesBlockSize;
+            memcpy(counter, _firstCounter, 12);
+            qToBigEndian<quint32>(counterBase + quint32(firstBlock + i), counter + 12);
+        }
+        int len = 0;
+        if (!EVP_EncryptUpdate(_blockCipher, unsignedData(_keystream), &len, reinterpret_cast<const unsigned char *>(_counters.constData()), _counters.size())
+            || len != _keystream.size()) {
+            setErrorString(tr("Could not encrypt %1").arg(_file.fileName()));
+            return done > 0 ? done : -1;
+        }
+
+        const auto keystream = _keystream.constData() + offsetInBlock;
+        for (qint64 i = 0; i < length; ++i) {
+            data[done + i] ^= keystream[i];
+        }
+        done += length;
+        _pos += length;
+    }
+
+    if (done < maxlen) {
+        if (_tag.size() != OCC::Constants::e2EeTagSize) {
+            setErrorString(tr("The authentication tag of %1 is unknown").arg(_file.fileName()));
+            return done > 0 ? done : -1;
+        }
+        const auto tagOffset = _pos - _plainSize;
+        const auto length = qMin(maxlen - done, OCC::Constants::e2EeTagSize - tagOffset);
+        memcpy(data + done, _tag.constData() + tagOffset, length);
+        done += length;
+        _pos += length;
+    }
+    return done;
+}
 }
@@ -111,6 +111,59 @@ private:
     quint64 _decryptedSoFar = 0;
     quint64 _totalSize = 0;
 };
+
+/**
+ * @brief Read-only view of a local file in its encrypted form
+ *
+ * Reading gives the AES-GCM ciphertext followed by the authentication tag,
+ * the same bytes fileEncryption() writes, without a temporary copy of the file.
+ * GCM encrypts in counter mode, so any range of the ciphertext can be produced
+ * on its own: the device is seekable and chunked uploads read it like a file.
+ *
+ * The tag depends on all of the data. It has to be computed up front with
+ * computeTag(); reading the last Constants::e2EeTagSize bytes fails without it.
+ */
+class OWNCLOUDSYNC_EXPORT EncryptedFileDevice : public QIODevice
+{
+    Q_OBJECT
+public:
+    EncryptedFileDevice(const QString &fileName, const QByteArray &key, const QByteArray &iv, const QByteArray &tag = QByteArray());
+
+    /**
+     * Encrypts the file, discarding the output, and returns the authentication
+     * tag or an empty array on error. Reads the whole file, use a worker thread.
+     */
+    static QByteArray computeTag(const QString &fileName, const QByteArray &key, const QByteArray &iv);
+
+    bool open(OpenMode mode) override;
+    void close() override;
+    qint64 size() const override;
+    bool seek(qint64 pos) override;
+    bool isSequential() const override { return false; }
+
+protected:
+    qint64 readData(char *data, qint64 maxlen) override;
+    qint64 writeData(const char *data, qint64 len) override;
+
+private:
+    bool initKeystream();
+
+    QFile _file;
+    QByteArray _key;
+    QByteArray _iv;
+    QByteArray _tag;
+
+    /// AES-ECB, turns counter blocks into keystream
+    CipherCtx _blockCipher;
+    /// Counter block for the first block of ciphertext
+    unsigned char _firstCounter[16];
+    /// Scratch buffers reused between reads
+    QByteArray _counters;
+    QByteArray _keystream;
+
+    qint64 _plainSize = 0;
+    qint64 _pos = 0;
+};
 }
 
 class OWNCLOUDSYNC_EXPORT ClientSideEncryption : public QObject {
@@ -77,6 +77,10 @@ static const char updateSegmentC[] = "updateSegment";
 static const char updateChannelC[] = "updateChannel";
 static const char geometryC[] = "geometry";
 static const char timeoutC[] = "timeout";
+static const char maxConcurrentSyncsC[] = "maxConcurrentSyncs";
+static const char http2EnabledC[] = "http2Enabled";
+static const char maxConcurrentRequestsC[] = "maxConcurrentRequests";
+static const char localFileSearchIndexC[] = "localFileSearchIndex";
 static const char chunkSizeC[] = "chunkSize";
 static const char minChunkSizeC[] = "minChunkSize";
 static const char maxChunkSizeC[] = "maxChunkSize";
@@ -86,6 +90,7 @@ static const char logDirC[] = "logDir";
 static const char logDebugC[] = "logDebug";
 static const char logExpireC[] = "logExpire";
 static const char logFlushC[] = "logFlush";
+static const char logAsyncC[] = "logAsync";
 static const char showExperimentalOptionsC[] = "showExperimentalOptions";
 static const char clientVersionC[] = "clientVersion";
 
@@ -233,6 +238,34 @@ int ConfigFile::timeout() const
     return settings.value(QLatin1String(timeoutC), 300).toInt(); // default to 5 min
 }
 
+int ConfigFile::maxConcurrentSyncs() const
+{
+    QSettings settings(configFile(), QSettings::IniFormat);
+    return qMax(1, settings.value(QLatin1String(maxConcurrentSyncsC), 2).toInt());
+}
+
+bool ConfigFile::http2Enabled() const
+{
+    QSettings settings(configFile(), QSettings::IniFormat);
+    return settings.value(QLatin1String(http2EnabledC), false).toBool();
+}
+
+int ConfigFile::maxConcurrentRequests(bool http2Supported) const
+{
+    QSettings settings(configFile(), QSettings::IniFormat);
+    const auto requests = settings.value(QLatin1String(maxConcurrentRequestsC), 0).toInt();
+    if (requests <= 0) {
+        return http2Supported ? 20 : 6;
+    }
+    return requests;
+}
+
+bool ConfigFile::localFileSearchIndex() const
+{
+    QSettings settings(configFile(), QSettings::IniFormat);
+    return settings.value(QLatin1String(localFileSearchIndexC), true).toBool();
+}
+
 qint64 ConfigFile::chunkSize() const
 {
     QSettings settings(configFile(), QSettings::IniFormat);
@@ -1012,6 +1045,18 @@ void ConfigFile::setLogFlush(bool enabled)
     settings.setValue(QLatin1String(logFlushC), enabled);
 }
 
+bool ConfigFile::logAsync() const
+{
+    QSettings settings(configFile(), QSettings::IniFormat);
+    return settings.value(QLatin1String(logAsyncC), false).toBool();
+}
+
+void ConfigFile::setLogAsync(bool enabled)
+{
+    QSettings settings(configFile(), QSettings::IniFormat);
+    settings.setValue(QLatin1String(logAsyncC), enabled);
+}
+
 bool ConfigFile::showExperimentalOptions() const
 {
     QSettings settings(configFile(), QSettings::IniFormat);
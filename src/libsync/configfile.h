@@ -107,6 +107,9 @@ public:
     bool logFlush() const;
     void setLogFlush(bool enabled);
 
+    bool logAsync() const;
+    void setLogAsync(bool enabled);
+
     // Whether experimental UI options should be shown
     bool showExperimentalOptions() const;
 
@@ -159,6 +162,23 @@ public:
     void setShowInExplorerNavigationPane(bool show);
 
     int timeout() const;
+
+    /** How many folders FolderMan may sync at the same time, at least 1 */
+    int maxConcurrentSyncs() const;
+
+    /** Whether small requests may be multiplexed over HTTP/2 when the server offers it */
+    bool http2Enabled() const;
+
+    /** How many requests a folder's sync may have running at once
+     *
+     * Without a setting, 20 over HTTP/2 and 6 over HTTP/1.1, where Qt opens
+     * six connections per host and queues the other requests.
+     */
+    int maxConcurrentRequests(bool http2Supported) const;
+
+    /** Whether the sync journals index the synced file names for the local search */
+    bool localFileSearchIndex() const;
+
     qint64 chunkSize() const;
     qint64 maxChunkSize() const;
     qint64 minChunkSize() const;
@@ -26,6 +26,7 @@
 #include "vio/csync_vio_local.h"
 #include <QFileInfo>
 #include <QFile>
+#include <QElapsedTimer>
 #include <QThreadPool>
 #include <common/checksums.h>
 #include <common/constants.h>
@@ -1418,11 +1419,16 @@ void ProcessDirectoryJob::processFileFinalize(
 
     if (path._original != path._target && (item->_instruction == CSYNC_INSTRUCTION_UPDATE_METADATA || item->_instruction == CSYNC_INSTRUCTION_NONE)) {
         ASSERT(_dirItem && _dirItem->_instruction == CSYNC_INSTRUCTION_RENAME);
-        // This is because otherwise subitems are not updated!  (ideally renaming a directory could
-        // update the database for all items!  See PropagateDirectory::slotSubJobsFinished)
-        item->_instruction = CSYNC_INSTRUCTION_RENAME;
-        item->_renameTarget = path._target;
-        item->_direction = _dirItem->_direction;
+        // Unchanged files are moved in the database together with their renamed parent
+        // directory, see SyncJournalDb::moveFileRecordsBelow(). Directories, metadata
+        // changes and encrypted files, whose mangled name must be adjusted, still need
+        // their own rename.
+        if (item->_instruction == CSYNC_INSTRUCTION_UPDATE_METADATA || item->isDirectory()
+            || !item->_encryptedFileName.isEmpty()) {
+            item->_instruction = CSYNC_INSTRUCTION_RENAME;
+            item->_renameTarget = path._target;
+            item->_direction = _dirItem->_direction;
+        }
     }
 
     qCInfo(lcDisco) << "Discovered" << item->_file << item->_instruction << item->_direction << item->_type;
@@ -1733,9 +1739,12 @@ DiscoverySingleDirectoryJob *ProcessDirectoryJob::startAsyncServerQuery()
     connect(serverJob, &DiscoverySingleDirectoryJob::etag, this, &ProcessDirectoryJob::etag);
     _discoveryData->_currentlyActiveJobs++;
     _pendingAsyncJobs++;
-    connect(serverJob, &DiscoverySingleDirectoryJob::finished, this, [this, serverJob](const auto &results) {
+    QElapsedTimer duration;
+    duration.start();
+    connect(serverJob, &DiscoverySingleDirectoryJob::finished, this, [this, serverJob, duration](const auto &results) {
         _discoveryData->_currentlyActiveJobs--;
         _pendingAsyncJobs--;
+        emit _discoveryData->remoteDirectoryListed(std::chrono::milliseconds(duration.elapsed()));
         if (results) {
             _serverNormalQueryEntries = *results;
             _serverQueryDone = true;
@@ -24,6 +24,7 @@
 #include <QMutex>
 #include <QWaitCondition>
 #include <QRunnable>
+#include <chrono>
 #include <deque>
 #include "syncoptions.h"
 #include "syncfileitem.h"
@@ -290,6 +291,9 @@ signals:
     void silentlyExcluded(const QString &folderPath);
 
     void addErrorToGui(SyncFileItem::Status status, const QString &errorMessage, const QString &subject);
+
+    /// A PROPFIND for a remote directory finished, successful or not
+    void remoteDirectoryListed(std::chrono::milliseconds duration);
 };
 
 /// Implementation of DiscoveryPhase::adjustRenamedPath
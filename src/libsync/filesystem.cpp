@@ -21,13 +21,23 @@
 #include <QDirIterator>
 #include <QCoreApplication>
 
+#include <cstring>
+
+#ifdef Q_OS_UNIX
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <cerrno>
+#endif
+
 #include "csync.h"
 #include "vio/csync_vio_local.h"
 #include "std/c_time.h"
 
 namespace OCC {
 
-bool FileSystem::fileEquals(const QString &fn1, const QString &fn2)
+bool FileSystem::fileEquals(const QString &fn1, const QString &fn2, bool mapFiles)
 {
     // compare two files with given filename and return true if they have the same content
     QFile f1(fn1);
@@ -37,21 +47,53 @@ bool FileSystem::fileEquals(const QString &fn1, const QString &fn2)
         return false;
     }
 
-    if (getSize(fn1) != getSize(fn2)) {
+    const qint64 size = f1.size();
+    if (size != f2.size()) {
         return false;
     }
 
-    const int BufferSize = 16 * 1024;
-    QByteArray buffer1(BufferSize, 0);
-    QByteArray buffer2(BufferSize, 0);
-    // the files have the same size, compare all of it
-    while(!f1.atEnd()){
-        f1.read(buffer1.data(), BufferSize);
-        f2.read(buffer2.data(), BufferSize);
-        if (buffer1 != buffer2) {
+    // Compare mapped windows of both files, that avoids copying the content.
+    // Where mapping fails (network shares, ...) the window is read instead.
+    const qint64 WindowSize = 16 * 1024 * 1024;
+    const qint64 BufferSize = 1024 * 1024;
+    QByteArray buffer1;
+    QByteArray buffer2;
+    const auto readEquals = [&](qint64 offset, qint64 length) {
+        if (buffer1.isEmpty()) {
+            buffer1.resize(BufferSize);
+            buffer2.resize(BufferSize);
+        }
+        if (!f1.seek(offset) || !f2.seek(offset)) {
             return false;
         }
+        while (length > 0) {
+            const qint64 chunk = qMin(length, BufferSize);
+            if (f1.read(buffer1.data(), chunk) != chunk || f2.read(buffer2.data(), chunk) != chunk) {
+                return false;
+            }
+            if (memcmp(buffer1.constData(), buffer2.constData(), chunk) != 0) {
+                return false;
+            }
+            length -= chunk;
+        }
+        return true;
     };
+
+    for (qint64 offset = 0; offset < size; offset += WindowSize) {
+        const qint64 length = qMin(WindowSize, size - offset);
+        uchar *map1 = mapFiles ? f1.map(offset, length) : nullptr;
+        uchar *map2 = map1 ? f2.map(offset, length) : nullptr;
+        const bool equal = map1 && map2
+            ? memcmp(map1, map2, length) == 0
+            : readEquals(offset, length);
+        if (map1)
+            f1.unmap(map1);
+        if (map2)
+            f2.unmap(map2);
+        if (!equal) {
+            return false;
+        }
+    }
     return true;
 }
 
@@ -132,10 +174,125 @@ qint64 FileSystem::getSize(const QString &filename)
     return QFileInfo(filename).size();
 }
 
-// Code inspired from Qt5's QDir::removeRecursively
+static QString removeFileError(const QString &path, const QString &error)
+{
+    return QCoreApplication::translate("FileSystem", "Error removing \"%1\": %2")
+        .arg(QDir::toNativeSeparators(path), error);
+}
+
+static QString removeFolderError(const QString &path)
+{
+    return QCoreApplication::translate("FileSystem", "Could not remove folder \"%1\"")
+        .arg(QDir::toNativeSeparators(path));
+}
+
+#ifdef Q_OS_UNIX
+
+static bool removeTreeAt(int parentFd, const char *name, const QString &path,
+    const std::function<void(const QString &path, bool isDir)> &onDeleted, QStringList *errors);
+
+/*
+ * Removes the contents of the directory open as dirFd, which is closed.
+ *
+ * Works relative to the directory, so no path is resolved again for every
+ * entry. The removed entries are collected in removed when onDeleted is set.
+ */
+static bool removeDirectoryContents(int dirFd, const QString &path, QVector<QPair<QByteArray, bool>> *removed,
+    const std::function<void(const QString &path, bool isDir)> &onDeleted, QStringList *errors)
+{
+    DIR *dir = fdopendir(dirFd);
+    if (!dir) {
+        qCWarning(lcFileSystem) << "Error reading folder" << path << ':' << strerror(errno);
+        close(dirFd);
+        if (errors)
+            errors->append(removeFolderError(path));
+        return false;
+    }
+
+    bool allRemoved = true;
+    while (const auto entry = readdir(dir)) {
+        const char *name = entry->d_name;
+        if (strcmp(name, ".") == 0 || strcmp(name, "..") == 0)
+            continue;
+
+        // Symlinks to directories are removed like files
+        bool isDir = entry->d_type == DT_DIR;
+        if (entry->d_type == DT_UNKNOWN) {
+            struct stat st;
+            isDir = fstatat(dirFd, name, &st, AT_SYMLINK_NOFOLLOW) == 0 && S_ISDIR(st.st_mode);
+        }
+
+        bool removeOk = false;
+        if (isDir) {
+            removeOk = removeTreeAt(dirFd, name, path + QLatin1Char('/') + QFile::decodeName(name), onDeleted, errors);
+        } else {
+            removeOk = unlinkat(dirFd, name, 0) == 0;
+            if (!removeOk) {
+                const QString filePath = path + QLatin1Char('/') + QFile::decodeName(name);
+                const QString removeError = QString::fromLocal8Bit(strerror(errno));
+                if (errors)
+                    errors->append(removeFileError(filePath, removeError));
+                qCWarning(lcFileSystem) << "Error removing " << filePath << ':' << removeError;
+            }
+        }
+        if (!removeOk) {
+            allRemoved = false;
+        } else if (onDeleted) {
+            removed->append(qMakePair(QByteArray(name), isDir));
+        }
+    }
+    closedir(dir);
+    return allRemoved;
+}
+
+/*
+ * Removes the directory name below parentFd and everything in it.
+ *
+ * When that works, the caller reports just the directory. Otherwise what was
+ * removed in it is reported here, entry by entry.
+ */
+static bool removeTreeAt(int parentFd, const char *name, const QString &path,
+    const std::function<void(const QString &path, bool isDir)> &onDeleted, QStringList *errors)
+{
+    const int fd = openat(parentFd, name, O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+    if (fd == -1) {
+        qCWarning(lcFileSystem) << "Error opening folder" << path << ':' << strerror(errno);
+        if (errors)
+            errors->append(removeFolderError(path));
+        return false;
+    }
+    QVector<QPair<QByteArray, bool>> removed;
+    bool allRemoved = removeDirectoryContents(fd, path, &removed, onDeleted, errors);
+    if (allRemoved && unlinkat(parentFd, name, AT_REMOVEDIR) != 0) {
+        qCWarning(lcFileSystem) << "Error removing folder" << path << ':' << strerror(errno);
+        if (errors)
+            errors->append(removeFolderError(path));
+        allRemoved = false;
+    }
+    if (!allRemoved && onDeleted) {
+        for (const auto &entry : qAsConst(removed))
+            onDeleted(path + QLatin1Char('/') + QFile::decodeName(entry.first), entry.second);
+    }
+    return allRemoved;
+}
+
 bool FileSystem::removeRecursively(const QString &path, const std::function<void(const QString &path, bool isDir)> &onDeleted, QStringList *errors)
+{
+    const QByteArray encodedPath = QFile::encodeName(path);
+    if (!removeTreeAt(AT_FDCWD, encodedPath.constData(), path, onDeleted, errors))
+        return false;
+    if (onDeleted)
+        onDeleted(path, true);
+    return true;
+}
+
+#else
+
+// Code inspired from Qt5's QDir::removeRecursively
+static bool removeRecursivelyImpl(const QString &path, const std::function<void(const QString &path, bool isDir)> &onDeleted, QStringList *errors, bool isRoot)
 {
     bool allRemoved = true;
+    QVector<QPair<QString, bool>> removed;
     QDirIterator di(path, QDir::AllEntries | QDir::Hidden | QDir::System | QDir::NoDotAndDotDot);
 
     while (di.hasNext()) {
@@ -146,40 +303,51 @@ bool FileSystem::removeRecursively(const QString &path, const std::function<void
         // we never want to go into this branch for .lnk files
         bool isDir = fi.isDir() && !fi.isSymLink() && !FileSystem::isJunction(fi.absoluteFilePath());
         if (isDir) {
-            removeOk = removeRecursively(path + QLatin1Char('/') + di.fileName(), onDeleted, errors); // recursive
+            removeOk = removeRecursivelyImpl(path + QLatin1Char('/') + di.fileName(), onDeleted, errors, false); // recursive
         } else {
             QString removeError;
             removeOk = FileSystem::remove(di.filePath(), &removeError);
-            if (removeOk) {
-                if (onDeleted)
-                    onDeleted(di.filePath(), false);
-            } else {
+            if (!removeOk) {
                 if (errors) {
-                    errors->append(QCoreApplication::translate("FileSystem", "Error removing \"%1\": %2")
-                                       .arg(QDir::toNativeSeparators(di.filePath()), removeError));
+                    errors->append(removeFileError(di.filePath(), removeError));
                 }
                 qCWarning(lcFileSystem) << "Error removing " << di.filePath() << ':' << removeError;
             }
         }
-        if (!removeOk)
+        if (!removeOk) {
             allRemoved = false;
+        } else if (onDeleted) {
+            removed.append(qMakePair(di.filePath(), isDir));
+        }
     }
     if (allRemoved) {
         allRemoved = QDir().rmdir(path);
-        if (allRemoved) {
-            if (onDeleted)
-                onDeleted(path, true);
-        } else {
+        if (!allRemoved) {
             if (errors) {
-                errors->append(QCoreApplication::translate("FileSystem", "Could not remove folder \"%1\"")
-                                   .arg(QDir::toNativeSeparators(path)));
+                errors->append(removeFolderError(path));
             }
             qCWarning(lcFileSystem) << "Error removing folder" << path;
         }
     }
+    if (onDeleted) {
+        // Like on Unix, the contents of a removed folder are not reported separately
+        if (!allRemoved) {
+            for (const auto &entry : qAsConst(removed))
+                onDeleted(entry.first, entry.second);
+        } else if (isRoot) {
+            onDeleted(path, true);
+        }
+    }
     return allRemoved;
 }
 
+bool FileSystem::removeRecursively(const QString &path, const std::function<void(const QString &path, bool isDir)> &onDeleted, QStringList *errors)
+{
+    return removeRecursivelyImpl(path, onDeleted, errors, true);
+}
+
+#endif
+
 bool FileSystem::getInode(const QString &filename, quint64 *inode)
 {
     csync_file_stat_t fs;
@@ -42,8 +42,14 @@ namespace FileSystem {
 
     /**
      * @brief compare two files with given filename and return true if they have the same content
+     *
+     * Reads both files in full when their sizes are equal, so better not call
+     * it from the main thread.
+     *
+     * The files are compared in memory mapped windows unless \a mapFiles is
+     * false or mapping fails; then they are read.
      */
-    bool fileEquals(const QString &fn1, const QString &fn2);
+    bool OWNCLOUDSYNC_EXPORT fileEquals(const QString &fn1, const QString &fn2, bool mapFiles = true);
 
     /**
      * @brief Get the mtime for a filepath
@@ -90,7 +96,9 @@ namespace FileSystem {
      * Removes a directory and its contents recursively
      *
      * Returns true if all removes succeeded.
-     * onDeleted() is called for each deleted file or directory, including the root.
+     * onDeleted() is called for each removed file or directory, except for the
+     * contents of a removed directory, which is reported alone. So when
+     * everything was removed, it is called just once, for the root.
      * errors are collected in errors.
      */
     bool OWNCLOUDSYNC_EXPORT removeRecursively(const QString &path,
@@ -23,6 +23,8 @@
 #include <QMutexLocker>
 #include <QStringList>
 #include <QTimer>
+#include <QFutureWatcher>
+#include <QtConcurrent>
 
 #if defined(Q_OS_WIN)
 #include "folderwatcher_win.h"
@@ -32,17 +34,19 @@
 #include "folderwatcher_linux.h"
 #endif
 
-#include "folder.h"
 #include "filesystem.h"
+#include "common/utility.h"
 
 namespace OCC {
 
-Q_LOGGING_CATEGORY(lcFolderWatcher, "nextcloud.gui.folderwatcher", QtInfoMsg)
+Q_LOGGING_CATEGORY(lcFolderWatcher, "nextcloud.sync.folderwatcher", QtInfoMsg)
 
-FolderWatcher::FolderWatcher(Folder *folder)
-    : QObject(folder)
-    , _folder(folder)
+FolderWatcher::FolderWatcher(QObject *parent)
+    : QObject(parent)
 {
+    _flushTimer.setSingleShot(true);
+    _flushTimer.setInterval(coalescingIntervalMsec);
+    connect(&_flushTimer, &QTimer::timeout, this, &FolderWatcher::flushChanges);
 }
 
 FolderWatcher::~FolderWatcher() = default;
@@ -50,18 +54,17 @@ FolderWatcher::~FolderWatcher() = default;
 void FolderWatcher::init(const QString &root)
 {
     _d.reset(new FolderWatcherPrivate(this, root));
-    _timer.start();
 }
 
 bool FolderWatcher::pathIsIgnored(const QString &path)
 {
     if (path.isEmpty())
         return true;
-    if (!_folder)
+    if (!_ignoreCheck)
         return false;
 
 #ifndef OWNCLOUD_TEST
-    if (_folder->isFileExcludedAbsolute(path) && !Utility::isConflictFile(path)) {
+    if (_ignoreCheck(path) && !Utility::isConflictFile(path)) {
         qCDebug(lcFolderWatcher) << "* Ignoring file" << path;
         return true;
     }
@@ -140,36 +143,74 @@ int FolderWatcher::testLinuxWatchCount() const
 
 void FolderWatcher::changeDetected(const QString &path)
 {
-    QFileInfo fileInfo(path);
-    QStringList paths(path);
-    if (fileInfo.isDir()) {
-        QDir dir(path);
-        appendSubPaths(dir, paths);
-    }
-    changeDetected(paths);
+    queueChanges(QStringList(path), true);
 }
 
 void FolderWatcher::changeDetected(const QStringList &paths)
 {
-    // TODO: this shortcut doesn't look very reliable:
-    //   - why is the timeout only 1 second?
-    //   - what if there is more than one file being updated frequently?
-    //   - why do we skip the file altogether instead of e.g. reducing the upload frequency?
-
-    // Check if the same path was reported within the last second.
-    QSet<QString> pathsSet = paths.toSet();
-    if (pathsSet == _lastPaths && _timer.elapsed() < 1000) {
-        // the same path was reported within the last second. Skip.
+    queueChanges(paths, false);
+}
+
+void FolderWatcher::queueChanges(const QStringList &paths, bool withContents)
+{
+    for (const auto &path : paths) {
+        _pendingChanges[path] |= withContents;
+    }
+    if (!_pendingChanges.isEmpty() && !_flushTimer.isActive()) {
+        _flushTimer.start();
+    }
+}
+
+void FolderWatcher::flushChanges()
+{
+    if (_expansionRunning) {
+        // picked up once the running expansion is done
+        return;
+    }
+
+    QStringList paths;
+    QStringList directories;
+    paths.reserve(_pendingChanges.size());
+    for (auto it = _pendingChanges.cbegin(); it != _pendingChanges.cend(); ++it) {
+        paths.append(it.key());
+        if (it.value())
+            directories.append(it.key());
+    }
+    _pendingChanges.clear();
+
+    if (directories.isEmpty()) {
+        reportChanges(paths);
         return;
     }
-    _lastPaths = pathsSet;
-    _timer.restart();
 
+    // Listing new directories can take long for big trees, do it in a thread
+    _expansionRunning = true;
+    auto watcher = new QFutureWatcher<QStringList>(this);
+    connect(watcher, &QFutureWatcher<QStringList>::finished, this, [this, watcher, paths] {
+        watcher->deleteLater();
+        _expansionRunning = false;
+        reportChanges(paths + watcher->result());
+        if (!_pendingChanges.isEmpty() && !_flushTimer.isActive()) {
+            _flushTimer.start();
+        }
+    });
+    watcher->setFuture(QtConcurrent::run([directories] {
+        QStringList subPaths;
+        for (const auto &directory : directories) {
+            QDir dir(directory);
+            if (dir.exists())
+                appendSubPaths(dir, subPaths);
+        }
+        return subPaths;
+    }));
+}
+
+void FolderWatcher::reportChanges(const QStringList &paths)
+{
     QSet<QString> changedPaths;
 
     // ------- handle ignores:
-    for (int i = 0; i < paths.size(); ++i) {
-        QString path = paths[i];
+    for (const auto &path : paths) {
         if (!_testNotificationPath.isEmpty()
             && Utility::fileNamesEqual(path, _testNotificationPath)) {
             _testNotificationPath.clear();
@@ -184,10 +225,12 @@ void FolderWatcher::changeDetected(const QStringList &paths)
         return;
     }
 
-    qCInfo(lcFolderWatcher) << "Detected changes in paths:" << changedPaths;
+    qCInfo(lcFolderWatcher) << "Detected changes in" << changedPaths.size() << "paths";
+    qCDebug(lcFolderWatcher) << "Detected changes in paths:" << changedPaths;
     foreach (const QString &path, changedPaths) {
         emit pathChanged(path);
     }
+    emit pathsChanged(changedPaths);
 }
 
 } // namespace OCC
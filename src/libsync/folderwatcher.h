@@ -16,45 +16,57 @@
 #define MIRALL_FOLDERWATCHER_H
 
 #include "config.h"
+#include "owncloudlib.h"
 
 #include <QList>
 #include <QLoggingCategory>
 #include <QObject>
 #include <QString>
 #include <QStringList>
-#include <QElapsedTimer>
 #include <QHash>
 #include <QScopedPointer>
 #include <QSet>
 #include <QDir>
+#include <QTimer>
 
-class QTimer;
+#include <functional>
 
 namespace OCC {
 
 Q_DECLARE_LOGGING_CATEGORY(lcFolderWatcher)
 
 class FolderWatcherPrivate;
-class Folder;
 
 /**
  * @brief Monitors a directory recursively for changes
  *
  * Folder Watcher monitors a directory and its sub directories
  * for changes in the local file system. Changes are signalled
- * through the pathChanged() signal.
+ * through the pathChanged() and pathsChanged() signals.
  *
- * @ingroup gui
+ * Notifications are collected for a short while and reported as one
+ * deduplicated batch, so bursts of changes (a checkout, an unpacked
+ * archive) don't cause one round of processing per event.
+ *
+ * @ingroup libsync
  */
 
-class FolderWatcher : public QObject
+class OWNCLOUDSYNC_EXPORT FolderWatcher : public QObject
 {
     Q_OBJECT
 public:
+    /// Tells whether changes of an absolute path are not of interest
+    using IgnoreCheck = std::function<bool(const QString &path)>;
+
     // Construct, connect signals, call init()
-    explicit FolderWatcher(Folder *folder = nullptr);
+    explicit FolderWatcher(QObject *parent = nullptr);
     ~FolderWatcher() override;
 
+    /** Paths for which \a ignoreCheck returns true are neither watched nor
+     *  reported, except for conflict files. Set it before calling init().
+     */
+    void setIgnoreCheck(const IgnoreCheck &ignoreCheck) { _ignoreCheck = ignoreCheck; }
+
     /**
      * @param root Path of the root of the folder
      */
@@ -88,6 +100,10 @@ signals:
      *  of the contained files is changed. */
     void pathChanged(const QString &path);
 
+    /** Emitted once per batch of changes, after pathChanged() was
+     *  emitted for each of the paths. */
+    void pathsChanged(const QSet<QString> &paths);
+
     /**
      * Emitted if some notifications were lost.
      *
@@ -105,24 +121,35 @@ signals:
     void becameUnreliable(const QString &message);
 
 protected slots:
-    // called from the implementations to indicate a change in path
+    // called from the implementations to indicate a change in path,
+    // the contents of a directory path are reported as well
     void changeDetected(const QString &path);
     void changeDetected(const QStringList &paths);
 
 private slots:
     void startNotificationTestWhenReady();
+    void flushChanges();
 
 protected:
     QHash<QString, int> _pendingPathes;
 
 private:
+    /// How long notifications are collected before they are reported
+    static constexpr int coalescingIntervalMsec = 200;
+
     QScopedPointer<FolderWatcherPrivate> _d;
-    QElapsedTimer _timer;
-    QSet<QString> _lastPaths;
-    Folder *_folder;
+    IgnoreCheck _ignoreCheck;
     bool _isReliable = true;
 
-    void appendSubPaths(QDir dir, QStringList& subPaths);
+    /// Paths waiting to be reported, the value tells whether a directory's contents are included
+    QHash<QString, bool> _pendingChanges;
+    QTimer _flushTimer;
+    bool _expansionRunning = false;
+
+    void queueChanges(const QStringList &paths, bool withContents);
+    void reportChanges(const QStringList &paths);
+
+    static void appendSubPaths(QDir dir, QStringList& subPaths);
 
     /** Path of the expected test notification */
     QString _testNotificationPath;
@@ -15,14 +15,16 @@
 #include "config.h"
 
 #include <sys/inotify.h>
+#include <sys/ioctl.h>
 
-#include "folder.h"
 #include "folderwatcher_linux.h"
 
 #include <cerrno>
 #include <QStringList>
 #include <QObject>
+#include <QSet>
 #include <QVarLengthArray>
+#include <QVector>
 
 namespace OCC {
 
@@ -133,7 +135,14 @@ void FolderWatcherPrivate::slotReceivedNotification(int fd)
     struct inotify_event *event = nullptr;
     size_t i = 0;
     int error = 0;
-    QVarLengthArray<char, 2048> buffer(2048);
+
+    // Read everything that is queued at once: a burst of events is then
+    // handled as a single batch instead of one notification per 2 KiB.
+    int available = 0;
+    if (ioctl(fd, FIONREAD, &available) < 0 || available < 2048) {
+        available = 2048;
+    }
+    QVarLengthArray<char, 2048> buffer(available);
 
     len = read(fd, buffer.data(), buffer.size());
     error = errno;
@@ -155,6 +164,13 @@ void FolderWatcherPrivate::slotReceivedNotification(int fd)
         error = errno;
     }
 
+    QStringList changedPaths;
+    QSet<QString> seenPaths;
+    QStringList newDirectories;
+    // Directories moved away in this batch, by move cookie, until the
+    // matching IN_MOVED_TO shows up
+    QHash<uint32_t, QString> movedFromDirectories;
+
     // iterate events in buffer
     unsigned int ulen = len;
     for (i = 0; i + sizeof(inotify_event) < ulen; i += sizeof(inotify_event) + (event ? event->len : 0)) {
@@ -177,17 +193,53 @@ void FolderWatcherPrivate::slotReceivedNotification(int fd)
             continue;
         }
         const QString p = _watchToPath[event->wd] + '/' + fileName;
-        _parent->changeDetected(p);
+        const bool isDirectory = event->mask & IN_ISDIR;
+
+        if (isDirectory && (event->mask & (IN_MOVED_TO | IN_CREATE))) {
+            // the contents of a new directory are reported too
+            newDirectories.append(p);
+        } else if (!seenPaths.contains(p)) {
+            seenPaths.insert(p);
+            changedPaths.append(p);
+        }
 
-        if ((event->mask & (IN_MOVED_TO | IN_CREATE))
-            && QFileInfo(p).isDir()
-            && !_parent->pathIsIgnored(p)) {
-            slotAddFolderRecursive(p);
+        if (!isDirectory) {
+            continue;
         }
-        if (event->mask & (IN_MOVED_FROM | IN_DELETE)) {
+        if (event->mask & IN_MOVED_FROM) {
+            movedFromDirectories.insert(event->cookie, p);
+        } else if (event->mask & IN_MOVED_TO) {
+            const QString from = movedFromDirectories.take(event->cookie);
+            if (!from.isEmpty() && !_parent->pathIsIgnored(p)) {
+                renameFoldersBelow(from, p);
+            } else {
+                if (!from.isEmpty()) {
+                    removeFoldersBelow(from);
+                }
+                if (!_parent->pathIsIgnored(p)) {
+                    slotAddFolderRecursive(p);
+                }
+            }
+        } else if (event->mask & IN_CREATE) {
+            if (!_parent->pathIsIgnored(p)) {
+                slotAddFolderRecursive(p);
+            }
+        } else if (event->mask & IN_DELETE) {
             removeFoldersBelow(p);
         }
     }
+
+    // Directories that were moved out of the watched tree
+    for (const auto &from : qAsConst(movedFromDirectories)) {
+        removeFoldersBelow(from);
+    }
+
+    for (const auto &directory : qAsConst(newDirectories)) {
+        _parent->changeDetected(directory);
+    }
+    if (!changedPaths.isEmpty()) {
+        _parent->changeDetected(changedPaths);
+    }
 }
 
 void FolderWatcherPrivate::removeFoldersBelow(const QString &path)
@@ -217,4 +269,38 @@ void FolderWatcherPrivate::removeFoldersBelow(const QString &path)
     }
 }
 
+void FolderWatcherPrivate::renameFoldersBelow(const QString &from, const QString &to)
+{
+    auto it = _pathToWatch.find(from);
+    if (it == _pathToWatch.end()) {
+        slotAddFolderRecursive(to);
+        return;
+    }
+
+    // A directory that is replaced by the move is gone
+    removeFoldersBelow(to);
+
+    // The watches follow the moved inodes, only the paths change
+    QString fromSlash = from + '/';
+    QVector<QPair<QString, int>> moved;
+    while (it != _pathToWatch.end()) {
+        auto itPath = it.key();
+        if (!itPath.startsWith(from))
+            break;
+        if (itPath != from && !itPath.startsWith(fromSlash)) {
+            // order is 'foo', 'foo bar', 'foo/bar'
+            ++it;
+            continue;
+        }
+        moved.append(qMakePair(itPath, it.value()));
+        it = _pathToWatch.erase(it);
+    }
+    for (const auto &entry : qAsConst(moved)) {
+        const QString newPath = to + entry.first.mid(from.size());
+        _pathToWatch.insert(newPath, entry.second);
+        _watchToPath.insert(entry.second, newPath);
+    }
+    qCDebug(lcFolderWatcher) << "Moved" << moved.size() << "watches from" << from << "to" << to;
+}
+
 } // ns mirall
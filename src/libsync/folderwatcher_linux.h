@@ -29,7 +29,7 @@ namespace OCC {
 
 /**
  * @brief Linux (inotify) API implementation of FolderWatcher
- * @ingroup gui
+ * @ingroup libsync
  */
 class FolderWatcherPrivate : public QObject
 {
@@ -52,6 +52,8 @@ protected:
     bool findFoldersBelow(const QDir &dir, QStringList &fullList);
     void inotifyRegisterPath(const QString &path);
     void removeFoldersBelow(const QString &path);
+    /// Keeps the watches of a renamed directory and updates their paths
+    void renameFoldersBelow(const QString &from, const QString &to);
 
 private:
     FolderWatcher *_parent;
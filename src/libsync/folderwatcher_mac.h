@@ -25,7 +25,7 @@ namespace OCC {
 
 /**
  * @brief Mac OS X API implementation of FolderWatcher
- * @ingroup gui
+ * @ingroup libsync
  */
 class FolderWatcherPrivate
 {
@@ -25,7 +25,7 @@ class FolderWatcher;
 
 /**
  * @brief The WatcherThread class
- * @ingroup gui
+ * @ingroup libsync
  */
 class WatcherThread : public QThread
 {
@@ -66,7 +66,7 @@ private:
 
 /**
  * @brief Windows implementation of FolderWatcher
- * @ingroup gui
+ * @ingroup libsync
  */
 class FolderWatcherPrivate : public QObject
 {
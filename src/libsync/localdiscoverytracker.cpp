@@ -30,6 +30,12 @@ void LocalDiscoveryTracker::addTouchedPath(const QString &relativePath)
     _localDiscoveryPaths.insert(relativePath);
 }
 
+void LocalDiscoveryTracker::addTouchedPathForRunningSync(const QString &relativePath)
+{
+    qCDebug(lcLocalDiscoveryTracker) << "inserted touched for running sync" << relativePath;
+    _previousLocalDiscoveryPaths.insert(relativePath);
+}
+
 void LocalDiscoveryTracker::startSyncFullDiscovery()
 {
     _localDiscoveryPaths.clear();
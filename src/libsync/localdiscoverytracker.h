@@ -59,6 +59,13 @@ public:
      */
     void addTouchedPath(const QString &relativePath);
 
+    /** Adds a touched path that the currently running sync will still discover.
+     *
+     * See SyncEngine::addLocalDiscoveryPath(). The path is treated like the ones
+     * the sync was started with: forgotten on success, retried on failure.
+     */
+    void addTouchedPathForRunningSync(const QString &relativePath);
+
     /** Call when a sync run starts that rediscovers all local files */
     void startSyncFullDiscovery();
 
@@ -0,0 +1,91 @@
+/*
+ * Copyright (C) by Nextcloud GmbH
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ */
+
+#include "localioexecutor.h"
+
+#include <QLoggingCategory>
+#include <QRunnable>
+
+namespace OCC {
+
+Q_LOGGING_CATEGORY(lcLocalIoExecutor, "nextcloud.sync.localioexecutor", QtInfoMsg)
+
+LocalIoExecutor::LocalIoExecutor(QObject *parent)
+    : QObject(parent)
+{
+    // Local disks don't gain from many parallel operations, network mounts
+    // gain a little; keep it bounded either way
+    _pool.setMaxThreadCount(4);
+}
+
+LocalIoExecutor::~LocalIoExecutor()
+{
+    _queues.clear();
+    _pool.waitForDone();
+}
+
+QString LocalIoExecutor::directoryKey(const QString &path)
+{
+    const auto slash = path.lastIndexOf(QLatin1Char('/'));
+    return slash < 0 ? QString() : path.left(slash);
+}
+
+void LocalIoExecutor::enqueue(const QString &key, QObject *context, std::function<void()> operation, std::function<void()> callback)
+{
+    auto &queue = _queues[key];
+    queue.push_back(Task { context, std::move(operation), std::move(callback) });
+    if (queue.size() == 1) {
+        startNext(key);
+    }
+}
+
+void LocalIoExecutor::startNext(const QString &key)
+{
+    auto it = _queues.find(key);
+    if (it == _queues.end() || it->empty()) {
+        return;
+    }
+
+    auto operation = it->front().operation;
+    // The executor waits for its workers when it is destroyed, so it is
+    // alive here; the queued call is dropped if it is gone by then
+    _pool.start(QRunnable::create([this, operation, key] {
+        operation();
+        QMetaObject::invokeMethod(this, [this, key] { taskFinished(key); }, Qt::QueuedConnection);
+    }));
+}
+
+void LocalIoExecutor::taskFinished(const QString &key)
+{
+    auto it = _queues.find(key);
+    if (it == _queues.end() || it->empty()) {
+        return;
+    }
+
+    auto task = std::move(it->front());
+    it->pop_front();
+    if (it->empty()) {
+        _queues.erase(it);
+    } else {
+        startNext(key);
+    }
+
+    if (task.context) {
+        task.callback();
+    } else {
+        qCDebug(lcLocalIoExecutor) << "Context of a finished operation is gone, dropping the result in" << key;
+    }
+}
+
+}
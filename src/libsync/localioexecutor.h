@@ -0,0 +1,89 @@
+/*
+ * Copyright (C) by Nextcloud GmbH
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ */
+
+#pragma once
+
+#include "owncloudlib.h"
+
+#include <QHash>
+#include <QObject>
+#include <QPointer>
+#include <QString>
+#include <QThreadPool>
+
+#include <deque>
+#include <functional>
+#include <memory>
+
+namespace OCC {
+
+/**
+ * @brief Runs local file system operations of the propagation off the main thread
+ * @ingroup libsync
+ *
+ * A rename or a remove on a slow or network mounted disk would otherwise
+ * block the network job scheduling and the user interface.
+ *
+ * Operations are posted with a key, usually the directory they work in.
+ * Operations with the same key run one after the other in the order they
+ * were posted, operations with different keys run in parallel on a bounded
+ * thread pool.
+ *
+ * The callback gets the result of the operation on the thread of the
+ * executor, unless the context object was deleted in the meantime. The
+ * operation itself must not touch the context: it runs on a worker thread.
+ */
+class OWNCLOUDSYNC_EXPORT LocalIoExecutor : public QObject
+{
+    Q_OBJECT
+public:
+    explicit LocalIoExecutor(QObject *parent = nullptr);
+
+    /// Waits for the running operations, the pending ones are dropped
+    ~LocalIoExecutor() override;
+
+    void setMaxThreadCount(int count) { _pool.setMaxThreadCount(count); }
+
+    template <typename Operation, typename Callback>
+    void post(const QString &key, QObject *context, Operation operation, Callback callback)
+    {
+        using Result = decltype(operation());
+        auto result = std::make_shared<Result>();
+        enqueue(key, context,
+            [operation, result]() mutable { *result = operation(); },
+            [callback, result]() mutable { callback(std::move(*result)); });
+    }
+
+    /// The directory of a path, the usual key for post()
+    static QString directoryKey(const QString &path);
+
+private:
+    struct Task
+    {
+        QPointer<QObject> context;
+        std::function<void()> operation;
+        std::function<void()> callback;
+    };
+
+    void enqueue(const QString &key, QObject *context, std::function<void()> operation, std::function<void()> callback);
+    void startNext(const QString &key);
+    void taskFinished(const QString &key);
+
+    QThreadPool _pool;
+
+    /// Per key, the running task is the first one
+    QHash<QString, std::deque<Task>> _queues;
+};
+
+}
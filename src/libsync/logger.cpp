@@ -13,6 +13,7 @@
  */
 
 #include "logger.h"
+#include "asynclogwriter.h"
 
 #include "config.h"
 
@@ -21,6 +22,7 @@
 #include <QStringList>
 #include <QtGlobal>
 #include <QTextCodec>
+#include <QtConcurrent>
 #include <qmetaobject.h>
 
 #include <iostream>
@@ -62,6 +64,9 @@ Logger::~Logger()
 #ifndef NO_MSG_HANDLER
     qInstallMessageHandler(nullptr);
 #endif
+    if (_asyncWriter) {
+        _asyncWriter->stop();
+    }
 }
 
 
@@ -113,6 +118,15 @@ void Logger::doLog(QtMsgType type, const QMessageLogContext &ctx, const QString
         OutputDebugString(msgW.c_str());
     }
 #endif
+    if (_asyncWriter && type != QtFatalMsg) {
+        _asyncWriter->enqueue(msg);
+        emit logWindowLog(msg);
+        return;
+    }
+    if (_asyncWriter) {
+        // Get everything queued so far into the file before the fatal message
+        _asyncWriter->stop();
+    }
     {
         QMutexLocker lock(&_mutex);
         _crashLogIndex = (_crashLogIndex + 1) % CrashLogSize;
@@ -133,6 +147,22 @@ void Logger::doLog(QtMsgType type, const QMessageLogContext &ctx, const QString
     emit logWindowLog(msg);
 }
 
+void Logger::writeRecords(const QVector<QString> &records)
+{
+    QMutexLocker lock(&_mutex);
+    for (const auto &record : records) {
+        _crashLogIndex = (_crashLogIndex + 1) % CrashLogSize;
+        _crashLog[_crashLogIndex] = record;
+        if (_logstream) {
+            (*_logstream) << record << QLatin1Char('\n');
+        }
+    }
+    // One flush per batch instead of one per message
+    if (_logstream) {
+        _logstream->flush();
+    }
+}
+
 void Logger::close()
 {
     dumpCrashLog();
@@ -151,6 +181,10 @@ QString Logger::logFile() const
 
 void Logger::setLogFile(const QString &name)
 {
+    if (_asyncWriter) {
+        // Pending records still belong to the previous file
+        _asyncWriter->drain();
+    }
     QMutexLocker locker(&_mutex);
     if (_logstream) {
         _logstream.reset(nullptr);
@@ -202,6 +236,23 @@ void Logger::setLogFlush(bool flush)
     _doFileFlush = flush;
 }
 
+void Logger::setLogAsync(bool async)
+{
+    if (async == logAsync()) {
+        return;
+    }
+    if (async) {
+        _asyncWriter = std::make_unique<AsyncLogWriter>([this](const QVector<QString> &records) {
+            writeRecords(records);
+        });
+        _asyncWriter->start(QThread::LowPriority);
+    } else {
+        // Stop before resetting so every queued record is written
+        _asyncWriter->stop();
+        _asyncWriter.reset();
+    }
+}
+
 void Logger::setLogDebug(bool debug)
 {
     const QSet<QString> rules = {debug ? QStringLiteral("nextcloud.*.debug=true") : QString()};
@@ -331,12 +382,15 @@ void Logger::enterNextLogFile()
         if (logToCompress.isEmpty() && files.size() > 0 && !files.last().endsWith(".gz"))
             logToCompress = dir.absoluteFilePath(files.last());
         if (!logToCompress.isEmpty()) {
-            QString compressedName = logToCompress + ".gz";
-            if (compressLog(logToCompress, compressedName)) {
-                QFile::remove(logToCompress);
-            } else {
-                QFile::remove(compressedName);
-            }
+            // Compressing a big debug log takes a while, don't block the caller on it
+            QtConcurrent::run([logToCompress] {
+                QString compressedName = logToCompress + ".gz";
+                if (compressLog(logToCompress, compressedName)) {
+                    QFile::remove(logToCompress);
+                } else {
+                    QFile::remove(compressedName);
+                }
+            });
         }
     }
 }
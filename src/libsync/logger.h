@@ -22,11 +22,15 @@
 #include <QTextStream>
 #include <qmutex.h>
 
+#include <memory>
+
 #include "common/utility.h"
 #include "owncloudlib.h"
 
 namespace OCC {
 
+class AsyncLogWriter;
+
 /**
  * @brief The Logger class
  * @ingroup libsync
@@ -55,6 +59,15 @@ public:
 
     void setLogFlush(bool flush);
 
+    /** Hand formatted messages to a background writer thread instead of
+     * writing them to the log file from the logging thread.
+     *
+     * Producers only enqueue; the writer batches file writes and flushes.
+     * Fatal messages are still written synchronously.
+     */
+    bool logAsync() const { return _asyncWriter != nullptr; }
+    void setLogAsync(bool async);
+
     bool logDebug() const { return _logDebug; }
     void setLogDebug(bool debug);
 
@@ -98,6 +111,7 @@ private:
 
     void close();
     void dumpCrashLog();
+    void writeRecords(const QVector<QString> &records);
 
     QFile _logFile;
     bool _doFileFlush = false;
@@ -110,6 +124,7 @@ private:
     QSet<QString> _logRules;
     QVector<QString> _crashLog;
     int _crashLogIndex = 0;
+    std::unique_ptr<AsyncLogWriter> _asyncWriter;
 };
 
 } // namespace OCC
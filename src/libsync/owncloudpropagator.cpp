@@ -18,10 +18,13 @@
 #include "common/syncjournalfilerecord.h"
 #include "propagatedownload.h"
 #include "propagateupload.h"
+#include "propagateuploadencrypted.h"
 #include "propagateremotedelete.h"
 #include "propagateremotemove.h"
 #include "propagateremotemkdir.h"
 #include "bulkpropagatorjob.h"
+#include "bulkdownloadpropagatorjob.h"
+#include "bulkdeletemovepropagatorjob.h"
 #include "propagatorjobs.h"
 #include "filesystem.h"
 #include "common/utility.h"
@@ -89,7 +92,10 @@ int OwncloudPropagator::maximumActiveTransferJob()
         // disable parallelism when there is a network limit.
         return 1;
     }
-    return qMin(3, qCeil(_syncOptions._parallelNetworkJobs / 2.));
+    // Over HTTP/2 small transfers share one connection, but large uploads
+    // still take one of the six connections Qt opens per host
+    const int maximum = _account->isHttp2Supported() ? 6 : 3;
+    return qMin(maximum, qCeil(_syncOptions._parallelNetworkJobs / 2.));
 }
 
 /* The maximum number of active jobs in parallel  */
@@ -411,6 +417,7 @@ void OwncloudPropagator::resetDelayedUploadTasks()
 {
     _scheduleDelayedTasks = false;
     _delayedTasks.clear();
+    _delayedRemoteChanges.clear();
 }
 
 void OwncloudPropagator::adjustDeletedFoldersWithNewChildren(SyncFileItemVector &items)
@@ -478,8 +485,10 @@ qint64 OwncloudPropagator::smallFileSize()
     return smallFileSize;
 }
 
-void OwncloudPropagator::start(SyncFileItemVector &&items)
+void OwncloudPropagator::start(SyncFileItemVector &&syncedItems)
 {
+    // Don't leave the caller holding on to every item until the end of the sync
+    auto items = std::move(syncedItems);
     Q_ASSERT(std::is_sorted(items.begin(), items.end()));
 
     /* This builds all the jobs needed for the propagation.
@@ -507,12 +516,6 @@ void OwncloudPropagator::start(SyncFileItemVector &&items)
             items.end());
     }
 
-    QStringList files;
-
-    for (const auto &item : items) {
-        files.push_back(item->_file);
-    }
-
     // process each item that is new and is a directory and make sure every parent in its tree has the instruction NEW instead of REMOVE
     adjustDeletedFoldersWithNewChildren(items);
 
@@ -590,7 +593,7 @@ void OwncloudPropagator::start(SyncFileItemVector &&items)
         _rootJob->_dirDeletionJobs.appendJob(it);
     }
 
-    connect(_rootJob.data(), &PropagatorJob::finished, this, &OwncloudPropagator::emitFinished);
+    connect(_rootJob.data(), &PropagatorJob::finished, this, &OwncloudPropagator::slotRootJobFinished);
 
     _jobScheduled = false;
     scheduleNextJob();
@@ -654,6 +657,8 @@ void OwncloudPropagator::startFilePropagation(const SyncFileItemPtr &item,
             directoriesToRemove.prepend(job);
         }
         removedDirectory = item->_file + "/";
+    } else if (isDelayedRemoteChangeItem(item)) {
+        _delayedRemoteChanges.push_back(item);
     } else {
         directories.top().second->appendTask(item);
     }
@@ -676,6 +681,15 @@ void OwncloudPropagator::setSyncOptions(const SyncOptions &syncOptions)
     _chunkSize = syncOptions._initialChunkSize;
 }
 
+void OwncloudPropagator::setParallelNetworkJobs(int jobs)
+{
+    _syncOptions._parallelNetworkJobs = jobs;
+    if (_rootJob) {
+        // More jobs may be allowed now
+        scheduleNextJob();
+    }
+}
+
 bool OwncloudPropagator::localFileNameClash(const QString &relFile)
 {
     const QString file(_localDir + relFile);
@@ -803,6 +817,8 @@ void OwncloudPropagator::scheduleNextJobImpl()
             }
         }
     }
+
+    releaseIdleEncryptedUploadBatches();
 }
 
 void OwncloudPropagator::reportProgress(const SyncFileItem &item, qint64 bytes)
@@ -939,6 +955,41 @@ bool OwncloudPropagator::isDelayedUploadItem(const SyncFileItemPtr &item) const
     return account()->capabilities().bulkUpload() && !_scheduleDelayedTasks && !item->_isEncrypted && _syncOptions._minChunkSize > item->_size && !isInBulkUploadBlackList(item->_file);
 }
 
+bool OwncloudPropagator::bulkDownloadAvailable() const
+{
+    static const auto bulkDownloadEnv = qgetenv("OWNCLOUD_BULK_DOWNLOAD");
+    if (bulkDownloadEnv == "0" || _bulkDownloadUnsupported) {
+        return false;
+    }
+    return bulkDownloadEnv == "1" || account()->serverVersionInt() >= Account::makeServerVersion(30, 0, 0);
+}
+
+bool OwncloudPropagator::isBulkDownloadItem(const SyncFileItemPtr &item) const
+{
+    return item->_direction == SyncFileItem::Down
+        && (item->_instruction == CSYNC_INSTRUCTION_NEW || item->_instruction == CSYNC_INSTRUCTION_SYNC)
+        && item->_type == ItemTypeFile
+        && !item->_isEncrypted
+        && item->_file == item->destination()
+        && item->_size > 0 && item->_size < _syncOptions._minChunkSize;
+}
+
+bool OwncloudPropagator::isDelayedRemoteChangeItem(const SyncFileItemPtr &item) const
+{
+    static const auto bulkDeleteMoveEnv = qgetenv("OWNCLOUD_BULK_DELETE_MOVE");
+    return bulkDeleteMoveEnv != "0"
+        && item->_direction == SyncFileItem::Up
+        && (item->_instruction == CSYNC_INSTRUCTION_REMOVE || item->_instruction == CSYNC_INSTRUCTION_RENAME)
+        && !item->isDirectory()
+        && !item->_isEncrypted
+        && item->_encryptedFileName.isEmpty();
+}
+
+void OwncloudPropagator::clearDelayedRemoteChanges()
+{
+    _delayedRemoteChanges.clear();
+}
+
 void OwncloudPropagator::setScheduleDelayedTasks(bool active)
 {
     _scheduleDelayedTasks = active;
@@ -966,6 +1017,66 @@ bool OwncloudPropagator::isInBulkUploadBlackList(const QString &file) const
     return _bulkUploadBlackList.contains(file);
 }
 
+static QString parentPathOf(const QString &file)
+{
+    const auto slashPosition = file.lastIndexOf(QLatin1Char('/'));
+    return slashPosition >= 0 ? file.left(slashPosition) : QString();
+}
+
+EncryptedFolderUploadBatch *OwncloudPropagator::encryptedUploadBatch(const QString &file, const QString &remoteParentPath)
+{
+    auto &batch = _encryptedUploadBatches[parentPathOf(file)];
+    if (!batch || !batch->acceptsMembers()) {
+        if (batch) {
+            // Unlocks once the uploads that joined it are done
+            batch->release();
+        }
+        batch = new EncryptedFolderUploadBatch(this, remoteParentPath, this);
+    }
+    return batch;
+}
+
+void OwncloudPropagator::releaseIdleEncryptedUploadBatches()
+{
+    for (const auto &batch : qAsConst(_encryptedUploadBatches)) {
+        if (batch && batch->isIdle()) {
+            batch->release();
+        }
+    }
+}
+
+void OwncloudPropagator::abortEncryptedUploadBatches()
+{
+    for (const auto &batch : qAsConst(_encryptedUploadBatches)) {
+        if (batch) {
+            batch->abort();
+        }
+    }
+}
+
+void OwncloudPropagator::slotRootJobFinished(SyncFileItem::Status status)
+{
+    _rootJobStatus = status;
+    for (const auto &batch : qAsConst(_encryptedUploadBatches)) {
+        if (batch && batch->holdsLock()) {
+            connect(batch, &EncryptedFolderUploadBatch::finished, this, &OwncloudPropagator::slotEncryptedUploadBatchFinished, Qt::UniqueConnection);
+            connect(batch, &EncryptedFolderUploadBatch::error, this, &OwncloudPropagator::slotEncryptedUploadBatchFinished, Qt::UniqueConnection);
+            batch->release();
+        }
+    }
+    slotEncryptedUploadBatchFinished();
+}
+
+void OwncloudPropagator::slotEncryptedUploadBatchFinished()
+{
+    for (const auto &batch : qAsConst(_encryptedUploadBatches)) {
+        if (batch && batch->holdsLock()) {
+            return;
+        }
+    }
+    emitFinished(_rootJobStatus);
+}
+
 // ================================================================================
 
 PropagatorJob::PropagatorJob(OwncloudPropagator *propagator)
@@ -1162,9 +1273,50 @@ bool PropagateDirectory::scheduleSelfOrChild()
         return false;
     }
 
+    if (!_bulkDownloadsScheduled) {
+        _bulkDownloadsScheduled = true;
+        scheduleBulkDownloads();
+    }
+
     return _subJobs.scheduleSelfOrChild();
 }
 
+void PropagateDirectory::scheduleBulkDownloads()
+{
+    // Below that, the archive request doesn't save much over single downloads
+    constexpr auto bulkDownloadMinimumCount = 10;
+
+    if (!propagator()->bulkDownloadAvailable()) {
+        return;
+    }
+
+    QMap<QString, SyncFileItemVector> itemsByDirectory;
+    for (const auto &item : qAsConst(_subJobs._tasksToDo)) {
+        if (propagator()->isBulkDownloadItem(item)) {
+            itemsByDirectory[item->_file.left(qMax(0, item->_file.lastIndexOf(QLatin1Char('/'))))].append(item);
+        }
+    }
+
+    QSet<SyncFileItemPtr> heldBackItems;
+    for (auto it = itemsByDirectory.cbegin(); it != itemsByDirectory.cend(); ++it) {
+        if (it.value().size() < bulkDownloadMinimumCount) {
+            continue;
+        }
+        // The job runs the downloads of its items once the archive is done
+        for (const auto &item : it.value()) {
+            heldBackItems.insert(item);
+        }
+        auto job = new BulkDownloadPropagatorJob(propagator(), it.key(), it.value());
+        job->setAssociatedComposite(&_subJobs);
+        _subJobs._jobsToDo.prepend(job);
+    }
+
+    auto &tasks = _subJobs._tasksToDo;
+    tasks.erase(std::remove_if(tasks.begin(), tasks.end(), [&heldBackItems](const SyncFileItemPtr &item) {
+        return heldBackItems.contains(item);
+    }), tasks.end());
+}
+
 void PropagateDirectory::slotFirstJobFinished(SyncFileItem::Status status)
 {
     _firstJob.take()->deleteLater();
@@ -1285,6 +1437,7 @@ bool PropagateRootDirectory::scheduleSelfOrChild()
         return false;
     }
 
+    // This also puts the archive downloads of the files at the root in front
     if (PropagateDirectory::scheduleSelfOrChild() && propagator()->delayedTasks().empty()) {
         return true;
     }
@@ -1294,7 +1447,7 @@ bool PropagateRootDirectory::scheduleSelfOrChild()
         return false;
     }
 
-    if (!propagator()->delayedTasks().empty()) {
+    if (!propagator()->delayedTasks().empty() || !propagator()->delayedRemoteChanges().empty()) {
         return scheduleDelayedJobs();
     }
 
@@ -1305,7 +1458,7 @@ void PropagateRootDirectory::slotSubJobsFinished(SyncFileItem::Status status)
 {
     qCInfo(lcRootDirectory()) << status << "slotSubJobsFinished" << _state << "pending uploads" << propagator()->delayedTasks().size() << "subjobs state" << _subJobs._state;
 
-    if (!propagator()->delayedTasks().empty()) {
+    if (!propagator()->delayedTasks().empty() || !propagator()->delayedRemoteChanges().empty()) {
         scheduleDelayedJobs();
         return;
     }
@@ -1337,9 +1490,17 @@ bool PropagateRootDirectory::scheduleDelayedJobs()
 {
     qCInfo(lcPropagator) << "PropagateRootDirectory::scheduleDelayedJobs";
     propagator()->setScheduleDelayedTasks(true);
-    auto bulkPropagatorJob = std::make_unique<BulkPropagatorJob>(propagator(), propagator()->delayedTasks());
-    propagator()->clearDelayedTasks();
-    _subJobs.appendJob(bulkPropagatorJob.release());
+    // Deletes and moves go first, uploads may reuse the names they free
+    if (!propagator()->delayedRemoteChanges().empty()) {
+        auto bulkDeleteMoveJob = std::make_unique<BulkDeleteMovePropagatorJob>(propagator(), propagator()->delayedRemoteChanges());
+        propagator()->clearDelayedRemoteChanges();
+        _subJobs.appendJob(bulkDeleteMoveJob.release());
+    }
+    if (!propagator()->delayedTasks().empty()) {
+        auto bulkPropagatorJob = std::make_unique<BulkPropagatorJob>(propagator(), propagator()->delayedTasks());
+        propagator()->clearDelayedTasks();
+        _subJobs.appendJob(bulkPropagatorJob.release());
+    }
     _subJobs._state = Running;
     return _subJobs.scheduleSelfOrChild();
 }
@@ -28,6 +28,7 @@
 #include "syncfileitem.h"
 #include "common/syncjournaldb.h"
 #include "bandwidthmanager.h"
+#include "localioexecutor.h"
 #include "accountfwd.h"
 #include "syncoptions.h"
 
@@ -352,6 +353,11 @@ private slots:
     void slotFirstJobFinished(SyncFileItem::Status status);
     virtual void slotSubJobsFinished(SyncFileItem::Status status);
 
+private:
+    /** Hands the small downloads of this directory, the root included, to an archive download that runs them once it is done */
+    void scheduleBulkDownloads();
+
+    bool _bulkDownloadsScheduled = false;
 };
 
 /**
@@ -412,6 +418,7 @@ public:
 };
 
 class PropagateUploadFileCommon;
+class EncryptedFolderUploadBatch;
 
 class OWNCLOUDSYNC_EXPORT OwncloudPropagator : public QObject
 {
@@ -439,6 +446,11 @@ public:
 
     ~OwncloudPropagator() override;
 
+    /** Builds the job tree and starts propagating
+     *
+     * Takes ownership of the items: afterwards only the jobs reference them,
+     * so every item is freed as soon as its job is done.
+     */
     void start(SyncFileItemVector &&_syncedItems);
 
     void startDirectoryPropagation(const SyncFileItemPtr &item,
@@ -455,11 +467,16 @@ public:
 
     const SyncOptions &syncOptions() const;
     void setSyncOptions(const SyncOptions &syncOptions);
+    /** Changes how many network jobs may run at once, also while propagating */
+    void setParallelNetworkJobs(int jobs);
 
     int _downloadLimit = 0;
     int _uploadLimit = 0;
     BandwidthManager _bandwidthManager;
 
+    /// Local file system operations of the jobs run here, off the main thread
+    LocalIoExecutor _localIoExecutor;
+
     bool _abortRequested = false;
 
     /** The list of currently active jobs.
@@ -473,6 +490,9 @@ public:
     /** We detected that another sync is required after this one */
     bool _anotherSyncNeeded;
 
+    /** The server did not answer an archive download request with an archive */
+    bool _bulkDownloadUnsupported = false;
+
     /** Per-folder quota guesses.
      *
      * This starts out empty. When an upload in a folder fails due to insufficent
@@ -538,6 +558,7 @@ public:
     {
         if (_abortRequested)
             return;
+        abortEncryptedUploadBatches();
         if (_rootJob) {
             // Connect to abortFinished  which signals that abort has been asynchronously finished
             connect(_rootJob.data(), &PropagateDirectory::abortFinished, this, &OwncloudPropagator::emitFinished);
@@ -604,6 +625,29 @@ public:
 
     Q_REQUIRED_RESULT bool isDelayedUploadItem(const SyncFileItemPtr &item) const;
 
+    /** Whether small downloads can be fetched as a tar archive of their folder
+     *
+     * Available with servers from version 30 on, OWNCLOUD_BULK_DOWNLOAD=0
+     * disables it and OWNCLOUD_BULK_DOWNLOAD=1 forces it.
+     */
+    Q_REQUIRED_RESULT bool bulkDownloadAvailable() const;
+
+    /** Whether the item is a small download that can be part of an archive */
+    Q_REQUIRED_RESULT bool isBulkDownloadItem(const SyncFileItemPtr &item) const;
+
+    /** Whether the item is a remote file delete or move that is batched with the others
+     *
+     * OWNCLOUD_BULK_DELETE_MOVE=0 propagates each of them within its folder instead.
+     */
+    Q_REQUIRED_RESULT bool isDelayedRemoteChangeItem(const SyncFileItemPtr &item) const;
+
+    Q_REQUIRED_RESULT const std::deque<SyncFileItemPtr>& delayedRemoteChanges() const
+    {
+        return _delayedRemoteChanges;
+    }
+
+    void clearDelayedRemoteChanges();
+
     Q_REQUIRED_RESULT const std::deque<SyncFileItemPtr>& delayedTasks() const
     {
         return _delayedTasks;
@@ -619,6 +663,13 @@ public:
 
     bool isInBulkUploadBlackList(const QString &file) const;
 
+    /** The shared lock and metadata of the encrypted parent folder of @a file.
+     *
+     * Creates a new batch when there is none yet or the previous one doesn't
+     * take more uploads.
+     */
+    EncryptedFolderUploadBatch *encryptedUploadBatch(const QString &file, const QString &remoteParentPath);
+
 private slots:
 
     void abortTimeout()
@@ -638,6 +689,10 @@ private slots:
 
     void scheduleNextJobImpl();
 
+    /** Unlocks the encrypted folders that are still locked before finishing */
+    void slotRootJobFinished(SyncFileItem::Status status);
+    void slotEncryptedUploadBatchFinished();
+
 signals:
     void newItem(const SyncFileItemPtr &);
     void itemCompleted(const SyncFileItemPtr &);
@@ -667,6 +722,14 @@ private:
 
     static void adjustDeletedFoldersWithNewChildren(SyncFileItemVector &items);
 
+    /** Unlocks the folders of batches whose members are all done
+     *
+     * Called after scheduling: the jobs that could still join a batch
+     * are running by then, so the lock isn't kept for nothing.
+     */
+    void releaseIdleEncryptedUploadBatches();
+    void abortEncryptedUploadBatches();
+
     AccountPtr _account;
     QScopedPointer<PropagateRootDirectory> _rootJob;
     SyncOptions _syncOptions;
@@ -678,8 +741,13 @@ private:
     std::deque<SyncFileItemPtr> _delayedTasks;
     bool _scheduleDelayedTasks = false;
 
+    std::deque<SyncFileItemPtr> _delayedRemoteChanges;
+
     QSet<QString> &_bulkUploadBlackList;
 
+    QHash<QString, QPointer<EncryptedFolderUploadBatch>> _encryptedUploadBatches;
+    SyncFileItem::Status _rootJobStatus = SyncFileItem::NoStatus;
+
     static bool _allowDelayedUpload;
 };
 
@@ -32,6 +32,7 @@
 #include <QNetworkAccessManager>
 #include <QFileInfo>
 #include <QDir>
+#include <QtConcurrent>
 #include <cmath>
 
 #ifdef Q_OS_UNIX
@@ -43,6 +44,13 @@ namespace OCC {
 Q_LOGGING_CATEGORY(lcGetJob, "nextcloud.sync.networkjob.get", QtInfoMsg)
 Q_LOGGING_CATEGORY(lcPropagateDownload, "nextcloud.sync.propagator.download", QtInfoMsg)
 
+// If the hashes are collision safe and identical, we assume the content is too.
+static bool isCollisionSafeHash(const QByteArray &checksumHeader)
+{
+    return checksumHeader.startsWith("SHA")
+        || checksumHeader.startsWith("MD5:");
+}
+
 // Always coming in with forward slashes.
 // In csync_excluded_no_ctx we ignore all files with longer than 254 chars
 // This function also adds a dot at the beginning of the filename to hide the file on OS X and Linux
@@ -557,19 +565,13 @@ void PropagateDownloadFile::startAfterIsEncryptedIsChecked()
     // Maybe it's not a real conflict and no download is necessary!
     // If the hashes are collision safe and identical, we assume the content is too.
     // For weak checksums, we only do that if the mtimes are also identical.
-
-    const auto csync_is_collision_safe_hash = [](const QByteArray &checksum_header)
-    {
-        return checksum_header.startsWith("SHA")
-            || checksum_header.startsWith("MD5:");
-    };
     if (_item->_modtime <= 0) {
         qCWarning(lcPropagateDownload()) << "invalid modified time" << _item->_file << _item->_modtime;
     }
     if (_item->_instruction == CSYNC_INSTRUCTION_CONFLICT
         && _item->_size == _item->_previousSize
         && !_item->_checksumHeader.isEmpty()
-        && (csync_is_collision_safe_hash(_item->_checksumHeader)
+        && (isCollisionSafeHash(_item->_checksumHeader)
             || _item->_modtime == _item->_previousModtime)) {
         qCDebug(lcPropagateDownload) << _item->_file << "may not need download, computing checksum";
         auto computeChecksum = new ComputeChecksum(this);
@@ -587,7 +589,8 @@ void PropagateDownloadFile::startAfterIsEncryptedIsChecked()
 void PropagateDownloadFile::conflictChecksumComputed(const QByteArray &checksumType, const QByteArray &checksum)
 {
     propagator()->_activeJobList.removeOne(this);
-    if (makeChecksumHeader(checksumType, checksum) == _item->_checksumHeader) {
+    _localChecksumHeader = makeChecksumHeader(checksumType, checksum);
+    if (_localChecksumHeader == _item->_checksumHeader) {
         // No download necessary, just update fs and journal metadata
         qCDebug(lcPropagateDownload) << _item->_file << "remote and local checksum match";
 
@@ -1163,8 +1166,46 @@ void PropagateDownloadFile::downloadFinished()
     // Apply the remote permissions
     FileSystem::setFileReadOnlyWeak(_tmpFile.fileName(), !_item->_remotePerm.isNull() && !_item->_remotePerm.hasPermission(RemotePermissions::CanWrite));
 
-    bool isConflict = _item->_instruction == CSYNC_INSTRUCTION_CONFLICT
-        && (QFileInfo(fn).isDir() || !FileSystem::fileEquals(fn, _tmpFile.fileName()));
+    if (_item->_instruction != CSYNC_INSTRUCTION_CONFLICT) {
+        installDownloadedFile(false);
+        return;
+    }
+    if (QFileInfo(fn).isDir()) {
+        installDownloadedFile(true);
+        return;
+    }
+
+    // Compare the stored checksums before comparing the content: the local one was
+    // computed in start(), the downloaded one was validated or computed after the download.
+    if (!_localChecksumHeader.isEmpty() && isCollisionSafeHash(_localChecksumHeader)
+        && parseChecksumHeaderType(_localChecksumHeader) == parseChecksumHeaderType(_item->_checksumHeader)) {
+        installDownloadedFile(_localChecksumHeader != _item->_checksumHeader);
+        return;
+    }
+
+    // Reading both files can take a while, don't block the main thread with it
+    qCDebug(lcPropagateDownload) << _item->_file << "comparing the local and the downloaded content";
+    connect(&_conflictCompareWatcher, &QFutureWatcherBase::finished,
+        this, &PropagateDownloadFile::slotConflictContentCompared, Qt::UniqueConnection);
+    propagator()->_activeJobList.append(this);
+    const QString tmpFileName = _tmpFile.fileName();
+    _conflictCompareWatcher.setFuture(QtConcurrent::run([fn, tmpFileName] {
+        return FileSystem::fileEquals(fn, tmpFileName);
+    }));
+}
+
+void PropagateDownloadFile::slotConflictContentCompared()
+{
+    propagator()->_activeJobList.removeOne(this);
+    if (propagator()->_abortRequested)
+        return;
+    installDownloadedFile(!_conflictCompareWatcher.result());
+}
+
+void PropagateDownloadFile::installDownloadedFile(bool isConflict)
+{
+    const QString fn = propagator()->fullLocalPath(_item->_file);
+    bool previousFileExists = FileSystem::fileExists(fn);
     if (isConflict) {
         QString error;
         if (!propagator()->createConflict(_item, _associatedComposite, &error)) {
@@ -1180,42 +1221,65 @@ void PropagateDownloadFile::downloadFinished()
     // (except with the cfapi backend)
     const auto isVirtualDownload = _item->_type == ItemTypeVirtualFileDownload;
     const auto isCfApiVfs = vfs && vfs->mode() == Vfs::WindowsCfApi;
-    if (previousFileExists && (isCfApiVfs || !isVirtualDownload)) {
-        // Check whether the existing file has changed since the discovery
-        // phase by comparing size and mtime to the previous values. This
-        // is necessary to avoid overwriting user changes that happened between
-        // the discovery phase and now.
-        const qint64 expectedSize = _item->_previousSize;
-        const time_t expectedMtime = _item->_previousModtime;
-        if (!FileSystem::verifyFileUnchanged(fn, expectedSize, expectedMtime)) {
-            propagator()->_anotherSyncNeeded = true;
-            done(SyncFileItem::SoftError, tr("File has changed since discovery"));
-            return;
-        }
-    }
+    const bool verifyUnchanged = previousFileExists && (isCfApiVfs || !isVirtualDownload);
+    const qint64 expectedSize = _item->_previousSize;
+    const time_t expectedMtime = _item->_previousModtime;
+    const QString tmpFileName = _tmpFile.fileName();
 
-    QString error;
     emit propagator()->touchedFile(fn);
-    // The fileChanged() check is done above to generate better error messages.
-    if (!FileSystem::uncheckedRenameReplace(_tmpFile.fileName(), fn, &error)) {
+    propagator()->_activeJobList.append(this);
+    propagator()->_localIoExecutor.post(LocalIoExecutor::directoryKey(fn), this,
+        [fn, tmpFileName, verifyUnchanged, expectedSize, expectedMtime] {
+            InstallResult result;
+            // Check whether the existing file has changed since the discovery
+            // phase by comparing size and mtime to the previous values. This
+            // is necessary to avoid overwriting user changes that happened between
+            // the discovery phase and now.
+            if (verifyUnchanged && !FileSystem::verifyFileUnchanged(fn, expectedSize, expectedMtime)) {
+                result.changedSinceDiscovery = true;
+                return result;
+            }
+            // The fileChanged() check is done above to generate better error messages.
+            if (!FileSystem::uncheckedRenameReplace(tmpFileName, fn, &result.error)) {
+                result.locked = FileSystem::isFileLocked(fn);
+                return result;
+            }
+            result.installed = true;
+            FileSystem::setFileHidden(fn, false);
+
+            // Maybe we downloaded a newer version of the file than we thought we would...
+            // Get up to date information for the journal.
+            result.size = FileSystem::getSize(fn);
+            return result;
+        },
+        [this, isConflict](const InstallResult &result) { slotDownloadedFileInstalled(result, isConflict); });
+}
+
+void PropagateDownloadFile::slotDownloadedFileInstalled(const InstallResult &result, bool isConflict)
+{
+    propagator()->_activeJobList.removeOne(this);
+    const QString fn = propagator()->fullLocalPath(_item->_file);
+    if (result.changedSinceDiscovery) {
+        propagator()->_anotherSyncNeeded = true;
+        done(SyncFileItem::SoftError, tr("File has changed since discovery"));
+        return;
+    }
+    if (!result.installed) {
         qCWarning(lcPropagateDownload) << QString("Rename failed: %1 => %2").arg(_tmpFile.fileName()).arg(fn);
         // If the file is locked, we want to retry this sync when it
         // becomes available again, otherwise try again directly
-        if (FileSystem::isFileLocked(fn)) {
+        if (result.locked) {
             emit propagator()->seenLockedFile(fn);
         } else {
             propagator()->_anotherSyncNeeded = true;
         }
 
-        done(SyncFileItem::SoftError, error);
+        done(SyncFileItem::SoftError, result.error);
         return;
     }
 
-    FileSystem::setFileHidden(fn, false);
-
-    // Maybe we downloaded a newer version of the file than we thought we would...
-    // Get up to date information for the journal.
-    _item->_size = FileSystem::getSize(fn);
+    _item->_size = result.size;
+    const auto vfs = propagator()->syncOptions()._vfs;
 
     // Maybe what we downloaded was a conflict file? If so, set a conflict record.
     // (the data was prepared in slotGetFinished above)
@@ -21,6 +21,7 @@
 
 #include <QBuffer>
 #include <QFile>
+#include <QFutureWatcher>
 
 namespace OCC {
 class PropagateDownloadEncrypted;
@@ -231,6 +232,8 @@ private slots:
     /// Called when the download's checksum computation is done
     void contentChecksumComputed(const QByteArray &checksumType, const QByteArray &checksum);
     void downloadFinished();
+    /// Called when the local and the downloaded content of a conflict were compared
+    void slotConflictContentCompared();
     /// Called when it's time to update the db metadata
     void updateMetadata(bool isConflict);
 
@@ -244,6 +247,18 @@ private slots:
 private:
     void startAfterIsEncryptedIsChecked();
     void deleteExistingFolder();
+    struct InstallResult
+    {
+        bool installed = false;
+        bool changedSinceDiscovery = false;
+        bool locked = false;
+        QString error;
+        qint64 size = 0;
+    };
+
+    /// Moves the downloaded file in place, creating a conflict copy of the local file first if needed
+    void installDownloadedFile(bool isConflict);
+    void slotDownloadedFileInstalled(const InstallResult &result, bool isConflict);
 
     qint64 _resumeStart;
     qint64 _downloadProgress;
@@ -254,6 +269,10 @@ private:
     EncryptedFile _encryptedInfo;
     ConflictRecord _conflictRecord;
 
+    /// Checksum header of the local file, if it was computed for a conflict
+    QByteArray _localChecksumHeader;
+    QFutureWatcher<bool> _conflictCompareWatcher;
+
     QElapsedTimer _stopwatch;
 
     PropagateDownloadEncrypted *_downloadEncryptedHelper = nullptr;
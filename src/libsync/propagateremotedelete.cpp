@@ -113,7 +113,8 @@ void PropagateRemoteDelete::slotDeleteJobFinished()
         return;
     }
 
-    propagator()->_journal->deleteFileRecord(_item->_originalFile, _item->isDirectory());
+    // The record moved along if a parent was renamed during this sync
+    propagator()->_journal->deleteFileRecord(propagator()->adjustRenamedPath(_item->_originalFile), _item->isDirectory());
     propagator()->_journal->commit("Remote Remove");
 
     done(SyncFileItem::Success);
@@ -203,8 +203,10 @@ void PropagateRemoteMkdir::slotMkdir()
     _uploadEncryptedHelper = new PropagateUploadEncrypted(propagator(), remoteParentPath, _item, this);
     connect(_uploadEncryptedHelper, &PropagateUploadEncrypted::finalized,
       this, &PropagateRemoteMkdir::slotStartEncryptedMkcolJob);
-    connect(_uploadEncryptedHelper, &PropagateUploadEncrypted::error,
-      []{ qCDebug(lcPropagateRemoteMkdir) << "Error setting up encryption."; });
+    connect(_uploadEncryptedHelper, &PropagateUploadEncrypted::error, this, [this] {
+        qCDebug(lcPropagateRemoteMkdir) << "Error setting up encryption.";
+        done(SyncFileItem::NormalError, tr("Could not lock the encrypted folder or store its metadata."));
+    });
     _uploadEncryptedHelper->start();
 }
 
@@ -227,7 +229,7 @@ void PropagateRemoteMkdir::slotMkcolJobFinished()
 
     const auto jobPath = _job->path();
 
-    if (_uploadEncryptedHelper && _uploadEncryptedHelper->isFolderLocked() && !_uploadEncryptedHelper->isUnlockRunning()) {
+    if (_uploadEncryptedHelper && _uploadEncryptedHelper->isFolderLocked()) {
         // since we are done, we need to unlock a folder in case it was locked
         connect(_uploadEncryptedHelper, &PropagateUploadEncrypted::folderUnlocked, this, [this, err, jobHttpReasonPhraseString, jobPath]() {
             finalizeMkColJob(err, jobHttpReasonPhraseString, jobPath);
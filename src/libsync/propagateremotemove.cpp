@@ -244,18 +244,21 @@ void PropagateRemoteMove::finalize()
     // reopens the db successfully.
     // The db is only queried to transfer the content checksum from the old
     // to the new record. It is not a problem to skip it here.
+    //
+    // Below a renamed parent the db data was already moved together with it.
+    const auto originalFile = propagator()->adjustRenamedPath(_item->_originalFile);
     SyncJournalFileRecord oldRecord;
-    propagator()->_journal->getFileRecord(_item->_originalFile, &oldRecord);
+    propagator()->_journal->getFileRecord(originalFile, &oldRecord);
     auto &vfs = propagator()->syncOptions()._vfs;
-    auto pinState = vfs->pinState(_item->_originalFile);
+    auto pinState = vfs->pinState(originalFile);
 
     const auto targetFile = propagator()->fullLocalPath(_item->_renameTarget);
 
     if (QFileInfo::exists(targetFile)) {
         // Delete old db data.
-        propagator()->_journal->deleteFileRecord(_item->_originalFile);
-        if (!vfs->setPinState(_item->_originalFile, PinState::Inherited)) {
-            qCWarning(lcPropagateRemoteMove) << "Could not set pin state of" << _item->_originalFile << "to inherited";
+        propagator()->_journal->deleteFileRecord(originalFile);
+        if (!vfs->setPinState(originalFile, PinState::Inherited)) {
+            qCWarning(lcPropagateRemoteMove) << "Could not set pin state of" << originalFile << "to inherited";
         }
     }
 
@@ -293,7 +296,8 @@ void PropagateRemoteMove::finalize()
 
     if (_item->isDirectory()) {
         propagator()->_renamedDirectories.insert(_item->_file, _item->_renameTarget);
-        if (!adjustSelectiveSync(propagator()->_journal, _item->_file, _item->_renameTarget)) {
+        if (!adjustSelectiveSync(propagator()->_journal, _item->_file, _item->_renameTarget)
+            || !propagator()->_journal->moveFileRecordsBelow(originalFile, _item->_renameTarget)) {
             done(SyncFileItem::FatalError, tr("Error writing metadata to the database"));
             return;
         }
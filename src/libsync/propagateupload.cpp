@@ -30,6 +30,7 @@
 #include "networkjobs.h"
 #include "clientsideencryption.h"
 #include "clientsideencryptionjobs.h"
+#include "common/constants.h"
 
 #include <QNetworkAccessManager>
 #include <QFileInfo>
@@ -336,7 +337,7 @@ void PropagateUploadFileCommon::slotComputeContentChecksum()
         this, &PropagateUploadFileCommon::slotComputeTransmissionChecksum);
     connect(computeChecksum, &ComputeChecksum::done,
         computeChecksum, &QObject::deleteLater);
-    computeChecksum->start(_fileToUpload._path);
+    computeChecksum->start(fileToUploadDevice());
 }
 
 void PropagateUploadFileCommon::slotComputeTransmissionChecksum(const QByteArray &contentChecksumType, const QByteArray &contentChecksum)
@@ -363,7 +364,7 @@ void PropagateUploadFileCommon::slotComputeTransmissionChecksum(const QByteArray
         this, &PropagateUploadFileCommon::slotStartUpload);
     connect(computeChecksum, &ComputeChecksum::done,
         computeChecksum, &QObject::deleteLater);
-    computeChecksum->start(_fileToUpload._path);
+    computeChecksum->start(fileToUploadDevice());
 }
 
 void PropagateUploadFileCommon::slotStartUpload(const QByteArray &transmissionChecksumType, const QByteArray &transmissionChecksum)
@@ -411,8 +412,16 @@ void PropagateUploadFileCommon::slotStartUpload(const QByteArray &transmissionCh
         qDebug() << "prevModtime" << prevModtime << "Curr" << _item->_modtime;
         return slotOnErrorStartFolderUnlock(SyncFileItem::SoftError, tr("Local file changed during syncing. It will be resumed."));
     }
+    // The authentication tag in the metadata must match the data that gets encrypted while uploading
+    if (_uploadingEncrypted && _uploadEncryptedHelper->encryptedFileModtime() != _item->_modtime) {
+        propagator()->_anotherSyncNeeded = true;
+        return slotOnErrorStartFolderUnlock(SyncFileItem::SoftError, tr("Local file changed during syncing. It will be resumed."));
+    }
 
     _fileToUpload._size = FileSystem::getSize(fullFilePath);
+    if (_uploadingEncrypted) {
+        _fileToUpload._size += Constants::e2EeTagSize;
+    }
     _item->_size = FileSystem::getSize(originalFilePath);
 
     // But skip the file if the mtime is too close to 'now'!
@@ -426,6 +435,16 @@ void PropagateUploadFileCommon::slotStartUpload(const QByteArray &transmissionCh
     doStartUpload();
 }
 
+std::unique_ptr<QIODevice> PropagateUploadFileCommon::fileToUploadDevice() const
+{
+    if (_uploadingEncrypted) {
+        const auto &encryptedFile = _uploadEncryptedHelper->encryptedFile();
+        return std::make_unique<EncryptionHelper::EncryptedFileDevice>(_fileToUpload._path,
+            encryptedFile.encryptionKey, encryptedFile.initializationVector, encryptedFile.authenticationTag);
+    }
+    return std::make_unique<QFile>(_fileToUpload._path);
+}
+
 void PropagateUploadFileCommon::slotFolderUnlocked(const QByteArray &folderId, int httpReturnCode)
 {
     qDebug() << "Failed to unlock encrypted folder" << folderId;
@@ -436,6 +455,15 @@ void PropagateUploadFileCommon::slotFolderUnlocked(const QByteArray &folderId, i
     }
 }
 
+void PropagateUploadFileCommon::slotEncryptedFileCommitted()
+{
+    if (!_uploadEncryptedHelper->isFileCommitted()) {
+        done(SyncFileItem::NormalError, tr("Failed to update the metadata of the encrypted folder."));
+        return;
+    }
+    finalize();
+}
+
 void PropagateUploadFileCommon::slotOnErrorStartFolderUnlock(SyncFileItem::Status status, const QString &errorString)
 {
     if (_uploadingEncrypted) {
@@ -448,7 +476,12 @@ void PropagateUploadFileCommon::slotOnErrorStartFolderUnlock(SyncFileItem::Statu
 }
 
 UploadDevice::UploadDevice(const QString &fileName, qint64 start, qint64 size, BandwidthManager *bwm)
-    : _file(fileName)
+    : UploadDevice(std::make_unique<QFile>(fileName), start, size, bwm)
+{
+}
+
+UploadDevice::UploadDevice(std::unique_ptr<QIODevice> source, qint64 start, qint64 size, BandwidthManager *bwm)
+    : _source(std::move(source))
     , _start(start)
     , _size(size)
     , _bandwidthManager(bwm)
@@ -469,17 +502,26 @@ bool UploadDevice::open(QIODevice::OpenMode mode)
     if (mode & QIODevice::WriteOnly)
         return false;
 
-    // Get the file size now: _file.fileName() is no longer reliable
-    // on all platforms after openAndSeekFileSharedRead().
-    auto fileDiskSize = FileSystem::getSize(_file.fileName());
+    if (auto file = qobject_cast<QFile *>(_source.get())) {
+        // Get the file size now: file->fileName() is no longer reliable
+        // on all platforms after openAndSeekFileSharedRead().
+        auto fileDiskSize = FileSystem::getSize(file->fileName());
 
-    QString openError;
-    if (!FileSystem::openAndSeekFileSharedRead(&_file, &openError, _start)) {
-        setErrorString(openError);
-        return false;
-    }
+        QString openError;
+        if (!FileSystem::openAndSeekFileSharedRead(file, &openError, _start)) {
+            setErrorString(openError);
+            return false;
+        }
 
-    _size = qBound(0ll, _size, fileDiskSize - _start);
+        _size = qBound(0ll, _size, fileDiskSize - _start);
+    } else {
+        if (!_source->open(QIODevice::ReadOnly) || !_source->seek(_start)) {
+            setErrorString(_source->errorString());
+            return false;
+        }
+
+        _size = qBound(0ll, _size, _source->size() - _start);
+    }
     _read = 0;
 
     return QIODevice::open(mode);
@@ -487,7 +529,7 @@ bool UploadDevice::open(QIODevice::OpenMode mode)
 
 void UploadDevice::close()
 {
-    _file.close();
+    _source->close();
     QIODevice::close();
 }
 
@@ -521,9 +563,9 @@ qint64 UploadDevice::readData(char *data, qint64 maxlen)
         _bandwidthQuota -= maxlen;
     }
 
-    auto c = _file.read(data, maxlen);
+    auto c = _source->read(data, maxlen);
     if (c < 0) {
-        setErrorString(_file.errorString());
+        setErrorString(_source->errorString());
         return -1;
     }
     _read += c;
@@ -568,7 +610,7 @@ bool UploadDevice::seek(qint64 pos)
         return false;
     }
     _read = pos;
-    _file.seek(_start + pos);
+    _source->seek(_start + pos);
     return true;
 }
 
@@ -780,6 +822,22 @@ QMap<QByteArray, QByteArray> PropagateUploadFileCommon::headers()
 
 void PropagateUploadFileCommon::finalize()
 {
+    if (_uploadingEncrypted && !_uploadEncryptedHelper->isFileCommitted()) {
+        // The file was encrypted while it was sent, also by resends of a request. If it changed
+        // since the authentication tag was computed, the server got data that doesn't match the
+        // tag: keep it out of the metadata, the next sync uploads the file again.
+        if (!FileSystem::verifyFileUnchanged(propagator()->fullLocalPath(_item->_file), _item->_size, _item->_modtime)) {
+            propagator()->_anotherSyncNeeded = true;
+            slotOnErrorStartFolderUnlock(SyncFileItem::SoftError, tr("Local file changed during sync."));
+            return;
+        }
+
+        // Only record the file as synced once it is part of the stored metadata
+        connect(_uploadEncryptedHelper, &PropagateUploadEncrypted::folderUnlocked, this, &PropagateUploadFileCommon::slotEncryptedFileCommitted);
+        _uploadEncryptedHelper->commitFile();
+        return;
+    }
+
     // Update the quota, if known
     auto quotaIt = propagator()->_folderQuota.find(QFileInfo(_item->_file).path());
     if (quotaIt != propagator()->_folderQuota.end())
@@ -812,13 +870,7 @@ void PropagateUploadFileCommon::finalize()
     propagator()->_journal->setUploadInfo(_item->_file, SyncJournalDb::UploadInfo());
     propagator()->_journal->commit("upload file start");
 
-    if (_uploadingEncrypted) {
-        _uploadStatus = { SyncFileItem::Success, QString() };
-        connect(_uploadEncryptedHelper, &PropagateUploadEncrypted::folderUnlocked, this, &PropagateUploadFileCommon::slotFolderUnlocked);
-        _uploadEncryptedHelper->unlockFolder();
-    } else {
-        done(SyncFileItem::Success);
-    }
+    done(SyncFileItem::Success);
 }
 
 void PropagateUploadFileCommon::abortNetworkJobs(
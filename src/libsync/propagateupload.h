@@ -20,6 +20,8 @@
 #include <QFile>
 #include <QElapsedTimer>
 
+#include <memory>
+
 
 namespace OCC {
 
@@ -39,6 +41,8 @@ class UploadDevice : public QIODevice
     Q_OBJECT
 public:
     UploadDevice(const QString &fileName, qint64 start, qint64 size, BandwidthManager *bwm);
+    /** Uploads a range of @a source instead of a plain file. Takes ownership, the device must not be open. */
+    UploadDevice(std::unique_ptr<QIODevice> source, qint64 start, qint64 size, BandwidthManager *bwm);
     ~UploadDevice() override;
 
     bool open(QIODevice::OpenMode mode) override;
@@ -61,8 +65,8 @@ public:
 signals:
 
 private:
-    /// The local file to read data from
-    QFile _file;
+    /// The local file, or a device presenting it differently, to read data from
+    std::unique_ptr<QIODevice> _source;
 
     /// Start of the file data to use
     qint64 _start = 0;
@@ -264,6 +268,8 @@ private slots:
     void slotStartUpload(const QByteArray &transmissionChecksumType, const QByteArray &transmissionChecksum);
     // invoked when encrypted folder lock has been released
     void slotFolderUnlocked(const QByteArray &folderId, int httpReturnCode);
+    // invoked when the metadata of the encrypted folder was stored and the folder unlocked
+    void slotEncryptedFileCommitted();
     // invoked on internal error to unlock a folder and faile
     void slotOnErrorStartFolderUnlock(SyncFileItem::Status status, const QString &errorString);
 
@@ -316,6 +322,12 @@ protected:
 
     /** Bases headers that need to be sent on the PUT, or in the MOVE for chunking-ng */
     QMap<QByteArray, QByteArray> headers();
+
+    /**
+     * The data to upload, not opened yet: the local file or, for end-to-end
+     * encrypted folders, a device that encrypts it while it is being read.
+     */
+    std::unique_ptr<QIODevice> fileToUploadDevice() const;
 private:
   PropagateUploadEncrypted *_uploadEncryptedHelper;
   bool _uploadingEncrypted;
@@ -3,6 +3,8 @@
 #include "networkjobs.h"
 #include "clientsideencryption.h"
 #include "account.h"
+#include "filesystem.h"
+#include "common/constants.h"
 
 #include <QFileInfo>
 #include <QDir>
@@ -11,291 +13,442 @@
 #include <QTemporaryFile>
 #include <QLoggingCategory>
 #include <QMimeDatabase>
+#include <QtConcurrent>
 
 namespace OCC {
 
 Q_LOGGING_CATEGORY(lcPropagateUploadEncrypted, "nextcloud.sync.propagator.upload.encrypted", QtInfoMsg)
 
-PropagateUploadEncrypted::PropagateUploadEncrypted(OwncloudPropagator *propagator, const QString &remoteParentPath, SyncFileItemPtr item, QObject *parent)
+namespace {
+
+QString absoluteRemotePath(OwncloudPropagator *propagator, const QString &remoteParentPath)
+{
+    auto rootPath = propagator->remotePath();
+    if (rootPath.startsWith('/')) {
+        rootPath = rootPath.mid(1);
+    }
+    auto path = QString(rootPath + remoteParentPath);
+    if (path.endsWith('/')) {
+        path.chop(1);
+    }
+    return path;
+}
+
+EncryptedFile encryptedFileFor(const FolderMetadata &metadata, const QFileInfo &info)
+{
+    const QString fileName = info.fileName();
+
+    // Find existing metadata for this file
+    const QVector<EncryptedFile> files = metadata.files();
+    for (const EncryptedFile &file : files) {
+        if (file.originalFilename == fileName) {
+            return file;
+        }
+    }
+
+    // New encrypted file so set it all up!
+    EncryptedFile encryptedFile;
+    encryptedFile.encryptionKey = EncryptionHelper::generateRandom(16);
+    encryptedFile.encryptedFilename = EncryptionHelper::generateRandomFilename();
+    encryptedFile.initializationVector = EncryptionHelper::generateRandom(16);
+    encryptedFile.fileVersion = 1;
+    encryptedFile.metadataKey = 1;
+    encryptedFile.originalFilename = fileName;
+
+    QMimeDatabase mdb;
+    encryptedFile.mimetype = mdb.mimeTypeForFile(info).name().toLocal8Bit();
+
+    // Other clients expect "httpd/unix-directory" instead of "inode/directory"
+    // Doesn't matter much for us since we don't do much about that mimetype anyway
+    if (encryptedFile.mimetype == QByteArrayLiteral("inode/directory")) {
+        encryptedFile.mimetype = QByteArrayLiteral("httpd/unix-directory");
+    }
+    return encryptedFile;
+}
+
+}
+
+EncryptedFolderUploadBatch::EncryptedFolderUploadBatch(OwncloudPropagator *propagator, const QString &remoteParentPath, QObject *parent)
     : QObject(parent)
     , _propagator(propagator)
     , _remoteParentPath(remoteParentPath)
-    , _item(item)
-    , _metadata(nullptr)
 {
 }
 
-void PropagateUploadEncrypted::start()
+EncryptedFolderUploadBatch::~EncryptedFolderUploadBatch() = default;
+
+constexpr int EncryptedFolderUploadBatch::maximumMembers;
+
+void EncryptedFolderUploadBatch::start()
 {
-    const auto rootPath = [=]() {
-        const auto result = _propagator->remotePath();
-        if (result.startsWith('/')) {
-            return result.mid(1);
-        } else {
-            return result;
-        }
-    }();
-    const auto absoluteRemoteParentPath = [=]{
-        auto path = QString(rootPath + _remoteParentPath);
-        if (path.endsWith('/')) {
-            path.chop(1);
-        }
-        return path;
-    }();
-
-
-    /* If the file is in a encrypted folder, which we know, we wouldn't be here otherwise,
-     * we need to do the long road:
-     * find the ID of the folder.
-     * lock the folder using it's id.
-     * download the metadata
-     * update the metadata
-     * upload the file
-     * upload the metadata
-     * unlock the folder.
-     */
-    qCDebug(lcPropagateUploadEncrypted) << "Folder is encrypted, let's get the Id from it.";
-    auto job = new LsColJob(_propagator->account(), absoluteRemoteParentPath, this);
+    if (_state != Idle) {
+        return;
+    }
+    _state = Locking;
+
+    qCDebug(lcPropagateUploadEncrypted) << "Folder" << _remoteParentPath << "is encrypted, let's get the Id from it.";
+    auto job = new LsColJob(_propagator->account(), absoluteRemotePath(_propagator, _remoteParentPath), this);
     job->setProperties({"resourcetype", "http://owncloud.org/ns:fileid"});
-    connect(job, &LsColJob::directoryListingSubfolders, this, &PropagateUploadEncrypted::slotFolderEncryptedIdReceived);
-    connect(job, &LsColJob::finishedWithError, this, &PropagateUploadEncrypted::slotFolderEncryptedIdError);
+    connect(job, &LsColJob::directoryListingSubfolders, this, &EncryptedFolderUploadBatch::slotFolderIdReceived);
+    connect(job, &LsColJob::finishedWithError, this, &EncryptedFolderUploadBatch::slotFolderIdError);
     job->start();
 }
 
-/* We try to lock a folder, if it's locked we try again in one second.
- * if it's still locked we try again in one second. looping untill one minute.
- *                                                                      -> fail.
- * the 'loop':                                                         /
- *    slotFolderEncryptedIdReceived -> slotTryLock -> lockError -> stillTime? -> slotTryLock
- *                                        \
- *                                         -> success.
- */
+bool EncryptedFolderUploadBatch::acceptsMembers() const
+{
+    return (_state == Idle || _state == Locking || _state == Ready)
+        && !_storeFailed && !_releaseRequested && !_abortRequested
+        && _members < maximumMembers;
+}
 
-void PropagateUploadEncrypted::slotFolderEncryptedIdReceived(const QStringList &list)
+bool EncryptedFolderUploadBatch::isIdle() const
 {
-  qCDebug(lcPropagateUploadEncrypted) << "Received id of folder, trying to lock it so we can prepare the metadata";
-  auto job = qobject_cast<LsColJob *>(sender());
-  const auto& folderInfo = job->_folderInfos.value(list.first());
-  _folderLockFirstTry.start();
-  slotTryLock(folderInfo.fileId);
+    return _state == Ready && _activeMembers == 0 && _filesBeingStored.isEmpty() && _filesToStore.isEmpty();
 }
 
-void PropagateUploadEncrypted::slotTryLock(const QByteArray& fileId)
+void EncryptedFolderUploadBatch::join()
 {
-  auto *lockJob = new LockEncryptFolderApiJob(_propagator->account(), fileId, this);
-  connect(lockJob, &LockEncryptFolderApiJob::success, this, &PropagateUploadEncrypted::slotFolderLockedSuccessfully);
-  connect(lockJob, &LockEncryptFolderApiJob::error, this, &PropagateUploadEncrypted::slotFolderLockedError);
-  lockJob->start();
+    ++_members;
+    ++_activeMembers;
 }
 
-void PropagateUploadEncrypted::slotFolderLockedSuccessfully(const QByteArray& fileId, const QByteArray& token)
+void EncryptedFolderUploadBatch::leave()
 {
-  qCDebug(lcPropagateUploadEncrypted) << "Folder" << fileId << "Locked Successfully for Upload, Fetching Metadata";
-  // Should I use a mutex here?
-  _currentLockingInProgress = true;
-  _folderToken = token;
-  _folderId = fileId;
-  _isFolderLocked = true;
+    Q_ASSERT(_activeMembers > 0);
+    --_activeMembers;
+    unlockIfReleased();
+}
+
+void EncryptedFolderUploadBatch::slotFolderIdReceived(const QStringList &list)
+{
+    auto job = qobject_cast<LsColJob *>(sender());
+    _folderId = job->_folderInfos.value(list.first()).fileId;
+    _folderLockFirstTry.start();
+    slotTryLock();
+}
+
+void EncryptedFolderUploadBatch::slotFolderIdError(QNetworkReply *reply)
+{
+    Q_UNUSED(reply);
+    qCWarning(lcPropagateUploadEncrypted) << "Error retrieving the Id of the encrypted folder" << _remoteParentPath;
+    fail();
+}
+
+void EncryptedFolderUploadBatch::slotTryLock()
+{
+    if (_abortRequested) {
+        fail();
+        return;
+    }
+    auto *lockJob = new LockEncryptFolderApiJob(_propagator->account(), _folderId, this);
+    connect(lockJob, &LockEncryptFolderApiJob::success, this, &EncryptedFolderUploadBatch::slotFolderLocked);
+    connect(lockJob, &LockEncryptFolderApiJob::error, this, &EncryptedFolderUploadBatch::slotFolderLockedError);
+    lockJob->start();
+}
+
+void EncryptedFolderUploadBatch::slotFolderLockedError(const QByteArray &fileId, int httpErrorCode)
+{
+    qCDebug(lcPropagateUploadEncrypted) << "Folder" << fileId << "could not be locked:" << httpErrorCode;
+
+    // Probably locked by another client, keep trying every five seconds for up to five minutes
+    if (_folderLockFirstTry.elapsed() > 1000 * 60 * 5) {
+        qCWarning(lcPropagateUploadEncrypted) << "Giving up locking folder" << fileId;
+        fail();
+        return;
+    }
+    QTimer::singleShot(5000, this, &EncryptedFolderUploadBatch::slotTryLock);
+}
 
-  auto job = new GetMetadataApiJob(_propagator->account(), _folderId);
-  connect(job, &GetMetadataApiJob::jsonReceived,
-          this, &PropagateUploadEncrypted::slotFolderEncryptedMetadataReceived);
-  connect(job, &GetMetadataApiJob::error,
-          this, &PropagateUploadEncrypted::slotFolderEncryptedMetadataError);
+void EncryptedFolderUploadBatch::slotFolderLocked(const QByteArray &fileId, const QByteArray &token)
+{
+    qCDebug(lcPropagateUploadEncrypted) << "Folder" << fileId << "Locked Successfully for Upload, Fetching Metadata";
+    _folderToken = token;
 
-  job->start();
+    auto job = new GetMetadataApiJob(_propagator->account(), _folderId);
+    connect(job, &GetMetadataApiJob::jsonReceived, this, &EncryptedFolderUploadBatch::slotMetadataReceived);
+    connect(job, &GetMetadataApiJob::error, this, &EncryptedFolderUploadBatch::slotMetadataError);
+    job->start();
 }
 
-void PropagateUploadEncrypted::slotFolderEncryptedMetadataError(const QByteArray& fileId, int httpReturnCode)
+void EncryptedFolderUploadBatch::slotMetadataError(const QByteArray &fileId, int httpReturnCode)
 {
     Q_UNUSED(fileId);
-    Q_UNUSED(httpReturnCode);
     qCDebug(lcPropagateUploadEncrypted()) << "Error Getting the encrypted metadata. Pretend we got empty metadata.";
     FolderMetadata emptyMetadata(_propagator->account());
-    emptyMetadata.encryptedMetadata();
     auto json = QJsonDocument::fromJson(emptyMetadata.encryptedMetadata());
-    slotFolderEncryptedMetadataReceived(json, httpReturnCode);
+    slotMetadataReceived(json, httpReturnCode);
 }
 
-void PropagateUploadEncrypted::slotFolderEncryptedMetadataReceived(const QJsonDocument &json, int statusCode)
+void EncryptedFolderUploadBatch::slotMetadataReceived(const QJsonDocument &json, int statusCode)
 {
-  qCDebug(lcPropagateUploadEncrypted) << "Metadata Received, Preparing it for the new file." << json.toVariant();
-
-  // Encrypt File!
-  _metadata = new FolderMetadata(_propagator->account(), json.toJson(QJsonDocument::Compact), statusCode);
+    qCDebug(lcPropagateUploadEncrypted) << "Metadata of" << _remoteParentPath << "received";
+    _metadata.reset(new FolderMetadata(_propagator->account(), json.toJson(QJsonDocument::Compact), statusCode));
+    _metadataStatusCode = statusCode;
+    _state = Ready;
+    emit ready();
+
+    // Every member may have failed in the meantime
+    unlockIfReleased();
+}
 
-  QFileInfo info(_propagator->fullLocalPath(_item->_file));
-  const QString fileName = info.fileName();
+EncryptedFile EncryptedFolderUploadBatch::encryptedFileFor(const QString &localFile)
+{
+    Q_ASSERT(_state == Ready);
+    return OCC::encryptedFileFor(*_metadata, QFileInfo(localFile));
+}
 
-  // Find existing metadata for this file
-  bool found = false;
-  EncryptedFile encryptedFile;
-  const QVector<EncryptedFile> files = _metadata->files();
+void EncryptedFolderUploadBatch::storeFile(const EncryptedFile &file)
+{
+    if (_state != Ready || _storeFailed || _abortRequested) {
+        qCWarning(lcPropagateUploadEncrypted) << "Can't store the metadata of" << _remoteParentPath << "anymore";
+        const auto encryptedFilename = file.encryptedFilename;
+        QTimer::singleShot(0, this, [this, encryptedFilename] {
+            emit fileStored(encryptedFilename, false);
+        });
+        return;
+    }
+    _filesToStore.append(file);
+    storeMetadata();
+}
 
-  for(const EncryptedFile &file : files) {
-    if (file.originalFilename == fileName) {
-      encryptedFile = file;
-      found = true;
+void EncryptedFolderUploadBatch::storeMetadata()
+{
+    if (!_filesBeingStored.isEmpty() || _filesToStore.isEmpty()) {
+        return;
     }
-  }
+    _filesBeingStored = std::move(_filesToStore);
+    _filesToStore.clear();
 
+    qCInfo(lcPropagateUploadEncrypted) << "Storing the metadata of" << _remoteParentPath << "with" << _filesBeingStored.size() << "new entries";
+    for (const auto &file : qAsConst(_filesBeingStored)) {
+        _metadata->addEncryptedFile(file);
+    }
 
+    if (_metadataStatusCode == 404) {
+        auto job = new StoreMetaDataApiJob(_propagator->account(), _folderId, _metadata->encryptedMetadata());
+        connect(job, &StoreMetaDataApiJob::success, this, &EncryptedFolderUploadBatch::slotMetadataStored);
+        connect(job, &StoreMetaDataApiJob::error, this, &EncryptedFolderUploadBatch::slotMetadataStoreError);
+        job->start();
+    } else {
+        auto job = new UpdateMetadataApiJob(_propagator->account(), _folderId, _metadata->encryptedMetadata(), _folderToken);
+        connect(job, &UpdateMetadataApiJob::success, this, &EncryptedFolderUploadBatch::slotMetadataStored);
+        connect(job, &UpdateMetadataApiJob::error, this, &EncryptedFolderUploadBatch::slotMetadataStoreError);
+        job->start();
+    }
+}
 
-  // New encrypted file so set it all up!
-  if (!found) {
-      encryptedFile.encryptionKey = EncryptionHelper::generateRandom(16);
-      encryptedFile.encryptedFilename = EncryptionHelper::generateRandomFilename();
-      encryptedFile.initializationVector = EncryptionHelper::generateRandom(16);
-      encryptedFile.fileVersion = 1;
-      encryptedFile.metadataKey = 1;
-      encryptedFile.originalFilename = fileName;
+void EncryptedFolderUploadBatch::slotMetadataStored()
+{
+    qCDebug(lcPropagateUploadEncrypted) << "Uploading of the metadata success";
+    // The metadata exists on the server from now on
+    _metadataStatusCode = 200;
+
+    const auto storedFiles = std::move(_filesBeingStored);
+    _filesBeingStored.clear();
+    for (const auto &file : storedFiles) {
+        emit fileStored(file.encryptedFilename, true);
+    }
 
-      QMimeDatabase mdb;
-      encryptedFile.mimetype = mdb.mimeTypeForFile(info).name().toLocal8Bit();
+    storeMetadata();
+    unlockIfReleased();
+}
 
-      // Other clients expect "httpd/unix-directory" instead of "inode/directory"
-      // Doesn't matter much for us since we don't do much about that mimetype anyway
-      if (encryptedFile.mimetype == QByteArrayLiteral("inode/directory")) {
-          encryptedFile.mimetype = QByteArrayLiteral("httpd/unix-directory");
-      }
-  }
+void EncryptedFolderUploadBatch::slotMetadataStoreError(const QByteArray &fileId, int httpReturnCode)
+{
+    qCWarning(lcPropagateUploadEncrypted) << "Update metadata error for folder" << fileId << "with error" << httpReturnCode;
+    _storeFailed = true;
+
+    auto failedFiles = std::move(_filesBeingStored);
+    _filesBeingStored.clear();
+    failedFiles += _filesToStore;
+    _filesToStore.clear();
+    for (const auto &file : qAsConst(failedFiles)) {
+        emit fileStored(file.encryptedFilename, false);
+    }
 
-  _item->_encryptedFileName = _remoteParentPath + QLatin1Char('/') + encryptedFile.encryptedFilename;
-  _item->_isEncrypted = true;
+    // Later uploads start over with a fresh lock and metadata
+    release();
+}
 
-  qCDebug(lcPropagateUploadEncrypted) << "Creating the encrypted file.";
+void EncryptedFolderUploadBatch::release()
+{
+    _releaseRequested = true;
+    unlockIfReleased();
+}
 
-  if (info.isDir()) {
-      _completeFileName = encryptedFile.encryptedFilename;
-  } else {
-      QFile input(info.absoluteFilePath());
-      QFile output(QDir::tempPath() + QDir::separator() + encryptedFile.encryptedFilename);
-
-      QByteArray tag;
-      bool encryptionResult = EncryptionHelper::fileEncryption(
-        encryptedFile.encryptionKey,
-        encryptedFile.initializationVector,
-        &input, &output, tag);
-
-      if (!encryptionResult) {
-        qCDebug(lcPropagateUploadEncrypted()) << "There was an error encrypting the file, aborting upload.";
-        connect(this, &PropagateUploadEncrypted::folderUnlocked, this, &PropagateUploadEncrypted::error);
+void EncryptedFolderUploadBatch::abort()
+{
+    _abortRequested = true;
+    if (_state == Ready) {
         unlockFolder();
-        return;
-      }
-
-      encryptedFile.authenticationTag = tag;
-      _completeFileName = output.fileName();
-  }
-
-  qCDebug(lcPropagateUploadEncrypted) << "Creating the metadata for the encrypted file.";
-
-  _metadata->addEncryptedFile(encryptedFile);
-  _encryptedFile = encryptedFile;
-
-  qCDebug(lcPropagateUploadEncrypted) << "Metadata created, sending to the server.";
-
-  if (statusCode == 404) {
-    auto job = new StoreMetaDataApiJob(_propagator->account(),
-                                       _folderId,
-                                       _metadata->encryptedMetadata());
-    connect(job, &StoreMetaDataApiJob::success, this, &PropagateUploadEncrypted::slotUpdateMetadataSuccess);
-    connect(job, &StoreMetaDataApiJob::error, this, &PropagateUploadEncrypted::slotUpdateMetadataError);
-    job->start();
-  } else {
-    auto job = new UpdateMetadataApiJob(_propagator->account(),
-                                      _folderId,
-                                      _metadata->encryptedMetadata(),
-                                      _folderToken);
+    }
+}
 
-    connect(job, &UpdateMetadataApiJob::success, this, &PropagateUploadEncrypted::slotUpdateMetadataSuccess);
-    connect(job, &UpdateMetadataApiJob::error, this, &PropagateUploadEncrypted::slotUpdateMetadataError);
-    job->start();
-  }
+void EncryptedFolderUploadBatch::unlockIfReleased()
+{
+    if (_abortRequested && _state == Ready) {
+        unlockFolder();
+    } else if (_releaseRequested && isIdle()) {
+        unlockFolder();
+    }
 }
 
-void PropagateUploadEncrypted::slotUpdateMetadataSuccess(const QByteArray& fileId)
+void EncryptedFolderUploadBatch::unlockFolder()
 {
-    Q_UNUSED(fileId);
-    qCDebug(lcPropagateUploadEncrypted) << "Uploading of the metadata success, Encrypting the file";
-    QFileInfo outputInfo(_completeFileName);
+    _state = Unlocking;
+    auto *unlockJob = new UnlockEncryptFolderApiJob(_propagator->account(), _folderId, _folderToken, this);
+    connect(unlockJob, &UnlockEncryptFolderApiJob::success, this, [this](const QByteArray &folderId) {
+        qCDebug(lcPropagateUploadEncrypted) << "Successfully Unlocked" << folderId;
+        _state = Finished;
+        emit finished(folderId, 200);
+    });
+    connect(unlockJob, &UnlockEncryptFolderApiJob::error, this, [this](const QByteArray &folderId, int httpStatus) {
+        qCWarning(lcPropagateUploadEncrypted) << "Unlock Error" << folderId << httpStatus;
+        _state = Finished;
+        emit finished(folderId, httpStatus);
+    });
+    unlockJob->start();
+}
 
-    qCDebug(lcPropagateUploadEncrypted) << "Encrypted Info:" << outputInfo.path() << outputInfo.fileName() << outputInfo.size();
-    qCDebug(lcPropagateUploadEncrypted) << "Finalizing the upload part, now the actuall uploader will take over";
-    emit finalized(outputInfo.path() + QLatin1Char('/') + outputInfo.fileName(),
-                   _remoteParentPath + QLatin1Char('/') + outputInfo.fileName(),
-                   outputInfo.size());
+void EncryptedFolderUploadBatch::fail()
+{
+    _state = Failed;
+    emit error();
 }
 
-void PropagateUploadEncrypted::slotUpdateMetadataError(const QByteArray& fileId, int httpErrorResponse)
+PropagateUploadEncrypted::PropagateUploadEncrypted(OwncloudPropagator *propagator, const QString &remoteParentPath, SyncFileItemPtr item, QObject *parent)
+    : QObject(parent)
+    , _propagator(propagator)
+    , _remoteParentPath(remoteParentPath)
+    , _item(item)
 {
-  qCDebug(lcPropagateUploadEncrypted) << "Update metadata error for folder" << fileId << "with error" << httpErrorResponse;
-  qCDebug(lcPropagateUploadEncrypted()) << "Unlocking the folder.";
-  connect(this, &PropagateUploadEncrypted::folderUnlocked, this, &PropagateUploadEncrypted::error);
-  unlockFolder();
 }
 
-void PropagateUploadEncrypted::slotFolderLockedError(const QByteArray& fileId, int httpErrorCode)
+PropagateUploadEncrypted::~PropagateUploadEncrypted()
 {
-    Q_UNUSED(httpErrorCode);
-    /* try to call the lock from 5 to 5 seconds
-     * and fail if it's more than 5 minutes. */
-    QTimer::singleShot(5000, this, [this, fileId]{
-        if (!_currentLockingInProgress) {
-            qCDebug(lcPropagateUploadEncrypted) << "Error locking the folder while no other update is locking it up.";
-            qCDebug(lcPropagateUploadEncrypted) << "Perhaps another client locked it.";
-            qCDebug(lcPropagateUploadEncrypted) << "Abort";
-        return;
-        }
+    // Aborted jobs are deleted without unlocking
+    leaveBatch();
+}
 
-        // Perhaps I should remove the elapsed timer if the lock is from this client?
-        if (_folderLockFirstTry.elapsed() > /* five minutes */ 1000 * 60 * 5 ) {
-            qCDebug(lcPropagateUploadEncrypted) << "One minute passed, ignoring more attempts to lock the folder.";
-        return;
-        }
-        slotTryLock(fileId);
+void PropagateUploadEncrypted::start()
+{
+    // Files and directories share the lock and the metadata with all other uploads into the folder
+    _batch = _propagator->encryptedUploadBatch(_item->_file, _remoteParentPath);
+    _batch->join();
+    _isBatchMember = true;
+    connect(_batch, &EncryptedFolderUploadBatch::error, this, [this] {
+        leaveBatch();
+        emit error();
     });
-
-    qCDebug(lcPropagateUploadEncrypted) << "Folder" << fileId << "Coundn't be locked.";
+    if (_batch->isFailed()) {
+        QTimer::singleShot(0, this, [this] {
+            leaveBatch();
+            emit error();
+        });
+    } else if (_batch->isReady()) {
+        slotBatchReady();
+    } else {
+        connect(_batch, &EncryptedFolderUploadBatch::ready, this, &PropagateUploadEncrypted::slotBatchReady);
+        _batch->start();
+    }
 }
 
-void PropagateUploadEncrypted::slotFolderEncryptedIdError(QNetworkReply *r)
+void PropagateUploadEncrypted::slotBatchReady()
 {
-    Q_UNUSED(r);
-    qCDebug(lcPropagateUploadEncrypted) << "Error retrieving the Id of the encrypted folder.";
+  _folderToken = _batch->folderToken();
+  _folderId = _batch->folderId();
+  _isFolderLocked = true;
+
+  _completeFileName = _propagator->fullLocalPath(_item->_file);
+  _encryptedFile = _batch->encryptedFileFor(_completeFileName);
+  _item->_encryptedFileName = _remoteParentPath + QLatin1Char('/') + _encryptedFile.encryptedFilename;
+  _item->_isEncrypted = true;
+
+  if (_item->isDirectory()) {
+    // The entry of a directory is stored before the directory is created
+    connect(_batch, &EncryptedFolderUploadBatch::fileStored, this, &PropagateUploadEncrypted::slotFileStored);
+    _batch->storeFile(_encryptedFile);
+    return;
+  }
+
+  // Nothing is written to disk: only the authentication tag, which goes into the
+  // metadata, is computed up front. The ciphertext is produced while uploading.
+  qCDebug(lcPropagateUploadEncrypted) << "Computing the authentication tag of the file.";
+  _encryptedFileModtime = FileSystem::getModTime(_completeFileName);
+  connect(&_tagWatcher, &QFutureWatcherBase::finished,
+          this, &PropagateUploadEncrypted::slotAuthenticationTagComputed, Qt::UniqueConnection);
+  _tagWatcher.setFuture(QtConcurrent::run(&EncryptionHelper::EncryptedFileDevice::computeTag,
+                                          _completeFileName, _encryptedFile.encryptionKey, _encryptedFile.initializationVector));
 }
 
-void PropagateUploadEncrypted::unlockFolder()
+void PropagateUploadEncrypted::slotAuthenticationTagComputed()
 {
-    ASSERT(!_isUnlockRunning);
+  const auto tag = _tagWatcher.result();
+  if (tag.isEmpty() || FileSystem::getModTime(_completeFileName) != _encryptedFileModtime) {
+    qCDebug(lcPropagateUploadEncrypted()) << "There was an error encrypting the file, aborting upload.";
+    leaveBatch();
+    emit error();
+    return;
+  }
 
-    if (_isUnlockRunning) {
-        qWarning() << "Double-call to unlockFolder.";
-        return;
-    }
+  _encryptedFile.authenticationTag = tag;
 
-    _isUnlockRunning = true;
+  // The metadata is only updated after the body was uploaded, see commitFile()
+  const auto encryptedSize = FileSystem::getSize(_completeFileName) + Constants::e2EeTagSize;
+  qCDebug(lcPropagateUploadEncrypted) << "Encrypted Info:" << _completeFileName << _encryptedFile.encryptedFilename << encryptedSize;
+  emit finalized(_completeFileName,
+                 _remoteParentPath + QLatin1Char('/') + _encryptedFile.encryptedFilename,
+                 encryptedSize);
+}
 
-    qDebug() << "Calling Unlock";
-    auto *unlockJob = new UnlockEncryptFolderApiJob(_propagator->account(),
-        _folderId, _folderToken, this);
+void PropagateUploadEncrypted::commitFile()
+{
+  if (!_batch) {
+    QTimer::singleShot(0, this, &PropagateUploadEncrypted::unlockFolder);
+    return;
+  }
+  connect(_batch, &EncryptedFolderUploadBatch::fileStored, this, &PropagateUploadEncrypted::slotFileStored);
+  _batch->storeFile(_encryptedFile);
+}
 
-    connect(unlockJob, &UnlockEncryptFolderApiJob::success, [this](const QByteArray &folderId) {
-        qDebug() << "Successfully Unlocked";
-        _folderToken = "";
-        _folderId = "";
-        _isFolderLocked = false;
+void PropagateUploadEncrypted::slotFileStored(const QByteArray &encryptedFilename, bool success)
+{
+  if (encryptedFilename != _encryptedFile.encryptedFilename) {
+    return;
+  }
+  disconnect(_batch, &EncryptedFolderUploadBatch::fileStored, this, &PropagateUploadEncrypted::slotFileStored);
+  _isFileCommitted = success;
 
-        emit folderUnlocked(folderId, 200);
-        _isUnlockRunning = false;
-    });
-    connect(unlockJob, &UnlockEncryptFolderApiJob::error, [this](const QByteArray &folderId, int httpStatus) {
-        qDebug() << "Unlock Error";
+  if (!_item->isDirectory()) {
+    unlockFolder();
+  } else if (success) {
+    emit finalized(_completeFileName, _remoteParentPath + QLatin1Char('/') + _encryptedFile.encryptedFilename, 0);
+  } else {
+    leaveBatch();
+    emit error();
+  }
+}
 
-        emit folderUnlocked(folderId, httpStatus);
-        _isUnlockRunning = false;
-    });
-    unlockJob->start();
+void PropagateUploadEncrypted::unlockFolder()
+{
+  // The batch unlocks the folder once no other upload uses it anymore
+  leaveBatch();
+
+  const auto folderId = _folderId;
+  _folderToken = "";
+  _folderId = "";
+  _isFolderLocked = false;
+  QTimer::singleShot(0, this, [this, folderId] {
+    emit folderUnlocked(folderId, 200);
+  });
+}
+
+void PropagateUploadEncrypted::leaveBatch()
+{
+  if (_isBatchMember && _batch) {
+    _batch->leave();
+  }
+  _isBatchMember = false;
 }
 
 } // namespace OCC
@@ -9,6 +9,8 @@
 #include <QNetworkReply>
 #include <QFile>
 #include <QTemporaryFile>
+#include <QFutureWatcher>
+#include <QPointer>
 
 #include "owncloudpropagator.h"
 #include "clientsideencryption.h"
@@ -16,69 +18,187 @@
 namespace OCC {
 class FolderMetadata;
 
-  /* This class is used if the server supports end to end encryption.
- * It will fire for *any* folder, encrypted or not, because when the
- * client starts the upload request we don't know if the folder is
- * encrypted on the server.
+/* Shared by the uploads into one encrypted folder during a propagation.
  *
- * emits:
- * finalized() if the encrypted file is ready to be uploaded
- * error() if there was an error with the encryption
- * folderNotEncrypted() if the file is within a folder that's not encrypted.
+ * The folder is locked and its metadata is fetched once for up to
+ * maximumMembers uploads and directory creations. Each of them stores the
+ * metadata with its own entry right after its body was uploaded, so the
+ * metadata on the server never lags behind more than the files of the
+ * stores in flight. The propagator releases the batch, and with it the
+ * lock, as soon as the next job it schedules doesn't join the batch.
  *
+ * emits:
+ * ready() once the folder is locked and the metadata is available
+ * error() if the folder could not be locked
+ * fileStored() when the metadata with an entry was stored, or that failed
+ * finished() after the folder was unlocked
  */
+class OWNCLOUDSYNC_EXPORT EncryptedFolderUploadBatch : public QObject
+{
+    Q_OBJECT
+public:
+    /// How many uploads may share one lock, so other clients get their turn
+    static constexpr int maximumMembers = 50;
+
+    EncryptedFolderUploadBatch(OwncloudPropagator *propagator, const QString &remoteParentPath, QObject *parent = nullptr);
+    ~EncryptedFolderUploadBatch() override;
+
+    /// Locks the folder and fetches the metadata, does nothing if that already happened
+    void start();
+
+    bool isReady() const { return _state == Ready; }
+    bool isFailed() const { return _state == Failed; }
+    /// Whether the folder is locked or about to be
+    bool holdsLock() const { return _state == Locking || _state == Ready || _state == Unlocking; }
+    /// Whether uploads can still join, otherwise the propagator starts a new batch
+    bool acceptsMembers() const;
+    /// Whether the folder is locked while no member uses it
+    bool isIdle() const;
+
+    const QByteArray &folderToken() const { return _folderToken; }
+    const QByteArray &folderId() const { return _folderId; }
 
+    /// An upload or directory creation starts to use the folder
+    void join();
+    /// The member is done with the folder, successful or not
+    void leave();
+
+    /// Existing metadata entry for the local file, or a new one with fresh key and name
+    EncryptedFile encryptedFileFor(const QString &localFile);
+
+    /// Stores the metadata with @a file added, fileStored() tells the outcome
+    void storeFile(const EncryptedFile &file);
+
+    /// Unlocks the folder as soon as no member uses it anymore
+    void release();
+
+    /// Unlocks the folder right away, members that are still running lose the lock
+    void abort();
+
+signals:
+    void ready();
+    void error();
+    void fileStored(const QByteArray &encryptedFilename, bool success);
+    void finished(const QByteArray &folderId, int httpStatus);
+
+private slots:
+    void slotFolderIdReceived(const QStringList &list);
+    void slotFolderIdError(QNetworkReply *reply);
+    void slotTryLock();
+    void slotFolderLocked(const QByteArray &fileId, const QByteArray &token);
+    void slotFolderLockedError(const QByteArray &fileId, int httpErrorCode);
+    void slotMetadataReceived(const QJsonDocument &json, int statusCode);
+    void slotMetadataError(const QByteArray &fileId, int httpReturnCode);
+    void slotMetadataStored();
+    void slotMetadataStoreError(const QByteArray &fileId, int httpReturnCode);
+
+private:
+    enum State {
+        Idle,
+        Locking,
+        Ready,
+        Unlocking,
+        Finished,
+        Failed
+    };
+
+    /// Sends the files handed over since the last store, one store at a time
+    void storeMetadata();
+    void unlockIfReleased();
+    void fail();
+    void unlockFolder();
+
+    OwncloudPropagator *_propagator;
+    QString _remoteParentPath;
+    State _state = Idle;
+
+    QByteArray _folderToken;
+    QByteArray _folderId;
+    QElapsedTimer _folderLockFirstTry;
+
+    QScopedPointer<FolderMetadata> _metadata;
+    int _metadataStatusCode = -1;
+    QVector<EncryptedFile> _filesToStore;
+    QVector<EncryptedFile> _filesBeingStored;
+    // Once a store failed, the metadata on the server is not known anymore
+    bool _storeFailed = false;
+
+    int _members = 0;
+    int _activeMembers = 0;
+    bool _releaseRequested = false;
+    bool _abortRequested = false;
+};
+
+/* Uploads a file or creates a directory in an encrypted folder.
+ *
+ * It joins the EncryptedFolderUploadBatch of the parent folder, which holds
+ * the lock and the metadata shared with the other uploads into the folder.
+ *
+ * emits:
+ * finalized() once the file can be uploaded, or the directory be created
+ * error() if the folder could not be locked or the file not be encrypted
+ * folderUnlocked() once this upload is done with the folder
+ */
 class PropagateUploadEncrypted : public QObject
 {
   Q_OBJECT
 public:
     PropagateUploadEncrypted(OwncloudPropagator *propagator, const QString &remoteParentPath, SyncFileItemPtr item, QObject *parent = nullptr);
-    ~PropagateUploadEncrypted() override = default;
+    ~PropagateUploadEncrypted() override;
 
     void start();
 
+    /// Leaves the folder to the other uploads, emits folderUnlocked()
     void unlockFolder();
 
-    bool isUnlockRunning() const { return _isUnlockRunning; }
     bool isFolderLocked() const { return _isFolderLocked; }
     const QByteArray folderToken() const { return _folderToken; }
 
+    /// Key, IV and authentication tag of the uploaded file, valid after finalized()
+    const EncryptedFile &encryptedFile() const { return _encryptedFile; }
+    /// Modification time of the local file when its authentication tag was computed
+    time_t encryptedFileModtime() const { return _encryptedFileModtime; }
+
+    /** Stores the metadata of the folder with the uploaded file added.
+     *
+     * Emits folderUnlocked() afterwards, isFileCommitted() tells whether the
+     * metadata was stored.
+     */
+    void commitFile();
+    bool isFileCommitted() const { return _isFileCommitted; }
+
 private slots:
-    void slotFolderEncryptedIdReceived(const QStringList &list);
-    void slotFolderEncryptedIdError(QNetworkReply *r);
-    void slotFolderLockedSuccessfully(const QByteArray& fileId, const QByteArray& token);
-    void slotFolderLockedError(const QByteArray& fileId, int httpErrorCode);
-    void slotTryLock(const QByteArray& fileId);
-    void slotFolderEncryptedMetadataReceived(const QJsonDocument &json, int statusCode);
-    void slotFolderEncryptedMetadataError(const QByteArray& fileId, int httpReturnCode);
-    void slotUpdateMetadataSuccess(const QByteArray& fileId);
-    void slotUpdateMetadataError(const QByteArray& fileId, int httpReturnCode);
+    void slotBatchReady();
+    void slotAuthenticationTagComputed();
+    void slotFileStored(const QByteArray &encryptedFilename, bool success);
 
 signals:
-    // Emmited after the file is encrypted and everythign is setup.
+    // Emmited after the metadata is updated and everythign is setup.
+    // For files path is the local file, which gets encrypted while it's uploaded.
     void finalized(const QString& path, const QString& filename, quint64 size);
     void error();
     void folderUnlocked(const QByteArray &folderId, int httpStatus);
 
 private:
+  void leaveBatch();
+
   OwncloudPropagator *_propagator;
   QString _remoteParentPath;
   SyncFileItemPtr _item;
 
   QByteArray _folderToken;
   QByteArray _folderId;
-
-  QElapsedTimer _folderLockFirstTry;
-  bool _currentLockingInProgress = false;
-
-  bool _isUnlockRunning = false;
   bool _isFolderLocked = false;
 
-  QByteArray _generatedKey;
-  QByteArray _generatedIv;
-  FolderMetadata *_metadata;
   EncryptedFile _encryptedFile;
   QString _completeFileName;
+
+  QFutureWatcher<QByteArray> _tagWatcher;
+  time_t _encryptedFileModtime = 0;
+
+  QPointer<EncryptedFolderUploadBatch> _batch;
+  bool _isBatchMember = false;
+  bool _isFileCommitted = false;
 };
 
 
@@ -46,45 +46,49 @@ QByteArray localFileIdFromFullId(const QByteArray &id)
     return id.left(8);
 }
 
+PropagateLocalRemove::RemoveResult PropagateLocalRemove::removeLocally(const QString &filename, bool isDirectory, bool moveToTrash)
+{
+    RemoveResult result;
+    if (moveToTrash) {
+        if ((QDir(filename).exists() || FileSystem::fileExists(filename))
+            && !FileSystem::moveToTrash(filename, &result.error)) {
+            result.success = false;
+        }
+    } else if (isDirectory) {
+        if (QDir(filename).exists()) {
+            QStringList errors;
+            result.success = FileSystem::removeRecursively(
+                filename,
+                [&result](const QString &path, bool isDir) {
+                    result.deleted.append(qMakePair(path, isDir));
+                },
+                &errors);
+            result.error = errors.join(", ");
+        }
+    } else {
+        if (FileSystem::fileExists(filename)
+            && !FileSystem::remove(filename, &result.error)) {
+            result.success = false;
+        }
+    }
+    return result;
+}
+
 /**
- * The code will update the database in case of error.
- * If everything goes well (no error, returns true), the caller is responsible for removing the entries
- * in the database.  But in case of error, we need to remove the entries from the database of the files
- * that were deleted.
+ * If everything went well, the caller is responsible for removing the entries
+ * in the database. But when a recursive removal failed, we need to remove the
+ * entries from the database of the files that were deleted.
  *
- * \a path is relative to propagator()->_localDir + _item->_file and should start with a slash
+ * A fully deleted folder is reported without its contents, so each of them
+ * takes one recursive delete in the journal.
  */
-bool PropagateLocalRemove::removeRecursively(const QString &path)
+void PropagateLocalRemove::removeDeletedRecords(const QList<QPair<QString, bool>> &deleted)
 {
-    QString absolute = propagator()->fullLocalPath(_item->_file + path);
-    QStringList errors;
-    QList<QPair<QString, bool>> deleted;
-    bool success = FileSystem::removeRecursively(
-        absolute,
-        [&deleted](const QString &path, bool isDir) {
-            // by prepending, a folder deletion may be followed by content deletions
-            deleted.prepend(qMakePair(path, isDir));
-        },
-        &errors);
-
-    if (!success) {
-        // We need to delete the entries from the database now from the deleted vector.
-        // Do it while avoiding redundant delete calls to the journal.
-        QString deletedDir;
-        foreach (const auto &it, deleted) {
-            if (!it.first.startsWith(propagator()->localPath()))
-                continue;
-            if (!deletedDir.isEmpty() && it.first.startsWith(deletedDir))
-                continue;
-            if (it.second) {
-                deletedDir = it.first;
-            }
-            propagator()->_journal->deleteFileRecord(it.first.mid(propagator()->localPath().size()), it.second);
-        }
-
-        _error = errors.join(", ");
+    for (const auto &it : deleted) {
+        if (!it.first.startsWith(propagator()->localPath()))
+            continue;
+        propagator()->_journal->deleteFileRecord(it.first.mid(propagator()->localPath().size()), it.second);
     }
-    return success;
 }
 
 void PropagateLocalRemove::start()
@@ -104,29 +108,24 @@ void PropagateLocalRemove::start()
         return;
     }
 
-    QString removeError;
-    if (_moveToTrash) {
-        if ((QDir(filename).exists() || FileSystem::fileExists(filename))
-            && !FileSystem::moveToTrash(filename, &removeError)) {
-            done(SyncFileItem::NormalError, removeError);
-            return;
-        }
-    } else {
-        if (_item->isDirectory()) {
-            if (QDir(filename).exists() && !removeRecursively(QString())) {
-                done(SyncFileItem::NormalError, _error);
-                return;
-            }
-        } else {
-            if (FileSystem::fileExists(filename)
-                && !FileSystem::remove(filename, &removeError)) {
-                done(SyncFileItem::NormalError, removeError);
-                return;
-            }
-        }
+    const bool isDirectory = _item->isDirectory();
+    const bool moveToTrash = _moveToTrash;
+    propagator()->_activeJobList.append(this);
+    propagator()->_localIoExecutor.post(LocalIoExecutor::directoryKey(filename), this,
+        [filename, isDirectory, moveToTrash] { return removeLocally(filename, isDirectory, moveToTrash); },
+        [this](const RemoveResult &result) { slotRemoved(result); });
+}
+
+void PropagateLocalRemove::slotRemoved(const RemoveResult &result)
+{
+    propagator()->_activeJobList.removeOne(this);
+    if (!result.success) {
+        removeDeletedRecords(result.deleted);
+        done(SyncFileItem::NormalError, result.error);
+        return;
     }
     propagator()->reportProgress(*_item, 0);
-    propagator()->_journal->deleteFileRecord(_item->_originalFile, _item->isDirectory());
+    propagator()->_journal->deleteFileRecord(propagator()->adjustRenamedPath(_item->_originalFile), _item->isDirectory());
     propagator()->_journal->commit("Local remove");
     done(SyncFileItem::Success);
 }
@@ -150,23 +149,13 @@ void PropagateLocalMkdir::startLocalMkdir()
     QString newDirStr = QDir::toNativeSeparators(newDir.path());
 
     // When turning something that used to be a file into a directory
-    // we need to delete the file first.
-    QFileInfo fi(newDirStr);
-    if (fi.exists() && fi.isFile()) {
-        if (_deleteExistingFile) {
-            QString removeError;
-            if (!FileSystem::remove(newDirStr, &removeError)) {
-                done(SyncFileItem::NormalError,
-                    tr("could not delete file %1, error: %2")
-                        .arg(newDirStr, removeError));
-                return;
-            }
-        } else if (_item->_instruction == CSYNC_INSTRUCTION_CONFLICT) {
-            QString error;
-            if (!propagator()->createConflict(_item, _associatedComposite, &error)) {
-                done(SyncFileItem::SoftError, error);
-                return;
-            }
+    // we need to delete the file first, that is done together with the mkdir.
+    // A conflicting file is kept as a conflict copy instead.
+    if (!_deleteExistingFile && _item->_instruction == CSYNC_INSTRUCTION_CONFLICT && QFileInfo(newDirStr).isFile()) {
+        QString error;
+        if (!propagator()->createConflict(_item, _associatedComposite, &error)) {
+            done(SyncFileItem::SoftError, error);
+            return;
         }
     }
 
@@ -176,9 +165,32 @@ void PropagateLocalMkdir::startLocalMkdir()
         return;
     }
     emit propagator()->touchedFile(newDirStr);
-    QDir localDir(propagator()->localPath());
-    if (!localDir.mkpath(_item->_file)) {
-        done(SyncFileItem::NormalError, tr("Could not create folder %1").arg(newDirStr));
+
+    const bool deleteExistingFile = _deleteExistingFile;
+    const QString localPath = propagator()->localPath();
+    const QString file = _item->_file;
+    propagator()->_activeJobList.append(this);
+    propagator()->_localIoExecutor.post(LocalIoExecutor::directoryKey(newDir.path()), this,
+        [newDirStr, deleteExistingFile, localPath, file] {
+            if (deleteExistingFile && QFileInfo(newDirStr).isFile()) {
+                QString removeError;
+                if (!FileSystem::remove(newDirStr, &removeError)) {
+                    return tr("could not delete file %1, error: %2").arg(newDirStr, removeError);
+                }
+            }
+            if (!QDir(localPath).mkpath(file)) {
+                return tr("Could not create folder %1").arg(newDirStr);
+            }
+            return QString();
+        },
+        [this](const QString &error) { slotLocalMkdirDone(error); });
+}
+
+void PropagateLocalMkdir::slotLocalMkdirDone(const QString &error)
+{
+    propagator()->_activeJobList.removeOne(this);
+    if (!error.isEmpty()) {
+        done(SyncFileItem::NormalError, error);
         return;
     }
 
@@ -235,21 +247,39 @@ void PropagateLocalRename::start()
 
         emit propagator()->touchedFile(existingFile);
         emit propagator()->touchedFile(targetFile);
-        QString renameError;
-        if (!FileSystem::rename(existingFile, targetFile, &renameError)) {
-            done(SyncFileItem::NormalError, renameError);
-            return;
-        }
+        propagator()->_activeJobList.append(this);
+        propagator()->_localIoExecutor.post(LocalIoExecutor::directoryKey(targetFile), this,
+            [existingFile, targetFile] {
+                QString renameError;
+                const bool success = FileSystem::rename(existingFile, targetFile, &renameError);
+                return qMakePair(success, renameError);
+            },
+            [this](const QPair<bool, QString> &result) {
+                propagator()->_activeJobList.removeOne(this);
+                if (!result.first) {
+                    done(SyncFileItem::NormalError, result.second);
+                    return;
+                }
+                finalizeRename();
+            });
+        return;
     }
 
+    finalizeRename();
+}
+
+void PropagateLocalRename::finalizeRename()
+{
+    // Below a renamed parent the db data was already moved together with it
+    const auto originalFile = propagator()->adjustRenamedPath(_item->_originalFile);
     SyncJournalFileRecord oldRecord;
-    propagator()->_journal->getFileRecord(_item->_originalFile, &oldRecord);
-    propagator()->_journal->deleteFileRecord(_item->_originalFile);
+    propagator()->_journal->getFileRecord(originalFile, &oldRecord);
+    propagator()->_journal->deleteFileRecord(originalFile);
 
     auto &vfs = propagator()->syncOptions()._vfs;
-    auto pinState = vfs->pinState(_item->_originalFile);
-    if (!vfs->setPinState(_item->_originalFile, PinState::Inherited)) {
-        qCWarning(lcPropagateLocalRename) << "Could not set pin state of" << _item->_originalFile << "to inherited";
+    auto pinState = vfs->pinState(originalFile);
+    if (!vfs->setPinState(originalFile, PinState::Inherited)) {
+        qCWarning(lcPropagateLocalRename) << "Could not set pin state of" << originalFile << "to inherited";
     }
 
     const auto oldFile = _item->_file;
@@ -269,7 +299,8 @@ void PropagateLocalRename::start()
         }
     } else {
         propagator()->_renamedDirectories.insert(oldFile, _item->_renameTarget);
-        if (!PropagateRemoteMove::adjustSelectiveSync(propagator()->_journal, oldFile, _item->_renameTarget)) {
+        if (!PropagateRemoteMove::adjustSelectiveSync(propagator()->_journal, oldFile, _item->_renameTarget)
+            || !propagator()->_journal->moveFileRecordsBelow(originalFile, _item->_renameTarget)) {
             done(SyncFileItem::FatalError, tr("Failed to rename file"));
             return;
         }
@@ -43,8 +43,18 @@ public:
     void start() override;
 
 private:
-    bool removeRecursively(const QString &path);
-    QString _error;
+    struct RemoveResult
+    {
+        bool success = true;
+        QString error;
+        QList<QPair<QString, bool>> deleted; /// by a failed recursive removal, see FileSystem::removeRecursively()
+    };
+
+    /// Runs on a worker thread of the LocalIoExecutor
+    static RemoveResult removeLocally(const QString &filename, bool isDirectory, bool moveToTrash);
+    void slotRemoved(const RemoveResult &result);
+    void removeDeletedRecords(const QList<QPair<QString, bool>> &deleted);
+
     bool _moveToTrash;
 };
 
@@ -73,6 +83,7 @@ public:
 
 private:
     void startLocalMkdir();
+    void slotLocalMkdirDone(const QString &error);
     void startDemanglingName(const QString &parentPath);
 
     bool _deleteExistingFile;
@@ -92,5 +103,9 @@ public:
     }
     void start() override;
     JobParallelism parallelism() override { return _item->isDirectory() ? WaitForFinished : FullParallelism; }
+
+private:
+    /// Updates the journal once the local file was renamed
+    void finalizeRename();
 };
 }
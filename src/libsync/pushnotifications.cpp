@@ -16,9 +16,13 @@
 #include "creds/abstractcredentials.h"
 #include "account.h"
 
+#include <QJsonArray>
+#include <QJsonDocument>
+
 namespace {
 static constexpr int MAX_ALLOWED_FAILED_AUTHENTICATION_ATTEMPTS = 3;
 static constexpr int PING_INTERVAL = 30 * 1000;
+static const QString NOTIFY_FILE_ID_PREFIX = QStringLiteral("notify_file_id ");
 }
 
 namespace OCC {
@@ -113,6 +117,8 @@ void PushNotifications::onWebSocketTextMessageReceived(const QString &message)
 
     if (message == "notify_file") {
         handleNotifyFile();
+    } else if (message.startsWith(NOTIFY_FILE_ID_PREFIX)) {
+        handleNotifyFileId(message);
     } else if (message == "notify_activity") {
         handleNotifyActivity();
     } else if (message == "notify_notification") {
@@ -195,6 +201,11 @@ void PushNotifications::handleAuthenticated()
     _failedAuthenticationAttemptsCount = 0;
     _isReady = true;
     startPingTimer();
+
+    // Ask for the ids of changed files, servers that don't know about it
+    // keep sending plain notify_file messages.
+    _webSocket->sendTextMessage(QStringLiteral("listen notify_file_id"));
+
     emit ready();
 
     // We maybe reconnected to websocket while being offline for a
@@ -211,6 +222,34 @@ void PushNotifications::handleNotifyFile()
     emitFilesChanged();
 }
 
+void PushNotifications::handleNotifyFileId(const QString &message)
+{
+    const auto json = QJsonDocument::fromJson(message.midRef(NOTIFY_FILE_ID_PREFIX.size()).toUtf8());
+    if (!json.isArray()) {
+        qCWarning(lcPushNotifications) << "Could not parse file ids, treat as change of any file:" << message;
+        emitFilesChanged();
+        return;
+    }
+
+    QVector<qint64> fileIds;
+    const auto array = json.array();
+    fileIds.reserve(array.size());
+    for (const auto &value : array) {
+        const auto fileId = value.toVariant().toLongLong();
+        if (fileId > 0) {
+            fileIds.append(fileId);
+        }
+    }
+
+    if (fileIds.isEmpty()) {
+        emitFilesChanged();
+        return;
+    }
+
+    qCInfo(lcPushNotifications) << "Files push notification arrived for" << fileIds.size() << "file ids";
+    emit fileIdsChanged(_account, fileIds);
+}
+
 void PushNotifications::handleInvalidCredentials()
 {
     qCInfo(lcPushNotifications) << "Invalid credentials submitted to websocket";
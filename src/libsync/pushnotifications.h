@@ -16,6 +16,7 @@
 
 #include <QWebSocket>
 #include <QTimer>
+#include <QVector>
 
 #include "capabilities.h"
 
@@ -74,6 +75,14 @@ signals:
      */
     void filesChanged(Account *account);
 
+    /**
+     * Will be emitted if files on the server changed and the server told which ones
+     *
+     * Emitted instead of filesChanged(). The ids are the numeric file ids of the
+     * changed files, see SyncJournalFileRecord::numericFileId().
+     */
+    void fileIdsChanged(Account *account, const QVector<qint64> &fileIds);
+
     /**
      * Will be emitted if activities have been changed on the server
      */
@@ -120,6 +129,7 @@ private:
 
     void handleAuthenticated();
     void handleNotifyFile();
+    void handleNotifyFileId(const QString &message);
     void handleInvalidCredentials();
     void handleNotifyNotification();
     void handleNotifyActivity();
@@ -61,8 +61,6 @@ namespace OCC {
 
 Q_LOGGING_CATEGORY(lcEngine, "nextcloud.sync.engine", QtInfoMsg)
 
-bool SyncEngine::s_anySyncRunning = false;
-
 /** When the client touches a file, block change notifications for this duration (ms)
  *
  * On Linux and Windows the file watcher can't distinguish a change that originates
@@ -413,9 +411,8 @@ void OCC::SyncEngine::slotItemDiscovered(const OCC::SyncFileItemPtr &item)
     checkErrorBlacklisting(*item);
     _needsUpdate = true;
 
-    // Insert sorted
-    auto it = std::lower_bound( _syncItems.begin(), _syncItems.end(), item ); // the _syncItems is sorted
-    _syncItems.insert( it, item );
+    // Sorted once discovery is done, see slotDiscoveryFinished()
+    _syncItems.append(item);
 
     slotNewItem(item);
 
@@ -424,6 +421,14 @@ void OCC::SyncEngine::slotItemDiscovered(const OCC::SyncFileItemPtr &item)
     }
 }
 
+void SyncEngine::setParallelNetworkJobs(int jobs)
+{
+    _syncOptions._parallelNetworkJobs = jobs;
+    if (_propagator) {
+        _propagator->setParallelNetworkJobs(jobs);
+    }
+}
+
 void SyncEngine::startSync()
 {
     if (_journal->exists()) {
@@ -439,16 +444,17 @@ void SyncEngine::startSync()
         }
     }
 
-    if (s_anySyncRunning || _syncRunning) {
+    if (_syncRunning) {
         ASSERT(false)
         return;
     }
 
-    s_anySyncRunning = true;
     _syncRunning = true;
     _anotherSyncNeeded = NoFollowUpSync;
     _clearTouchedFilesTimer.stop();
 
+    emit syncStarting();
+
     _hasNoneFiles = false;
     _hasRemoveFile = false;
     _seenConflictFiles.clear();
@@ -537,6 +543,9 @@ void SyncEngine::startSync()
         return;
     }
 
+    _localDiscoveryDecisions.clear();
+    _acceptLateLocalDiscoveryPaths = true;
+
     _stopWatch.start();
     _progressInfo->_status = ProgressInfo::Starting;
     emit transmissionProgress(*_progressInfo);
@@ -563,7 +572,11 @@ void SyncEngine::startSync()
     if (!_discoveryPhase->_remoteFolder.endsWith('/'))
         _discoveryPhase->_remoteFolder+='/';
     _discoveryPhase->_syncOptions = _syncOptions;
-    _discoveryPhase->_shouldDiscoverLocaly = [this](const QString &s) { return shouldDiscoverLocally(s); };
+    _discoveryPhase->_shouldDiscoverLocaly = [this](const QString &s) {
+        const auto result = shouldDiscoverLocally(s);
+        _localDiscoveryDecisions.insert(s, result);
+        return result;
+    };
     _discoveryPhase->setSelectiveSyncBlackList(selectiveSyncBlackList);
     _discoveryPhase->setSelectiveSyncWhiteList(_journal->getSelectiveSyncList(SyncJournalDb::SelectiveSyncWhiteList, &ok));
     if (!ok) {
@@ -604,6 +617,7 @@ void SyncEngine::startSync()
     _discoveryPhase->startJob(discoveryJob);
     connect(discoveryJob, &ProcessDirectoryJob::etag, this, &SyncEngine::slotRootEtagReceived);
     connect(_discoveryPhase.data(), &DiscoveryPhase::addErrorToGui, this, &SyncEngine::addErrorToGui);
+    connect(_discoveryPhase.data(), &DiscoveryPhase::remoteDirectoryListed, this, &SyncEngine::remoteDirectoryListed);
 }
 
 void SyncEngine::slotFolderDiscovered(bool local, const QString &folder)
@@ -648,6 +662,9 @@ void SyncEngine::slotDiscoveryFinished()
 
     qCInfo(lcEngine) << "#### Discovery end #################################################### " << _stopWatch.addLapTime(QLatin1String("Discovery Finished")) << "ms";
 
+    _acceptLateLocalDiscoveryPaths = false;
+    _localDiscoveryDecisions.clear();
+
     // Sanity check
     if (!_journal->open()) {
         qCWarning(lcEngine) << "Bailing out, DB failure";
@@ -664,6 +681,9 @@ void SyncEngine::slotDiscoveryFinished()
     _progressInfo->_status = ProgressInfo::Reconcile;
     emit transmissionProgress(*_progressInfo);
 
+    sortSyncFileItems(_syncItems);
+    qCInfo(lcEngine) << "Sorted" << _syncItems.size() << "items in" << _stopWatch.addLapTime(QStringLiteral("Sort")) << "ms";
+
     //    qCInfo(lcEngine) << "Permissions of the root folder: " << _csync_ctx->remote.root_perms.toString();
     auto finish = [this]{
         auto databaseFingerprint = _journal->dataFingerprint();
@@ -840,7 +860,6 @@ void SyncEngine::finalize(bool success)
     if (_discoveryPhase) {
         _discoveryPhase.take()->deleteLater();
     }
-    s_anySyncRunning = false;
     _syncRunning = false;
     emit finished(success);
 
@@ -850,6 +869,8 @@ void SyncEngine::finalize(bool success)
     _uniqueErrors.clear();
     _localDiscoveryPaths.clear();
     _localDiscoveryStyle = LocalDiscoveryStyle::FilesystemOnly;
+    _acceptLateLocalDiscoveryPaths = false;
+    _localDiscoveryDecisions.clear();
 
     _clearTouchedFilesTimer.start();
 }
@@ -1000,6 +1021,44 @@ bool SyncEngine::shouldDiscoverLocally(const QString &path) const
     return false;
 }
 
+bool SyncEngine::addLocalDiscoveryPath(const QString &path)
+{
+    if (!_syncRunning || !_acceptLateLocalDiscoveryPaths)
+        return false;
+
+    // The parent folder must not have been looked at yet, and nothing above it may
+    // have been skipped: a skipped folder makes its whole subtree come from the db.
+    const auto slash = path.lastIndexOf(QLatin1Char('/'));
+    const QString parent = slash < 0 ? QString() : path.left(slash);
+    if (_localDiscoveryDecisions.contains(parent))
+        return false;
+    for (auto ancestor = parent; !ancestor.isEmpty();) {
+        const auto ancestorSlash = ancestor.lastIndexOf(QLatin1Char('/'));
+        ancestor = ancestorSlash < 0 ? QString() : ancestor.left(ancestorSlash);
+        if (!_localDiscoveryDecisions.value(ancestor, true))
+            return false;
+    }
+
+    // The parent must already be known, otherwise the folder that lists it may have
+    // done so before it was created.
+    if (!parent.isEmpty()) {
+        SyncJournalFileRecord parentRecord;
+        if (!_journal->getFileRecord(parent, &parentRecord) || !parentRecord.isDirectory())
+            return false;
+        if (!QFileInfo(_localPath + parent).isDir())
+            return false;
+    }
+
+    if (_localDiscoveryStyle == LocalDiscoveryStyle::DatabaseAndFilesystem) {
+        // Keep the invariant of setLocalDiscoveryOptions(): no entry contains another
+        auto paths = _localDiscoveryPaths;
+        paths.insert(path);
+        setLocalDiscoveryOptions(LocalDiscoveryStyle::DatabaseAndFilesystem, std::move(paths));
+    }
+    qCInfo(lcEngine) << "Local change during discovery will be picked up by the running sync:" << path;
+    return true;
+}
+
 void SyncEngine::wipeVirtualFiles(const QString &localPath, SyncJournalDb &journal, Vfs &vfs)
 {
     qCInfo(lcEngine) << "Wiping virtual files inside" << localPath;
@@ -22,6 +22,7 @@
 #include <QString>
 #include <QSet>
 #include <QMap>
+#include <QHash>
 #include <QStringList>
 #include <QSharedPointer>
 #include <set>
@@ -71,6 +72,8 @@ public:
 
     SyncOptions syncOptions() const { return _syncOptions; }
     void setSyncOptions(const SyncOptions &options) { _syncOptions = options; }
+    /** Changes SyncOptions::_parallelNetworkJobs, also for the running propagation */
+    void setParallelNetworkJobs(int jobs);
     bool ignoreHiddenFiles() const { return _ignore_hidden_files; }
     void setIgnoreHiddenFiles(bool ignore) { _ignore_hidden_files = ignore; }
 
@@ -121,6 +124,19 @@ public:
      */
     bool shouldDiscoverLocally(const QString &path) const;
 
+    /**
+     * Offers a path that changed locally while a sync is running to the running
+     * local discovery.
+     *
+     * Returns true if the discovery of this sync run has not yet decided about the
+     * path's parent directory and will therefore still pick the change up. In that
+     * case no follow-up sync is needed for the path.
+     *
+     * Returns false once the discovery is over or if the change can't be folded
+     * into it anymore; the caller should keep the path for the next sync.
+     */
+    bool addLocalDiscoveryPath(const QString &path);
+
     /** Access the last sync run's local discovery style */
     LocalDiscoveryStyle lastLocalDiscoveryStyle() const { return _lastLocalDiscoveryStyle; }
 
@@ -158,6 +174,12 @@ signals:
     void finished(bool success);
     void started();
 
+    /// At the very start of a sync run, before discovery; finished() always follows
+    void syncStarting();
+
+    /// A remote directory was listed during discovery, for statistics
+    void remoteDirectoryListed(std::chrono::milliseconds duration);
+
     /**
      * Emited when the sync engine detects that all the files have been removed or change.
      * This usually happen when the server was reset or something.
@@ -226,8 +248,6 @@ private:
     // cleanup and emit the finished signal
     void finalize(bool success);
 
-    static bool s_anySyncRunning; //true when one sync is running somewhere (for debugging)
-
     // Must only be acessed during update and reconcile
     QVector<SyncFileItemPtr> _syncItems;
 
@@ -295,6 +315,12 @@ private:
     LocalDiscoveryStyle _lastLocalDiscoveryStyle = LocalDiscoveryStyle::FilesystemOnly;
     LocalDiscoveryStyle _localDiscoveryStyle = LocalDiscoveryStyle::FilesystemOnly;
     std::set<QString> _localDiscoveryPaths;
+
+    /** Whether addLocalDiscoveryPath() may still fold paths into the running discovery */
+    bool _acceptLateLocalDiscoveryPaths = false;
+
+    /** Result of every shouldDiscoverLocally() call made by the running discovery, by folder */
+    QHash<QString, bool> _localDiscoveryDecisions;
 };
 }
 
@@ -18,8 +18,13 @@
 #include "filesystem.h"
 
 #include <QLoggingCategory>
+#include <QThread>
+#include <QtConcurrent>
 #include "csync/vio/csync_vio_local.h"
 
+#include <algorithm>
+#include <array>
+
 namespace OCC {
 
 Q_LOGGING_CATEGORY(lcFileItem, "nextcloud.sync.fileitem", QtInfoMsg)
@@ -78,4 +83,42 @@ SyncFileItemPtr SyncFileItem::fromSyncJournalFileRecord(const SyncJournalFileRec
     return item;
 }
 
+void sortSyncFileItems(SyncFileItemVector &items)
+{
+    // Below this, spreading the work costs more than it saves
+    constexpr int minimumChunkSize = 16 * 1024;
+
+    const auto chunkCount = std::min(QThread::idealThreadCount(), items.size() / minimumChunkSize);
+    if (chunkCount < 2) {
+        std::stable_sort(items.begin(), items.end());
+        return;
+    }
+
+    // Detach once up front, the workers only touch disjoint ranges of the raw data
+    const auto data = items.data();
+
+    QVector<QPair<int, int>> ranges;
+    for (int i = 0; i < chunkCount; ++i) {
+        ranges.append({ items.size() * i / chunkCount, items.size() * (i + 1) / chunkCount });
+    }
+    QtConcurrent::blockingMap(ranges, [data](const QPair<int, int> &range) {
+        std::stable_sort(data + range.first, data + range.second);
+    });
+
+    while (ranges.size() > 1) {
+        QVector<QPair<int, int>> merged;
+        QVector<std::array<int, 3>> merges;
+        for (int i = 0; i + 1 < ranges.size(); i += 2) {
+            merges.append({ ranges[i].first, ranges[i].second, ranges[i + 1].second });
+            merged.append({ ranges[i].first, ranges[i + 1].second });
+        }
+        if (ranges.size() % 2)
+            merged.append(ranges.last());
+        QtConcurrent::blockingMap(merges, [data](const std::array<int, 3> &merge) {
+            std::inplace_merge(data + merge[0], data + merge[1], data + merge[2]);
+        });
+        ranges = merged;
+    }
+}
+
 }
@@ -123,9 +123,10 @@ public:
 
     friend bool operator<(const SyncFileItem &item1, const SyncFileItem &item2)
     {
-        // Sort by destination
-        auto d1 = item1.destination();
-        auto d2 = item2.destination();
+        // Sort by destination, see destination(). Bound by reference since
+        // sorting compares millions of times and copies aren't free.
+        const QString &d1 = item1._renameTarget.isEmpty() ? item1._file : item1._renameTarget;
+        const QString &d2 = item2._renameTarget.isEmpty() ? item2._file : item2._renameTarget;
 
         // But this we need to order it so the slash come first. It should be this order:
         //  "foo", "foo/bar", "foo-bar"
@@ -286,6 +287,13 @@ inline bool operator<(const SyncFileItemPtr &item1, const SyncFileItemPtr &item2
 }
 
 using SyncFileItemVector = QVector<SyncFileItemPtr>;
+
+/**
+ * Sorts items by destination, like std::stable_sort with operator<
+ *
+ * Large vectors are sorted in chunks on the global thread pool and then merged.
+ */
+OWNCLOUDSYNC_EXPORT void sortSyncFileItems(SyncFileItemVector &items);
 }
 
 Q_DECLARE_METATYPE(OCC::SyncFileItem)
@@ -0,0 +1,206 @@
+/*
+ * Copyright (C) by Nextcloud GmbH
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ */
+
+#include "syncstatistics.h"
+#include "account.h"
+#include "syncengine.h"
+#include "common/syncjournaldb.h"
+
+#include <QDateTime>
+#include <QJsonArray>
+#include <QMetaEnum>
+
+#if defined(Q_OS_WIN)
+#include <windows.h>
+#include <psapi.h>
+#elif defined(Q_OS_UNIX)
+#include <sys/resource.h>
+#endif
+
+namespace OCC {
+
+namespace {
+
+    // Upper bounds of the PROPFIND duration histogram buckets, one more bucket is unbounded
+    const qint64 propfindBucketsMsec[] = { 50, 100, 250, 500, 1000, 2500, 5000 };
+
+    QString enumKey(const QMetaEnum &metaEnum, int value, const char *prefix = "")
+    {
+        QString key = QString::fromLatin1(metaEnum.valueToKey(value));
+        if (key.startsWith(QLatin1String(prefix)))
+            key = key.mid(qstrlen(prefix));
+        return key.toLower();
+    }
+}
+
+SyncStatistics::SyncStatistics(SyncEngine *engine, SyncJournalDb *journal, QObject *parent)
+    : QObject(parent)
+    , _engine(engine)
+    , _journal(journal)
+{
+    static_assert(sizeof(propfindBucketsMsec) / sizeof(propfindBucketsMsec[0]) + 1 == std::tuple_size<decltype(_propfindHistogram)>::value,
+        "one histogram entry per bucket");
+
+    connect(engine, &SyncEngine::syncStarting, this, &SyncStatistics::slotStarted);
+    connect(engine, &SyncEngine::aboutToPropagate, this, &SyncStatistics::slotAboutToPropagate);
+    connect(engine, &SyncEngine::itemCompleted, this, &SyncStatistics::slotItemCompleted);
+    connect(engine, &SyncEngine::remoteDirectoryListed, this, &SyncStatistics::slotRemoteDirectoryListed);
+    connect(engine, &SyncEngine::finished, this, &SyncStatistics::slotFinished);
+}
+
+qint64 SyncStatistics::peakMemoryUsage()
+{
+#if defined(Q_OS_WIN)
+    PROCESS_MEMORY_COUNTERS counters;
+    if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+        return counters.PeakWorkingSetSize;
+    return 0;
+#elif defined(Q_OS_UNIX)
+    rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0)
+        return 0;
+#ifdef Q_OS_MAC
+    return usage.ru_maxrss; // bytes
+#else
+    return qint64(usage.ru_maxrss) * 1024; // kilobytes
+#endif
+#else
+    return 0;
+#endif
+}
+
+AccessManager::RequestStatistics SyncStatistics::requestStatistics() const
+{
+    if (_engine) {
+        if (auto accessManager = qobject_cast<AccessManager *>(_engine->account()->networkAccessManager())) {
+            return accessManager->requestStatistics();
+        }
+    }
+    return {};
+}
+
+void SyncStatistics::slotStarted()
+{
+    _runTimer.start();
+    _discoveryMsec = -1;
+    _commitCountAtStart = _journal->commitCount();
+    _items.clear();
+    _statuses.clear();
+    _retries = 0;
+    _propfindCount = 0;
+    _propfindTotalMsec = 0;
+    _propfindHistogram.fill(0);
+    _requestsAtStart = requestStatistics();
+}
+
+void SyncStatistics::slotAboutToPropagate()
+{
+    _discoveryMsec = _runTimer.elapsed();
+}
+
+void SyncStatistics::slotItemCompleted(const SyncFileItemPtr &item)
+{
+    static const auto directions = QMetaEnum::fromType<SyncFileItem::Direction>();
+    static const auto instructions = QMetaEnum::fromType<SyncInstructions>();
+    static const auto statuses = QMetaEnum::fromType<SyncFileItem::Status>();
+
+    auto &counter = _items[enumKey(directions, item->_direction)][enumKey(instructions, item->_instruction, "CSYNC_INSTRUCTION_")];
+    counter.count++;
+    if (item->isDirectory()) {
+        // no content is transferred
+    } else if (item->_instruction == CSYNC_INSTRUCTION_NEW || item->_instruction == CSYNC_INSTRUCTION_SYNC
+        || item->_instruction == CSYNC_INSTRUCTION_CONFLICT) {
+        counter.bytes += item->_size;
+    }
+
+    _statuses[enumKey(statuses, item->_status)]++;
+    if (item->_hasBlacklistEntry) {
+        _retries++;
+    }
+}
+
+void SyncStatistics::slotRemoteDirectoryListed(std::chrono::milliseconds duration)
+{
+    const auto msec = duration.count();
+    _propfindCount++;
+    _propfindTotalMsec += msec;
+
+    size_t bucket = 0;
+    for (const auto bound : propfindBucketsMsec) {
+        if (msec < bound)
+            break;
+        ++bucket;
+    }
+    _propfindHistogram[bucket]++;
+}
+
+void SyncStatistics::slotFinished(bool success)
+{
+    if (!_runTimer.isValid()) {
+        return;
+    }
+    const auto totalMsec = _runTimer.elapsed();
+    _runTimer.invalidate();
+
+    QJsonObject items;
+    for (auto direction = _items.cbegin(); direction != _items.cend(); ++direction) {
+        QJsonObject instructions;
+        for (auto instruction = direction->cbegin(); instruction != direction->cend(); ++instruction) {
+            instructions.insert(instruction.key(), QJsonObject { { QStringLiteral("count"), instruction->count }, { QStringLiteral("bytes"), instruction->bytes } });
+        }
+        items.insert(direction.key(), instructions);
+    }
+
+    QJsonObject statuses;
+    for (auto it = _statuses.cbegin(); it != _statuses.cend(); ++it) {
+        statuses.insert(it.key(), it.value());
+    }
+
+    QJsonArray histogram;
+    for (size_t i = 0; i < _propfindHistogram.size(); ++i) {
+        const auto bound = i < _propfindHistogram.size() - 1 ? QJsonValue(propfindBucketsMsec[i]) : QJsonValue();
+        histogram.append(QJsonObject { { QStringLiteral("belowMsec"), bound }, { QStringLiteral("count"), _propfindHistogram[i] } });
+    }
+
+    const auto requests = requestStatistics();
+
+    // Without propagation, discovery took the whole run
+    const auto discoveryMsec = _discoveryMsec < 0 ? totalMsec : _discoveryMsec;
+
+    QJsonObject statistics {
+        { QStringLiteral("finishedAt"), QDateTime::currentDateTimeUtc().toString(Qt::ISODateWithMs) },
+        { QStringLiteral("success"), success },
+        { QStringLiteral("localPath"), _engine ? _engine->localPath() : QString() },
+        { QStringLiteral("durationMsec"), QJsonObject {
+            { QStringLiteral("total"), totalMsec },
+            { QStringLiteral("discovery"), discoveryMsec },
+            { QStringLiteral("propagation"), totalMsec - discoveryMsec } } },
+        { QStringLiteral("items"), items },
+        { QStringLiteral("itemStatus"), statuses },
+        { QStringLiteral("retries"), _retries },
+        { QStringLiteral("propfind"), QJsonObject {
+            { QStringLiteral("count"), _propfindCount },
+            { QStringLiteral("totalMsec"), _propfindTotalMsec },
+            { QStringLiteral("histogram"), histogram } } },
+        { QStringLiteral("requests"), QJsonObject {
+            { QStringLiteral("http1"), requests.http1Requests - _requestsAtStart.http1Requests },
+            { QStringLiteral("http2"), requests.http2Requests - _requestsAtStart.http2Requests },
+            { QStringLiteral("tlsHandshakes"), requests.tlsHandshakes - _requestsAtStart.tlsHandshakes } } },
+        { QStringLiteral("journalCommits"), _journal->commitCount() - _commitCountAtStart },
+        { QStringLiteral("peakMemoryBytes"), peakMemoryUsage() },
+    };
+    emit runFinished(statistics);
+}
+
+}
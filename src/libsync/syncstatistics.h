@@ -0,0 +1,96 @@
+/*
+ * Copyright (C) by Nextcloud GmbH
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ */
+
+#pragma once
+
+#include "owncloudlib.h"
+#include "accessmanager.h"
+#include "syncfileitem.h"
+
+#include <QElapsedTimer>
+#include <QHash>
+#include <QJsonObject>
+#include <QObject>
+#include <QPointer>
+
+#include <array>
+#include <chrono>
+
+namespace OCC {
+
+class SyncEngine;
+class SyncJournalDb;
+
+/**
+ * @brief Collects machine-readable statistics about each sync run of an engine
+ * @ingroup libsync
+ *
+ * For every run, from SyncEngine::syncStarting() to SyncEngine::finished(),
+ * runFinished() is emitted with a JSON record of:
+ *  - item counts and bytes by direction and instruction, item status counts
+ *    and the number of items that were retried after an earlier error,
+ *  - the durations of the discovery and propagation phases,
+ *  - the number of PROPFINDs and a histogram of their durations,
+ *  - the requests of the account over HTTP/1.1 and HTTP/2 and the TLS
+ *    handshakes they took, including those of other folders syncing meanwhile,
+ *  - the number of journal commits,
+ *  - the peak memory use of the process.
+ */
+class OWNCLOUDSYNC_EXPORT SyncStatistics : public QObject
+{
+    Q_OBJECT
+public:
+    SyncStatistics(SyncEngine *engine, SyncJournalDb *journal, QObject *parent = nullptr);
+
+    /// Peak resident memory of the process in bytes, 0 if unknown
+    static qint64 peakMemoryUsage();
+
+signals:
+    void runFinished(const QJsonObject &statistics);
+
+private slots:
+    void slotStarted();
+    void slotAboutToPropagate();
+    void slotItemCompleted(const SyncFileItemPtr &item);
+    void slotRemoteDirectoryListed(std::chrono::milliseconds duration);
+    void slotFinished(bool success);
+
+private:
+    AccessManager::RequestStatistics requestStatistics() const;
+
+    struct Counter
+    {
+        qint64 count = 0;
+        qint64 bytes = 0;
+    };
+
+    QPointer<SyncEngine> _engine;
+    SyncJournalDb *_journal;
+
+    QElapsedTimer _runTimer;
+    qint64 _discoveryMsec = -1;
+    int _commitCountAtStart = 0;
+
+    QHash<QString, QHash<QString, Counter>> _items; /// by direction, then instruction
+    QHash<QString, qint64> _statuses;
+    qint64 _retries = 0;
+
+    qint64 _propfindCount = 0;
+    qint64 _propfindTotalMsec = 0;
+    std::array<qint64, 8> _propfindHistogram = {}; /// counts per duration bucket, see the .cpp
+
+    AccessManager::RequestStatistics _requestsAtStart;
+};
+
+}
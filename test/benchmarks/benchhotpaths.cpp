@@ -0,0 +1,262 @@
+/*
+ *    This software is in the public domain, furnished "as is", without technical
+ *    support, and with no warranty, express or implied, as to its usefulness for
+ *    any purpose.
+ *
+ */
+
+/*
+ * Microbenchmarks for the primitives that dominate discovery and reconcile.
+ *
+ * Run with the usual QtTest benchmark options, for example
+ *   HotPathsBench -tickcounter -o result.xml,xml
+ * to record per-operation cost in a machine-readable form.
+ */
+
+#include <QtTest>
+#include <QTemporaryDir>
+
+#include "common/checksums.h"
+#include "common/syncjournaldb.h"
+#include "common/syncjournalfilerecord.h"
+#include "csync_exclude.h"
+#include "vio/csync_vio_local.h"
+#include "networkjobs.h"
+#include "syncfileitem.h"
+
+#include <algorithm>
+
+using namespace OCC;
+
+#define EXCLUDE_LIST_FILE SOURCEDIR "/../../sync-exclude.lst"
+
+namespace {
+
+constexpr int JournalRecordCount = 20000;
+constexpr int DirectoryEntryCount = 5000;
+constexpr int PropfindEntryCount = 1000;
+constexpr int SortItemCount = 100000;
+
+QByteArray recordPath(int i)
+{
+    // 50 entries per directory, three levels deep
+    return QByteArray("dir") + QByteArray::number(i / 2500) + "/sub" + QByteArray::number((i / 50) % 50)
+        + "/file" + QByteArray::number(i) + ".txt";
+}
+
+QByteArray propfindXml(int entries)
+{
+    QByteArray xml = "<?xml version='1.0' encoding='utf-8'?>"
+                     "<d:multistatus xmlns:d=\"DAV:\" xmlns:s=\"http://sabredav.org/ns\" xmlns:oc=\"http://owncloud.org/ns\" xmlns:nc=\"http://nextcloud.org/ns\">"
+                     "<d:response><d:href>/remote.php/dav/files/admin/folder/</d:href>"
+                     "<d:propstat><d:prop><oc:id>00000001ocobzus5kn6s</oc:id><oc:permissions>RDNVCK</oc:permissions>"
+                     "<oc:size>121780</oc:size><d:getetag>\"5527beb0400b0\"</d:getetag>"
+                     "<d:resourcetype><d:collection/></d:resourcetype>"
+                     "<d:getlastmodified>Fri, 06 Feb 2015 13:49:55 GMT</d:getlastmodified>"
+                     "</d:prop><d:status>HTTP/1.1 200 OK</d:status></d:propstat></d:response>";
+    for (int i = 0; i < entries; ++i) {
+        const auto n = QByteArray::number(i);
+        xml += "<d:response><d:href>/remote.php/dav/files/admin/folder/document%20" + n + ".pdf</d:href>"
+               "<d:propstat><d:prop><oc:id>" + n.rightJustified(8, '0') + "ocobzus5kn6s</oc:id>"
+               "<oc:permissions>RDNVW</oc:permissions>"
+               "<d:getetag>\"2fa2f0d9ed49ea0c3e409d49e652" + n + "\"</d:getetag>"
+               "<d:resourcetype/>"
+               "<d:getlastmodified>Fri, 06 Feb 2015 13:49:55 GMT</d:getlastmodified>"
+               "<d:getcontentlength>121780</d:getcontentlength>"
+               "<oc:checksums><oc:checksum>SHA1:a94a8fe5ccb19ba61c4c0873d391e987982fbbd3</oc:checksum></oc:checksums>"
+               "</d:prop><d:status>HTTP/1.1 200 OK</d:status></d:propstat>"
+               "<d:propstat><d:prop><oc:downloadURL/><oc:dDC/></d:prop>"
+               "<d:status>HTTP/1.1 404 Not Found</d:status></d:propstat></d:response>";
+    }
+    xml += "</d:multistatus>";
+    return xml;
+}
+
+}
+
+class BenchHotPaths : public QObject
+{
+    Q_OBJECT
+
+    QTemporaryDir _tempDir;
+    QScopedPointer<SyncJournalDb> _db;
+
+private slots:
+    void initTestCase()
+    {
+        QVERIFY(_tempDir.isValid());
+        _db.reset(new SyncJournalDb(_tempDir.path() + QStringLiteral("/sync.db")));
+
+        SyncJournalFileRecord record;
+        record._type = ItemTypeFile;
+        record._remotePerm = RemotePermissions::fromDbValue("RW");
+        record._checksumHeader = "SHA1:a94a8fe5ccb19ba61c4c0873d391e987982fbbd3";
+        for (int i = 0; i < JournalRecordCount; ++i) {
+            record._path = recordPath(i);
+            record._inode = i + 1;
+            record._modtime = 1500000000 + i;
+            record._fileSize = 4096;
+            record._etag = "etag" + QByteArray::number(i);
+            record._fileId = QByteArray::number(i).rightJustified(8, '0') + "ocobzus5kn6s";
+            QVERIFY(_db->setFileRecord(record));
+        }
+        _db->commit(QStringLiteral("bench setup"));
+    }
+
+    void benchGetFileRecord()
+    {
+        int i = 0;
+        SyncJournalFileRecord record;
+        QBENCHMARK {
+            QVERIFY(_db->getFileRecord(recordPath(i), &record));
+            QVERIFY(record.isValid());
+            i = (i + 7919) % JournalRecordCount;
+        }
+    }
+
+    void benchSetFileRecord()
+    {
+        SyncJournalFileRecord record;
+        QVERIFY(_db->getFileRecord(recordPath(42), &record));
+        qint64 modtime = record._modtime;
+        QBENCHMARK {
+            record._modtime = ++modtime;
+            QVERIFY(_db->setFileRecord(record));
+        }
+        _db->commit(QStringLiteral("bench setFileRecord"));
+    }
+
+    void benchListFilesInPath()
+    {
+        int count = 0;
+        QBENCHMARK {
+            count = 0;
+            QVERIFY(_db->listFilesInPath("dir3/sub7", [&](const SyncJournalFileRecord &) { ++count; }));
+        }
+        QCOMPARE(count, 50);
+    }
+
+    void benchIsExcluded_data()
+    {
+        QTest::addColumn<QString>("path");
+        QTest::newRow("short") << QStringLiteral("/sync/folder/file.txt");
+        QTest::newRow("deep") << QStringLiteral("/sync/folder/this/is/quite/a/long/path/with/many/components/file.txt");
+        QTest::newRow("excluded") << QStringLiteral("/sync/folder/project/.DS_Store");
+    }
+
+    void benchIsExcluded()
+    {
+        QFETCH(QString, path);
+        ExcludedFiles excludedFiles;
+        excludedFiles.addExcludeFilePath(QStringLiteral(EXCLUDE_LIST_FILE));
+        QVERIFY(excludedFiles.reloadExcludeFiles());
+        const QString basePath = QStringLiteral("/sync/folder/");
+        bool excluded = false;
+        QBENCHMARK {
+            excluded = excludedFiles.isExcluded(path, basePath, false);
+        }
+        Q_UNUSED(excluded);
+    }
+
+    void benchComputeChecksum_data()
+    {
+        QTest::addColumn<QByteArray>("type");
+        QTest::addColumn<int>("size");
+        for (const char *type : { checkSumMD5C, checkSumSHA1C, checkSumSHA2C, checkSumSHA3C, checkSumAdlerC }) {
+            QTest::newRow(QByteArray(QByteArray(type) + " 4KiB").constData()) << QByteArray(type) << 4 * 1024;
+            QTest::newRow(QByteArray(QByteArray(type) + " 16MiB").constData()) << QByteArray(type) << 16 * 1024 * 1024;
+        }
+    }
+
+    void benchComputeChecksum()
+    {
+        QFETCH(QByteArray, type);
+        QFETCH(int, size);
+        QByteArray data(size, 'W');
+        QBuffer buffer(&data);
+        QVERIFY(buffer.open(QIODevice::ReadOnly));
+        QByteArray checksum;
+        QBENCHMARK {
+            buffer.seek(0);
+            checksum = ComputeChecksum::computeNow(&buffer, type);
+        }
+        QVERIFY(!checksum.isEmpty());
+    }
+
+    void benchLsColXMLParser()
+    {
+        const auto xml = propfindXml(PropfindEntryCount);
+        int items = 0;
+        QBENCHMARK {
+            LsColXMLParser parser;
+            items = 0;
+            connect(&parser, &LsColXMLParser::directoryListingIterated, this, [&items] { ++items; });
+            QHash<QString, ExtraFolderInfo> sizes;
+            QVERIFY(parser.parse(xml, &sizes, QStringLiteral("/remote.php/dav/files/admin/folder")));
+        }
+        QCOMPARE(items, PropfindEntryCount + 1);
+    }
+
+    void benchSyncFileItemSort()
+    {
+        QVector<SyncFileItemPtr> source;
+        source.reserve(SortItemCount);
+        for (int i = 0; i < SortItemCount; ++i) {
+            auto item = SyncFileItemPtr::create();
+            item->_file = QString::fromUtf8(recordPath((i * 7919) % SortItemCount));
+            if (i % 20 == 0)
+                item->_renameTarget = item->_file + QStringLiteral(".moved");
+            source.append(item);
+        }
+        QVector<SyncFileItemPtr> items;
+        QBENCHMARK {
+            items = source;
+            std::sort(items.begin(), items.end(), [](const SyncFileItemPtr &a, const SyncFileItemPtr &b) { return *a < *b; });
+        }
+        QVERIFY(std::is_sorted(items.begin(), items.end(), [](const SyncFileItemPtr &a, const SyncFileItemPtr &b) { return *a < *b; }));
+    }
+
+    void benchSortSyncFileItems()
+    {
+        QVector<SyncFileItemPtr> source;
+        source.reserve(SortItemCount);
+        for (int i = 0; i < SortItemCount; ++i) {
+            auto item = SyncFileItemPtr::create();
+            item->_file = QString::fromUtf8(recordPath((i * 7919) % SortItemCount));
+            if (i % 20 == 0)
+                item->_renameTarget = item->_file + QStringLiteral(".moved");
+            source.append(item);
+        }
+        QVector<SyncFileItemPtr> items;
+        QBENCHMARK {
+            items = source;
+            sortSyncFileItems(items);
+        }
+        QVERIFY(std::is_sorted(items.begin(), items.end()));
+    }
+
+    void benchLocalReaddir()
+    {
+        QTemporaryDir dir;
+        QVERIFY(dir.isValid());
+        for (int i = 0; i < DirectoryEntryCount; ++i) {
+            QFile f(dir.filePath(QStringLiteral("file%1.txt").arg(i)));
+            QVERIFY(f.open(QIODevice::WriteOnly));
+            f.write("x");
+        }
+        int entries = 0;
+        QBENCHMARK {
+            entries = 0;
+            auto dh = csync_vio_local_opendir(dir.path());
+            QVERIFY(dh);
+            while (auto dirent = csync_vio_local_readdir(dh, nullptr)) {
+                ++entries;
+            }
+            csync_vio_local_closedir(dh);
+        }
+        QCOMPARE(entries, DirectoryEntryCount);
+    }
+};
+
+QTEST_GUILESS_MAIN(BenchHotPaths)
+#include "benchhotpaths.moc"
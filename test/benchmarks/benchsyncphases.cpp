@@ -0,0 +1,319 @@
+/*
+ *    This software is in the public domain, furnished "as is", without technical
+ *    support, and with no warranty, express or implied, as to its usefulness for
+ *    any purpose.
+ *
+ */
+
+/*
+ * Parameterized sync benchmark on top of FakeFolder/FakeQNAM.
+ *
+ * Runs three scenarios on a synthetic tree: the initial sync, a no-op resync and
+ * a sync after a mix of renames and deletes. For each it reports the discovery,
+ * reconcile and propagation times, the number of heap allocations and the peak
+ * RSS as JSON. With --baseline the results are compared against a previously
+ * stored JSON file and the process exits with 1 if a metric regressed by more
+ * than --tolerance percent.
+ */
+
+#include "syncenginetestutils.h"
+#include <syncengine.h>
+#include "common/vfs.h"
+
+#include <QCommandLineParser>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QRandomGenerator>
+
+#include <atomic>
+#include <cstdlib>
+#include <iostream>
+#include <new>
+
+#ifdef Q_OS_UNIX
+#include <sys/resource.h>
+#endif
+
+using namespace OCC;
+
+namespace {
+std::atomic<quint64> allocationCount{ 0 };
+}
+
+// Count every heap allocation done by the process; cheap enough to keep on all the time.
+void *operator new(std::size_t size)
+{
+    allocationCount.fetch_add(1, std::memory_order_relaxed);
+    if (void *p = std::malloc(size ? size : 1))
+        return p;
+    throw std::bad_alloc();
+}
+
+void operator delete(void *p) noexcept
+{
+    std::free(p);
+}
+
+void operator delete(void *p, std::size_t) noexcept
+{
+    std::free(p);
+}
+
+namespace {
+
+struct TreeShape
+{
+    int filesPerDir = 10;
+    int dirsPerDir = 8;
+    int depth = 4;
+    qint64 fileSize = 64;
+};
+
+struct Options
+{
+    TreeShape shape;
+    double renameRatio = 0.05;
+    double deleteRatio = 0.05;
+    bool upload = true;
+    QString vfs = QStringLiteral("off");
+    bool bulkUpload = false;
+};
+
+qint64 peakRssKb()
+{
+#ifdef Q_OS_UNIX
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) == 0) {
+#ifdef Q_OS_MAC
+        return usage.ru_maxrss / 1024; // bytes on macOS
+#else
+        return usage.ru_maxrss;
+#endif
+    }
+#endif
+    return -1;
+}
+
+void addTree(const TreeShape &shape, int depth, const QString &path, FileModifier &fi, QStringList &files, int &dirCount)
+{
+    for (int fileNum = 1; fileNum <= shape.filesPerDir; ++fileNum) {
+        const QString name = QStringLiteral("file") + QString::number(fileNum);
+        const QString filePath = path.isEmpty() ? name : path + QLatin1Char('/') + name;
+        fi.insert(filePath, shape.fileSize);
+        files.append(filePath);
+    }
+    if (depth >= shape.depth)
+        return;
+    for (int dirNum = 1; dirNum <= shape.dirsPerDir; ++dirNum) {
+        const QString name = QStringLiteral("dir") + QString::number(dirNum);
+        const QString subPath = path.isEmpty() ? name : path + QLatin1Char('/') + name;
+        fi.mkdir(subPath);
+        ++dirCount;
+        addTree(shape, depth + 1, subPath, fi, files, dirCount);
+    }
+}
+
+QJsonObject runSync(FakeFolder &fakeFolder, const QString &scenario)
+{
+    auto &stopWatch = fakeFolder.syncEngine().stopWatch();
+    stopWatch.reset();
+    const auto allocationsBefore = allocationCount.load();
+
+    QElapsedTimer timer;
+    timer.start();
+    const bool ok = fakeFolder.syncOnce();
+    const auto total = timer.elapsed();
+
+    // The engine records laps relative to the start of the sync run
+    const auto discoveryEnd = stopWatch.durationOfLap(QStringLiteral("Discovery Finished"));
+    const auto reconcileEnd = stopWatch.durationOfLap(QStringLiteral("Reconcile (aboutToPropagate)"));
+    const auto propagationStart = stopWatch.durationOfLap(QStringLiteral("Post-Reconcile Finished"));
+    const auto syncEnd = stopWatch.durationOfLap(QStringLiteral("Sync Finished"));
+
+    QJsonObject result;
+    result[QStringLiteral("scenario")] = scenario;
+    result[QStringLiteral("success")] = ok;
+    result[QStringLiteral("discovery_ms")] = qint64(discoveryEnd);
+    result[QStringLiteral("reconcile_ms")] = qint64(reconcileEnd >= discoveryEnd ? reconcileEnd - discoveryEnd : 0);
+    result[QStringLiteral("propagation_ms")] = qint64(syncEnd >= propagationStart ? syncEnd - propagationStart : 0);
+    result[QStringLiteral("total_ms")] = total;
+    result[QStringLiteral("allocations")] = qint64(allocationCount.load() - allocationsBefore);
+    result[QStringLiteral("peak_rss_kb")] = peakRssKb();
+    return result;
+}
+
+QJsonArray runBenchmark(const Options &options, QJsonObject &parameters)
+{
+    QJsonArray results;
+
+    FakeFolder fakeFolder{ FileInfo{} };
+    if (options.vfs == QLatin1String("suffix")) {
+        fakeFolder.switchToVfs(QSharedPointer<Vfs>(createVfsFromPlugin(Vfs::WithSuffix).release()));
+    }
+    if (options.bulkUpload) {
+        fakeFolder.syncEngine().account()->setCapabilities({ { "dav", QVariantMap{ { "bulkupload", "1.0" } } } });
+    }
+
+    QStringList files;
+    int dirCount = 0;
+    FileModifier &origin = options.upload ? static_cast<FileModifier &>(fakeFolder.localModifier())
+                                          : static_cast<FileModifier &>(fakeFolder.remoteModifier());
+    addTree(options.shape, 0, QString(), origin, files, dirCount);
+    parameters[QStringLiteral("files")] = files.size();
+    parameters[QStringLiteral("dirs")] = dirCount;
+
+    results.append(runSync(fakeFolder, QStringLiteral("initial")));
+    results.append(runSync(fakeFolder, QStringLiteral("noop")));
+
+    // Same seed on every run so that results are comparable with a baseline
+    QRandomGenerator random(42);
+    int renamed = 0;
+    int deleted = 0;
+    for (const auto &file : qAsConst(files)) {
+        const double roll = random.generateDouble();
+        if (roll < options.renameRatio) {
+            origin.rename(file, file + QStringLiteral(".renamed"));
+            ++renamed;
+        } else if (roll < options.renameRatio + options.deleteRatio) {
+            origin.remove(file);
+            ++deleted;
+        }
+    }
+    parameters[QStringLiteral("renamed")] = renamed;
+    parameters[QStringLiteral("deleted")] = deleted;
+    results.append(runSync(fakeFolder, QStringLiteral("renameDelete")));
+
+    return results;
+}
+
+// Returns the number of regressions found
+int compareWithBaseline(const QJsonArray &results, const QJsonArray &baseline, double tolerance)
+{
+    static const char *metrics[] = { "discovery_ms", "reconcile_ms", "propagation_ms", "total_ms", "allocations", "peak_rss_kb" };
+    // Timer granularity makes tiny values too noisy to compare
+    constexpr qint64 minimumComparable = 10;
+
+    int regressions = 0;
+    for (const auto &value : results) {
+        const auto current = value.toObject();
+        const auto scenario = current.value(QStringLiteral("scenario")).toString();
+        const auto it = std::find_if(baseline.begin(), baseline.end(), [&](const QJsonValue &b) {
+            return b.toObject().value(QStringLiteral("scenario")).toString() == scenario;
+        });
+        if (it == baseline.end()) {
+            std::cerr << "no baseline for scenario " << qPrintable(scenario) << std::endl;
+            continue;
+        }
+        const auto reference = it->toObject();
+        for (const char *metric : metrics) {
+            const auto key = QLatin1String(metric);
+            const auto before = reference.value(key).toVariant().toLongLong();
+            const auto now = current.value(key).toVariant().toLongLong();
+            if (before < minimumComparable && now < minimumComparable)
+                continue;
+            const double change = before > 0 ? 100.0 * (now - before) / before : 100.0;
+            std::cout << qPrintable(scenario) << " " << metric << ": " << before << " -> " << now
+                      << " (" << (change >= 0 ? "+" : "") << change << "%)";
+            if (change > tolerance) {
+                std::cout << " REGRESSION";
+                ++regressions;
+            }
+            std::cout << std::endl;
+        }
+    }
+    return regressions;
+}
+
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription(QStringLiteral("Sync engine phase benchmark"));
+    parser.addHelpOption();
+    const QCommandLineOption filesOption(QStringLiteral("files-per-dir"), QStringLiteral("Files in each directory"), QStringLiteral("n"), QStringLiteral("10"));
+    const QCommandLineOption dirsOption(QStringLiteral("dirs-per-dir"), QStringLiteral("Subdirectories in each directory"), QStringLiteral("n"), QStringLiteral("8"));
+    const QCommandLineOption depthOption(QStringLiteral("depth"), QStringLiteral("Depth of the tree"), QStringLiteral("n"), QStringLiteral("4"));
+    const QCommandLineOption sizeOption(QStringLiteral("file-size"), QStringLiteral("Size of each file in bytes"), QStringLiteral("bytes"), QStringLiteral("64"));
+    const QCommandLineOption renameOption(QStringLiteral("rename-ratio"), QStringLiteral("Share of files renamed before the last sync"), QStringLiteral("ratio"), QStringLiteral("0.05"));
+    const QCommandLineOption deleteOption(QStringLiteral("delete-ratio"), QStringLiteral("Share of files deleted before the last sync"), QStringLiteral("ratio"), QStringLiteral("0.05"));
+    const QCommandLineOption directionOption(QStringLiteral("direction"), QStringLiteral("Create the tree locally (up) or on the server (down)"), QStringLiteral("up|down"), QStringLiteral("up"));
+    const QCommandLineOption vfsOption(QStringLiteral("vfs"), QStringLiteral("Virtual files mode"), QStringLiteral("off|suffix"), QStringLiteral("off"));
+    const QCommandLineOption bulkOption(QStringLiteral("bulk-upload"), QStringLiteral("Announce bulk upload support on the server"));
+    const QCommandLineOption outputOption(QStringLiteral("output"), QStringLiteral("Write the JSON report to this file instead of stdout"), QStringLiteral("file"));
+    const QCommandLineOption baselineOption(QStringLiteral("baseline"), QStringLiteral("Compare against a stored JSON report"), QStringLiteral("file"));
+    const QCommandLineOption toleranceOption(QStringLiteral("tolerance"), QStringLiteral("Allowed regression in percent"), QStringLiteral("percent"), QStringLiteral("10"));
+    parser.addOptions({ filesOption, dirsOption, depthOption, sizeOption, renameOption, deleteOption,
+        directionOption, vfsOption, bulkOption, outputOption, baselineOption, toleranceOption });
+    parser.process(app);
+
+    Options options;
+    options.shape.filesPerDir = parser.value(filesOption).toInt();
+    options.shape.dirsPerDir = parser.value(dirsOption).toInt();
+    options.shape.depth = parser.value(depthOption).toInt();
+    options.shape.fileSize = parser.value(sizeOption).toLongLong();
+    options.renameRatio = parser.value(renameOption).toDouble();
+    options.deleteRatio = parser.value(deleteOption).toDouble();
+    options.upload = parser.value(directionOption) != QLatin1String("down");
+    options.vfs = parser.value(vfsOption);
+    options.bulkUpload = parser.isSet(bulkOption);
+
+    if (options.vfs != QLatin1String("off") && options.vfs != QLatin1String("suffix")) {
+        std::cerr << "unsupported vfs mode " << qPrintable(options.vfs) << std::endl;
+        return 2;
+    }
+
+    QJsonObject parameters;
+    parameters[QStringLiteral("files_per_dir")] = options.shape.filesPerDir;
+    parameters[QStringLiteral("dirs_per_dir")] = options.shape.dirsPerDir;
+    parameters[QStringLiteral("depth")] = options.shape.depth;
+    parameters[QStringLiteral("file_size")] = options.shape.fileSize;
+    parameters[QStringLiteral("rename_ratio")] = options.renameRatio;
+    parameters[QStringLiteral("delete_ratio")] = options.deleteRatio;
+    parameters[QStringLiteral("direction")] = options.upload ? QStringLiteral("up") : QStringLiteral("down");
+    parameters[QStringLiteral("vfs")] = options.vfs;
+    parameters[QStringLiteral("bulk_upload")] = options.bulkUpload;
+
+    const auto results = runBenchmark(options, parameters);
+
+    QJsonObject report;
+    report[QStringLiteral("parameters")] = parameters;
+    report[QStringLiteral("results")] = results;
+    const auto json = QJsonDocument(report).toJson();
+
+    if (parser.isSet(outputOption)) {
+        QFile out(parser.value(outputOption));
+        if (!out.open(QIODevice::WriteOnly)) {
+            std::cerr << "cannot write " << qPrintable(out.fileName()) << std::endl;
+            return 2;
+        }
+        out.write(json);
+    } else if (!parser.isSet(baselineOption)) {
+        std::cout << json.constData();
+    }
+
+    bool success = std::all_of(results.begin(), results.end(), [](const QJsonValue &v) {
+        return v.toObject().value(QStringLiteral("success")).toBool();
+    });
+
+    if (parser.isSet(baselineOption)) {
+        QFile baselineFile(parser.value(baselineOption));
+        if (!baselineFile.open(QIODevice::ReadOnly)) {
+            std::cerr << "cannot read " << qPrintable(baselineFile.fileName()) << std::endl;
+            return 2;
+        }
+        const auto baseline = QJsonDocument::fromJson(baselineFile.readAll()).object();
+        if (baseline.value(QStringLiteral("parameters")).toObject() != parameters) {
+            std::cerr << "warning: baseline was recorded with different parameters" << std::endl;
+        }
+        const int regressions = compareWithBaseline(results, baseline.value(QStringLiteral("results")).toArray(),
+            parser.value(toleranceOption).toDouble());
+        if (regressions > 0)
+            success = false;
+    }
+
+    return success ? 0 : 1;
+}
@@ -79,6 +79,12 @@ void FakeWebSocketServer::close()
 
 void FakeWebSocketServer::processTextMessageInternal(const QString &message)
 {
+    const QString listenPrefix = QStringLiteral("listen ");
+    if (message.startsWith(listenPrefix)) {
+        _listenedEvents.append(message.mid(listenPrefix.size()));
+        return;
+    }
+
     auto client = qobject_cast<QWebSocket *>(sender());
     emit processTextMessage(client, message);
 }
@@ -134,6 +140,11 @@ void FakeWebSocketServer::clearTextMessages()
     _processTextMessageSpy->clear();
 }
 
+QStringList FakeWebSocketServer::listenedEvents() const
+{
+    return _listenedEvents;
+}
+
 OCC::AccountPtr FakeWebSocketServer::createAccount(const QString &username, const QString &password)
 {
     auto account = OCC::Account::create();
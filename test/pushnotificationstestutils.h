@@ -46,6 +46,9 @@ public:
 
     void clearTextMessages();
 
+    /// Events the client subscribed to with "listen <event>", these are not counted as text messages
+    QStringList listenedEvents() const;
+
     static OCC::AccountPtr createAccount(const QString &username = "user", const QString &password = "password");
 
 signals:
@@ -60,6 +63,7 @@ private slots:
 private:
     QWebSocketServer *_webSocketServer;
     QList<QWebSocket *> _clients;
+    QStringList _listenedEvents;
 
     std::unique_ptr<QSignalSpy> _processTextMessageSpy;
 };
@@ -0,0 +1,96 @@
+/*
+ *    This software is in the public domain, furnished "as is", without technical
+ *    support, and with no warranty, express or implied, as to its usefulness for
+ *    any purpose.
+ *
+ */
+
+#include <QtTest>
+#include <QBuffer>
+#include <QSettings>
+#include <QTemporaryDir>
+
+#include "accessmanager.h"
+#include "configfile.h"
+
+using namespace OCC;
+
+class TestAccessManager : public QObject
+{
+    Q_OBJECT
+
+    QTemporaryDir _confDir;
+
+    void setSetting(const QString &key, const QVariant &value)
+    {
+        QSettings settings(ConfigFile().configFile(), QSettings::IniFormat);
+        settings.setValue(key, value);
+    }
+
+private slots:
+    void initTestCase()
+    {
+        QVERIFY(_confDir.isValid());
+        ConfigFile::setConfDir(_confDir.path()); // we don't want to pollute the user's config file
+    }
+
+    void cleanup()
+    {
+        qunsetenv("OWNCLOUD_HTTP2_ENABLED");
+        QSettings(ConfigFile().configFile(), QSettings::IniFormat).clear();
+    }
+
+    void testHttp2EnvironmentOverridesSetting()
+    {
+        QVERIFY(!AccessManager::http2Enabled());
+
+        setSetting(QStringLiteral("http2Enabled"), true);
+        QVERIFY(AccessManager::http2Enabled());
+
+        // The environment variable wins in both directions
+        qputenv("OWNCLOUD_HTTP2_ENABLED", "0");
+        QVERIFY(!AccessManager::http2Enabled());
+
+        setSetting(QStringLiteral("http2Enabled"), false);
+        qputenv("OWNCLOUD_HTTP2_ENABLED", "1");
+        QVERIFY(AccessManager::http2Enabled());
+    }
+
+    void testHttp2Candidate()
+    {
+        // PROPFIND, GET, MOVE and DELETE have no body
+        QVERIFY(AccessManager::isHttp2Candidate(nullptr));
+
+        QByteArray smallBody(100, 'x');
+        QBuffer small(&smallBody);
+        QVERIFY(small.open(QIODevice::ReadOnly));
+        QVERIFY(AccessManager::isHttp2Candidate(&small));
+
+        QByteArray limitBody(1000 * 1000, 'x');
+        QBuffer limit(&limitBody);
+        QVERIFY(limit.open(QIODevice::ReadOnly));
+        QVERIFY(AccessManager::isHttp2Candidate(&limit));
+
+        QByteArray largeBody(1000 * 1000 + 1, 'x');
+        QBuffer large(&largeBody);
+        QVERIFY(large.open(QIODevice::ReadOnly));
+        QVERIFY(!AccessManager::isHttp2Candidate(&large));
+    }
+
+    void testMaxConcurrentRequests()
+    {
+        ConfigFile cfg;
+        QCOMPARE(cfg.maxConcurrentRequests(true), 20);
+        QCOMPARE(cfg.maxConcurrentRequests(false), 6);
+
+        setSetting(QStringLiteral("maxConcurrentRequests"), 12);
+        QCOMPARE(cfg.maxConcurrentRequests(true), 12);
+        QCOMPARE(cfg.maxConcurrentRequests(false), 12);
+
+        setSetting(QStringLiteral("maxConcurrentRequests"), 0);
+        QCOMPARE(cfg.maxConcurrentRequests(true), 20);
+    }
+};
+
+QTEST_GUILESS_MAIN(TestAccessManager)
+#include "testaccessmanager.moc"
@@ -0,0 +1,119 @@
+/*
+ *    This software is in the public domain, furnished "as is", without technical
+ *    support, and with no warranty, express or implied, as to its usefulness for
+ *    any purpose.
+ *
+ */
+
+#include <QtTest>
+
+#include "asynclogwriter.h"
+
+using namespace OCC;
+
+class TestAsyncLogWriter : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void testQueueOrder()
+    {
+        LogRecordQueue queue;
+        QString record;
+        QVERIFY(!queue.pop(record));
+
+        for (int i = 0; i < 100; ++i) {
+            queue.push(QString::number(i));
+        }
+        for (int i = 0; i < 100; ++i) {
+            QVERIFY(queue.pop(record));
+            QCOMPARE(record, QString::number(i));
+        }
+        QVERIFY(!queue.pop(record));
+
+        // the queue is reusable after running empty
+        queue.push(QStringLiteral("again"));
+        QVERIFY(queue.pop(record));
+        QCOMPARE(record, QStringLiteral("again"));
+    }
+
+    void testConcurrentProducers()
+    {
+        const int producerCount = 8;
+        const int recordsPerProducer = 5000;
+
+        QMutex sinkMutex;
+        QStringList written;
+        int batches = 0;
+        AsyncLogWriter writer([&](const QVector<QString> &records) {
+            QMutexLocker lock(&sinkMutex);
+            ++batches;
+            for (const auto &r : records)
+                written.append(r);
+        });
+        writer.start();
+
+        QVector<QThread *> producers;
+        for (int p = 0; p < producerCount; ++p) {
+            producers.append(QThread::create([&writer, p] {
+                for (int i = 0; i < recordsPerProducer; ++i) {
+                    writer.enqueue(QStringLiteral("%1:%2").arg(p).arg(i));
+                }
+            }));
+        }
+        for (auto t : producers)
+            t->start();
+        for (auto t : producers) {
+            t->wait();
+            delete t;
+        }
+        writer.stop();
+
+        QCOMPARE(written.size(), producerCount * recordsPerProducer);
+        // records were batched rather than handed over one by one
+        QVERIFY(batches < written.size());
+
+        // per producer, order is preserved
+        QVector<int> lastSeen(producerCount, -1);
+        for (const auto &r : qAsConst(written)) {
+            const auto parts = r.split(QLatin1Char(':'));
+            const int p = parts[0].toInt();
+            const int i = parts[1].toInt();
+            QCOMPARE(i, lastSeen[p] + 1);
+            lastSeen[p] = i;
+        }
+    }
+
+    void testDrainWithoutThread()
+    {
+        QStringList written;
+        AsyncLogWriter writer([&](const QVector<QString> &records) {
+            for (const auto &r : records)
+                written.append(r);
+        });
+        writer.enqueue(QStringLiteral("a"));
+        writer.enqueue(QStringLiteral("b"));
+        QVERIFY(written.isEmpty());
+        writer.drain();
+        QCOMPARE(written, QStringList({ QStringLiteral("a"), QStringLiteral("b") }));
+    }
+
+    void testRestart()
+    {
+        QStringList written;
+        AsyncLogWriter writer([&](const QVector<QString> &records) {
+            for (const auto &r : records)
+                written.append(r);
+        });
+        writer.start();
+        writer.enqueue(QStringLiteral("first"));
+        writer.stop();
+        writer.start();
+        writer.enqueue(QStringLiteral("second"));
+        writer.stop();
+        QCOMPARE(written, QStringList({ QStringLiteral("first"), QStringLiteral("second") }));
+    }
+};
+
+QTEST_GUILESS_MAIN(TestAsyncLogWriter)
+#include "testasynclogwriter.moc"
@@ -1,4 +1,6 @@
 #include <QTest>
+#include <QJsonDocument>
+#include <QJsonObject>
 
 #include "capabilities.h"
 
@@ -257,6 +259,32 @@ private slots:
 
         QCOMPARE(bulkuploadAvailable, true);
     }
+
+    void testToVariantMap_restoredFromJson_keepsParsedValues()
+    {
+        QVariantMap davMap;
+        davMap["bulkupload"] = "1.0";
+        davMap["chunking"] = "1.0";
+        davMap["httpErrorCodesThatResetFailingChunkedUploads"] = QVariantList { 500, 503 };
+
+        QVariantMap checksumsMap;
+        checksumsMap["supportedTypes"] = QStringList { "SHA1", "MD5" };
+
+        QVariantMap capabilitiesMap;
+        capabilitiesMap["dav"] = davMap;
+        capabilitiesMap["checksums"] = checksumsMap;
+
+        // As stored in the account settings
+        const auto json = QJsonDocument::fromVariant(OCC::Capabilities(capabilitiesMap).toVariantMap()).toJson(QJsonDocument::Compact);
+        const auto capabilities = OCC::Capabilities(QJsonDocument::fromJson(json).object().toVariantMap());
+
+        QVERIFY(capabilities.isValid());
+        QCOMPARE(capabilities.bulkUpload(), true);
+        QCOMPARE(capabilities.chunkingNg(), true);
+        QCOMPARE(capabilities.httpErrorCodesThatResetFailingChunkedUploads(), (QList<int> { 500, 503 }));
+        QCOMPARE(capabilities.supportedChecksumTypes(), (QList<QByteArray> { "SHA1", "MD5" }));
+        QCOMPARE(capabilities.uploadChecksumType(), QByteArray("SHA1"));
+    }
 };
 
 QTEST_GUILESS_MAIN(TestCapabilities)
@@ -247,6 +247,63 @@ private slots:
         QCOMPARE(generateHash(chunkedOutputDecrypted.readAll()), originalFileHash);
         chunkedOutputDecrypted.close();
     }
+
+    void testEncryptedFileDevice_data()
+    {
+        QTest::addColumn<int>("totalBytes");
+
+        QTest::newRow("empty") << 0;
+        QTest::newRow("one byte") << 1;
+        QTest::newRow("below block") << 15;
+        QTest::newRow("one block") << 16;
+        QTest::newRow("above block") << 17;
+        QTest::newRow("odd") << 4099;
+        QTest::newRow("several rounds") << 3 * 1024 * 1024 + 7;
+    }
+
+    void testEncryptedFileDevice()
+    {
+        QFETCH(int, totalBytes);
+
+        QTemporaryFile plainFile;
+        QVERIFY(plainFile.open());
+        QCOMPARE(plainFile.write(EncryptionHelper::generateRandom(totalBytes)), qint64(totalBytes));
+        plainFile.close();
+
+        const auto encryptionKey = EncryptionHelper::generateRandom(16);
+        const auto initializationVector = EncryptionHelper::generateRandom(16);
+
+        // The reference: what fileEncryption() writes
+        QTemporaryFile encryptedFile;
+        QByteArray tag;
+        QVERIFY(EncryptionHelper::fileEncryption(encryptionKey, initializationVector, &plainFile, &encryptedFile, tag));
+        QVERIFY(encryptedFile.open());
+        const auto expected = encryptedFile.readAll();
+        QCOMPARE(expected.size(), totalBytes + OCC::Constants::e2EeTagSize);
+
+        QCOMPARE(EncryptionHelper::EncryptedFileDevice::computeTag(plainFile.fileName(), encryptionKey, initializationVector), tag);
+
+        EncryptionHelper::EncryptedFileDevice device(plainFile.fileName(), encryptionKey, initializationVector, tag);
+        QVERIFY(device.open(QIODevice::ReadOnly));
+        QCOMPARE(device.size(), qint64(expected.size()));
+        QCOMPARE(device.readAll(), expected);
+
+        // Random access, as done by chunked uploads
+        for (const qint64 start : { qint64(0), qint64(5), qint64(16), qint64(totalBytes / 2), qint64(totalBytes) }) {
+            if (start > expected.size())
+                continue;
+            QVERIFY(device.seek(start));
+            QCOMPARE(device.read(70000), expected.mid(start, 70000));
+        }
+        device.close();
+
+        // Without the tag only the ciphertext can be read
+        EncryptionHelper::EncryptedFileDevice noTag(plainFile.fileName(), encryptionKey, initializationVector);
+        QVERIFY(noTag.open(QIODevice::ReadOnly));
+        if (totalBytes > 0)
+            QCOMPARE(noTag.read(totalBytes), expected.left(totalBytes));
+        QCOMPARE(noTag.read(1), QByteArray());
+    }
 };
 
 QTEST_APPLESS_MAIN(TestClientSideEncryption)
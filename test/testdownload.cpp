@@ -40,6 +40,41 @@ public:
 };
 
 
+/* Appends a ustar entry, preceded by a GNU long name entry when the name needs it */
+void appendTarEntry(QByteArray &archive, const QByteArray &name, const QByteArray &content, qint64 mtime, char typeFlag = '0')
+{
+    if (name.size() >= 100) {
+        appendTarEntry(archive, "././@LongLink", name + '\0', 0, 'L');
+    }
+
+    QByteArray header(512, '\0');
+    const auto setField = [&header](int offset, const QByteArray &value) {
+        header.replace(offset, value.size(), value);
+    };
+    const auto setOctal = [&setField](int offset, int length, qint64 value) {
+        setField(offset, QByteArray::number(value, 8).rightJustified(length - 1, '0'));
+    };
+    setField(0, name.left(99));
+    setOctal(100, 8, 0644);
+    setOctal(108, 8, 0);
+    setOctal(116, 8, 0);
+    setOctal(124, 12, content.size());
+    setOctal(136, 12, mtime);
+    header[156] = typeFlag;
+    setField(257, QByteArray("ustar\0" "00", 8));
+
+    setField(148, QByteArray(8, ' '));
+    int sum = 0;
+    for (const auto c : qAsConst(header)) {
+        sum += static_cast<unsigned char>(c);
+    }
+    setField(148, QByteArray::number(sum, 8).rightJustified(6, '0') + '\0');
+
+    archive += header;
+    archive += content;
+    archive += QByteArray((512 - content.size() % 512) % 512, '\0');
+}
+
 SyncFileItemPtr getItem(const QSignalSpy &spy, const QString &path)
 {
     for (const QList<QVariant> &args : spy) {
@@ -242,6 +277,199 @@ private slots:
         QCOMPARE(getItem(completeSpy, "A/resendme")->_status, SyncFileItem::NormalError);
         QVERIFY(getItem(completeSpy, "A/resendme")->_errorString.contains(serverMessage));
     }
+
+    void testBulkDownloadFromArchive()
+    {
+        FakeFolder fakeFolder{ FileInfo{} };
+        fakeFolder.syncEngine().account()->setServerVersion(QStringLiteral("30.0.0"));
+
+        const auto longName = QStringLiteral("many/") + QString(120, QLatin1Char('l'));
+        fakeFolder.remoteModifier().mkdir("many");
+        for (int i = 0; i < 30; ++i) {
+            fakeFolder.remoteModifier().insert(QStringLiteral("many/file%1").arg(i), 100 + i, static_cast<char>('A' + i % 26));
+        }
+        fakeFolder.remoteModifier().insert(longName, 42);
+        fakeFolder.remoteModifier().insert("many/big", 3 * 1000 * 1000);
+        auto checksummed = fakeFolder.remoteModifier().find("many/file3");
+        checksummed->checksums = "SHA1:" + QCryptographicHash::hash(QByteArray(checksummed->size, checksummed->contentChar), QCryptographicHash::Sha1).toHex();
+
+        int archiveRequests = 0;
+        QStringList singleDownloads;
+        fakeFolder.setServerOverride([&](QNetworkAccessManager::Operation op, const QNetworkRequest &request, QIODevice *) -> QNetworkReply * {
+            if (op != QNetworkAccessManager::GetOperation) {
+                return nullptr;
+            }
+            if (request.rawHeader("Accept") != "application/x-tar") {
+                singleDownloads.append(getFilePathFromUrl(request.url()));
+                return nullptr;
+            }
+
+            ++archiveRequests;
+            const auto directory = getFilePathFromUrl(request.url());
+            const auto fileNames = QJsonDocument::fromJson(QUrlQuery(request.url()).queryItemValue(QStringLiteral("files"), QUrl::FullyDecoded).toUtf8()).array();
+            QByteArray archive;
+            appendTarEntry(archive, directory.toUtf8() + '/', {}, 0, '5');
+            for (const auto &fileName : fileNames) {
+                const auto fileInfo = fakeFolder.remoteModifier().find(directory + QLatin1Char('/') + fileName.toString());
+                auto mtime = fileInfo->lastModified.toSecsSinceEpoch();
+                if (fileInfo->name == QStringLiteral("file7")) {
+                    // as if the file changed since discovery
+                    ++mtime;
+                }
+                appendTarEntry(archive, (directory + QLatin1Char('/') + fileInfo->name).toUtf8(), QByteArray(fileInfo->size, fileInfo->contentChar), mtime);
+            }
+            archive += QByteArray(1024, '\0');
+
+            auto reply = new FakePayloadReply(op, request, archive, this);
+            reply->setRawHeader("Content-Type", "application/x-tar");
+            return reply;
+        });
+
+        QVERIFY(fakeFolder.syncOnce());
+        QCOMPARE(archiveRequests, 1);
+        singleDownloads.sort();
+        QCOMPARE(singleDownloads, QStringList({ QStringLiteral("many/big"), QStringLiteral("many/file7") }));
+        QCOMPARE(fakeFolder.currentLocalState(), fakeFolder.currentRemoteState());
+
+        // No temporary files or download infos are left behind
+        QVERIFY(!fakeFolder.syncJournal().getDownloadInfo(QStringLiteral("many/file1"))._valid);
+        const auto localEntries = QDir(fakeFolder.localPath() + QStringLiteral("many")).entryList(QDir::Files | QDir::Hidden);
+        QCOMPARE(localEntries.filter(QStringLiteral(".~")).size(), 0);
+    }
+
+    void testBulkDownloadAtRoot()
+    {
+        FakeFolder fakeFolder{ FileInfo{} };
+        fakeFolder.syncEngine().account()->setServerVersion(QStringLiteral("30.0.0"));
+
+        fakeFolder.remoteModifier().mkdir("A");
+        for (int i = 0; i < 12; ++i) {
+            fakeFolder.remoteModifier().insert(QStringLiteral("root%1").arg(i), 10 + i);
+            fakeFolder.remoteModifier().insert(QStringLiteral("A/a%1").arg(i), 10 + i);
+        }
+
+        QStringList archiveDirectories;
+        int singleDownloads = 0;
+        fakeFolder.setServerOverride([&](QNetworkAccessManager::Operation op, const QNetworkRequest &request, QIODevice *) -> QNetworkReply * {
+            if (op != QNetworkAccessManager::GetOperation) {
+                return nullptr;
+            }
+            if (request.rawHeader("Accept") != "application/x-tar") {
+                ++singleDownloads;
+                return nullptr;
+            }
+
+            const auto directory = getFilePathFromUrl(request.url());
+            archiveDirectories.append(directory);
+            const auto prefix = directory.isEmpty() ? QString() : directory + QLatin1Char('/');
+            const auto fileNames = QJsonDocument::fromJson(QUrlQuery(request.url()).queryItemValue(QStringLiteral("files"), QUrl::FullyDecoded).toUtf8()).array();
+            QByteArray archive;
+            for (const auto &fileName : fileNames) {
+                const auto fileInfo = fakeFolder.remoteModifier().find(prefix + fileName.toString());
+                appendTarEntry(archive, (prefix + fileInfo->name).toUtf8(), QByteArray(fileInfo->size, fileInfo->contentChar), fileInfo->lastModified.toSecsSinceEpoch());
+            }
+            archive += QByteArray(1024, '\0');
+
+            auto reply = new FakePayloadReply(op, request, archive, this);
+            reply->setRawHeader("Content-Type", "application/x-tar");
+            return reply;
+        });
+
+        QVERIFY(fakeFolder.syncOnce());
+        // the files at the root get an archive of their own
+        archiveDirectories.sort();
+        QCOMPARE(archiveDirectories, QStringList({ QString(), QStringLiteral("A") }));
+        QCOMPARE(singleDownloads, 0);
+        QCOMPARE(fakeFolder.currentLocalState(), fakeFolder.currentRemoteState());
+    }
+
+    void testBulkDownloadRunsAlongOtherTransfers()
+    {
+        FakeFolder fakeFolder{ FileInfo{} };
+        fakeFolder.syncEngine().account()->setServerVersion(QStringLiteral("30.0.0"));
+
+        for (const auto &directory : { QStringLiteral("A"), QStringLiteral("B") }) {
+            fakeFolder.remoteModifier().mkdir(directory);
+            for (int i = 0; i < 12; ++i) {
+                fakeFolder.remoteModifier().insert(QStringLiteral("%1/file%2").arg(directory).arg(i), 10 + i);
+            }
+        }
+        fakeFolder.remoteModifier().mkdir("C");
+        fakeFolder.remoteModifier().insert("C/big", 3 * 1000 * 1000);
+
+        int runningArchives = 0;
+        int maximumRunningArchives = 0;
+        QStringList downloadsDuringArchives;
+        QStringList singleDownloads;
+        fakeFolder.setServerOverride([&](QNetworkAccessManager::Operation op, const QNetworkRequest &request, QIODevice *) -> QNetworkReply * {
+            if (op != QNetworkAccessManager::GetOperation) {
+                return nullptr;
+            }
+            const auto path = getFilePathFromUrl(request.url());
+            if (request.rawHeader("Accept") != "application/x-tar") {
+                singleDownloads.append(path);
+                if (runningArchives > 0) {
+                    downloadsDuringArchives.append(path);
+                }
+                return nullptr;
+            }
+
+            const auto fileNames = QJsonDocument::fromJson(QUrlQuery(request.url()).queryItemValue(QStringLiteral("files"), QUrl::FullyDecoded).toUtf8()).array();
+            QByteArray archive;
+            for (const auto &fileName : fileNames) {
+                const auto fileInfo = fakeFolder.remoteModifier().find(path + QLatin1Char('/') + fileName.toString());
+                appendTarEntry(archive, (path + QLatin1Char('/') + fileInfo->name).toUtf8(), QByteArray(fileInfo->size, fileInfo->contentChar), fileInfo->lastModified.toSecsSinceEpoch());
+            }
+            archive += QByteArray(1024, '\0');
+
+            // A slow archive, the other transfers must not wait for it
+            auto reply = new FakePayloadReply(op, request, archive, 500, this);
+            reply->setRawHeader("Content-Type", "application/x-tar");
+            maximumRunningArchives = qMax(maximumRunningArchives, ++runningArchives);
+            connect(reply, &QNetworkReply::finished, this, [&runningArchives] { --runningArchives; });
+            return reply;
+        });
+
+        QVERIFY(fakeFolder.syncOnce());
+        // the archives of both directories and the unrelated download overlap
+        QCOMPARE(maximumRunningArchives, 2);
+        QCOMPARE(downloadsDuringArchives, QStringList(QStringLiteral("C/big")));
+        // the downloads of the archived files waited for their archive
+        QCOMPARE(singleDownloads, QStringList(QStringLiteral("C/big")));
+        QCOMPARE(fakeFolder.currentLocalState(), fakeFolder.currentRemoteState());
+    }
+
+    void testBulkDownloadNotSupported()
+    {
+        FakeFolder fakeFolder{ FileInfo{} };
+        fakeFolder.syncEngine().account()->setServerVersion(QStringLiteral("30.0.0"));
+
+        // More files than fit in one archive request
+        fakeFolder.remoteModifier().mkdir("A");
+        for (int i = 0; i < 150; ++i) {
+            fakeFolder.remoteModifier().insert(QStringLiteral("A/file%1").arg(i), 10);
+        }
+
+        int archiveRequests = 0;
+        int singleDownloads = 0;
+        fakeFolder.setServerOverride([&](QNetworkAccessManager::Operation op, const QNetworkRequest &request, QIODevice *) -> QNetworkReply * {
+            if (op != QNetworkAccessManager::GetOperation) {
+                return nullptr;
+            }
+            if (request.rawHeader("Accept") == "application/x-tar") {
+                ++archiveRequests;
+                return new FakeErrorReply(op, request, this, 405);
+            }
+            ++singleDownloads;
+            return nullptr;
+        });
+
+        QVERIFY(fakeFolder.syncOnce());
+        // the first refusal disables archive requests for the rest of the sync
+        QCOMPARE(archiveRequests, 1);
+        QCOMPARE(singleDownloads, 150);
+        QCOMPARE(fakeFolder.currentLocalState(), fakeFolder.currentRemoteState());
+    }
 };
 
 QTEST_GUILESS_MAIN(TestDownload)
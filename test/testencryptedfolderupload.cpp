@@ -0,0 +1,295 @@
+/*
+ *    This software is in the public domain, furnished "as is", without technical
+ *    support, and with no warranty, express or implied, as to its usefulness for
+ *    any purpose.
+ *
+ */
+
+#include <QtTest>
+#include "syncenginetestutils.h"
+#include "owncloudpropagator.h"
+#include "propagateuploadencrypted.h"
+#include "clientsideencryption.h"
+
+#include <functional>
+
+#include <openssl/evp.h>
+#include <openssl/pem.h>
+#include <openssl/rsa.h>
+
+using namespace OCC;
+
+namespace {
+
+// The metadata key gets encrypted with the public key of the account
+QSslKey generatePublicKey()
+{
+    auto ctx = EVP_PKEY_CTX_new_id(EVP_PKEY_RSA, nullptr);
+    EVP_PKEY *keyPair = nullptr;
+    EVP_PKEY_keygen_init(ctx);
+    EVP_PKEY_CTX_set_rsa_keygen_bits(ctx, 2048);
+    EVP_PKEY_keygen(ctx, &keyPair);
+    EVP_PKEY_CTX_free(ctx);
+
+    auto bio = BIO_new(BIO_s_mem());
+    PEM_write_bio_PUBKEY(bio, keyPair);
+    char *data = nullptr;
+    const auto size = BIO_get_mem_data(bio, &data);
+    const QByteArray pem(data, static_cast<int>(size));
+    BIO_free(bio);
+    EVP_PKEY_free(keyPair);
+
+    return QSslKey(pem, QSsl::Rsa, QSsl::Pem, QSsl::PublicKey);
+}
+
+}
+
+/* Answers the end-to-end encryption API of the server and counts the requests */
+class FakeE2eeServer
+{
+public:
+    explicit FakeE2eeServer(FakeFolder &fakeFolder)
+    {
+        fakeFolder.setServerOverride([this](QNetworkAccessManager::Operation op, const QNetworkRequest &request, QIODevice *) -> QNetworkReply * {
+            const auto path = request.url().path();
+            const auto verb = request.attribute(QNetworkRequest::CustomVerbAttribute).toByteArray();
+            if (path.contains(QStringLiteral("/end_to_end_encryption/")) && path.contains(QStringLiteral("/lock/"))) {
+                if (verb == "POST") {
+                    ++locks;
+                    return new FakePayloadReply(op, request, R"({"ocs":{"data":{"e2e-token":"token"}}})", nullptr);
+                }
+                ++unlocks;
+                return new FakePayloadReply(op, request, QByteArray(), nullptr);
+            }
+            if (path.contains(QStringLiteral("/end_to_end_encryption/")) && path.contains(QStringLiteral("/meta-data/"))) {
+                if (verb == "GET") {
+                    // The folder has no metadata yet
+                    return new FakeErrorReply(op, request, nullptr, 404);
+                }
+                ++stores;
+                if (failStores) {
+                    return new FakeErrorReply(op, request, nullptr, 500);
+                }
+                return new FakePayloadReply(op, request, QByteArray(), storeDelay, nullptr);
+            }
+            if (onOtherRequest) {
+                onOtherRequest(verb, request);
+            }
+            return nullptr;
+        });
+    }
+
+    int locks = 0;
+    int unlocks = 0;
+    int stores = 0;
+    bool failStores = false;
+    int storeDelay = FakePayloadReply::defaultDelay;
+    // Called for the requests that are left to the fake server, e.g. the uploads
+    std::function<void(const QByteArray &verb, const QNetworkRequest &request)> onOtherRequest;
+};
+
+class TestEncryptedFolderUpload : public QObject
+{
+    Q_OBJECT
+
+    QSet<QString> _bulkUploadBlackList;
+
+    QScopedPointer<OwncloudPropagator> makePropagator(FakeFolder &fakeFolder)
+    {
+        fakeFolder.account()->e2e()->_publicKey = generatePublicKey();
+        return QScopedPointer<OwncloudPropagator>(new OwncloudPropagator(fakeFolder.account(), fakeFolder.localPath(),
+            QStringLiteral("/"), &fakeFolder.syncJournal(), _bulkUploadBlackList));
+    }
+
+    /* The fake server doesn't know encrypted folders: mark one in the journal, the uploads into it
+     * get encrypted as long as it doesn't change on the server */
+    static void setupEncryptedFolder(FakeFolder &fakeFolder, const QString &folder)
+    {
+        fakeFolder.account()->setCapabilities({
+            { "dav", QVariantMap{ { "chunking", "1.0" } } },
+            { "end-to-end-encryption", QVariantMap{ { "enabled", true }, { "api-version", "1.1" } } } });
+        fakeFolder.account()->e2e()->_publicKey = generatePublicKey();
+
+        SyncJournalFileRecord record;
+        QVERIFY(fakeFolder.syncJournal().getFileRecord(folder, &record));
+        QVERIFY(record.isValid());
+        record._isE2eEncrypted = true;
+        QVERIFY(fakeFolder.syncJournal().setFileRecord(record));
+    }
+
+private slots:
+    void testMetadataIsStoredPerFile()
+    {
+        FakeFolder fakeFolder{ FileInfo::A12_B12_C12_S12() };
+        FakeE2eeServer server(fakeFolder);
+        auto propagator = makePropagator(fakeFolder);
+
+        auto batch = propagator->encryptedUploadBatch(QStringLiteral("A/a1"), QStringLiteral("A"));
+        batch->join();
+        QCOMPARE(propagator->encryptedUploadBatch(QStringLiteral("A/a2"), QStringLiteral("A")), batch);
+        batch->join();
+
+        QSignalSpy readySpy(batch, &EncryptedFolderUploadBatch::ready);
+        QSignalSpy storedSpy(batch, &EncryptedFolderUploadBatch::fileStored);
+        QSignalSpy finishedSpy(batch, &EncryptedFolderUploadBatch::finished);
+        batch->start();
+        QVERIFY(readySpy.wait());
+        QCOMPARE(server.locks, 1);
+
+        // Every file is part of the stored metadata as soon as its body is uploaded
+        const auto first = batch->encryptedFileFor(fakeFolder.localPath() + QStringLiteral("A/a1"));
+        batch->storeFile(first);
+        QVERIFY(storedSpy.wait());
+        QCOMPARE(server.stores, 1);
+        QCOMPARE(storedSpy.last().at(0).toByteArray(), first.encryptedFilename);
+        QCOMPARE(storedSpy.last().at(1).toBool(), true);
+        batch->leave();
+
+        const auto second = batch->encryptedFileFor(fakeFolder.localPath() + QStringLiteral("A/a2"));
+        QVERIFY(second.encryptedFilename != first.encryptedFilename);
+        batch->storeFile(second);
+        QVERIFY(storedSpy.wait());
+        QCOMPARE(server.stores, 2);
+        QCOMPARE(storedSpy.last().at(0).toByteArray(), second.encryptedFilename);
+        QCOMPARE(storedSpy.last().at(1).toBool(), true);
+        batch->leave();
+
+        // The lock is kept for uploads that may still join until the batch is released
+        QVERIFY(batch->isIdle());
+        QVERIFY(batch->holdsLock());
+        QCOMPARE(server.unlocks, 0);
+
+        batch->release();
+        QVERIFY(finishedSpy.wait());
+        QCOMPARE(server.locks, 1);
+        QCOMPARE(server.unlocks, 1);
+        QVERIFY(!batch->holdsLock());
+        QVERIFY(propagator->encryptedUploadBatch(QStringLiteral("A/a1"), QStringLiteral("A")) != batch);
+    }
+
+    void testFailedStoreEndsTheBatch()
+    {
+        FakeFolder fakeFolder{ FileInfo::A12_B12_C12_S12() };
+        FakeE2eeServer server(fakeFolder);
+        server.failStores = true;
+        auto propagator = makePropagator(fakeFolder);
+
+        auto batch = propagator->encryptedUploadBatch(QStringLiteral("A/a1"), QStringLiteral("A"));
+        batch->join();
+
+        QSignalSpy readySpy(batch, &EncryptedFolderUploadBatch::ready);
+        QSignalSpy storedSpy(batch, &EncryptedFolderUploadBatch::fileStored);
+        QSignalSpy finishedSpy(batch, &EncryptedFolderUploadBatch::finished);
+        batch->start();
+        QVERIFY(readySpy.wait());
+
+        batch->storeFile(batch->encryptedFileFor(fakeFolder.localPath() + QStringLiteral("A/a1")));
+        QVERIFY(storedSpy.wait());
+        QCOMPARE(storedSpy.size(), 1);
+        QCOMPARE(storedSpy.last().at(1).toBool(), false);
+
+        // The metadata on the server is unknown now: later uploads start over
+        QVERIFY(!batch->acceptsMembers());
+        QVERIFY(propagator->encryptedUploadBatch(QStringLiteral("A/a2"), QStringLiteral("A")) != batch);
+
+        batch->leave();
+        QVERIFY(finishedSpy.wait());
+        QCOMPARE(server.stores, 1);
+        QCOMPARE(server.unlocks, 1);
+    }
+
+    void testBatchIsBounded()
+    {
+        FakeFolder fakeFolder{ FileInfo::A12_B12_C12_S12() };
+        FakeE2eeServer server(fakeFolder);
+        auto propagator = makePropagator(fakeFolder);
+
+        const int maximumMembers = EncryptedFolderUploadBatch::maximumMembers;
+        auto batch = propagator->encryptedUploadBatch(QStringLiteral("A/a1"), QStringLiteral("A"));
+        for (int i = 0; i < maximumMembers; ++i) {
+            QCOMPARE(propagator->encryptedUploadBatch(QStringLiteral("A/a1"), QStringLiteral("A")), batch);
+            batch->join();
+        }
+
+        // Other clients get their turn before the next uploads lock the folder again
+        QVERIFY(!batch->acceptsMembers());
+        auto next = propagator->encryptedUploadBatch(QStringLiteral("A/a1"), QStringLiteral("A"));
+        QVERIFY(next != batch);
+        QVERIFY(next->acceptsMembers());
+
+        // Batches of other folders are independent
+        QVERIFY(propagator->encryptedUploadBatch(QStringLiteral("B/b1"), QStringLiteral("B")) != next);
+        QCOMPARE(server.locks, 0);
+    }
+
+    void testSyncStoresMetadataInBatches()
+    {
+        FakeFolder fakeFolder{ FileInfo::A12_B12_C12_S12() };
+        FakeE2eeServer server(fakeFolder);
+        setupEncryptedFolder(fakeFolder, QStringLiteral("A"));
+
+        // The uploads finishing while the first store runs are stored together
+        server.storeDelay = 1000;
+        const int fileCount = 5;
+        for (int i = 0; i < fileCount; ++i) {
+            fakeFolder.localModifier().insert(QStringLiteral("A/new%1").arg(i));
+        }
+
+        ItemCompletedSpy completeSpy(fakeFolder);
+        QVERIFY(fakeFolder.syncOnce());
+        QCOMPARE(server.locks, 1);
+        QCOMPARE(server.stores, 2);
+        QCOMPARE(server.unlocks, 1);
+        for (int i = 0; i < fileCount; ++i) {
+            const auto path = QStringLiteral("A/new%1").arg(i);
+            QCOMPARE(completeSpy.findItem(path)->_status, SyncFileItem::Success);
+            SyncJournalFileRecord record;
+            QVERIFY(fakeFolder.syncJournal().getFileRecord(path, &record));
+            QVERIFY(record.isValid());
+            QVERIFY(record._isE2eEncrypted);
+        }
+    }
+
+    void testFileChangedWhileUploading()
+    {
+        FakeFolder fakeFolder{ FileInfo::A12_B12_C12_S12() };
+        FakeE2eeServer server(fakeFolder);
+        setupEncryptedFolder(fakeFolder, QStringLiteral("A"));
+
+        // Upload in chunks
+        SyncOptions options;
+        options._maxChunkSize = 1000 * 1000;
+        options._initialChunkSize = 1000 * 1000;
+        options._minChunkSize = 1000 * 1000;
+        fakeFolder.syncEngine().setSyncOptions(options);
+
+        const auto size = 3 * 1000 * 1000;
+        fakeFolder.localModifier().insert(QStringLiteral("A/big"), size);
+
+        // The chunks are all sent when they get assembled, the tag doesn't match the file anymore
+        int moves = 0;
+        server.onOtherRequest = [&](const QByteArray &verb, const QNetworkRequest &) {
+            if (verb == "MOVE") {
+                ++moves;
+                fakeFolder.localModifier().appendByte(QStringLiteral("A/big"));
+            }
+        };
+
+        ItemCompletedSpy completeSpy(fakeFolder);
+        fakeFolder.syncOnce();
+        QCOMPARE(moves, 1);
+        QCOMPARE(completeSpy.findItem(QStringLiteral("A/big"))->_status, SyncFileItem::SoftError);
+        QCOMPARE(fakeFolder.syncEngine().isAnotherSyncNeeded(), ImmediateFollowUp);
+
+        // The file isn't part of the metadata and isn't recorded as synced
+        QCOMPARE(server.locks, 1);
+        QCOMPARE(server.stores, 0);
+        QCOMPARE(server.unlocks, 1);
+        SyncJournalFileRecord record;
+        QVERIFY(fakeFolder.syncJournal().getFileRecord(QStringLiteral("A/big"), &record));
+        QVERIFY(!record.isValid());
+    }
+};
+
+QTEST_GUILESS_MAIN(TestEncryptedFolderUpload)
+#include "testencryptedfolderupload.moc"
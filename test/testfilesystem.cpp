@@ -0,0 +1,97 @@
+/*
+ *    This software is in the public domain, furnished "as is", without technical
+ *    support, and with no warranty, express or implied, as to its usefulness for
+ *    any purpose.
+ *
+ */
+
+#include <QtTest>
+#include <QTemporaryDir>
+
+#include "filesystem.h"
+
+using namespace OCC;
+
+namespace {
+
+// More than one mapped window and more than one read buffer
+const qint64 fileSize = 16 * 1024 * 1024 + 3 * 1024 * 1024 + 17;
+
+QByteArray content()
+{
+    QByteArray data(fileSize, Qt::Uninitialized);
+    for (qint64 i = 0; i < fileSize; ++i) {
+        data[static_cast<int>(i)] = static_cast<char>(i % 251);
+    }
+    return data;
+}
+
+bool writeFile(const QString &path, const QByteArray &data)
+{
+    QFile file(path);
+    return file.open(QIODevice::WriteOnly) && file.write(data) == data.size();
+}
+
+}
+
+class TestFileSystem : public QObject
+{
+    Q_OBJECT
+
+    QTemporaryDir _dir;
+    QString _first;
+    QString _second;
+
+private slots:
+    void initTestCase()
+    {
+        QVERIFY(_dir.isValid());
+        _first = _dir.filePath(QStringLiteral("first"));
+        _second = _dir.filePath(QStringLiteral("second"));
+    }
+
+    void testFileEquals_data()
+    {
+        QTest::addColumn<bool>("mapFiles");
+
+        QTest::newRow("mapped windows") << true;
+        QTest::newRow("read buffers") << false;
+    }
+
+    void testFileEquals()
+    {
+        QFETCH(bool, mapFiles);
+
+        const auto data = content();
+        QVERIFY(writeFile(_first, data));
+        QVERIFY(writeFile(_second, data));
+        QVERIFY(FileSystem::fileEquals(_first, _second, mapFiles));
+
+        // A difference in the second window, after a first window that is equal
+        auto changed = data;
+        changed[16 * 1024 * 1024 + 2 * 1024 * 1024 + 5] = 'x';
+        QVERIFY(writeFile(_second, changed));
+        QVERIFY(!FileSystem::fileEquals(_first, _second, mapFiles));
+
+        // A difference in the very last byte
+        changed = data;
+        changed[changed.size() - 1] = 'x';
+        QVERIFY(writeFile(_second, changed));
+        QVERIFY(!FileSystem::fileEquals(_first, _second, mapFiles));
+
+        QVERIFY(writeFile(_second, data.left(data.size() - 1)));
+        QVERIFY(!FileSystem::fileEquals(_first, _second, mapFiles));
+    }
+
+    void testEmptyAndMissingFiles()
+    {
+        QVERIFY(writeFile(_first, QByteArray()));
+        QVERIFY(writeFile(_second, QByteArray()));
+        QVERIFY(FileSystem::fileEquals(_first, _second));
+
+        QVERIFY(!FileSystem::fileEquals(_first, _dir.filePath(QStringLiteral("missing"))));
+    }
+};
+
+QTEST_GUILESS_MAIN(TestFileSystem)
+#include "testfilesystem.moc"
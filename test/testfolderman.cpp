@@ -10,7 +10,9 @@
 #include <QtTest>
 
 #include "common/utility.h"
+#include "common/syncjournaldb.h"
 #include "folderman.h"
+#include "folder.h"
 #include "account.h"
 #include "accountstate.h"
 #include "configfile.h"
@@ -208,6 +210,134 @@ private slots:
         QCOMPARE(folderman->findGoodPathForNewSyncFolder(dirPath + "/ownCloud2", url),
             QString(dirPath + "/ownCloud22"));
     }
+
+    void testScheduling()
+    {
+        QTemporaryDir dir;
+        ConfigFile::setConfDir(dir.path()); // we don't want to pollute the user's config file
+        QVERIFY(dir.isValid());
+        QDir dir2(dir.path());
+        QVERIFY(dir2.mkpath("a1"));
+        QVERIFY(dir2.mkpath("a2"));
+        QVERIFY(dir2.mkpath("b1"));
+        QVERIFY(dir2.mkpath("b2"));
+        QString dirPath = dir2.canonicalPath();
+
+        const auto makeAccountState = [](const QString &user) {
+            AccountPtr account = Account::create();
+            account->setCredentials(new HttpCredentialsTest(user, "secret"));
+            account->setUrl(QUrl("http://example.de"));
+            return AccountStatePtr(new AccountState(account));
+        };
+        const auto firstAccountState = makeAccountState("first");
+        const auto secondAccountState = makeAccountState("second");
+
+        FolderMan *folderman = FolderMan::instance();
+        QCOMPARE(folderman, &_fm);
+        auto a1 = folderman->addFolder(firstAccountState.data(), folderDefinition(dirPath + "/a1"));
+        auto a2 = folderman->addFolder(firstAccountState.data(), folderDefinition(dirPath + "/a2"));
+        auto b1 = folderman->addFolder(secondAccountState.data(), folderDefinition(dirPath + "/b1"));
+        auto b2 = folderman->addFolder(secondAccountState.data(), folderDefinition(dirPath + "/b2"));
+        QVERIFY(a1 && a2 && b1 && b2);
+
+        _fm._scheduledFolders.clear();
+        _fm._scheduledFolders.enqueue(a2);
+        _fm._scheduledFolders.enqueue(b1);
+        _fm._scheduledFolders.enqueue(b2);
+
+        // Without a running sync the queue order is kept
+        QCOMPARE(_fm.nextScheduledFolder({}), a2);
+
+        // All folders are on the same disk: a folder of another account goes first
+        QCOMPARE(_fm.nextScheduledFolder({ a1 }), b1);
+        QCOMPARE(_fm.nextScheduledFolder({ b1 }), a2);
+
+        // Unless the user waits for the other one
+        a2->setUserTouched();
+        QCOMPARE(_fm.nextScheduledFolder({ a1 }), a2);
+        _fm._scheduledFolders.clear();
+
+        // A folder that syncs quickly goes before one that never synced
+        _fm._scheduledFolders.enqueue(b1);
+        _fm._scheduledFolders.enqueue(b2);
+        b2->_lastSyncDuration = std::chrono::milliseconds(50);
+        QCOMPARE(_fm.nextScheduledFolder({}), b2);
+        b1->_lastSyncDuration = std::chrono::milliseconds(20);
+        QCOMPARE(_fm.nextScheduledFolder({}), b1);
+        _fm._scheduledFolders.clear();
+
+        // Syncs of the same account split its network budget
+        FolderMan::shareNetworkBudget({ a1, a2, b1 });
+        QCOMPARE(a1->networkBudgetShare(), 2);
+        QCOMPARE(a2->networkBudgetShare(), 2);
+        QCOMPARE(b1->networkBudgetShare(), 1);
+
+        // and get it back when the others are done
+        FolderMan::shareNetworkBudget({ a1, b1 });
+        QCOMPARE(a1->networkBudgetShare(), 1);
+        QCOMPARE(b1->networkBudgetShare(), 1);
+    }
+
+    void testFileIdsPushNotificationRouting()
+    {
+        QTemporaryDir dir;
+        ConfigFile::setConfDir(dir.path()); // we don't want to pollute the user's config file
+        QVERIFY(dir.isValid());
+        QDir dir2(dir.path());
+        QVERIFY(dir2.mkpath("first"));
+        QVERIFY(dir2.mkpath("second"));
+        QString dirPath = dir2.canonicalPath();
+
+        AccountPtr account = Account::create();
+        auto *cred = new HttpCredentialsTest("testuser", "secret");
+        account->setCredentials(cred);
+        account->setUrl(QUrl("http://example.de"));
+
+        AccountStatePtr newAccountState(new AccountState(account));
+        FolderMan *folderman = FolderMan::instance();
+        QCOMPARE(folderman, &_fm);
+        auto first = folderman->addFolder(newAccountState.data(), folderDefinition(dirPath + "/first"));
+        auto second = folderman->addFolder(newAccountState.data(), folderDefinition(dirPath + "/second"));
+        QVERIFY(first);
+        QVERIFY(second);
+
+        const auto addRecord = [](Folder *folder, const QByteArray &path, ItemType type, qint64 numericFileId) {
+            SyncJournalFileRecord record;
+            record._path = path;
+            record._type = type;
+            record._fileId = QByteArray::number(numericFileId).rightJustified(8, '0') + "ocinstance";
+            record._etag = "etag";
+            record._modtime = 1;
+            QVERIFY(folder->journalDb()->setFileRecord(record));
+        };
+        addRecord(first, "sub", ItemTypeDirectory, 41);
+        addRecord(first, "sub/file", ItemTypeFile, 42);
+        addRecord(second, "other", ItemTypeFile, 43);
+
+        const auto folderSet = [](const QList<Folder *> &folders) {
+            return QSet<Folder *>(folders.cbegin(), folders.cend());
+        };
+        const auto bothFolders = QSet<Folder *>{ first, second };
+
+        // Known ids only affect the folders that contain them
+        QCOMPARE(folderSet(folderman->foldersForFileIdsPushNotification(account.data(), { 42 })), QSet<Folder *>{ first });
+        QCOMPARE(folderSet(folderman->foldersForFileIdsPushNotification(account.data(), { 43 })), QSet<Folder *>{ second });
+        QCOMPARE(folderSet(folderman->foldersForFileIdsPushNotification(account.data(), { 42, 43 })), bothFolders);
+
+        // The parent of the changed file is discovered again
+        SyncJournalFileRecord parentRecord;
+        QVERIFY(first->journalDb()->getFileRecord(QByteArrayLiteral("sub"), &parentRecord));
+        QCOMPARE(parentRecord._etag, QByteArrayLiteral("_invalid_"));
+
+        // A single unknown id, even next to known ones, could be anywhere
+        QCOMPARE(folderSet(folderman->foldersForFileIdsPushNotification(account.data(), { 42, 99 })), bothFolders);
+        QCOMPARE(folderSet(folderman->foldersForFileIdsPushNotification(account.data(), { 99 })), bothFolders);
+        QCOMPARE(folderSet(folderman->foldersForFileIdsPushNotification(account.data(), {})), bothFolders);
+
+        // Folders of other accounts are never affected
+        AccountPtr otherAccount = Account::create();
+        QVERIFY(folderman->foldersForFileIdsPushNotification(otherAccount.data(), { 42 }).isEmpty());
+    }
 };
 
 QTEST_APPLESS_MAIN(TestFolderMan)
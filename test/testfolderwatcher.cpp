@@ -260,6 +260,25 @@ private slots:
         mkdir(dir);
         QVERIFY(waitForPathChanged(dir));
     }
+
+    void testCoalesceRepeatedChanges() {
+        QString file(_rootPath + "/a2/often_written");
+        for (int i = 0; i < 50; ++i) {
+            QFile f(file);
+            QVERIFY(f.open(QIODevice::WriteOnly | QIODevice::Append));
+            f.write("x");
+        }
+        QVERIFY(waitForPathChanged(file));
+
+        // Let the remaining notifications arrive
+        _pathChangedSpy->wait(1000);
+        int reports = 0;
+        for (int i = 0; i < _pathChangedSpy->size(); ++i) {
+            if (_pathChangedSpy->at(i).first().toString() == file)
+                ++reports;
+        }
+        QVERIFY(reports < 50);
+    }
 };
 
 #ifdef Q_OS_MAC
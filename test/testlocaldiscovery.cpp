@@ -67,6 +67,45 @@ private slots:
         QVERIFY(tracker.localDiscoveryPaths().empty());
     }
 
+    // Local changes reported while a sync runs are folded into the running discovery if possible
+    void testLateLocalDiscoveryPath()
+    {
+        FakeFolder fakeFolder{ FileInfo::A12_B12_C12_S12() };
+        auto &engine = fakeFolder.syncEngine();
+
+        // Not running: nothing to fold into
+        QVERIFY(!engine.addLocalDiscoveryPath("A/a1"));
+
+        fakeFolder.localModifier().insert("A/a3");
+        fakeFolder.localModifier().insert("C/c3");
+        engine.setLocalDiscoveryOptions(LocalDiscoveryStyle::DatabaseAndFilesystem, { "B/b1" });
+
+        bool offeredEarly = false;
+        bool pickedUpEarly = false;
+        connect(&engine, &SyncEngine::transmissionProgress, this, [&](const ProgressInfo &progress) {
+            if (offeredEarly || progress.status() != ProgressInfo::Starting)
+                return;
+            offeredEarly = true;
+            pickedUpEarly = engine.addLocalDiscoveryPath("A/a3");
+        });
+        bool offeredLate = false;
+        bool pickedUpLate = true;
+        connect(&engine, &SyncEngine::aboutToPropagate, this, [&] {
+            offeredLate = true;
+            pickedUpLate = engine.addLocalDiscoveryPath("C/c3");
+        });
+
+        QVERIFY(fakeFolder.syncOnce());
+        QVERIFY(offeredEarly);
+        QVERIFY(pickedUpEarly);
+        QVERIFY(offeredLate);
+        QVERIFY(!pickedUpLate);
+
+        // The early path was discovered by the running sync, the late one was not
+        QVERIFY(fakeFolder.currentRemoteState().find("A/a3"));
+        QVERIFY(!fakeFolder.currentRemoteState().find("C/c3"));
+    }
+
     void testLocalDiscoveryDecision()
     {
         FakeFolder fakeFolder{ FileInfo::A12_B12_C12_S12() };
@@ -0,0 +1,81 @@
+/*
+ *    This software is in the public domain, furnished "as is", without technical
+ *    support, and with no warranty, express or implied, as to its usefulness for
+ *    any purpose.
+ *
+ */
+
+#include <QtTest>
+#include <QMutex>
+
+#include "localioexecutor.h"
+
+using namespace OCC;
+
+class TestLocalIoExecutor : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void testOrderedPerKey()
+    {
+        LocalIoExecutor executor;
+        QObject context;
+
+        QMutex mutex;
+        QStringList operations;
+        QStringList callbacks;
+        for (int i = 0; i < 20; ++i) {
+            const auto key = i % 2 ? QStringLiteral("A") : QStringLiteral("B");
+            const auto name = key + QString::number(i);
+            executor.post(key, &context,
+                [&mutex, &operations, name] {
+                    QThread::msleep(1);
+                    QMutexLocker lock(&mutex);
+                    operations.append(name);
+                    return name;
+                },
+                [&callbacks](const QString &result) { callbacks.append(result); });
+        }
+        QTRY_COMPARE(callbacks.size(), 20);
+
+        // Within a key, the posting order is kept
+        for (const auto &list : { operations, callbacks }) {
+            QCOMPARE(list.filter("A"), QStringList({ "A1", "A3", "A5", "A7", "A9", "A11", "A13", "A15", "A17", "A19" }));
+            QCOMPARE(list.filter("B"), QStringList({ "B0", "B2", "B4", "B6", "B8", "B10", "B12", "B14", "B16", "B18" }));
+        }
+    }
+
+    void testContextDeleted()
+    {
+        LocalIoExecutor executor;
+        auto context = new QObject;
+
+        bool operationRan = false;
+        bool callbackRan = false;
+        executor.post(QStringLiteral("A"), context,
+            [&operationRan] { operationRan = true; return 0; },
+            [&callbackRan](int) { callbackRan = true; });
+        delete context;
+
+        // Later operations of the key still run
+        bool nextCallbackRan = false;
+        QObject otherContext;
+        executor.post(QStringLiteral("A"), &otherContext,
+            [] { return 0; },
+            [&nextCallbackRan](int) { nextCallbackRan = true; });
+        QTRY_VERIFY(nextCallbackRan);
+        QVERIFY(operationRan);
+        QVERIFY(!callbackRan);
+    }
+
+    void testDirectoryKey()
+    {
+        QCOMPARE(LocalIoExecutor::directoryKey("/sync/A/a1"), QStringLiteral("/sync/A"));
+        QCOMPARE(LocalIoExecutor::directoryKey("/sync/A"), QStringLiteral("/sync"));
+        QCOMPARE(LocalIoExecutor::directoryKey("a1"), QString());
+    }
+};
+
+QTEST_GUILESS_MAIN(TestLocalIoExecutor)
+#include "testlocalioexecutor.moc"
@@ -115,6 +115,51 @@ private slots:
         QVERIFY(verifyCalledOnceWithAccount(filesChangedSpy, account));
     }
 
+    void testSetup_authenticated_listenForFileIds()
+    {
+        FakeWebSocketServer fakeServer;
+        auto account = FakeWebSocketServer::createAccount();
+        QVERIFY(fakeServer.authenticateAccount(account));
+
+        QTRY_VERIFY(fakeServer.listenedEvents().contains(QStringLiteral("notify_file_id")));
+    }
+
+    void testOnWebSocketTextMessageReceived_notifyFileIdMessage_emitFileIdsChanged()
+    {
+        FakeWebSocketServer fakeServer;
+        auto account = FakeWebSocketServer::createAccount();
+        const auto socket = fakeServer.authenticateAccount(account);
+        QVERIFY(socket);
+        QSignalSpy filesChangedSpy(account->pushNotifications(), &OCC::PushNotifications::filesChanged);
+        QSignalSpy fileIdsChangedSpy(account->pushNotifications(), &OCC::PushNotifications::fileIdsChanged);
+
+        socket->sendTextMessage("notify_file_id [12,3456789012]");
+
+        // fileIdsChanged signal should be emitted instead of filesChanged
+        QVERIFY(fileIdsChangedSpy.wait());
+        QCOMPARE(fileIdsChangedSpy.count(), 1);
+        QCOMPARE(fileIdsChangedSpy.at(0).at(0).value<OCC::Account *>(), account.data());
+        QCOMPARE(fileIdsChangedSpy.at(0).at(1).value<QVector<qint64>>(), QVector<qint64>({ 12, 3456789012 }));
+        QCOMPARE(filesChangedSpy.count(), 0);
+    }
+
+    void testOnWebSocketTextMessageReceived_invalidNotifyFileIdMessage_emitFilesChanged()
+    {
+        FakeWebSocketServer fakeServer;
+        auto account = FakeWebSocketServer::createAccount();
+        const auto socket = fakeServer.authenticateAccount(account);
+        QVERIFY(socket);
+        QSignalSpy filesChangedSpy(account->pushNotifications(), &OCC::PushNotifications::filesChanged);
+        QSignalSpy fileIdsChangedSpy(account->pushNotifications(), &OCC::PushNotifications::fileIdsChanged);
+
+        socket->sendTextMessage("notify_file_id garbage");
+
+        // Without usable ids every file may have changed
+        QVERIFY(filesChangedSpy.wait());
+        QVERIFY(verifyCalledOnceWithAccount(filesChangedSpy, account));
+        QCOMPARE(fileIdsChangedSpy.count(), 0);
+    }
+
     void testOnWebSocketTextMessageReceived_notifyActivityMessage_emitNotification()
     {
         FakeWebSocketServer fakeServer;
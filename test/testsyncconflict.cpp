@@ -88,6 +88,38 @@ private slots:
         QCOMPARE(fakeFolder.currentLocalState(), fakeFolder.currentRemoteState());
     }
 
+    // Without checksums the downloaded and the local content are compared in a worker thread
+    void testConflictDecidedByContent()
+    {
+        FakeFolder fakeFolder{ FileInfo::A12_B12_C12_S12() };
+        ItemCompletedSpy completeSpy(fakeFolder);
+
+        // Same size, different content
+        fakeFolder.localModifier().setContents("A/a1", 'L');
+        fakeFolder.remoteModifier().setContents("A/a1", 'R');
+        // Same content, different mtime
+        fakeFolder.localModifier().setContents("A/a2", 'S');
+        fakeFolder.remoteModifier().setContents("A/a2", 'S');
+        fakeFolder.remoteModifier().setModTime("A/a2", QDateTime::currentDateTimeUtc().addDays(-1));
+        QVERIFY(fakeFolder.remoteModifier().find("A/a1")->checksums.isEmpty());
+        QVERIFY(fakeFolder.remoteModifier().find("A/a2")->checksums.isEmpty());
+        QVERIFY(fakeFolder.syncOnce());
+
+        QVERIFY(itemConflict(completeSpy, "A/a1"));
+        const auto conflicts = findConflicts(fakeFolder.currentLocalState().children["A"]);
+        QCOMPARE(conflicts.size(), 1);
+        QVERIFY(conflicts.first().startsWith("A/a1"));
+        QCOMPARE(fakeFolder.currentLocalState().find(conflicts.first())->contentChar, 'L');
+        QCOMPARE(fakeFolder.currentLocalState().find("A/a1")->contentChar, 'R');
+        QCOMPARE(fakeFolder.syncJournal().conflictRecordPaths().size(), 1);
+
+        // Equal content is no conflict
+        QCOMPARE(completeSpy.findItem("A/a2")->_status, SyncFileItem::Success);
+
+        QVERIFY(expectAndWipeConflict(fakeFolder.localModifier(), fakeFolder.currentLocalState(), "A/a1"));
+        QCOMPARE(fakeFolder.currentLocalState(), fakeFolder.currentRemoteState());
+    }
+
     void testUploadAfterDownload()
     {
         FakeFolder fakeFolder{ FileInfo::A12_B12_C12_S12() };
@@ -9,6 +9,10 @@
 #include "syncenginetestutils.h"
 #include <syncengine.h>
 
+#ifdef Q_OS_UNIX
+#include <unistd.h>
+#endif
+
 using namespace OCC;
 
 class TestSyncDelete : public QObject
@@ -42,6 +46,49 @@ private slots:
         QCOMPARE(fakeFolder.currentLocalState(), fakeFolder.currentRemoteState());
     }
 
+    void testDeleteDirectoryPartially()
+    {
+#ifndef Q_OS_UNIX
+        QSKIP("Needs a folder whose entries can't be removed");
+#else
+        if (geteuid() == 0)
+            QSKIP("Permissions don't stop root");
+
+        FakeFolder fakeFolder{ FileInfo::A12_B12_C12_S12() };
+        fakeFolder.remoteModifier().mkdir("A/deep");
+        fakeFolder.remoteModifier().insert("A/deep/d1");
+        fakeFolder.remoteModifier().mkdir("A/sub");
+        fakeFolder.remoteModifier().insert("A/sub/s1");
+        QVERIFY(fakeFolder.syncOnce());
+        QCOMPARE(fakeFolder.currentLocalState(), fakeFolder.currentRemoteState());
+
+        // The content of A/sub can't be removed
+        const QString subPath = fakeFolder.localPath() + "A/sub";
+        QFile::setPermissions(subPath, QFile::ReadOwner | QFile::ExeOwner);
+
+        fakeFolder.remoteModifier().remove("A");
+        QVERIFY(!fakeFolder.syncOnce());
+        QFile::setPermissions(subPath, QFile::ReadOwner | QFile::WriteOwner | QFile::ExeOwner);
+
+        // What was removed is gone from the journal, the rest is kept
+        const auto hasRecord = [&](const char *path) {
+            SyncJournalFileRecord record;
+            return fakeFolder.syncJournal().getFileRecord(QByteArray(path), &record) && record.isValid();
+        };
+        QVERIFY(!QFile::exists(fakeFolder.localPath() + "A/a1"));
+        QVERIFY(!hasRecord("A/a1"));
+        QVERIFY(!hasRecord("A/deep"));
+        QVERIFY(!hasRecord("A/deep/d1"));
+        QVERIFY(QFile::exists(subPath + "/s1"));
+        QVERIFY(hasRecord("A/sub/s1"));
+
+        // Once possible, the rest is removed too
+        QVERIFY(fakeFolder.syncOnce());
+        QVERIFY(!QFile::exists(fakeFolder.localPath() + "A"));
+        QCOMPARE(fakeFolder.currentLocalState(), fakeFolder.currentRemoteState());
+#endif
+    }
+
     void issue1329()
     {
         FakeFolder fakeFolder{ FileInfo::A12_B12_C12_S12() };
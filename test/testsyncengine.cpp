@@ -54,6 +54,18 @@ int itemSuccessfullyCompletedGetRank(const ItemCompletedSpy &spy, const QString
     return -1;
 }
 
+// Answers a bulk upload like the fake server, but late enough for the next batch to be sent meanwhile
+QNetworkReply *delayedBulkUploadReply(FakeFolder &fakeFolder, QNetworkAccessManager::Operation op, const QNetworkRequest &request, QIODevice *outgoingData)
+{
+    const auto contentType = request.header(QNetworkRequest::ContentTypeHeader).toString();
+    const auto files = FakePutMultiFileReply::performMultiPart(fakeFolder.remoteModifier(), request, outgoingData->readAll(), contentType);
+    QJsonObject replyObject;
+    for (const auto fileInfo : files) {
+        replyObject.insert(QChar('/') + fileInfo->path(), QJsonObject{ { "error", false }, { "etag", QString::fromUtf8(fileInfo->etag) } });
+    }
+    return new FakePayloadReply(op, request, QJsonDocument(replyObject).toJson(), 200, nullptr);
+}
+
 class TestSyncEngine : public QObject
 {
     Q_OBJECT
@@ -451,6 +463,10 @@ private slots:
         QVERIFY(fakeFolder.syncOnce());
         QCOMPARE(nGET, expectedGET);
 
+        // the content is identical, a download must not lead to a conflict copy
+        QVERIFY(fakeFolder.syncJournal().conflictRecordPaths().isEmpty());
+        QCOMPARE(fakeFolder.currentLocalState(), fakeFolder.currentRemoteState());
+
         // check that mtime in journal and filesystem agree
         QString a1path = fakeFolder.localPath() + "A/a1";
         SyncJournalFileRecord a1record;
@@ -1030,6 +1046,104 @@ private slots:
         QCOMPARE(fakeFolder.currentLocalState(), fakeFolder.currentRemoteState());
     }
 
+    /**
+     * Checks that many small files are split into several bulk uploads, which may be in flight together
+     */
+    void testManySmallFilesWithBulkUpload()
+    {
+        FakeFolder fakeFolder{ FileInfo::A12_B12_C12_S12() };
+        fakeFolder.syncEngine().account()->setCapabilities({ { "dav", QVariantMap{ {"bulkupload", "1.0"} } } });
+
+        int nPUT = 0;
+        int nPOST = 0;
+        int postsInFlight = 0;
+        int maximumPostsInFlight = 0;
+        fakeFolder.setServerOverride([&](QNetworkAccessManager::Operation op, const QNetworkRequest &request, QIODevice *outgoingData) -> QNetworkReply * {
+            if (op == QNetworkAccessManager::PostOperation) {
+                ++nPOST;
+                auto reply = delayedBulkUploadReply(fakeFolder, op, request, outgoingData);
+                maximumPostsInFlight = std::max(maximumPostsInFlight, ++postsInFlight);
+                connect(reply, &QNetworkReply::finished, this, [&] { --postsInFlight; });
+                return reply;
+            } else if (op == QNetworkAccessManager::PutOperation) {
+                ++nPUT;
+            }
+            return nullptr;
+        });
+
+        fakeFolder.localModifier().mkdir("many");
+        for (int i = 0; i < 250; ++i) {
+            fakeFolder.localModifier().insert(QStringLiteral("many/file%1").arg(i), 10 + i % 7);
+        }
+        fakeFolder.localModifier().insert("many/empty", 0);
+
+        QVERIFY(fakeFolder.syncOnce());
+        QCOMPARE(nPUT, 0);
+        QCOMPARE(nPOST, 3);
+        QVERIFY(maximumPostsInFlight > 1);
+        QCOMPARE(postsInFlight, 0);
+        QCOMPARE(fakeFolder.currentLocalState(), fakeFolder.currentRemoteState());
+
+        // nothing is left over for the next sync
+        nPOST = 0;
+        QVERIFY(fakeFolder.syncOnce());
+        QCOMPARE(nPOST, 0);
+    }
+
+    void testBulkUploadUnreadableFile()
+    {
+#ifdef Q_OS_WIN
+        QSKIP("Files can't be made unreadable by permissions on Windows");
+#endif
+        FakeFolder fakeFolder{ FileInfo::A12_B12_C12_S12() };
+        fakeFolder.syncEngine().account()->setCapabilities({ { "dav", QVariantMap{ {"bulkupload", "1.0"} } } });
+
+        int postsInFlight = 0;
+        fakeFolder.setServerOverride([&](QNetworkAccessManager::Operation op, const QNetworkRequest &request, QIODevice *outgoingData) -> QNetworkReply * {
+            if (op == QNetworkAccessManager::PostOperation) {
+                auto reply = delayedBulkUploadReply(fakeFolder, op, request, outgoingData);
+                ++postsInFlight;
+                connect(reply, &QNetworkReply::finished, this, [&] { --postsInFlight; });
+                return reply;
+            }
+            return nullptr;
+        });
+
+        fakeFolder.localModifier().mkdir("many");
+        for (int i = 0; i < 250; ++i) {
+            fakeFolder.localModifier().insert(QStringLiteral("many/file%1").arg(i), 10);
+        }
+        // Can't be opened when its batch is sent, while other batches may be in flight
+        const auto unreadable = QStringLiteral("many/file249");
+        QFile::setPermissions(fakeFolder.localPath() + unreadable, QFileDevice::WriteOwner);
+        if (QFile(fakeFolder.localPath() + unreadable).open(QIODevice::ReadOnly)) {
+            QSKIP("The file stays readable, probably running as root");
+        }
+
+        int finishedCount = 0;
+        connect(&fakeFolder.syncEngine(), &SyncEngine::finished, this, [&] {
+            ++finishedCount;
+            // The propagation only ends once every request is answered
+            QCOMPARE(postsInFlight, 0);
+        });
+        ItemCompletedSpy completeSpy(fakeFolder);
+        QVERIFY(!fakeFolder.syncOnce());
+        QCOMPARE(finishedCount, 1);
+        QCOMPARE(postsInFlight, 0);
+
+        QCOMPARE(completeSpy.findItem(unreadable)->_status, SyncFileItem::NormalError);
+        QVERIFY(!fakeFolder.currentRemoteState().find(unreadable));
+        for (int i = 0; i < 249; ++i) {
+            const auto file = QStringLiteral("many/file%1").arg(i);
+            QCOMPARE(completeSpy.findItem(file)->_status, SyncFileItem::Success);
+            QVERIFY(fakeFolder.currentRemoteState().find(file));
+        }
+
+        QFile::setPermissions(fakeFolder.localPath() + unreadable, QFileDevice::ReadOwner | QFileDevice::WriteOwner);
+        QVERIFY(fakeFolder.syncOnce());
+        QCOMPARE(fakeFolder.currentLocalState(), fakeFolder.currentRemoteState());
+    }
+
     void testRemoteMoveFailedInsufficientStorageLocalMoveRolledBack()
     {
         FakeFolder fakeFolder{FileInfo{}};
@@ -1244,6 +1358,30 @@ private slots:
         auto expectedState = fakeFolder.currentLocalState();
         QCOMPARE(fakeFolder.currentRemoteState(), expectedState);
     }
+
+    // The engine must not keep the items of a finished sync alive
+    void testSyncItemsReleasedAfterSync()
+    {
+        FakeFolder fakeFolder{ FileInfo::A12_B12_C12_S12() };
+        fakeFolder.remoteModifier().insert("A/new");
+        fakeFolder.remoteModifier().mkdir("D");
+        fakeFolder.remoteModifier().insert("D/d1");
+        fakeFolder.localModifier().insert("B/new");
+        fakeFolder.localModifier().remove("C/c1");
+
+        QVector<QWeakPointer<SyncFileItem>> items;
+        connect(&fakeFolder.syncEngine(), &SyncEngine::aboutToPropagate, this, [&](const SyncFileItemVector &propagated) {
+            for (const auto &item : propagated)
+                items.append(item);
+        });
+        QVERIFY(fakeFolder.syncOnce());
+        QCOMPARE(fakeFolder.currentLocalState(), fakeFolder.currentRemoteState());
+        QCoreApplication::sendPostedEvents(nullptr, QEvent::DeferredDelete);
+
+        QVERIFY(items.size() >= 5);
+        for (const auto &item : qAsConst(items))
+            QVERIFY(item.isNull());
+    }
 };
 
 QTEST_GUILESS_MAIN(TestSyncEngine)
@@ -63,6 +63,39 @@ private slots:
         QVERIFY(!(b < b));
         QVERIFY(!(c < c));
     }
+
+    void testSortSyncFileItems() {
+        // Large enough to be sorted in parallel chunks
+        SyncFileItemVector items;
+        for (int i = 0; i < 100000; ++i) {
+            auto item = SyncFileItemPtr::create();
+            const int n = (i * 7919) % 100000;
+            item->_file = QStringLiteral("dir%1/sub%2/file%3").arg(n / 2500).arg((n / 50) % 50).arg(n);
+            if (n % 20 == 0)
+                item->_renameTarget = item->_file + QStringLiteral("-moved");
+            // equal destinations must keep their order
+            item->_size = i;
+            items.append(item);
+            if (n % 1000 == 0) {
+                auto twin = SyncFileItemPtr::create(*item);
+                twin->_size = -i;
+                items.append(twin);
+            }
+        }
+        auto expected = items;
+        std::stable_sort(expected.begin(), expected.end());
+
+        sortSyncFileItems(items);
+        QCOMPARE(items.size(), expected.size());
+        for (int i = 0; i < items.size(); ++i)
+            QCOMPARE(items[i], expected[i]);
+
+        SyncFileItemVector few = { SyncFileItemPtr::create(createItem("b")), SyncFileItemPtr::create(createItem("a/b")), SyncFileItemPtr::create(createItem("a")) };
+        sortSyncFileItems(few);
+        QCOMPARE(few[0]->_file, QStringLiteral("a"));
+        QCOMPARE(few[1]->_file, QStringLiteral("a/b"));
+        QCOMPARE(few[2]->_file, QStringLiteral("b"));
+    }
 };
 
 QTEST_APPLESS_MAIN(TestSyncFileItem)
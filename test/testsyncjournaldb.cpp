@@ -90,6 +90,185 @@ private slots:
         QVERIFY(!record.isValid());
     }
 
+    void testNumericFileId()
+    {
+        auto makeRecord = [&](const QByteArray &path, const QByteArray &fileId) {
+            SyncJournalFileRecord record;
+            record._path = path;
+            record._fileId = fileId;
+            record._remotePerm = RemotePermissions::fromDbValue("RW");
+            record._modtime = dropMsecs(QDateTime::currentDateTime());
+            QVERIFY(_db.setFileRecord(record));
+        };
+        makeRecord("numeric/a", "00000012ocabcdefghij");
+        makeRecord("numeric/b", "00000123ocabcdefghij");
+        makeRecord("numeric/c", "1234567890ocabcdefghij");
+
+        auto pathsFor = [&](qint64 numericFileId) {
+            QByteArrayList paths;
+            if (!_db.getFileRecordsByNumericFileId(numericFileId, [&](const SyncJournalFileRecord &record) {
+                    paths.append(record._path);
+                })) {
+                paths.append("error");
+            }
+            return paths;
+        };
+        QCOMPARE(pathsFor(12), QByteArrayList({ "numeric/a" }));
+        QCOMPARE(pathsFor(123), QByteArrayList({ "numeric/b" }));
+        QCOMPARE(pathsFor(1234567890), QByteArrayList({ "numeric/c" }));
+        // Not just a prefix of a longer id
+        QVERIFY(pathsFor(1).isEmpty());
+        QVERIFY(pathsFor(1234).isEmpty());
+
+        for (const auto path : { "numeric/a", "numeric/b", "numeric/c" })
+            QVERIFY(_db.deleteFileRecord(path));
+    }
+
+    void testSearchFileNames_data()
+    {
+        QTest::addColumn<bool>("fileNameIndex");
+
+        QTest::newRow("index") << true;
+        QTest::newRow("scan") << false;
+    }
+
+    void testSearchFileNames()
+    {
+        QFETCH(bool, fileNameIndex);
+
+        // The setting applies when the journal is opened
+        _db.close();
+        SyncJournalDb::setFileNameIndexEnabled(fileNameIndex);
+        if (!fileNameIndex)
+            QVERIFY(!_db.hasFileNameIndex());
+
+        auto makeRecord = [&](const QByteArray &path) {
+            SyncJournalFileRecord record;
+            record._path = path;
+            record._fileId = "fileid-" + path;
+            record._remotePerm = RemotePermissions::fromDbValue("RW");
+            record._modtime = dropMsecs(QDateTime::currentDateTime());
+            QVERIFY(_db.setFileRecord(record));
+        };
+        makeRecord("search");
+        makeRecord("search/Budget 2021.ods");
+        makeRecord("search/budget notes.txt");
+        makeRecord("search/budget");
+        makeRecord("search/budget/report.pdf");
+        makeRecord("search/100%_done.txt");
+
+        auto search = [&](const QString &term, int limit = 10) {
+            QByteArrayList paths;
+            if (!_db.searchFileNames(term, limit, [&](const SyncJournalFileRecord &record) {
+                    paths.append(record._path);
+                })) {
+                paths.append("error");
+            }
+            return paths;
+        };
+
+        // Case insensitive and only on the file name, not the parent directories
+        QCOMPARE(search("budget"), QByteArrayList({ "search/Budget 2021.ods", "search/budget", "search/budget notes.txt" }));
+        QCOMPARE(search("report"), QByteArrayList({ "search/budget/report.pdf" }));
+        QCOMPARE(search("budget", 2).size(), 2);
+        // LIKE wildcards are matched literally
+        QCOMPARE(search("0%_"), QByteArrayList({ "search/100%_done.txt" }));
+        QVERIFY(search("nothing like it").isEmpty());
+
+        // Deleting keeps the index in sync
+        QVERIFY(_db.deleteFileRecord("search/budget", true));
+        QVERIFY(search("report").isEmpty());
+        QCOMPARE(search("budget"), QByteArrayList({ "search/Budget 2021.ods", "search/budget notes.txt" }));
+
+        QVERIFY(_db.deleteFileRecord("search", true));
+        QVERIFY(search("budget").isEmpty());
+
+        _db.close();
+        SyncJournalDb::setFileNameIndexEnabled(true);
+    }
+
+    void testFileNameIndexRebuild()
+    {
+        if (!_db.hasFileNameIndex())
+            QSKIP("SQLite has no FTS5 trigram support");
+
+        // Records written without the index...
+        _db.close();
+        SyncJournalDb::setFileNameIndexEnabled(false);
+        SyncJournalFileRecord record;
+        record._path = "rebuild/needle.txt";
+        record._fileId = "fileid-needle";
+        record._remotePerm = RemotePermissions::fromDbValue("RW");
+        record._modtime = dropMsecs(QDateTime::currentDateTime());
+        QVERIFY(_db.setFileRecord(record));
+
+        // ...are indexed when it comes back
+        _db.close();
+        SyncJournalDb::setFileNameIndexEnabled(true);
+        QVERIFY(_db.hasFileNameIndex());
+        QByteArrayList paths;
+        QVERIFY(_db.searchFileNames("needle", 10, [&](const SyncJournalFileRecord &rec) {
+            paths.append(rec._path);
+        }));
+        QCOMPARE(paths, QByteArrayList({ "rebuild/needle.txt" }));
+
+        QVERIFY(_db.deleteFileRecord("rebuild/needle.txt"));
+    }
+
+    void testMoveFileRecordsBelow()
+    {
+        auto makeRecord = [&](const QByteArray &path) {
+            SyncJournalFileRecord record;
+            record._path = path;
+            record._fileId = "fileid-" + path;
+            record._remotePerm = RemotePermissions::fromDbValue("RW");
+            record._checksumHeader = "SHA1:" + path;
+            record._modtime = dropMsecs(QDateTime::currentDateTime());
+            QVERIFY(_db.setFileRecord(record));
+        };
+        makeRecord("moveme");
+        makeRecord("moveme/a");
+        makeRecord("moveme/sub");
+        makeRecord("moveme/sub/b\xc3\xa9");
+        makeRecord("movemeToo/c");
+        _db.internalPinStates().setForPath("moveme/sub", PinState::OnlineOnly);
+
+        QVERIFY(_db.moveFileRecordsBelow("moveme", "moved/here"));
+
+        SyncJournalFileRecord record;
+        // The directory itself stays
+        QVERIFY(_db.getFileRecord(QByteArrayLiteral("moveme"), &record));
+        QVERIFY(record.isValid());
+        for (const auto path : { "moveme/a", "moveme/sub", "moveme/sub/b\xc3\xa9" }) {
+            QVERIFY(_db.getFileRecord(QByteArray(path), &record));
+            QVERIFY(!record.isValid());
+        }
+        for (const auto path : { "a", "sub", "sub/b\xc3\xa9" }) {
+            QVERIFY(_db.getFileRecord(QByteArray("moved/here/") + path, &record));
+            QVERIFY(record.isValid());
+            QCOMPARE(record._fileId, QByteArray("fileid-moveme/") + path);
+            QCOMPARE(record._checksumHeader, QByteArray("SHA1:moveme/") + path);
+        }
+        // Only children of the directory, not siblings sharing the prefix
+        QVERIFY(_db.getFileRecord(QByteArrayLiteral("movemeToo/c"), &record));
+        QVERIFY(record.isValid());
+
+        QCOMPARE(*_db.internalPinStates().rawForPath("moveme/sub"), PinState::Inherited);
+        QCOMPARE(*_db.internalPinStates().rawForPath("moved/here/sub"), PinState::OnlineOnly);
+        QCOMPARE(*_db.internalPinStates().effectiveForPath("moved/here/sub/b\xc3\xa9"), PinState::OnlineOnly);
+
+        if (_db.hasFileNameIndex()) {
+            QByteArrayList found;
+            QVERIFY(_db.searchFileNames(QStringLiteral("bé"), 10, [&](const SyncJournalFileRecord &rec) { found.append(rec._path); }));
+            QCOMPARE(found, QByteArrayList({ "moved/here/sub/b\xc3\xa9" }));
+        }
+
+        _db.internalPinStates().wipeForPathAndBelow("moved");
+        QVERIFY(_db.deleteFileRecord("moveme", true));
+        QVERIFY(_db.deleteFileRecord("moved", true));
+        QVERIFY(_db.deleteFileRecord("movemeToo", true));
+    }
+
     void testFileRecordChecksum()
     {
         // Try with and without a checksum
@@ -444,6 +623,16 @@ private slots:
         list = _db.internalPinStates().rawList();
         QCOMPARE(list->size(), 4 + 9 + 27 - 4);
 
+        // The effective states are resolved in memory, make sure they saw the wipe
+        QCOMPARE(get("online/local/online"), PinState::OnlineOnly);
+        QCOMPARE(get("local/online/local"), PinState::AlwaysLocal);
+        make("local", PinState::OnlineOnly);
+        QCOMPARE(get("local/local/online"), PinState::OnlineOnly);
+        QCOMPARE(get("local/local/nonexistant"), PinState::OnlineOnly);
+        QCOMPARE(get("local/online/local"), PinState::AlwaysLocal);
+        make("local", PinState::AlwaysLocal);
+        QCOMPARE(get("local/local/nonexistant"), PinState::AlwaysLocal);
+
         // Wiping everything
         _db.internalPinStates().wipeForPathAndBelow("");
         QCOMPARE(getRaw(""), PinState::Inherited);
@@ -451,6 +640,8 @@ private slots:
         QCOMPARE(getRaw("online"), PinState::Inherited);
         list = _db.internalPinStates().rawList();
         QCOMPARE(list->size(), 0);
+        QCOMPARE(get("online"), PinState::AlwaysLocal);
+        QCOMPARE(get("online/online/inherit"), PinState::AlwaysLocal);
     }
 
 private:
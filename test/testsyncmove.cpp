@@ -53,6 +53,15 @@ bool itemSuccessfulMove(const ItemCompletedSpy &spy, const QString &path)
     return itemSuccessful(spy, path, CSYNC_INSTRUCTION_RENAME);
 }
 
+// findItem() returns an empty item for paths that were not reported, look at both names here
+bool itemWasReported(const ItemCompletedSpy &spy, const QString &path)
+{
+    return std::any_of(spy.cbegin(), spy.cend(), [&path](const QList<QVariant> &args) {
+        const auto item = args[0].value<SyncFileItemPtr>();
+        return item->_file == path || item->destination() == path;
+    });
+}
+
 QStringList findConflicts(const FileInfo &dir)
 {
     QStringList conflicts;
@@ -873,6 +882,90 @@ private slots:
 
     }
 
+    // Unchanged files below a renamed directory are moved in the db along with it
+    void testDirectoryMoveMovesRecords()
+    {
+        FakeFolder fakeFolder{ FileInfo::A12_B12_C12_S12() };
+        fakeFolder.remoteModifier().mkdir("A/sub");
+        fakeFolder.remoteModifier().insert("A/sub/s1");
+        QVERIFY(fakeFolder.syncOnce());
+
+        auto fileIdOf = [&](const QByteArray &path) {
+            SyncJournalFileRecord record;
+            if (!fakeFolder.syncJournal().getFileRecord(path, &record) || !record.isValid())
+                return QByteArray();
+            return record._fileId;
+        };
+        const auto a1Id = fileIdOf("A/a1");
+        const auto s1Id = fileIdOf("A/sub/s1");
+        const auto b1Id = fileIdOf("B/b1");
+        QVERIFY(!a1Id.isEmpty() && !s1Id.isEmpty() && !b1Id.isEmpty());
+
+        OperationCounter counter;
+        fakeFolder.setServerOverride(counter.functor());
+
+        fakeFolder.localModifier().rename("A", "AM");
+        fakeFolder.remoteModifier().rename("B", "BM");
+        ItemCompletedSpy completeSpy(fakeFolder);
+        QVERIFY(fakeFolder.syncOnce());
+        QCOMPARE(fakeFolder.currentLocalState(), fakeFolder.currentRemoteState());
+        QCOMPARE(printDbData(fakeFolder.dbState()), printDbData(fakeFolder.currentRemoteState()));
+        QCOMPARE(counter.nGET, 0);
+        QCOMPARE(counter.nPUT, 0);
+        QCOMPARE(counter.nMOVE, 1);
+        QVERIFY(itemSuccessfulMove(completeSpy, "AM"));
+        QVERIFY(itemSuccessfulMove(completeSpy, "BM"));
+        QVERIFY(itemSuccessfulMove(completeSpy, "AM/sub"));
+        // no per-file renames
+        for (const auto &path : { "A/a1", "AM/a1", "A/sub/s1", "AM/sub/s1", "B/b1", "BM/b1" }) {
+            QVERIFY2(!itemWasReported(completeSpy, QString::fromLatin1(path)), path);
+        }
+
+        QCOMPARE(fileIdOf("AM/a1"), a1Id);
+        QCOMPARE(fileIdOf("AM/sub/s1"), s1Id);
+        QCOMPARE(fileIdOf("BM/b1"), b1Id);
+        QVERIFY(fileIdOf("A/a1").isEmpty());
+        QVERIFY(fileIdOf("A/sub/s1").isEmpty());
+        QVERIFY(fileIdOf("B/b1").isEmpty());
+
+        // Nothing left to do
+        counter.reset();
+        QVERIFY(fakeFolder.syncOnce());
+        QCOMPARE(counter.nGET + counter.nPUT + counter.nMOVE + counter.nDELETE, 0);
+        QCOMPARE(fakeFolder.currentLocalState(), fakeFolder.currentRemoteState());
+    }
+
+    // A delete below a renamed directory removes the record at its new place
+    void testDeleteInRenamedDirectory()
+    {
+        FakeFolder fakeFolder{ FileInfo::A12_B12_C12_S12() };
+
+        auto hasRecord = [&](const QByteArray &path) {
+            SyncJournalFileRecord record;
+            return fakeFolder.syncJournal().getFileRecord(path, &record) && record.isValid();
+        };
+
+        // Renamed locally, deleted on the server
+        fakeFolder.localModifier().rename("A", "AM");
+        fakeFolder.remoteModifier().remove("A/a1");
+        QVERIFY(fakeFolder.syncOnce());
+        QCOMPARE(fakeFolder.currentLocalState(), fakeFolder.currentRemoteState());
+        QVERIFY(!fakeFolder.currentLocalState().find("AM/a1"));
+        QVERIFY(!hasRecord("AM/a1"));
+        QVERIFY(!hasRecord("A/a1"));
+        QVERIFY(hasRecord("AM/a2"));
+
+        // Renamed on the server, deleted locally
+        fakeFolder.remoteModifier().rename("B", "BM");
+        fakeFolder.localModifier().remove("B/b1");
+        QVERIFY(fakeFolder.syncOnce());
+        QCOMPARE(fakeFolder.currentLocalState(), fakeFolder.currentRemoteState());
+        QVERIFY(!fakeFolder.currentRemoteState().find("BM/b1"));
+        QVERIFY(!hasRecord("BM/b1"));
+        QVERIFY(!hasRecord("B/b1"));
+        QVERIFY(hasRecord("BM/b2"));
+    }
+
     // Test that deletes don't run before renames
     void testRenameParallelism()
     {
@@ -890,6 +983,72 @@ private slots:
         QCOMPARE(fakeFolder.currentLocalState(), fakeFolder.currentRemoteState());
     }
 
+    // Remote deletes and moves of files in many folders are sent as one batch
+    void testBulkDeleteAndMove()
+    {
+        FakeFolder fakeFolder{ FileInfo::A12_B12_C12_S12() };
+        const QStringList folders = { "A", "B", "C" };
+        for (const auto &folder : folders) {
+            for (int i = 0; i < 10; ++i) {
+                fakeFolder.remoteModifier().insert(QStringLiteral("%1/del%2").arg(folder).arg(i));
+                fakeFolder.remoteModifier().insert(QStringLiteral("%1/mov%2").arg(folder).arg(i));
+            }
+        }
+        QVERIFY(fakeFolder.syncOnce());
+        QCOMPARE(fakeFolder.currentLocalState(), fakeFolder.currentRemoteState());
+
+        QStringList verbs;
+        fakeFolder.setServerOverride([&](QNetworkAccessManager::Operation op, const QNetworkRequest &req, QIODevice *) -> QNetworkReply * {
+            if (op == QNetworkAccessManager::DeleteOperation)
+                verbs.append("DELETE");
+            if (req.attribute(QNetworkRequest::CustomVerbAttribute) == "MOVE")
+                verbs.append("MOVE");
+            return nullptr;
+        });
+
+        for (const auto &folder : folders) {
+            for (int i = 0; i < 10; ++i) {
+                fakeFolder.localModifier().remove(QStringLiteral("%1/del%2").arg(folder).arg(i));
+                fakeFolder.localModifier().rename(QStringLiteral("%1/mov%2").arg(folder).arg(i), QStringLiteral("%1/moved%2").arg(folder).arg(i));
+            }
+        }
+        fakeFolder.localModifier().rename("A/a1", "C/a1");
+        fakeFolder.serverErrorPaths().append("B/del3", 500);
+        fakeFolder.serverErrorPaths().append("C/mov2", 403);
+
+        ItemCompletedSpy completeSpy(fakeFolder);
+        QVERIFY(!fakeFolder.syncOnce());
+
+        // Every request was sent, the deletes before the moves
+        QCOMPARE(verbs.count("DELETE"), 30);
+        QCOMPARE(verbs.count("MOVE"), 31);
+        QVERIFY(verbs.lastIndexOf("DELETE") < verbs.indexOf("MOVE"));
+
+        // Each item has its own result
+        QCOMPARE(completeSpy.findItem("B/del3")->_status, SyncFileItem::NormalError);
+        QCOMPARE(completeSpy.findItem("C/moved2")->_status, SyncFileItem::NormalError);
+        QVERIFY(itemSuccessful(completeSpy, "A/del3", CSYNC_INSTRUCTION_REMOVE));
+        QVERIFY(itemSuccessfulMove(completeSpy, "B/moved2"));
+        QVERIFY(itemSuccessfulMove(completeSpy, "C/a1"));
+
+        const auto remote = fakeFolder.currentRemoteState();
+        QVERIFY(remote.find("B/del3"));
+        QVERIFY(!remote.find("A/del3"));
+        QVERIFY(remote.find("C/mov2"));
+        QVERIFY(remote.find("B/moved2"));
+        QVERIFY(remote.find("C/a1"));
+
+        SyncJournalFileRecord record;
+        QVERIFY(fakeFolder.syncJournal().getFileRecord(QByteArray("B/del3"), &record) && record.isValid());
+        QVERIFY(fakeFolder.syncJournal().getFileRecord(QByteArray("A/del3"), &record) && !record.isValid());
+        QVERIFY(fakeFolder.syncJournal().getFileRecord(QByteArray("B/moved2"), &record) && record.isValid());
+
+        fakeFolder.serverErrorPaths().clear();
+        fakeFolder.syncJournal().wipeErrorBlacklist();
+        QVERIFY(fakeFolder.syncOnce());
+        QCOMPARE(fakeFolder.currentLocalState(), fakeFolder.currentRemoteState());
+    }
+
     void testMovedWithError_data()
     {
         QTest::addColumn<Vfs::Mode>("vfsMode");
@@ -0,0 +1,86 @@
+/*
+ *    This software is in the public domain, furnished "as is", without technical
+ *    support, and with no warranty, express or implied, as to its usefulness for
+ *    any purpose.
+ *
+ */
+
+#include <QtTest>
+#include "syncenginetestutils.h"
+#include "cmd/syncscheduler.h"
+#include <syncengine.h>
+
+using namespace OCC;
+
+class TestSyncScheduler : public QObject
+{
+    Q_OBJECT
+
+    /* Hands a second journal and engine on the fake folder to the scheduler, like nextcloudcmd does */
+    SyncEngine *addFolder(SyncScheduler &scheduler, FakeFolder &fakeFolder)
+    {
+        auto journal = std::make_unique<SyncJournalDb>(fakeFolder.localPath() + QStringLiteral(".sync_scheduler.db"));
+        auto engine = std::make_unique<SyncEngine>(fakeFolder.account(), fakeFolder.localPath(), QString(), journal.get());
+        engine->excludedFiles().addManualExclude(QStringLiteral("]*.~*"));
+        const auto enginePtr = engine.get();
+        scheduler.addFolder(fakeFolder.localPath(), std::move(journal), std::move(engine));
+        return enginePtr;
+    }
+
+private slots:
+    void testSyncOnce()
+    {
+        FakeFolder fakeFolder{ FileInfo::A12_B12_C12_S12() };
+        fakeFolder.localModifier().insert("A/new");
+
+        SyncScheduler scheduler(fakeFolder.account());
+        auto engine = addFolder(scheduler, fakeFolder);
+        QSignalSpy startedSpy(engine, &SyncEngine::syncStarting);
+        QSignalSpy finishedSpy(&scheduler, &SyncScheduler::finished);
+        scheduler.start();
+
+        QVERIFY(finishedSpy.wait());
+        QCOMPARE(finishedSpy.first().first().toBool(), true);
+        QCOMPARE(startedSpy.count(), 1);
+        QVERIFY(fakeFolder.currentRemoteState().find("A/new"));
+    }
+
+    void testLocalChangesTriggerSync()
+    {
+#ifdef Q_OS_MAC
+        QSKIP("The watcher discards the changes made by this process");
+#endif
+        FakeFolder fakeFolder{ FileInfo::A12_B12_C12_S12() };
+
+        SyncScheduler scheduler(fakeFolder.account());
+        scheduler.setWatchChanges(true);
+        // Remote changes don't matter here
+        scheduler.setPollInterval(std::chrono::hours(1));
+        auto engine = addFolder(scheduler, fakeFolder);
+        QSignalSpy startedSpy(engine, &SyncEngine::syncStarting);
+        QSignalSpy finishedSpy(engine, &SyncEngine::finished);
+        scheduler.start();
+
+        // The first sync looks at the whole tree
+        QVERIFY(finishedSpy.wait());
+        QCOMPARE(startedSpy.count(), 1);
+
+        // Nothing changed, nothing to sync
+        QVERIFY(!startedSpy.wait(2000));
+
+        // A burst of changes is synced in one run once it settles
+        fakeFolder.localModifier().insert("A/new1");
+        fakeFolder.localModifier().insert("B/new2");
+        fakeFolder.localModifier().appendByte("C/c1");
+        QVERIFY(finishedSpy.wait(5000));
+        QCOMPARE(startedSpy.count(), 2);
+        QCOMPARE(finishedSpy.last().first().toBool(), true);
+        QCOMPARE(fakeFolder.currentLocalState(), fakeFolder.currentRemoteState());
+
+        // The sync's own changes to the files and the journal don't start another one
+        QVERIFY(!startedSpy.wait(2000));
+    }
+};
+
+QTEST_GUILESS_MAIN(TestSyncScheduler)
+#include "testsyncscheduler.moc"
@@ -0,0 +1,73 @@
+/*
+ *    This software is in the public domain, furnished "as is", without technical
+ *    support, and with no warranty, express or implied, as to its usefulness for
+ *    any purpose.
+ *
+ */
+
+#include <QtTest>
+#include "syncenginetestutils.h"
+#include <syncengine.h>
+#include <syncstatistics.h>
+
+using namespace OCC;
+
+class TestSyncStatistics : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void testRunRecord()
+    {
+        FakeFolder fakeFolder{ FileInfo::A12_B12_C12_S12() };
+        SyncStatistics statistics(&fakeFolder.syncEngine(), &fakeFolder.syncJournal());
+        QSignalSpy runFinished(&statistics, &SyncStatistics::runFinished);
+
+        fakeFolder.localModifier().insert("A/up", 100);
+        fakeFolder.remoteModifier().insert("B/down", 200);
+        fakeFolder.remoteModifier().insert("C/down", 300);
+        QVERIFY(fakeFolder.syncOnce());
+        QCOMPARE(fakeFolder.currentLocalState(), fakeFolder.currentRemoteState());
+
+        QCOMPARE(runFinished.count(), 1);
+        const auto record = runFinished.first().first().toJsonObject();
+        QCOMPARE(record["success"].toBool(), true);
+
+        const auto items = record["items"].toObject();
+        QCOMPARE(items["up"].toObject()["new"].toObject()["count"].toInt(), 1);
+        QCOMPARE(items["up"].toObject()["new"].toObject()["bytes"].toInt(), 100);
+        QCOMPARE(items["down"].toObject()["new"].toObject()["count"].toInt(), 2);
+        QCOMPARE(items["down"].toObject()["new"].toObject()["bytes"].toInt(), 500);
+        QCOMPARE(record["itemStatus"].toObject()["success"].toInt(), 3);
+        QCOMPARE(record["retries"].toInt(), 0);
+
+        // At least the root was listed
+        const auto propfind = record["propfind"].toObject();
+        QVERIFY(propfind["count"].toInt() >= 1);
+        int histogramCount = 0;
+        for (const auto &bucket : propfind["histogram"].toArray()) {
+            histogramCount += bucket.toObject()["count"].toInt();
+        }
+        QCOMPARE(histogramCount, propfind["count"].toInt());
+
+        const auto duration = record["durationMsec"].toObject();
+        QCOMPARE(duration["discovery"].toInt() + duration["propagation"].toInt(), duration["total"].toInt());
+        QVERIFY(record["journalCommits"].toInt() > 0);
+        QVERIFY(record["requests"].toObject().contains("http2"));
+
+        // The next run has nothing to do, it still gets a record of its own
+        QVERIFY(fakeFolder.syncOnce());
+        QCOMPARE(runFinished.count(), 2);
+        const auto secondRecord = runFinished.last().first().toJsonObject();
+        QCOMPARE(secondRecord["success"].toBool(), true);
+        QVERIFY(secondRecord["propfind"].toObject()["count"].toInt() >= 1);
+        const auto secondDuration = secondRecord["durationMsec"].toObject();
+        QCOMPARE(secondDuration["discovery"].toInt() + secondDuration["propagation"].toInt(), secondDuration["total"].toInt());
+        const auto secondItems = secondRecord["items"].toObject();
+        QVERIFY(!secondItems["up"].toObject().contains("new"));
+        QVERIFY(!secondItems["down"].toObject().contains("new"));
+    }
+};
+
+QTEST_GUILESS_MAIN(TestSyncStatistics)
+#include "testsyncstatistics.moc"
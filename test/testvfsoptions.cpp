@@ -0,0 +1,120 @@
+/*
+ *    This software is in the public domain, furnished "as is", without technical
+ *    support, and with no warranty, express or implied, as to its usefulness for
+ *    any purpose.
+ *
+ */
+
+#include <QtTest>
+#include "syncenginetestutils.h"
+#include "cmd/vfsoptions.h"
+#include "common/vfs.h"
+#include "config.h"
+#include <syncengine.h>
+
+using namespace OCC;
+
+#define DVSUFFIX APPLICATION_DOTVIRTUALFILE_SUFFIX
+
+class TestVfsOptions : public QObject
+{
+    Q_OBJECT
+
+    /* Starts suffix virtual files on the fake folder and applies the options, like nextcloudcmd does */
+    static QSharedPointer<Vfs> setupVfs(FakeFolder &fakeFolder, const VfsOptions &options)
+    {
+        auto vfs = QSharedPointer<Vfs>(createVfsFromPlugin(options.mode).release());
+        fakeFolder.switchToVfs(vfs);
+        options.setupFolder(*vfs, fakeFolder.localPath(), fakeFolder.syncJournal(), true);
+        return vfs;
+    }
+
+private slots:
+    void testParseOption()
+    {
+        VfsOptions options;
+        QVERIFY(options.parseOption("--vfs", "suffix"));
+        QCOMPARE(options.mode, Vfs::WithSuffix);
+        QVERIFY(options.parseOption("--vfs", "xattr"));
+        QCOMPARE(options.mode, Vfs::XAttr);
+        QVERIFY(!options.parseOption("--vfs", "bogus"));
+        QCOMPARE(options.mode, Vfs::XAttr);
+
+        // The client's config doesn't know xattr
+        QVERIFY(!Vfs::modeFromString("xattr"));
+
+        QVERIFY(options.parseOption("--hydrate", "A/"));
+        QVERIFY(options.parseOption("--dehydrate", "B/b1" DVSUFFIX));
+        QVERIFY(!options.parseOption("--watch", "A"));
+        QCOMPARE(options.pinStates.size(), 2);
+        QCOMPARE(options.pinStates[0].first, QStringLiteral("A/"));
+        QVERIFY(options.pinStates[0].second == PinState::AlwaysLocal);
+        QCOMPARE(options.pinStates[1].first, QStringLiteral("B/b1" DVSUFFIX));
+        QVERIFY(options.pinStates[1].second == PinState::OnlineOnly);
+    }
+
+    void testNewFolderWithSuffix()
+    {
+        FakeFolder fakeFolder{ FileInfo() };
+        fakeFolder.remoteModifier().mkdir("A");
+        fakeFolder.remoteModifier().insert("A/a1");
+        fakeFolder.remoteModifier().mkdir("B");
+        fakeFolder.remoteModifier().insert("B/b1");
+
+        VfsOptions options;
+        QVERIFY(options.parseOption("--vfs", "suffix"));
+        QVERIFY(options.parseOption("--hydrate", "A/"));
+        setupVfs(fakeFolder, options);
+        QCOMPARE(*fakeFolder.syncJournal().internalPinStates().rawForPath(""), PinState::OnlineOnly);
+        QCOMPARE(*fakeFolder.syncJournal().internalPinStates().rawForPath("A"), PinState::AlwaysLocal);
+
+        // A new folder gets virtual files, except below the hydrated paths
+        QVERIFY(fakeFolder.syncOnce());
+        QVERIFY(fakeFolder.currentLocalState().find("A/a1"));
+        QVERIFY(!fakeFolder.currentLocalState().find("A/a1" DVSUFFIX));
+        QVERIFY(fakeFolder.currentLocalState().find("B/b1" DVSUFFIX));
+        QVERIFY(!fakeFolder.currentLocalState().find("B/b1"));
+    }
+
+    void testExistingFolderWithSuffix()
+    {
+        FakeFolder fakeFolder{ FileInfo::A12_B12_C12_S12() };
+
+        VfsOptions options;
+        QVERIFY(options.parseOption("--vfs", "suffix"));
+        QVERIFY(options.parseOption("--dehydrate", "A/"));
+        setupVfs(fakeFolder, options);
+        QCOMPARE(*fakeFolder.syncJournal().internalPinStates().rawForPath(""), PinState::Unspecified);
+
+        // The files of a folder synced before are kept, except below the dehydrated paths
+        QVERIFY(fakeFolder.syncOnce());
+        QVERIFY(fakeFolder.currentLocalState().find("A/a1" DVSUFFIX));
+        QVERIFY(fakeFolder.currentLocalState().find("A/a2" DVSUFFIX));
+        QVERIFY(!fakeFolder.currentLocalState().find("A/a1"));
+        QVERIFY(fakeFolder.currentLocalState().find("B/b1"));
+        QVERIFY(fakeFolder.currentLocalState().find("C/c1"));
+
+        // A dehydrated file can be hydrated again on the next run, by its placeholder name or its own
+        VfsOptions nextRun;
+        QVERIFY(nextRun.parseOption("--vfs", "suffix"));
+        QVERIFY(nextRun.parseOption("--hydrate", "A/a1" DVSUFFIX));
+        QVERIFY(nextRun.parseOption("--hydrate", "A/a2"));
+        setupVfs(fakeFolder, nextRun);
+        QCOMPARE(*fakeFolder.syncJournal().internalPinStates().rawForPath(""), PinState::Unspecified);
+
+        QVERIFY(fakeFolder.syncOnce());
+        QVERIFY(fakeFolder.currentLocalState().find("A/a1"));
+        QVERIFY(!fakeFolder.currentLocalState().find("A/a1" DVSUFFIX));
+        QVERIFY(fakeFolder.currentLocalState().find("A/a2"));
+        QVERIFY(!fakeFolder.currentLocalState().find("A/a2" DVSUFFIX));
+        QVERIFY(fakeFolder.currentLocalState().find("B/b1"));
+
+        // The pin states moved along with the files, they stay hydrated
+        QVERIFY(fakeFolder.syncOnce());
+        QVERIFY(fakeFolder.currentLocalState().find("A/a1"));
+        QVERIFY(fakeFolder.currentLocalState().find("A/a2"));
+    }
+};
+
+QTEST_GUILESS_MAIN(TestVfsOptions)
+#include "testvfsoptions.moc"